@@ -0,0 +1,400 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CGLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <cglm/cglm.h>
+#include <SDL3/SDL.h>
+
+#include "a3d.h"
+#include "a3d_logging.h"
+#include "a3d_mesh.h"
+#include "a3d_profiler.h"
+#include "a3d_renderer.h"
+#include "vulkan/a3d_vulkan.h"
+
+/* synthetic meshes are regular polygons, side counts cycle through this range */
+#define BENCH_MIN_SIDES 3
+#define BENCH_MAX_SIDES 32
+
+typedef struct {
+	Uint32   meshes; /* draw items per frame */
+	Uint32   unique; /* distinct meshes they share */
+	float    churn; /* fraction of transforms rewritten each frame */
+	Uint32   frames;
+	Uint32   warmup; /* untimed frames before measuring */
+	Uint32   seed;
+	int      width;
+	int      height;
+	bool     gpu_cull;
+	bool     standalone; /* a buffer pair per mesh instead of one shared pool */
+	bool     packed; /* a3d_vertex_packed instead of float vertices */
+} bench_config;
+
+typedef struct {
+	const a3d_mesh* mesh;
+	vec3     position;
+	float    spin;
+	mat4     model;
+} bench_object;
+
+static int compare_u64(const void* a, const void* b);
+static bool create_meshes(a3d* e, a3d_mesh_pool* pool, a3d_mesh* meshes, const bench_config* cfg);
+static bool parse_args(int argc, char** argv, bench_config* cfg);
+static Uint64 percentile(const Uint64* sorted, Uint32 count, double p);
+static void place_objects(bench_object* objects, const bench_config* cfg, a3d_mesh* meshes, Uint32* rng);
+static Uint32 xorshift(Uint32* state);
+
+int main(int argc, char** argv)
+{
+	bench_config cfg = {
+		.meshes = 10000,
+		.unique = 16,
+		.churn = 0.1f,
+		.frames = 1000,
+		.warmup = 60,
+		.seed = 1,
+		.width = 1280,
+		.height = 720
+	};
+	if (!parse_args(argc, argv, &cfg))
+		return EXIT_FAILURE;
+
+	/* headless has no present, so no vsync, and runs on lavapipe */
+	a3d engine;
+	if (!a3d_init_headless(&engine, cfg.width, cfg.height)) {
+		A3D_LOG_ERROR("engine initialisation failed");
+		return EXIT_FAILURE;
+	}
+
+	if (cfg.gpu_cull && !a3d_set_gpu_culling(&engine, true))
+		A3D_LOG_WARN("gpu culling unavailable, benchmarking the cpu cull");
+
+	a3d_mesh* meshes = calloc(cfg.unique, sizeof *meshes);
+	bench_object* objects = malloc(cfg.meshes * sizeof *objects);
+	Uint64* frame_ns = malloc(cfg.frames * sizeof *frame_ns);
+	a3d_profile_event* events = malloc(A3D_PROFILER_EVENTS * sizeof *events);
+	if (!meshes || !objects || !frame_ns || !events) {
+		A3D_LOG_ERROR("out of memory for %u objects", cfg.meshes);
+		return EXIT_FAILURE;
+	}
+
+	a3d_mesh_pool pool = {0};
+	if (!create_meshes(&engine, &pool, meshes, &cfg)) {
+		A3D_LOG_ERROR("failed to create bench meshes");
+		a3d_quit(&engine);
+		return EXIT_FAILURE;
+	}
+
+	Uint32 rng = cfg.seed ? cfg.seed : 1;
+	place_objects(objects, &cfg, meshes, &rng);
+
+	/* looking down -z at a grid that fills the view */
+	mat4 view;
+	mat4 proj;
+	glm_lookat((vec3){0.0f, 0.0f, 0.0f}, (vec3){0.0f, 0.0f, -1.0f}, (vec3){0.0f, 1.0f, 0.0f}, view);
+	glm_perspective(glm_rad(70.0f), (float)cfg.width / (float)cfg.height, 0.1f, 1000.0f, proj);
+	proj[1][1] *= -1.0f;
+	a3d_set_camera(&engine, view, proj);
+
+	Uint32 churned = (Uint32)(cfg.churn * cfg.meshes + 0.5f);
+	Uint32 cursor = 0;
+	Uint64 first_timed_frame = 0;
+	Uint64 draws = 0;
+	Uint32 timed = 0;
+	Uint64 timed_ns = 0;
+
+	for (Uint32 f = 0; f < cfg.warmup + cfg.frames && engine.running; f++) {
+		Uint64 start = SDL_GetTicksNS();
+
+		/* a sliding window of transforms changes, the rest are resubmitted as is */
+		float t = f * (1.0f / 60.0f);
+		for (Uint32 i = 0; i < churned; i++) {
+			bench_object* o = &objects[cursor];
+			glm_translate_make(o->model, o->position);
+			glm_rotate(o->model, t * o->spin, (vec3){0.0f, 0.0f, 1.0f});
+			cursor = (cursor + 1) % cfg.meshes;
+		}
+
+		a3d_renderer_begin_frame(engine.renderer);
+		for (Uint32 i = 0; i < cfg.meshes; i++)
+			a3d_submit_mesh(&engine, objects[i].mesh, objects[i].model);
+		a3d_renderer_end_frame(engine.renderer);
+
+		a3d_frame(&engine);
+
+		Uint64 elapsed = SDL_GetTicksNS() - start;
+		if (f == cfg.warmup)
+			first_timed_frame = a3d_profiler_frame();
+		if (f >= cfg.warmup) {
+			frame_ns[timed++] = elapsed;
+			timed_ns += elapsed;
+			draws += cfg.meshes;
+		}
+	}
+	vkDeviceWaitIdle(engine.vk.logical);
+
+	/* gpu frame times come back through the profiler ring, the tail of the run survives in it */
+	Uint32 event_count = a3d_profiler_collect(events, A3D_PROFILER_EVENTS);
+	Uint64* gpu_ns = malloc(event_count * sizeof *gpu_ns + 1);
+	Uint32 gpu_count = 0;
+	for (Uint32 i = 0; gpu_ns && i < event_count; i++)
+		if (events[i].gpu && events[i].frame >= first_timed_frame && strcmp(events[i].name, "gpu frame") == 0)
+			gpu_ns[gpu_count++] = events[i].end_ns - events[i].start_ns;
+
+	qsort(frame_ns, timed, sizeof *frame_ns, compare_u64);
+	if (gpu_ns)
+		qsort(gpu_ns, gpu_count, sizeof *gpu_ns, compare_u64);
+
+	VkPhysicalDeviceProperties props;
+	vkGetPhysicalDeviceProperties(engine.vk.physical, &props);
+
+	/* keep queued engine logs from landing in the middle of the report */
+	a3d_log_flush();
+
+	printf("device       %s\n", props.deviceName);
+	printf(
+		"scene        meshes=%u unique=%u churn=%.3f frames=%u warmup=%u seed=%u %dx%d %s %s %s\n",
+		cfg.meshes, cfg.unique, cfg.churn, timed, cfg.warmup, cfg.seed, cfg.width, cfg.height,
+		engine.renderer->gpu_culling ? "gpu-cull" : "cpu-cull", cfg.standalone ? "standalone" : "pooled",
+		cfg.packed ? "packed" : "float"
+	);
+	if (timed == 0)
+		A3D_LOG_ERROR("run stopped before any timed frame");
+	else {
+		printf(
+			"cpu frame    p50=%.3fms p95=%.3fms p99=%.3fms\n",
+			percentile(frame_ns, timed, 0.50) / 1e6,
+			percentile(frame_ns, timed, 0.95) / 1e6,
+			percentile(frame_ns, timed, 0.99) / 1e6
+		);
+		printf("draws/sec    %.0f\n", draws / (timed_ns / 1e9));
+	}
+
+	if (gpu_ns && gpu_count)
+		printf(
+			"gpu frame    p50=%.3fms p95=%.3fms p99=%.3fms (%u samples)\n",
+			percentile(gpu_ns, gpu_count, 0.50) / 1e6,
+			percentile(gpu_ns, gpu_count, 0.95) / 1e6,
+			percentile(gpu_ns, gpu_count, 0.99) / 1e6,
+			gpu_count
+		);
+	else
+		printf("gpu frame    n/a (no timestamp queries or A3D_PROFILER off)\n");
+
+	for (Uint32 i = 0; i < cfg.unique; i++)
+		a3d_destroy_mesh(&engine, &meshes[i]);
+	if (!cfg.standalone)
+		a3d_destroy_mesh_pool(&engine, &pool);
+	a3d_quit(&engine);
+
+	free(gpu_ns);
+	free(events);
+	free(frame_ns);
+	free(objects);
+	free(meshes);
+	return timed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* private */
+static int compare_u64(const void* a, const void* b)
+{
+	Uint64 x = *(const Uint64*)a;
+	Uint64 y = *(const Uint64*)b;
+	return (x > y) - (x < y);
+}
+
+/* triangle fans around the origin, each mesh a different polygon and colour */
+static bool create_meshes(a3d* e, a3d_mesh_pool* pool, a3d_mesh* meshes, const bench_config* cfg)
+{
+	Uint32 count = cfg->unique;
+	a3d_vertex_format format = cfg->packed ? A3D_VERTEX_FORMAT_PACKED : A3D_VERTEX_FORMAT_FLOAT;
+	Uint32 vertex_size = a3d_vertex_format_stride(format);
+	Uint32 stride_vertices = BENCH_MAX_SIDES + 1;
+	Uint32 stride_indices = 3 * BENCH_MAX_SIDES;
+	char* vertices = malloc((size_t)count * stride_vertices * vertex_size);
+	Uint16* indices = malloc(count * stride_indices * sizeof *indices);
+	a3d_mesh_desc* descs = malloc(count * sizeof *descs);
+	if (!vertices || !indices || !descs) {
+		A3D_LOG_ERROR("out of memory for %u bench meshes", count);
+		free(vertices);
+		free(indices);
+		free(descs);
+		return false;
+	}
+
+	/* every polygon fits the same box, packed positions are quantised against it */
+	vec3 aabb_min = {-0.5f, -0.5f, 0.0f};
+	vec3 aabb_max = {0.5f, 0.5f, 0.0f};
+
+	Uint32 vertex_total = 0;
+	Uint32 index_total = 0;
+	for (Uint32 m = 0; m < count; m++) {
+		Uint32 sides = BENCH_MIN_SIDES + m % (BENCH_MAX_SIDES - BENCH_MIN_SIDES + 1);
+		float hue = (float)m / (float)count;
+		char* v = vertices + (size_t)m * stride_vertices * vertex_size;
+		Uint16* idx = indices + m * stride_indices;
+
+		for (Uint32 s = 0; s <= sides; s++) {
+			/* centre first, then the rim */
+			float angle = 2.0f * GLM_PIf * (s ? s - 1 : 0) / sides;
+			float position[3] = {s ? 0.5f * cosf(angle) : 0.0f, s ? 0.5f * sinf(angle) : 0.0f, 0.0f};
+			float colour[4] = {s ? hue : 1.0f, s ? 1.0f - hue : 1.0f, s ? 0.5f : 1.0f, 1.0f};
+
+			if (cfg->packed)
+				a3d_pack_vertex(position, NULL, colour, NULL, aabb_min, aabb_max, (a3d_vertex_packed*)v + s);
+			else
+				((a3d_vertex*)v)[s] = (a3d_vertex){
+					.position = {position[0], position[1]},
+					.colour = {colour[0], colour[1], colour[2]}
+				};
+		}
+
+		/* counter clockwise */
+		for (Uint32 s = 0; s < sides; s++) {
+			idx[3 * s + 0] = 0;
+			idx[3 * s + 1] = (Uint16)(s + 1);
+			idx[3 * s + 2] = (Uint16)((s + 1) % sides + 1);
+		}
+
+		descs[m] = (a3d_mesh_desc){
+			.vertices = v,
+			.vertex_count = sides + 1,
+			.indices = idx,
+			.index_count = 3 * sides,
+			.aabb_min = {aabb_min[0], aabb_min[1], aabb_min[2]},
+			.aabb_max = {aabb_max[0], aabb_max[1], aabb_max[2]}
+		};
+		vertex_total += sides + 1;
+		index_total += 3 * sides;
+	}
+
+	bool ok = true;
+	if (!cfg->standalone) {
+		ok = a3d_create_mesh_pool(e, pool, format, vertex_total, index_total);
+		if (ok && !a3d_create_meshes(e, pool, meshes, descs, count)) {
+			a3d_destroy_mesh_pool(e, pool);
+			ok = false;
+		}
+	}
+	else {
+		for (Uint32 m = 0; ok && m < count; m++) {
+			if (cfg->packed)
+				ok = a3d_create_packed_mesh(e, &meshes[m], &descs[m]);
+			else
+				ok = a3d_create_mesh(
+					e, &meshes[m], descs[m].vertices, descs[m].vertex_count,
+					descs[m].indices, descs[m].index_count
+				);
+			if (!ok)
+				for (Uint32 i = 0; i < m; i++)
+					a3d_destroy_mesh(e, &meshes[i]);
+		}
+	}
+
+	free(vertices);
+	free(indices);
+	free(descs);
+	return ok;
+}
+
+static bool parse_args(int argc, char** argv, bench_config* cfg)
+{
+	for (int i = 1; i < argc; i++) {
+		const char* arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+
+		if (strcmp(arg, "--gpu-cull") == 0) {
+			cfg->gpu_cull = true;
+			continue;
+		}
+		if (strcmp(arg, "--standalone") == 0) {
+			cfg->standalone = true;
+			continue;
+		}
+		if (strcmp(arg, "--packed") == 0) {
+			cfg->packed = true;
+			continue;
+		}
+
+		if (!value) {
+			fprintf(stderr, "missing value for %s\n", arg);
+			return false;
+		}
+		i++;
+
+		if (strcmp(arg, "--meshes") == 0)
+			cfg->meshes = (Uint32)strtoul(value, NULL, 10);
+		else if (strcmp(arg, "--unique") == 0)
+			cfg->unique = (Uint32)strtoul(value, NULL, 10);
+		else if (strcmp(arg, "--churn") == 0)
+			cfg->churn = strtof(value, NULL);
+		else if (strcmp(arg, "--frames") == 0)
+			cfg->frames = (Uint32)strtoul(value, NULL, 10);
+		else if (strcmp(arg, "--warmup") == 0)
+			cfg->warmup = (Uint32)strtoul(value, NULL, 10);
+		else if (strcmp(arg, "--seed") == 0)
+			cfg->seed = (Uint32)strtoul(value, NULL, 10);
+		else if (strcmp(arg, "--width") == 0)
+			cfg->width = atoi(value);
+		else if (strcmp(arg, "--height") == 0)
+			cfg->height = atoi(value);
+		else {
+			fprintf(
+				stderr,
+				"usage: %s [--meshes N] [--unique M] [--churn 0..1] [--frames F] [--warmup W]\n"
+				"          [--seed S] [--width W] [--height H] [--gpu-cull] [--standalone] [--packed]\n",
+				argv[0]
+			);
+			return false;
+		}
+	}
+
+	if (cfg->meshes == 0 || cfg->unique == 0 || cfg->frames == 0 || cfg->width <= 0 || cfg->height <= 0) {
+		fprintf(stderr, "meshes, unique, frames and the size must all be positive\n");
+		return false;
+	}
+	if (cfg->unique > cfg->meshes)
+		cfg->unique = cfg->meshes;
+	if (cfg->churn < 0.0f)
+		cfg->churn = 0.0f;
+	if (cfg->churn > 1.0f)
+		cfg->churn = 1.0f;
+
+	return true;
+}
+
+/* nearest rank on an ascending array */
+static Uint64 percentile(const Uint64* sorted, Uint32 count, double p)
+{
+	Uint32 rank = (Uint32)ceil(p * count);
+	return sorted[rank ? rank - 1 : 0];
+}
+
+/* a square grid of slabs receding from the camera, seeded so every run sees the same scene */
+static void place_objects(bench_object* objects, const bench_config* cfg, a3d_mesh* meshes, Uint32* rng)
+{
+	Uint32 side = (Uint32)ceilf(sqrtf((float)cfg->meshes));
+
+	for (Uint32 i = 0; i < cfg->meshes; i++) {
+		bench_object* o = &objects[i];
+		o->mesh = &meshes[xorshift(rng) % cfg->unique];
+		o->position[0] = ((float)(i % side) - 0.5f * side) * 1.1f;
+		o->position[1] = ((float)((i / side) % side) - 0.5f * side) * 1.1f;
+		o->position[2] = -(float)side - (float)(xorshift(rng) % 1024) / 64.0f;
+		o->spin = (float)(xorshift(rng) % 2048) / 1024.0f - 1.0f;
+
+		glm_translate_make(o->model, o->position);
+	}
+}
+
+static Uint32 xorshift(Uint32* state)
+{
+	Uint32 x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return *state = x;
+}
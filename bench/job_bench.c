@@ -0,0 +1,217 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL3/SDL.h>
+
+#include "a3d_job.h"
+#include "a3d_logging.h"
+
+/* batch sizes the parallel for sweep tries, per call */
+static const Uint32 batches[] = {1, 4, 16, 64, 256, 1024, 4096};
+
+typedef struct {
+	Uint32   workers; /* 0 for one per core */
+	Uint32   jobs;    /* empty jobs per spawn and steal run */
+	Uint32   items;   /* elements per parallel for */
+	Uint32   work;    /* flops per element, sets how fine grained a batch is */
+	Uint32   repeat;  /* runs per measurement, the median is reported */
+} bench_config;
+
+typedef struct {
+	float*   values;
+	Uint32   work;
+} bench_array;
+
+static int compare_u64(const void* a, const void* b);
+static void empty_job(void* data, Uint32 first, Uint32 count);
+static Uint64 median(Uint64* samples, Uint32 count);
+static bool parse_args(int argc, char** argv, bench_config* cfg);
+static void scale_job(void* data, Uint32 first, Uint32 count);
+static Uint64 time_parallel_for(bench_array* array, const bench_config* cfg, Uint32 batch, Uint64* samples);
+static Uint64 time_spawn(const bench_config* cfg, bool help, Uint64* samples);
+
+int main(int argc, char** argv)
+{
+	bench_config cfg = {
+		.workers = 0,
+		.jobs = 100000,
+		.items = 1 << 20,
+		.work = 16,
+		.repeat = 9
+	};
+	if (!parse_args(argc, argv, &cfg))
+		return EXIT_FAILURE;
+
+	if (!a3d_job_init(cfg.workers)) {
+		A3D_LOG_ERROR("job system initialisation failed");
+		return EXIT_FAILURE;
+	}
+	Uint32 threads = a3d_job_worker_count();
+
+	bench_array array = {.values = malloc(cfg.items * sizeof(float)), .work = cfg.work};
+	Uint64* samples = malloc(cfg.repeat * sizeof *samples);
+	if (!array.values || !samples) {
+		A3D_LOG_ERROR("out of memory for %u items", cfg.items);
+		free(array.values);
+		free(samples);
+		a3d_job_shutdown();
+		return EXIT_FAILURE;
+	}
+
+	printf("threads      %u\n", threads);
+
+	/* a plain call, the floor every job pays on top of */
+	for (Uint32 r = 0; r < cfg.repeat; r++) {
+		Uint64 start = SDL_GetTicksNS();
+		for (Uint32 i = 0; i < cfg.jobs; i++)
+			empty_job(NULL, i, 1);
+		samples[r] = SDL_GetTicksNS() - start;
+	}
+	printf("call         %8.1f ns/job\n", (double)median(samples, cfg.repeat) / cfg.jobs);
+
+	/* pushed and mostly popped again by the submitting thread */
+	printf("spawn        %8.1f ns/job\n", (double)time_spawn(&cfg, true, samples) / cfg.jobs);
+
+	/* the submitter only watches the counter, every job is taken by a thief */
+	if (threads > 1)
+		printf("steal        %8.1f ns/job\n", (double)time_spawn(&cfg, false, samples) / cfg.jobs);
+	else
+		printf("steal        n/a (no worker threads)\n");
+
+	/* where a batch stops paying for its job */
+	for (Uint32 r = 0; r < cfg.repeat; r++) {
+		Uint64 start = SDL_GetTicksNS();
+		scale_job(&array, 0, cfg.items);
+		samples[r] = SDL_GetTicksNS() - start;
+	}
+	Uint64 serial = median(samples, cfg.repeat);
+	printf("\nparallel for, %u items, %u flops each\n", cfg.items, cfg.work);
+	printf("serial       %8.3f ms\n", serial / 1e6);
+
+	for (size_t i = 0; i < sizeof batches / sizeof batches[0]; i++) {
+		if (batches[i] > cfg.items)
+			break;
+		Uint64 ns = time_parallel_for(&array, &cfg, batches[i], samples);
+		printf(
+			"batch %-6u %8.3f ms  %5.2fx  %6.1f ns/batch\n",
+			batches[i], ns / 1e6, (double)serial / ns, (double)ns * batches[i] / cfg.items
+		);
+	}
+
+	free(samples);
+	free(array.values);
+	a3d_job_shutdown();
+	return EXIT_SUCCESS;
+}
+
+/* private */
+static int compare_u64(const void* a, const void* b)
+{
+	Uint64 x = *(const Uint64*)a;
+	Uint64 y = *(const Uint64*)b;
+	return (x > y) - (x < y);
+}
+
+static void empty_job(void* data, Uint32 first, Uint32 count)
+{
+	(void)data;
+	(void)first;
+	(void)count;
+	/* keeps the plain call loop from being folded away */
+	__asm__ volatile("" ::: "memory");
+}
+
+static Uint64 median(Uint64* samples, Uint32 count)
+{
+	qsort(samples, count, sizeof *samples, compare_u64);
+	return samples[count / 2];
+}
+
+static bool parse_args(int argc, char** argv, bench_config* cfg)
+{
+	for (int i = 1; i < argc; i++) {
+		const char* arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+		if (!value) {
+			fprintf(stderr, "missing value for %s\n", arg);
+			return false;
+		}
+
+		if (strcmp(arg, "--workers") == 0)
+			cfg->workers = (Uint32)strtoul(value, NULL, 10);
+		else if (strcmp(arg, "--jobs") == 0)
+			cfg->jobs = (Uint32)strtoul(value, NULL, 10);
+		else if (strcmp(arg, "--items") == 0)
+			cfg->items = (Uint32)strtoul(value, NULL, 10);
+		else if (strcmp(arg, "--work") == 0)
+			cfg->work = (Uint32)strtoul(value, NULL, 10);
+		else if (strcmp(arg, "--repeat") == 0)
+			cfg->repeat = (Uint32)strtoul(value, NULL, 10);
+		else {
+			fprintf(
+				stderr,
+				"usage: %s [--workers W] [--jobs N] [--items M] [--work F] [--repeat R]\n",
+				argv[0]
+			);
+			return false;
+		}
+		i++;
+	}
+
+	if (cfg->jobs == 0 || cfg->items == 0 || cfg->repeat == 0) {
+		fprintf(stderr, "jobs, items and repeat must all be positive\n");
+		return false;
+	}
+
+	return true;
+}
+
+static void scale_job(void* data, Uint32 first, Uint32 count)
+{
+	bench_array* array = data;
+	for (Uint32 i = first; i < first + count; i++) {
+		float v = (float)i;
+		for (Uint32 k = 0; k < array->work; k++)
+			v = v * 0.999f + 0.5f;
+		array->values[i] = v;
+	}
+}
+
+static Uint64 time_parallel_for(bench_array* array, const bench_config* cfg, Uint32 batch, Uint64* samples)
+{
+	for (Uint32 r = 0; r < cfg->repeat; r++) {
+		Uint64 start = SDL_GetTicksNS();
+		a3d_job_parallel_for(cfg->items, batch, scale_job, array);
+		samples[r] = SDL_GetTicksNS() - start;
+	}
+
+	return median(samples, cfg->repeat);
+}
+
+/* submit and wait; without help the waiting thread never runs a job itself */
+static Uint64 time_spawn(const bench_config* cfg, bool help, Uint64* samples)
+{
+	for (Uint32 r = 0; r < cfg->repeat; r++) {
+		a3d_job_counter counter = {0};
+		Uint64 start = SDL_GetTicksNS();
+
+		/* past the deque size the rest run inline, so go in deque sized rounds */
+		for (Uint32 done = 0; done < cfg->jobs; done += A3D_JOB_DEQUE_SIZE) {
+			Uint32 n = cfg->jobs - done < A3D_JOB_DEQUE_SIZE ? cfg->jobs - done : A3D_JOB_DEQUE_SIZE;
+			for (Uint32 i = 0; i < n; i++)
+				a3d_job_submit(empty_job, NULL, &counter);
+
+			if (help)
+				a3d_job_wait(&counter);
+			else
+				while (SDL_GetAtomicInt(&counter.pending) > 0)
+					SDL_CPUPauseInstruction();
+		}
+
+		samples[r] = SDL_GetTicksNS() - start;
+	}
+
+	return median(samples, cfg->repeat);
+}
@@ -4,8 +4,11 @@
 
 #include <SDL3/SDL.h>
 #include <SDL3/SDL_vulkan.h>
+#include <cglm/types.h>
 #include <vulkan/vulkan_core.h>
 
+#include "a3d_vertex.h"
+
 #if !defined(A3D_VK_VALIDATION)
 #	ifndef NDEBUG
 #		define A3D_VK_VALIDATION 1
@@ -14,12 +17,42 @@
 #	endif
 #endif
 
+/* number of frames the cpu may record ahead of the gpu */
+#if !defined(A3D_VK_FRAMES_IN_FLIGHT)
+#	define A3D_VK_FRAMES_IN_FLIGHT 2
+#endif
+#if A3D_VK_FRAMES_IN_FLIGHT < 1 || A3D_VK_FRAMES_IN_FLIGHT > 3
+#	error "A3D_VK_FRAMES_IN_FLIGHT must be between 1 and 3"
+#endif
+
+/* vkCmdBeginRendering and synchronization2 instead of render pass objects, where the device has them */
+#if !defined(A3D_VK_DYNAMIC_RENDERING)
+#	define A3D_VK_DYNAMIC_RENDERING 1
+#endif
+
+/* swapchains retired by resizes that may still be presenting; past this many the oldest is waited out */
+#define A3D_VK_MAX_RETIRED_SWAPCHAINS 4
+
 /* structures */
 typedef struct a3d a3d;
 typedef void (*a3d_event_handler)(a3d *engine, const SDL_Event *e);
+/* headless frames, tightly packed rgba8; pixels are only valid during the call */
+typedef void (*a3d_readback_fn)(a3d* e, const void* pixels, Uint32 width, Uint32 height, Uint64 frame, void* user);
 typedef struct a3d_renderer a3d_renderer;
 typedef struct a3d_mesh a3d_mesh;
-typedef struct a3d_mvp a3d_mvp;
+typedef struct a3d_mesh_pool a3d_mesh_pool;
+typedef struct a3d_camera a3d_camera;
+typedef struct a3d_streamer a3d_streamer;
+typedef struct a3d_vk_allocator a3d_vk_allocator;
+typedef struct a3d_vk_uploader a3d_vk_uploader;
+typedef struct a3d_vk_sync a3d_vk_sync;
+typedef struct a3d_vk_descriptors a3d_vk_descriptors;
+typedef struct a3d_vk_bindless a3d_vk_bindless;
+typedef struct a3d_vk_recorder a3d_vk_recorder;
+typedef struct a3d_vk_gpu_cull a3d_vk_gpu_cull;
+typedef struct a3d_vk_headless a3d_vk_headless;
+typedef struct a3d_vk_profiler a3d_vk_profiler;
+typedef struct a3d_vk_graph a3d_vk_graph;
 
 #define A3D_MAX_HANDLERS 64
 typedef struct {
@@ -27,6 +60,13 @@ typedef struct {
 	a3d_event_handler fn;
 } a3d_handler_slot;
 
+/* per-slot state of the frames-in-flight ring */
+typedef struct {
+	VkCommandBuffer cmd;
+	VkSemaphore image_available;
+	Uint64   value; /* graphics timeline value of the slot's last submit, reached once it can be reused */
+} a3d_vk_frame;
+
 struct a3d {
 	/* SDL */
 	SDL_Window* window;
@@ -38,6 +78,7 @@ struct a3d {
 
 	bool        running;
 	bool        fb_resized;
+	bool        headless; /* no window, surface or swapchain */
 
 	/* vulkan & graphics */
 	struct {
@@ -47,44 +88,69 @@ struct a3d {
 
 		Uint32  graphics_family;
 		Uint32  present_family;
+		Uint32  transfer_family; /* graphics_family if there is no dedicated one */
+		Uint32  compute_family;  /* async compute, graphics_family if there is none */
 		VkQueue graphics_queue;
 		VkQueue present_queue;
+		VkQueue transfer_queue;
+		VkQueue compute_queue;
 
 		VkDevice logical;
 		VkPhysicalDevice physical;
+		bool    multi_draw_indirect; /* multiDrawIndirect and drawIndirectFirstInstance enabled */
+		bool    dynamic_rendering;   /* dynamicRendering and synchronization2 enabled */
+		a3d_vk_sync* sync; /* a timeline per queue, every submission goes through it */
+		a3d_vk_allocator* allocator;
+		a3d_vk_uploader* uploader;
 
+		a3d_vk_headless* headless; /* offscreen targets standing in for the swapchain images */
 		VkSwapchainKHR swapchain;
+		/* retired by resizes, oldest first, each destroyed once the graphics timeline reaches its value */
+		VkSwapchainKHR retired_swapchains[A3D_VK_MAX_RETIRED_SWAPCHAINS];
+		Uint64  retired_values[A3D_VK_MAX_RETIRED_SWAPCHAINS];
+		Uint32  retired_count;
 		VkFormat swapchain_fmt;
 		VkExtent2D swapchain_extent;
 		VkImage  swapchain_images[8];
 		VkImageView swapchain_views[8];
 		Uint32  swapchain_images_count;
 
-		VkRenderPass render_pass;
-		VkFramebuffer fbs[8];
+		a3d_vk_graph* graph; /* owns the render passes, framebuffers and depth buffer */
+		Uint32  main_pass;   /* graph handles, rebuilt with it */
+		Uint32  backbuffer;
+		bool    graph_gpu_cull; /* built with the cull pass */
 		VkClearValue clear_col;
 
 		VkCommandPool cmd_pool;
-		VkCommandBuffer cmd_buffs[8];
+		a3d_vk_recorder* recorder;
 
-		VkSemaphore image_available;
-		VkSemaphore render_finished;
-		VkFence in_flight;
+		a3d_vk_frame frames[A3D_VK_FRAMES_IN_FLIGHT];
+		Uint32 frame_index;
+		/* indexed by swapchain image */
+		VkSemaphore render_finished[8];
+		Uint64  images_in_flight[8]; /* graphics value of the last submit rendering into each */
 
+		a3d_vk_descriptors* descriptors;
+		a3d_vk_bindless* bindless; /* global arrays every draw indexes into */
+		VkPipelineCache pipeline_cache;
 		VkPipelineLayout pipeline_layout;
-		VkPipeline pipeline;
+		VkPipeline pipelines[A3D_VERTEX_FORMAT_COUNT]; /* one per vertex layout, sharing the layout above */
+		a3d_vk_gpu_cull* gpu_cull; /* NULL if the device can't draw indirect with a count */
+		a3d_vk_profiler* profiler; /* NULL without timestamp queries or with A3D_PROFILER off */
 
-		VkImage  depth_image;
-		VkDeviceMemory depth_mem;
-		VkImageView depth_view;
 		VkFormat depth_fmt;
 	} vk;
 
 	a3d_renderer* renderer;
+	a3d_streamer* streamer; /* NULL until a3d_stream_init */
 };
 
 /* declarations */
 void a3d_frame(a3d* e);
 bool a3d_init(a3d* e, const char* title, int w, int h);
+bool a3d_init_headless(a3d* e, int w, int h);
 void a3d_quit(a3d* e);
-bool a3d_submit_mesh(a3d* e, const a3d_mesh* mesh, const a3d_mvp* mvp);
\ No newline at end of file
+void a3d_set_camera(a3d* e, mat4 view, mat4 proj);
+bool a3d_set_gpu_culling(a3d* e, bool enabled);
+void a3d_set_readback(a3d* e, a3d_readback_fn fn, void* user);
+bool a3d_submit_mesh(a3d* e, const a3d_mesh* mesh, mat4 model);
\ No newline at end of file
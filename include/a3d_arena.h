@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* default page size, oversized requests get a page of their own */
+#define A3D_ARENA_PAGE_SIZE (64 * 1024)
+
+/* c99 has no _Alignof */
+#define A3D_ALIGNOF(T) offsetof(struct { char c; T x; }, x)
+
+typedef struct a3d_arena_page {
+	struct a3d_arena_page* next;
+	size_t   size;
+	size_t   used;
+	unsigned char data[];
+} a3d_arena_page;
+
+/* linear allocator, pages are kept across resets so steady state never mallocs */
+typedef struct {
+	a3d_arena_page* pages;
+	a3d_arena_page* current;
+	size_t   page_size;
+	size_t   used;       /* bytes handed out since the last reset */
+	size_t   high_water; /* largest used ever seen */
+	void*    last;       /* most recent allocation, can grow in place */
+} a3d_arena;
+
+void* a3d_arena_alloc(a3d_arena* a, size_t size, size_t align);
+void a3d_arena_destroy(a3d_arena* a);
+void* a3d_arena_grow(a3d_arena* a, void* ptr, size_t old_size, size_t new_size, size_t align);
+bool a3d_arena_init(a3d_arena* a, size_t initial_size);
+void a3d_arena_reset(a3d_arena* a);
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cglm/types.h>
+#include <SDL3/SDL_stdinc.h>
+
+/* planes point inward, (n, d) with |n| = 1 */
+typedef struct {
+	vec4     planes[6];
+} a3d_frustum;
+
+/* world-space boxes in structure-of-arrays form, 32 byte aligned and padded to a multiple of 8 */
+typedef struct {
+	float*   cx;
+	float*   cy;
+	float*   cz;
+	float*   ex;
+	float*   ey;
+	float*   ez;
+	Uint32   count;
+} a3d_cull_bounds;
+
+#define A3D_CULL_PAD(n) (((n) + 7u) & ~7u)
+
+Uint32 a3d_cull_aabbs(const a3d_frustum* frustum, const a3d_cull_bounds* bounds, Uint32* out_visible);
+void a3d_cull_transform_aabb(mat4 model, vec3 local_min, vec3 local_max, vec3 out_centre, vec3 out_extent);
+void a3d_frustum_from_matrix(a3d_frustum* frustum, mat4 view_proj);
@@ -0,0 +1,7 @@
+#pragma once
+
+#include "a3d.h"
+
+bool a3d_image_write_ppm(const char* path, const void* rgba, Uint32 width, Uint32 height);
+/* a3d_readback_fn writing each frame to disk; user is a printf pattern taking the frame number as %lu */
+void a3d_image_write_readback(a3d* e, const void* pixels, Uint32 width, Uint32 height, Uint64 frame, void* user);
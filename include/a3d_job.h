@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdbool.h>
+#include <SDL3/SDL.h>
+
+/* worker threads besides the main thread, whatever the core count */
+#if !defined(A3D_JOB_MAX_WORKERS)
+#	define A3D_JOB_MAX_WORKERS 31
+#endif
+/* per worker; a push onto a full deque runs the job inline instead. power of two */
+#define A3D_JOB_DEQUE_SIZE 4096
+/* jobs waiting for the main thread */
+#define A3D_JOB_MAIN_QUEUE_SIZE 256
+/* failed steal rounds before an idle worker sleeps until a push wakes it */
+#define A3D_JOB_SPIN 64
+
+/* plain jobs are called with first 0 and count 1, parallel for ranges with their slice */
+typedef void (*a3d_job_fn)(void* data, Uint32 first, Uint32 count);
+
+/* zero initialise; every submit against it adds one, a3d_job_wait returns once all have run */
+typedef struct {
+	SDL_AtomicInt pending;
+} a3d_job_counter;
+
+typedef struct {
+	a3d_job_fn fn;
+	void*    data;
+	Uint32   first;
+	Uint32   count;
+	a3d_job_counter* counter;
+} a3d_job;
+
+bool a3d_job_init(Uint32 workers);
+bool a3d_job_is_main_thread(void);
+void a3d_job_parallel_for(Uint32 count, Uint32 batch, a3d_job_fn fn, void* data);
+void a3d_job_run_main(void);
+void a3d_job_shutdown(void);
+void a3d_job_submit(a3d_job_fn fn, void* data, a3d_job_counter* counter);
+void a3d_job_submit_main(a3d_job_fn fn, void* data, a3d_job_counter* counter);
+void a3d_job_submit_range(a3d_job_fn fn, void* data, Uint32 first, Uint32 count, a3d_job_counter* counter);
+void a3d_job_wait(a3d_job_counter* counter);
+Uint32 a3d_job_worker_count(void);
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <stdio.h>
+#include <SDL3/SDL_atomic.h>
+#include <SDL3/SDL_stdinc.h>
 
 /* ANSI colours */
 #define ANSI_RESET     "\x1b[0m"
@@ -10,22 +12,112 @@
 #define ANSI_BG_RED    "\x1b[41m"
 #define ANSI_BG_YELLOW "\x1b[43m"
 
-/* logging */
-#define A3D_LOG(fmt, ...) \
-	fprintf(stdout, fmt "\n", ##__VA_ARGS__)
+/* levels, A3D_LOG is PLAIN and only OFF strips it */
+#define A3D_LOG_LEVEL_DEBUG 0
+#define A3D_LOG_LEVEL_INFO  1
+#define A3D_LOG_LEVEL_WARN  2
+#define A3D_LOG_LEVEL_ERROR 3
+#define A3D_LOG_LEVEL_PLAIN 4
+#define A3D_LOG_LEVEL_OFF   5
+
+/* calls below a subsystem's minimum compile away; define A3D_LOG_SUBSYSTEM before including */
+#if !defined(A3D_LOG_MIN_LEVEL)
+#	if defined(NDEBUG)
+#		define A3D_LOG_MIN_LEVEL A3D_LOG_LEVEL_INFO
+#	else
+#		define A3D_LOG_MIN_LEVEL A3D_LOG_LEVEL_DEBUG
+#	endif
+#endif
+#if !defined(A3D_LOG_MIN_CORE)
+#	define A3D_LOG_MIN_CORE A3D_LOG_MIN_LEVEL
+#endif
+#if !defined(A3D_LOG_MIN_RENDERER)
+#	define A3D_LOG_MIN_RENDERER A3D_LOG_MIN_LEVEL
+#endif
+#if !defined(A3D_LOG_MIN_VULKAN)
+#	define A3D_LOG_MIN_VULKAN A3D_LOG_MIN_LEVEL
+#endif
+#if !defined(A3D_LOG_SUBSYSTEM)
+#	define A3D_LOG_SUBSYSTEM CORE
+#endif
+
+/* records each thread can queue before the writer catches up, power of two */
+#if !defined(A3D_LOG_RING_RECORDS)
+#	define A3D_LOG_RING_RECORDS 512
+#endif
+/* longer messages are truncated */
+#define A3D_LOG_MESSAGE_SIZE 224
+/* messages a call site may log per window before the rest are only counted, 0 for no limit */
+#if !defined(A3D_LOG_RATE_BURST)
+#	define A3D_LOG_RATE_BURST 20
+#endif
+#define A3D_LOG_RATE_WINDOW_MS 1000
+/* the writer wakes at least this often, errors and filling rings wake it sooner */
+#define A3D_LOG_FLUSH_MS 10
 
-#define A3D_LOG_INFO(fmt, ...) \
-	fprintf(stdout, ANSI_FG_WHITE ANSI_BG_CYAN " INFO  " ANSI_RESET " " fmt "\n", ##__VA_ARGS__)
+/* binary log: this header once, then one a3d_log_binary_record per message followed by
+ * subsystem_len + file_len + message_len bytes of unterminated text */
+#define A3D_LOG_BINARY_MAGIC 0x4c443341 /* "A3DL" */
+#define A3D_LOG_BINARY_VERSION 1
 
-#define A3D_LOG_WARN(fmt, ...) \
-	fprintf(stderr, ANSI_FG_WHITE ANSI_BG_YELLOW " WARN  " ANSI_RESET " " fmt "\n", ##__VA_ARGS__)
+typedef struct {
+	Uint32   magic;
+	Uint32   version;
+} a3d_log_binary_header;
 
-#define A3D_LOG_ERROR(fmt, ...) \
-	fprintf(stderr, ANSI_FG_WHITE ANSI_BG_RED " ERROR " ANSI_RESET " %s:%d: " fmt "\n", __FILE__, __LINE__, ##__VA_ARGS__)
+typedef struct {
+	Uint64   time_ns;
+	Uint64   thread;
+	Uint32   seq;
+	Sint32   line;
+	Sint32   suppressed; /* messages the rate limit dropped at this site just before this one */
+	Uint16   level;
+	Uint16   subsystem_len;
+	Uint16   file_len;
+	Uint16   message_len;
+} a3d_log_binary_record;
 
-#if !defined(NDEBUG)
-#define A3D_LOG_DEBUG(fmt, ...) \
-	fprintf(stdout, ANSI_FG_WHITE ANSI_BG_MAGENTA " DEBUG " ANSI_RESET " " fmt "\n", ##__VA_ARGS__)
+/* one per call site, rate limiting state */
+typedef struct {
+	SDL_AtomicInt window;
+	SDL_AtomicInt count;
+	SDL_AtomicInt suppressed;
+} a3d_log_site;
+
+#if defined(__GNUC__)
+#	define A3D_LOG_PRINTF(fmt_index, args_index) __attribute__((format(printf, fmt_index, args_index)))
 #else
-#define A3D_LOG_DEBUG(fmt, ...) ((void)0)
+#	define A3D_LOG_PRINTF(fmt_index, args_index)
 #endif
+
+#define A3D_LOG_CAT_(a, b) a##b
+#define A3D_LOG_CAT(a, b) A3D_LOG_CAT_(a, b)
+#define A3D_LOG_STR_(a) #a
+#define A3D_LOG_STR(a) A3D_LOG_STR_(a)
+#define A3D_LOG_ENABLED(level) ((level) >= A3D_LOG_CAT(A3D_LOG_MIN_, A3D_LOG_SUBSYSTEM))
+
+#define A3D_LOG_AT(level, fmt, ...) \
+	do { \
+		if (A3D_LOG_ENABLED(level)) { \
+			static a3d_log_site a3d_log_site_; \
+			/* the leading %s keeps A3D_LOG() from being an empty format */ \
+			a3d_log_write( \
+				&a3d_log_site_, (level), A3D_LOG_STR(A3D_LOG_SUBSYSTEM), \
+				__FILE__, __LINE__, "%s" fmt, "", ##__VA_ARGS__ \
+			); \
+		} \
+	} while (0)
+
+/* logging */
+#define A3D_LOG(fmt, ...) A3D_LOG_AT(A3D_LOG_LEVEL_PLAIN, fmt, ##__VA_ARGS__)
+#define A3D_LOG_INFO(fmt, ...) A3D_LOG_AT(A3D_LOG_LEVEL_INFO, fmt, ##__VA_ARGS__)
+#define A3D_LOG_WARN(fmt, ...) A3D_LOG_AT(A3D_LOG_LEVEL_WARN, fmt, ##__VA_ARGS__)
+#define A3D_LOG_ERROR(fmt, ...) A3D_LOG_AT(A3D_LOG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
+#define A3D_LOG_DEBUG(fmt, ...) A3D_LOG_AT(A3D_LOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
+
+void a3d_log_flush(void);
+bool a3d_log_init(const char* binary_path);
+void a3d_log_shutdown(void);
+void a3d_log_write(
+	a3d_log_site* site, int level, const char* subsystem, const char* file, int line, const char* fmt, ...
+) A3D_LOG_PRINTF(6, 7);
@@ -1,23 +1,87 @@
 #pragma once
 
 #include "a3d.h"
+#include "a3d_vertex.h"
 #include "vulkan/a3d_vulkan_buffer.h"
 
-typedef struct a3d_vertex {
-	float    position[2];
-	float    colour[3];
-} a3d_vertex;
+/* levels of detail a mesh can carry */
+#define A3D_MESH_MAX_LODS 8
+
+typedef struct {
+	Uint32   first_index; /* absolute, like a3d_mesh::first_index */
+	Uint32   index_count;
+	float    distance; /* used up to this view distance */
+} a3d_mesh_lod;
+
+/* one mesh for a3d_create_meshes, vertices in the pool's format */
+typedef struct {
+	const void* vertices;
+	Uint32   vertex_count;
+	const Uint16* indices;
+	Uint32   index_count;
+	/* packed only: the box the positions were quantised against, float meshes compute their own */
+	vec3     aabb_min;
+	vec3     aabb_max;
+} a3d_mesh_desc;
+
+/* shared vertex and index buffers, meshes are bump allocated and only freed with the pool */
+struct a3d_mesh_pool {
+	a3d_vertex_format format; /* every mesh in the pool shares it */
+	a3d_buffer vertex_buffer;
+	Uint32   vertex_capacity;
+	Uint32   vertex_count;
+
+	a3d_buffer index_buffer;
+	Uint32   index_capacity;
+	Uint32   index_count;
+
+	Uint32   mesh_count;
+};
 
 struct a3d_mesh {
+	a3d_mesh_pool* pool; /* NULL if the buffers below are owned by the mesh */
 	a3d_buffer vertex_buffer;
 	Uint32   vertex_count;
 
 	a3d_buffer index_buffer;
 	Uint32   index_count;
 
+	/* where the mesh starts in its buffers, zero unless it lives in a pool */
+	Sint32   vertex_offset;
+	Uint32   first_index;
+
+	/* 0 without a lod table, otherwise lods[0] matches first_index and index_count */
+	Uint32   lod_count;
+	a3d_mesh_lod lods[A3D_MESH_MAX_LODS];
+
 	VkPrimitiveTopology topology;
+	a3d_vertex_format format; /* picks the pipeline; packed positions are snorm16 across the aabb */
+	Uint32   id; /* unique among live meshes and reused after destroy, feeds the renderer sort key */
+
+	/* local space bounds, computed at creation */
+	vec3     aabb_min;
+	vec3     aabb_max;
+	vec4     sphere; /* centre xyz, radius w */
 };
 
+bool a3d_create_mesh(
+	a3d* e, a3d_mesh* mesh, const a3d_vertex* vertices, Uint32 vertex_count,
+	const Uint16* indices, Uint32 index_count
+);
+bool a3d_create_mesh_pool(
+	a3d* e, a3d_mesh_pool* pool, a3d_vertex_format format, Uint32 vertex_capacity, Uint32 index_capacity
+);
+bool a3d_create_packed_mesh(a3d* e, a3d_mesh* mesh, const a3d_mesh_desc* desc);
+bool a3d_create_meshes(a3d* e, a3d_mesh_pool* pool, a3d_mesh* meshes, const a3d_mesh_desc* descs, Uint32 count);
+void a3d_bind_mesh(a3d* e, const a3d_mesh* mesh, VkCommandBuffer* cmd);
 void a3d_destroy_mesh(a3d* e, a3d_mesh* mesh);
-void a3d_draw_mesh(a3d* e, const a3d_mesh* mesh, VkCommandBuffer* cmd);
+void a3d_destroy_mesh_pool(a3d* e, a3d_mesh_pool* pool);
+void a3d_draw_mesh(a3d* e, const a3d_mesh* mesh, VkCommandBuffer* cmd, Uint32 first_instance, Uint32 instance_count);
 bool a3d_init_triangle(a3d* e, a3d_mesh* mesh);
+void a3d_mesh_normal_matrix(mat4 model, vec4 out_normal[3]);
+void a3d_mesh_shader_model(const a3d_mesh* mesh, mat4 model, mat4 out_model);
+bool a3d_mesh_pool_reserve(
+	a3d_mesh_pool* pool, Uint32 vertex_count, Uint32 index_count, Uint32* out_first_vertex, Uint32* out_first_index
+);
+Uint32 a3d_mesh_next_id(void);
+void a3d_mesh_release_id(Uint32 id);
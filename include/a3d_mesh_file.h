@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <SDL3/SDL_stdinc.h>
+
+#include "a3d.h"
+
+/* .a3dm: this header, then the vertex and index streams laid out exactly as the engine's vertex format
+ * and Uint16 so they can go from the mapping into the staging ring untouched */
+#define A3D_MESH_FILE_MAGIC 0x4d443341 /* "A3DM" */
+#define A3D_MESH_FILE_VERSION 1
+/* stream offsets are multiples of this */
+#define A3D_MESH_FILE_ALIGN 16
+#define A3D_MESH_FILE_MAX_LODS 8
+
+typedef struct {
+	Uint32   first_index; /* into the file's index stream */
+	Uint32   index_count;
+	float    distance; /* used up to this view distance, the last lod has no limit */
+	Uint32   pad;
+} a3d_mesh_file_lod;
+
+/* little endian, everything a multiple of 16 bytes so the streams can follow directly */
+typedef struct {
+	Uint32   magic;
+	Uint32   version;
+	Uint32   vertex_size; /* stride of vertex_format when written, a mismatch is rejected */
+	Uint32   index_size;
+
+	Uint32   vertex_count;
+	Uint32   index_count;
+	Uint32   lod_count;
+	Uint32   vertex_format; /* a3d_vertex_format; packed positions are quantised against aabb */
+
+	Uint64   vertex_offset; /* from the start of the file */
+	Uint64   index_offset;
+
+	float    aabb_min[4]; /* local space, w unused */
+	float    aabb_max[4];
+	float    sphere[4]; /* centre xyz, radius w */
+
+	a3d_mesh_file_lod lods[A3D_MESH_FILE_MAX_LODS];
+} a3d_mesh_file_header;
+
+/* a validated file, mapped read only until a3d_mesh_file_close */
+typedef struct {
+	const a3d_mesh_file_header* header;
+	const void* vertices;
+	const void* indices;
+	size_t   size;
+} a3d_mesh_file_view;
+
+void a3d_mesh_file_apply(const a3d_mesh_file_header* h, Uint32 first_vertex, Uint32 first_index, a3d_mesh* mesh);
+void a3d_mesh_file_close(a3d_mesh_file_view* view);
+bool a3d_mesh_file_open(const char* path, a3d_mesh_file_view* out_view);
+bool a3d_load_mesh_file(a3d* e, a3d_mesh_pool* pool, const char* path, a3d_mesh* mesh);
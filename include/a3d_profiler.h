@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdbool.h>
+#include <SDL3/SDL_stdinc.h>
+#include <SDL3/SDL_timer.h>
+
+/* scopes compile away entirely when 0 */
+#if !defined(A3D_PROFILER)
+#	define A3D_PROFILER 1
+#endif
+/* events kept before the oldest are overwritten, power of two */
+#define A3D_PROFILER_EVENTS 8192
+
+typedef struct {
+	const char* name; /* must outlive the profiler, string literals in practice */
+	Uint64   start_ns; /* SDL_GetTicksNS time base, gpu events are mapped onto it */
+	Uint64   end_ns;
+	Uint64   thread;
+	Uint64   frame;
+	bool     gpu;
+} a3d_profile_event;
+
+#if A3D_PROFILER
+#	define A3D_PROFILE_BEGIN(var) Uint64 var = SDL_GetTicksNS()
+#	define A3D_PROFILE_END(var, name) a3d_profiler_record((name), (var), SDL_GetTicksNS(), false)
+#else
+#	define A3D_PROFILE_BEGIN(var) ((void)0)
+#	define A3D_PROFILE_END(var, name) ((void)0)
+#endif
+
+void a3d_profiler_begin_frame(void);
+Uint32 a3d_profiler_collect(a3d_profile_event* out_events, Uint32 max_count);
+Uint64 a3d_profiler_frame(void);
+void a3d_profiler_record(const char* name, Uint64 start_ns, Uint64 end_ns, bool gpu);
+void a3d_profiler_record_frame(const char* name, Uint64 start_ns, Uint64 end_ns, Uint64 frame, bool gpu);
+bool a3d_profiler_write_trace(const char* path);
@@ -3,25 +3,82 @@
 #include <stdbool.h>
 #include <SDL3/SDL_stdinc.h>
 
+#include "a3d.h"
+#include "a3d_arena.h"
 #include "a3d_mesh.h"
 #include "a3d_transform.h"
 
-#define A3D_RENDERER_MAX_DRAW_CALLS 1024 /* change later */
+/* first page of each frame arena; raise it to the reported high-water mark to never grow */
+#if !defined(A3D_RENDERER_ARENA_SIZE)
+#	define A3D_RENDERER_ARENA_SIZE (256 * 1024)
+#endif
+/* item capacity the queue starts each frame with before doubling */
+#define A3D_RENDERER_INITIAL_ITEMS 256
+/* from this many items the world bounds are transformed on the job system, in batches */
+#if !defined(A3D_RENDERER_PARALLEL_ITEMS)
+#	define A3D_RENDERER_PARALLEL_ITEMS 4096
+#endif
+#if !defined(A3D_RENDERER_JOB_BATCH)
+#	define A3D_RENDERER_JOB_BATCH 1024
+#endif
+
+/*
+ * sort key fields, most significant first. state changes dominate: depth only orders draws front
+ * to back among items sharing pipeline, material and mesh, never across meshes. mesh ids are
+ * recycled slots, so the mesh field holds as long as fewer than 2^20 meshes are alive at once
+ */
+#define A3D_SORT_KEY_PIPELINE_BITS 8
+#define A3D_SORT_KEY_MATERIAL_BITS 12
+#define A3D_SORT_KEY_MESH_BITS 20
+#define A3D_SORT_KEY_DEPTH_BITS 24
 
 typedef struct a3d_draw_item {
 	const a3d_mesh* mesh;
-	a3d_mvp  mvp;
+	Uint64   key;
+	mat4     model;
 } a3d_draw_item;
 
+typedef struct {
+	Uint64   key;
+	Uint32   index;
+} a3d_sort_entry;
+
+/* a run of sorted items sharing a mesh, drawn as one instanced call */
+typedef struct a3d_draw_batch {
+	const a3d_mesh* mesh;
+	Uint32   first; /* first model matrix, passed as firstInstance */
+	Uint32   count;
+} a3d_draw_batch;
+
 struct a3d_renderer {
-	a3d_draw_item items[A3D_RENDERER_MAX_DRAW_CALLS];
+	/* one per frame in flight, reset when its frame comes round again */
+	a3d_arena arenas[A3D_VK_FRAMES_IN_FLIGHT];
+	Uint32   arena_index;
+
+	/* all of these live in the current frame arena */
+	a3d_draw_item* items;
+	Uint32   capacity;
 	Uint32   count;
+	a3d_draw_item* sorted; /* visible items only */
+	Uint32   visible_count;
+	a3d_draw_batch* batches;
+	Uint32   batch_count;
+	Uint32   last_count; /* sizes the next frame's queue up front */
+
+	a3d_camera camera;
 	bool     frame_active;
+	bool     gpu_culling; /* leave culling to the compute pass, every item reaches the gpu */
 };
 
 void a3d_renderer_begin_frame(a3d_renderer* r);
-bool a3d_renderer_draw_mesh(a3d_renderer* r, const a3d_mesh* mesh, const a3d_mvp* mvp);
+bool a3d_renderer_draw_mesh(a3d_renderer* r, const a3d_mesh* mesh, mat4 model);
 void a3d_renderer_end_frame(a3d_renderer* r);
+a3d_arena* a3d_renderer_frame_arena(a3d_renderer* r);
+size_t a3d_renderer_arena_high_water(a3d_renderer* r);
+void a3d_renderer_get_batches(a3d_renderer* r, const a3d_draw_batch** out_batches, Uint32* out_count);
+const a3d_camera* a3d_renderer_get_camera(a3d_renderer* r);
 void a3d_renderer_get_draw_items(a3d_renderer* r, const a3d_draw_item** out_items, Uint32* out_count);
 bool a3d_renderer_init(a3d_renderer* r);
+void a3d_renderer_set_camera(a3d_renderer* r, mat4 view, mat4 proj);
+void a3d_renderer_set_gpu_culling(a3d_renderer* r, bool enabled);
 void a3d_renderer_shutdown(a3d_renderer* r);
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stdbool.h>
+#include <SDL3/SDL.h>
+
+#include "a3d.h"
+#include "a3d_mesh.h"
+#include "a3d_mesh_file.h"
+#include "a3d_transform.h"
+#include "vulkan/a3d_vulkan_buffer.h"
+
+/* loader threads reading mesh files into staging */
+#if !defined(A3D_STREAM_THREADS)
+#	define A3D_STREAM_THREADS 2
+#endif
+/* staging is split into this many slots, one file each, so loads in flight are bounded */
+#if !defined(A3D_STREAM_SLOTS)
+#	define A3D_STREAM_SLOTS 8
+#endif
+/* largest mesh file that can be streamed, vertex and index streams together */
+#if !defined(A3D_STREAM_SLOT_SIZE)
+#	define A3D_STREAM_SLOT_SIZE (4ull * 1024 * 1024)
+#endif
+/* bytes of copies recorded per frame; one mesh always goes through even if it is bigger */
+#if !defined(A3D_STREAM_FRAME_BUDGET)
+#	define A3D_STREAM_FRAME_BUDGET (8ull * 1024 * 1024)
+#endif
+/* live handles, queued through resident */
+#define A3D_STREAM_MAX_REQUESTS 4096
+
+/* index in the low 16 bits, generation above so stale handles are caught; 0 is never valid */
+typedef Uint32 a3d_stream_handle;
+
+typedef enum {
+	A3D_STREAM_INVALID,   /* unknown, cancelled or released */
+	A3D_STREAM_QUEUED,    /* waiting for a loader */
+	A3D_STREAM_LOADING,   /* a loader is reading it into staging */
+	A3D_STREAM_STAGED,    /* in staging, waiting for the render thread to record its copies */
+	A3D_STREAM_UPLOADING, /* copies submitted, waiting on the transfer timeline */
+	A3D_STREAM_RESIDENT,  /* a3d_stream_get_mesh returns it */
+	A3D_STREAM_FAILED
+} a3d_stream_state;
+
+typedef struct {
+	a3d_stream_state state;
+	Uint16   generation;
+	bool     cancelled; /* set while a loader or the gpu still holds it */
+	float    priority;  /* higher loads first */
+	Uint32   heap_index;
+	Uint32   slot;
+	char*    path;
+	a3d_mesh_file_header header; /* copied out of the file by the loader */
+	a3d_mesh mesh;
+} a3d_stream_request;
+
+typedef struct {
+	Uint32   request;
+	Uint64   value; /* upload timeline value that frees the slot */
+	bool     used;
+} a3d_stream_slot;
+
+struct a3d_streamer {
+	a3d_mesh_pool* pool; /* streamed meshes are placed here */
+	a3d_buffer staging;  /* A3D_STREAM_SLOTS * A3D_STREAM_SLOT_SIZE, host visible */
+
+	/* everything below is guarded by lock */
+	SDL_Mutex* lock;
+	SDL_Condition* work; /* signalled when a request is queued or a slot frees up */
+	SDL_Thread* threads[A3D_STREAM_THREADS];
+	bool     running;
+
+	a3d_stream_request requests[A3D_STREAM_MAX_REQUESTS];
+	Uint32   free_list[A3D_STREAM_MAX_REQUESTS];
+	Uint32   free_count;
+
+	/* max-heap of queued request indices on priority */
+	Uint32   heap[A3D_STREAM_MAX_REQUESTS];
+	Uint32   heap_count;
+
+	a3d_stream_slot slots[A3D_STREAM_SLOTS];
+	Uint32   free_slots;
+};
+
+void a3d_stream_cancel(a3d* e, a3d_stream_handle handle);
+const a3d_mesh* a3d_stream_get_mesh(a3d* e, a3d_stream_handle handle);
+a3d_stream_state a3d_stream_get_state(a3d* e, a3d_stream_handle handle);
+bool a3d_stream_init(a3d* e, a3d_mesh_pool* pool);
+float a3d_stream_priority(const a3d_camera* camera, mat4 model, const vec4 sphere);
+a3d_stream_handle a3d_stream_request_mesh(a3d* e, const char* path, float priority);
+void a3d_stream_set_priority(a3d* e, a3d_stream_handle handle, float priority);
+void a3d_stream_shutdown(a3d* e);
+void a3d_stream_update(a3d* e);
@@ -4,10 +4,11 @@
 
 #include "a3d.h"
 
-struct a3d_mvp {
-	mat4     model;
+/* uploaded as-is to the per-frame camera uniform buffer (std140) */
+struct a3d_camera {
 	mat4     view;
 	mat4     proj;
+	mat4     view_proj;
 };
 
-void a3d_mvp_compose(mat4 out, const a3d_mvp* in);
+void a3d_camera_set(a3d_camera* camera, mat4 view, mat4 proj);
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <SDL3/SDL_stdinc.h>
+
+/* vertex layouts a mesh can be stored in, each gets its own pipeline */
+typedef enum {
+	A3D_VERTEX_FORMAT_FLOAT,  /* a3d_vertex */
+	A3D_VERTEX_FORMAT_PACKED, /* a3d_vertex_packed */
+	A3D_VERTEX_FORMAT_COUNT
+} a3d_vertex_format;
+
+/* 20 bytes, 2d position and colour */
+typedef struct a3d_vertex {
+	float    position[2];
+	float    colour[3];
+} a3d_vertex;
+
+/* 20 bytes for what takes 48 as floats: 3d position, normal, colour and uv */
+typedef struct a3d_vertex_packed {
+	Sint16   position[4]; /* snorm16 across the mesh box, w unused */
+	Sint16   normal[2];   /* octahedral, snorm16 */
+	Uint8    colour[4];   /* unorm8 rgba */
+	Uint16   uv[2];       /* half floats */
+} a3d_vertex_packed;
+
+void a3d_pack_vertex(
+	const float position[3], const float normal[3], const float colour[4], const float uv[2],
+	const float aabb_min[3], const float aabb_max[3], a3d_vertex_packed* out
+);
+Uint32 a3d_vertex_format_stride(a3d_vertex_format format);
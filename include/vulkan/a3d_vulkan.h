@@ -6,18 +6,15 @@
 bool a3d_vk_allocate_command_buffers(a3d* e);
 
 bool a3d_vk_create_command_pool(a3d* e);
-bool a3d_vk_create_depth_resources(a3d* e);
-bool a3d_vk_create_framebuffers(a3d* e);
+bool a3d_vk_create_frame_graph(a3d* e);
 bool a3d_vk_create_image_views(a3d* e);
 bool a3d_vk_create_logical_device(a3d* e);
-bool a3d_vk_create_render_pass(a3d* e);
 bool a3d_vk_create_swapchain(a3d* e);
 bool a3d_vk_create_sync_objects(a3d* e);
 
 void a3d_vk_destroy_command_pool(a3d* e);
-void a3d_vk_destroy_depth_resources(a3d* e);
-void a3d_vk_destroy_framebuffers(a3d* e);
-void a3d_vk_destroy_render_pass(a3d* e);
+void a3d_vk_destroy_frame_graph(a3d* e);
+void a3d_vk_destroy_image_views(a3d* e);
 void a3d_vk_destroy_swapchain(a3d* e);
 void a3d_vk_destroy_sync_objects(a3d* e);
 
@@ -32,8 +29,7 @@ void a3d_vk_log_surface_support(a3d* e);
 bool a3d_vk_pick_physical_device(a3d* e);
 bool a3d_vk_pick_queue_families(a3d* e, VkPhysicalDevice device);
 
-bool a3d_vk_record_command_buffers(a3d* e);
-bool a3d_vk_record_command_buffer(a3d* e, Uint32 i, VkClearValue clear);
+bool a3d_vk_record_command_buffer(a3d* e, Uint32 frame, Uint32 image, VkClearValue clear);
 
 bool a3d_vk_recreate_swapchain(a3d* e);
 
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "a3d.h"
+#include "vulkan/a3d_vulkan_buffer.h"
+
+/* set index in every layout that sees the global arrays, after the per-frame set */
+#define A3D_VK_BINDLESS_SET 1
+/* array sizes, lowered to the device's update after bind limits */
+#define A3D_VK_BINDLESS_IMAGES 16384
+#define A3D_VK_BINDLESS_BUFFERS 16384
+#define A3D_VK_BINDLESS_SAMPLERS 256
+/* returned when an array is full; never a valid index */
+#define A3D_VK_BINDLESS_NONE UINT32_MAX
+
+/* one array each, the binding number is the type */
+typedef enum {
+	A3D_VK_BINDLESS_SAMPLED_IMAGE,
+	A3D_VK_BINDLESS_STORAGE_BUFFER,
+	A3D_VK_BINDLESS_SAMPLER,
+	A3D_VK_BINDLESS_TYPE_COUNT
+} a3d_vk_bindless_type;
+
+/* hands out the slots of one array; freed slots come back only once no submitted work reads them */
+typedef struct {
+	Uint32   capacity;
+	Uint32   next;       /* slots from here on have never been handed out */
+	Uint32*  free;       /* stack of returned slots, capacity long */
+	Uint32   free_count;
+	Uint32   used;
+} a3d_vk_bindless_array;
+
+/*
+ * one descriptor set for the whole frame, bound once per pipeline bind and never rewritten as a
+ * whole. resources are written into a free slot when added and draws pick them by index through
+ * push constants, so a new texture or material costs a descriptor write, not a set per draw.
+ * update after bind lets slots change while frames still in flight hold the set bound
+ */
+struct a3d_vk_bindless {
+	VkDescriptorSetLayout layout;
+	VkDescriptorPool pool;
+	VkDescriptorSet set;
+	a3d_vk_bindless_array arrays[A3D_VK_BINDLESS_TYPE_COUNT];
+};
+
+Uint32 a3d_vk_bindless_add_buffer(a3d* e, const a3d_buffer* buff);
+Uint32 a3d_vk_bindless_add_image(a3d* e, VkImageView view, VkImageLayout layout);
+Uint32 a3d_vk_bindless_add_sampler(a3d* e, VkSampler sampler);
+void a3d_vk_bindless_free(a3d* e, a3d_vk_bindless_type type, Uint32 index);
+bool a3d_vk_create_bindless(a3d* e);
+void a3d_vk_destroy_bindless(a3d* e);
@@ -3,10 +3,12 @@
 #include <vulkan/vulkan.h>
 
 #include "a3d.h"
+#include "vulkan/a3d_vulkan_memory.h"
 
 typedef struct {
 	VkBuffer buff;
-	VkDeviceMemory mem;
+	a3d_vk_allocation* alloc;
+	VkDeviceSize offset; /* into alloc->memory */
 	VkDeviceSize size;
 } a3d_buffer;
 
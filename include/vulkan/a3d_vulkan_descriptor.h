@@ -0,0 +1,32 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "a3d.h"
+#include "a3d_renderer.h"
+#include "a3d_transform.h"
+#include "vulkan/a3d_vulkan_buffer.h"
+
+/* model matrices per frame before the storage buffer has to grow */
+#define A3D_VK_MODELS_INITIAL_CAPACITY 1024
+
+/* per frame slot, written by the cpu once that slot's last submit has retired */
+typedef struct {
+	VkDescriptorSet set;
+	a3d_buffer camera; /* uniform, one a3d_camera */
+	a3d_buffer models; /* storage, one mat4 per draw item */
+	a3d_buffer normals; /* storage, the unscaled model's normal matrix per item, std430 mat3 */
+	Uint32   models_capacity; /* items both hold */
+	Uint32   models_index; /* where the draws find them in the bindless buffers */
+	Uint32   normals_index;
+} a3d_vk_frame_data;
+
+struct a3d_vk_descriptors {
+	VkDescriptorSetLayout layout;
+	VkDescriptorPool pool;
+	a3d_vk_frame_data frames[A3D_VK_FRAMES_IN_FLIGHT];
+};
+
+bool a3d_vk_create_descriptors(a3d* e);
+void a3d_vk_destroy_descriptors(a3d* e);
+bool a3d_vk_write_frame_data(a3d* e, Uint32 frame, const a3d_camera* camera, const a3d_draw_item* items, Uint32 count);
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "a3d.h"
+#include "a3d_renderer.h"
+#include "a3d_transform.h"
+#include "vulkan/a3d_vulkan_buffer.h"
+
+/* draw items per frame before the object and instance buffers have to grow */
+#define A3D_VK_CULL_INITIAL_CAPACITY 1024
+/* batches per frame before the command buffers have to grow */
+#define A3D_VK_CULL_INITIAL_BATCHES 64
+/* must match local_size_x in shaders/cull.comp */
+#define A3D_VK_CULL_WORKGROUP 64
+
+/* std430 layout of Object in shaders/cull.comp */
+typedef struct {
+	float    aabb_min[4];
+	float    aabb_max[4];
+	Uint32   batch;
+	Uint32   base;
+	Uint32   pad[2];
+} a3d_vk_cull_object;
+
+/* std140 layout of Params in shaders/cull.comp */
+typedef struct {
+	vec4     planes[6];
+	Uint32   count;
+	Uint32   pad[3];
+} a3d_vk_cull_params;
+
+/* per frame slot, written by the cpu once that slot's last submit has retired */
+typedef struct {
+	VkDescriptorSet set;
+	a3d_buffer params;   /* uniform, host visible */
+	a3d_buffer objects;   /* storage, host visible, one per draw item */
+	a3d_buffer instances; /* storage, one slot per draw item, compacted by the compute pass */
+	a3d_buffer templates; /* host visible, one command per batch with no instances yet */
+	a3d_buffer commands;  /* storage + indirect, the templates once the compute pass counted instances */
+	Uint32   capacity;
+	Uint32   batch_capacity;
+	Uint32   instances_index; /* where the vertex shaders find the instances in the bindless buffers */
+	VkBuffer models;      /* model buffer the set last pointed at */
+
+	/* this frame's work, groups live in the renderer frame arena */
+	Uint32   item_count;
+	Uint32   batch_count;
+	const a3d_draw_batch* groups; /* first/count span the group's batches */
+	Uint32   group_count;
+} a3d_vk_cull_frame;
+
+struct a3d_vk_gpu_cull {
+	VkDescriptorSetLayout layout;
+	VkDescriptorPool pool;
+	VkPipelineLayout pipeline_layout;
+	VkPipeline pipeline;
+	a3d_vk_cull_frame frames[A3D_VK_FRAMES_IN_FLIGHT];
+};
+
+bool a3d_vk_create_gpu_cull(a3d* e);
+void a3d_vk_destroy_gpu_cull(a3d* e);
+void a3d_vk_gpu_cull_dispatch(a3d* e, Uint32 frame, VkCommandBuffer cmd);
+void a3d_vk_gpu_cull_draw(a3d* e, Uint32 frame, VkCommandBuffer cmd);
+bool a3d_vk_gpu_cull_prepare(
+	a3d* e, Uint32 frame, const a3d_camera* camera, const a3d_draw_batch* batches, Uint32 batch_count
+);
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "a3d.h"
+#include "vulkan/a3d_vulkan_memory.h"
+
+#define A3D_VK_GRAPH_MAX_PASSES 16
+#define A3D_VK_GRAPH_MAX_RESOURCES 32
+/* resources a single pass may touch */
+#define A3D_VK_GRAPH_MAX_ACCESSES 8
+/* images behind one imported resource, one per swapchain image */
+#define A3D_VK_GRAPH_MAX_IMAGES 8
+
+typedef enum {
+	A3D_VK_GRAPH_RASTER,   /* runs inside a render pass built from its attachments */
+	A3D_VK_GRAPH_COMPUTE,
+	A3D_VK_GRAPH_TRANSFER
+} a3d_vk_graph_pass_type;
+
+/* how a pass touches a resource; shader usages take the pass's shader stages */
+typedef enum {
+	A3D_VK_GRAPH_COLOUR,        /* colour attachment */
+	A3D_VK_GRAPH_DEPTH,         /* depth attachment, tested and written */
+	A3D_VK_GRAPH_SAMPLED,
+	A3D_VK_GRAPH_STORAGE_READ,
+	A3D_VK_GRAPH_STORAGE_WRITE,
+	A3D_VK_GRAPH_INDIRECT,      /* draw arguments and counts */
+	A3D_VK_GRAPH_TRANSFER_SRC,
+	A3D_VK_GRAPH_TRANSFER_DST,
+	A3D_VK_GRAPH_USAGE_COUNT
+} a3d_vk_graph_usage;
+
+/* recorded once per frame for every pass that survived compile; data is what a3d_vk_graph_execute got */
+typedef void (*a3d_vk_graph_fn)(a3d* e, VkCommandBuffer cmd, Uint32 frame, Uint32 image, void* data);
+
+/* where a resource stands between accesses while compiling */
+typedef struct {
+	VkImageLayout layout;
+	VkPipelineStageFlags write_stages;
+	VkAccessFlags write_access;
+	VkPipelineStageFlags read_stages;    /* since the last write */
+	VkPipelineStageFlags visible_stages; /* already see the last write, reading there needs no barrier */
+	VkAccessFlags visible_access;
+} a3d_vk_graph_state;
+
+/*
+ * everything recorded ahead of a pass in one barrier command; images only for layout changes. the
+ * stage masks are the union for vkCmdPipelineBarrier, synchronization2 keeps each image's own
+ */
+typedef struct {
+	VkPipelineStageFlags src_stages;
+	VkPipelineStageFlags dst_stages;
+	VkAccessFlags src_access;
+	VkAccessFlags dst_access;
+	Uint32   image_count;
+	Uint32   image_resources[A3D_VK_GRAPH_MAX_ACCESSES]; /* to patch in the current swapchain image */
+	VkImageMemoryBarrier2 images[A3D_VK_GRAPH_MAX_ACCESSES];
+} a3d_vk_graph_barrier;
+
+typedef struct {
+	const char* name;
+	bool     imported;
+	bool     is_image;
+	bool     output; /* read after the graph, passes writing it are never culled */
+
+	/* images */
+	VkFormat format;
+	VkExtent2D extent; /* transients with a zero extent follow the swapchain */
+	VkImageAspectFlags aspect;
+	VkImageUsageFlags usage; /* transients: every usage the passes declared */
+	VkImage  images[A3D_VK_GRAPH_MAX_IMAGES];
+	VkImageView views[A3D_VK_GRAPH_MAX_IMAGES];
+	Uint32   image_count;
+	VkImageLayout final_layout; /* imports are left in this, UNDEFINED for wherever the last pass put them */
+
+	/* imports: what the outside world did last, e.g. the acquire wait stage */
+	a3d_vk_graph_state initial;
+
+	/* compiled */
+	Uint32   first_use; /* live pass indices, UINT32_MAX if unused */
+	Uint32   last_use;
+	Uint32   slot;      /* transients: memory shared with others whose lifetimes don't overlap */
+	VkMemoryRequirements reqs;
+} a3d_vk_graph_resource;
+
+typedef struct {
+	Uint32   resource;
+	a3d_vk_graph_usage usage;
+	bool     clear; /* attachments: cleared on load instead of read */
+	VkClearValue clear_value;
+
+	/* compiled, attachments only */
+	VkImageLayout initial_layout;
+	VkImageLayout final_layout;
+	bool     store; /* read by a later pass or after the graph */
+} a3d_vk_graph_access;
+
+typedef struct {
+	const char* name;
+	a3d_vk_graph_pass_type type;
+	a3d_vk_graph_fn fn;
+	bool     side_effect; /* kept even if nothing reads what it writes, e.g. a readback */
+	bool     secondary;   /* raster contents come from secondary command buffers this frame */
+
+	a3d_vk_graph_access accesses[A3D_VK_GRAPH_MAX_ACCESSES];
+	Uint32   access_count;
+
+	/* compiled */
+	bool     live;
+	a3d_vk_graph_barrier barrier;
+	VkSubpassDependency entry; /* raster: hazards folded into the render pass instead of a barrier */
+	VkSubpassDependency exit;
+	VkRenderPass render_pass; /* raster, without dynamic rendering */
+	VkFramebuffer fbs[A3D_VK_GRAPH_MAX_IMAGES];
+	Uint32   fb_count;
+	VkExtent2D extent;
+	Uint32   attachment_count;
+	VkFormat colour_formats[A3D_VK_GRAPH_MAX_ACCESSES]; /* what pipelines drawing in the pass are built for */
+	Uint32   colour_count;
+	VkFormat depth_format;
+} a3d_vk_graph_pass;
+
+/*
+ * passes run in declaration order. compile culls passes nothing depends on, works out the barriers
+ * between the rest, folding attachment transitions into the render passes, and places transient
+ * images whose lifetimes don't overlap in the same memory. compiling again rebuilds everything.
+ * with dynamic rendering the folding is left to explicit barriers and no render pass objects exist
+ */
+struct a3d_vk_graph {
+	a3d_vk_graph_resource resources[A3D_VK_GRAPH_MAX_RESOURCES];
+	Uint32   resource_count;
+	a3d_vk_graph_pass passes[A3D_VK_GRAPH_MAX_PASSES];
+	Uint32   pass_count;
+	bool     invalid; /* a declaration failed, compile refuses */
+
+	/* compiled */
+	bool     compiled;
+	bool     dynamic; /* vkCmdBeginRendering and synchronization2, no render pass or framebuffer objects */
+	a3d_vk_graph_barrier tail; /* brings imports into their final layout */
+	a3d_vk_allocation* slots[A3D_VK_GRAPH_MAX_RESOURCES];
+	Uint32   slot_count;
+	VkDeviceSize transient_size;  /* bytes actually allocated */
+	VkDeviceSize unaliased_size;  /* what the transients would take without aliasing */
+	Uint32   barrier_count;       /* pipeline barriers recorded per frame */
+};
+
+Uint32 a3d_vk_graph_add_pass(a3d_vk_graph* g, const char* name, a3d_vk_graph_pass_type type, a3d_vk_graph_fn fn);
+void a3d_vk_graph_clear(a3d_vk_graph* g, Uint32 pass, Uint32 resource, VkClearValue value);
+bool a3d_vk_graph_compile(a3d* e, a3d_vk_graph* g);
+Uint32 a3d_vk_graph_create_image(a3d_vk_graph* g, const char* name, VkFormat format, Uint32 width, Uint32 height);
+void a3d_vk_graph_destroy(a3d* e, a3d_vk_graph* g);
+bool a3d_vk_graph_execute(a3d* e, a3d_vk_graph* g, VkCommandBuffer cmd, Uint32 frame, Uint32 image, void* data);
+VkFramebuffer a3d_vk_graph_framebuffer(const a3d_vk_graph* g, Uint32 pass, Uint32 image);
+Uint32 a3d_vk_graph_import_buffer(a3d_vk_graph* g, const char* name, VkPipelineStageFlags ready_stages);
+Uint32 a3d_vk_graph_import_image(
+	a3d_vk_graph* g, const char* name, VkFormat format, VkExtent2D extent,
+	const VkImage* images, const VkImageView* views, Uint32 count,
+	VkPipelineStageFlags ready_stages, VkImageLayout final_layout
+);
+VkRenderPass a3d_vk_graph_render_pass(const a3d_vk_graph* g, Uint32 pass);
+void a3d_vk_graph_rendering_formats(const a3d_vk_graph* g, Uint32 pass, VkPipelineRenderingCreateInfo* info);
+void a3d_vk_graph_set_output(a3d_vk_graph* g, Uint32 resource);
+void a3d_vk_graph_set_secondary(a3d_vk_graph* g, Uint32 pass, bool secondary);
+void a3d_vk_graph_set_side_effect(a3d_vk_graph* g, Uint32 pass);
+void a3d_vk_graph_use(a3d_vk_graph* g, Uint32 pass, Uint32 resource, a3d_vk_graph_usage usage);
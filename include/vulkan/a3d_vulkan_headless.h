@@ -0,0 +1,28 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "a3d.h"
+#include "vulkan/a3d_vulkan_buffer.h"
+#include "vulkan/a3d_vulkan_memory.h"
+
+/* srgb like the usual swapchain, so read back bytes are ready to display */
+#define A3D_VK_HEADLESS_FORMAT VK_FORMAT_R8G8B8A8_SRGB
+
+/* one offscreen target and readback buffer per frame slot, the slot index is the image index */
+struct a3d_vk_headless {
+	a3d_vk_allocation* image_mem[A3D_VK_FRAMES_IN_FLIGHT];
+	a3d_buffer readback[A3D_VK_FRAMES_IN_FLIGHT];
+	Uint64   frame_numbers[A3D_VK_FRAMES_IN_FLIGHT];
+	bool     pending[A3D_VK_FRAMES_IN_FLIGHT];
+	Uint64   frame_count;
+
+	a3d_readback_fn fn;
+	void*    user;
+};
+
+bool a3d_vk_create_headless(a3d* e);
+void a3d_vk_destroy_headless(a3d* e);
+bool a3d_vk_headless_draw_frame(a3d* e);
+void a3d_vk_headless_flush(a3d* e);
+void a3d_vk_headless_record_readback(a3d* e, Uint32 image, VkCommandBuffer cmd);
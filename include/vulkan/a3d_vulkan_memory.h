@@ -0,0 +1,90 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "a3d.h"
+
+/* default size of a pooled VkDeviceMemory block, clamped to 1/8 of small heaps */
+#define A3D_VK_MEMORY_BLOCK_SIZE (64ull * 1024 * 1024)
+/* blocks used below this fraction are drained by a3d_vk_memory_defragment */
+#define A3D_VK_MEMORY_DEFRAG_OCCUPANCY 0.25f
+/* free ranges are bucketed by the highest set bit of their size */
+#define A3D_VK_MEMORY_BUCKETS 64
+
+typedef struct a3d_vk_block a3d_vk_block;
+typedef struct a3d_vk_allocation a3d_vk_allocation;
+
+/* a range inside a block, kept in address order; free ranges are merged on release */
+struct a3d_vk_allocation {
+	a3d_vk_block* block;
+	VkDeviceMemory memory;
+	VkDeviceSize offset;
+	VkDeviceSize size;
+	void*    mapped; /* NULL unless the memory type is host visible */
+	bool     free;
+
+	a3d_vk_allocation* prev;
+	a3d_vk_allocation* next;
+
+	/* the pool's size bucket, while free and not in a dedicated block */
+	a3d_vk_allocation* free_prev;
+	a3d_vk_allocation* free_next;
+};
+
+/*
+ * the blocks of one memory type. every free range sits in the bucket of its size's highest bit,
+ * so a fit is found by looking at the request's own bucket and then the first non-empty one above,
+ * where anything fits bar alignment, instead of walking every range of every block
+ */
+typedef struct {
+	a3d_vk_block* blocks;
+	a3d_vk_allocation* buckets[A3D_VK_MEMORY_BUCKETS];
+	Uint64   nonempty; /* bit per bucket holding a free range */
+} a3d_vk_pool;
+
+struct a3d_vk_block {
+	a3d_vk_pool* pool;
+	VkDeviceMemory memory;
+	VkDeviceSize size;
+	VkDeviceSize used;
+	Uint32   type_index;
+	Uint32   alloc_count;
+	void*    mapped;
+	bool     dedicated;
+	bool     draining;
+
+	a3d_vk_allocation* ranges;
+	a3d_vk_block* next;
+};
+
+typedef struct {
+	VkDeviceSize reserved; /* bytes held in VkDeviceMemory blocks */
+	VkDeviceSize used;     /* bytes handed out to resources */
+	Uint32   block_count;
+	Uint32   alloc_count;
+} a3d_vk_heap_stats;
+
+struct a3d_vk_allocator {
+	VkPhysicalDeviceMemoryProperties props;
+	VkDeviceSize block_size[VK_MAX_MEMORY_TYPES];
+	a3d_vk_pool pools[VK_MAX_MEMORY_TYPES];
+	/* optimal tiling images never share a block with buffers, so bufferImageGranularity can't bite */
+	a3d_vk_pool image_pools[VK_MAX_MEMORY_TYPES];
+	a3d_vk_heap_stats heaps[VK_MAX_MEMORY_HEAPS];
+
+	Uint32   device_allocations;
+	Uint32   max_device_allocations;
+};
+
+/* called for every live allocation in a block being drained; the callee should
+ * recreate its resource (which will land in another block) and free the old one */
+typedef void (*a3d_vk_defrag_fn)(a3d* e, a3d_vk_allocation* alloc, void* user);
+
+a3d_vk_allocation* a3d_vk_memory_alloc(a3d* e, const VkMemoryRequirements* reqs, VkMemoryPropertyFlags props);
+a3d_vk_allocation* a3d_vk_memory_alloc_image(a3d* e, const VkMemoryRequirements* reqs, VkMemoryPropertyFlags props);
+VkDeviceSize a3d_vk_memory_defragment(a3d* e, a3d_vk_defrag_fn fn, void* user);
+void a3d_vk_memory_free(a3d* e, a3d_vk_allocation* alloc);
+void a3d_vk_memory_get_stats(a3d* e, a3d_vk_heap_stats* out_heaps, Uint32* out_count);
+bool a3d_vk_memory_init(a3d* e);
+void a3d_vk_memory_log_stats(a3d* e);
+void a3d_vk_memory_shutdown(a3d* e);
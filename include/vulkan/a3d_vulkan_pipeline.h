@@ -4,5 +4,14 @@
 
 #include "a3d.h"
 
+/* push constants every graphics pipeline sees; indices into the bindless arrays */
+typedef struct {
+	Uint32   models;  /* storage buffer holding the frame's model matrices */
+	Uint32   normals; /* and the matching normal matrices, written for packed meshes only */
+	Uint32   instances; /* gpu culled draws: maps the instance to its draw item, NONE when they match */
+} a3d_vk_draw_constants;
+
+void a3d_vk_bind_graphics_pipeline(a3d* e, Uint32 frame, VkCommandBuffer cmd, a3d_vertex_format format);
+bool a3d_vk_create_compute_pipeline(a3d* e, const char* path, VkPipelineLayout layout, VkPipeline* out_pipeline);
 bool a3d_vk_create_graphics_pipeline(a3d* e);
 void a3d_vk_destroy_graphics_pipeline(a3d* e);
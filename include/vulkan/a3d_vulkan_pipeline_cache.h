@@ -0,0 +1,29 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "a3d.h"
+
+/* relative to the working directory, like the shaders */
+#if !defined(A3D_VK_PIPELINE_CACHE_PATH)
+#	define A3D_VK_PIPELINE_CACHE_PATH "pipeline_cache.bin"
+#endif
+#define A3D_VK_PIPELINE_CACHE_MAGIC 0x50443341u /* "A3DP" */
+#define A3D_VK_PIPELINE_CACHE_VERSION 1
+
+/* precedes the driver blob on disk; any mismatch discards the file */
+typedef struct {
+	Uint32   magic;
+	Uint32   version;
+	Uint32   vendor_id;
+	Uint32   device_id;
+	Uint32   driver_version;
+	Uint8    uuid[VK_UUID_SIZE];
+	Uint32   reserved;
+	Uint64   data_size;
+	Uint64   checksum; /* fnv-1a over the blob */
+} a3d_vk_pipeline_cache_header;
+
+bool a3d_vk_pipeline_cache_init(a3d* e);
+bool a3d_vk_pipeline_cache_save(a3d* e);
+void a3d_vk_pipeline_cache_shutdown(a3d* e);
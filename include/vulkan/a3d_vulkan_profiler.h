@@ -0,0 +1,28 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "a3d.h"
+
+/* gpu scopes a single frame can open, two queries each */
+#define A3D_VK_PROFILER_SCOPES 16
+
+/* one query pool per frame slot, read back once the slot's last submit has retired */
+struct a3d_vk_profiler {
+	VkQueryPool pools[A3D_VK_FRAMES_IN_FLIGHT];
+	const char* names[A3D_VK_FRAMES_IN_FLIGHT][A3D_VK_PROFILER_SCOPES];
+	Uint32   scope_count[A3D_VK_FRAMES_IN_FLIGHT];
+	Uint64   submit_ns[A3D_VK_FRAMES_IN_FLIGHT]; /* cpu time the first timestamp is pinned to */
+	Uint64   frames[A3D_VK_FRAMES_IN_FLIGHT];
+	bool     pending[A3D_VK_FRAMES_IN_FLIGHT];
+
+	double   period; /* nanoseconds per tick */
+	Uint64   mask; /* timestampValidBits worth of ones */
+};
+
+bool a3d_vk_create_profiler(a3d* e);
+void a3d_vk_destroy_profiler(a3d* e);
+void a3d_vk_profiler_begin(a3d* e, Uint32 frame, VkCommandBuffer cmd);
+Uint32 a3d_vk_profiler_scope_begin(a3d* e, Uint32 frame, VkCommandBuffer cmd, const char* name);
+void a3d_vk_profiler_scope_end(a3d* e, Uint32 frame, VkCommandBuffer cmd, Uint32 scope);
+void a3d_vk_profiler_submitted(a3d* e, Uint32 frame);
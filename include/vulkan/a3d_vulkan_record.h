@@ -0,0 +1,48 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <vulkan/vulkan.h>
+
+#include "a3d.h"
+#include "a3d_renderer.h"
+
+/* secondaries recorded in parallel at most; 0 picks one per job worker */
+#if !defined(A3D_VK_RECORD_THREADS)
+#	define A3D_VK_RECORD_THREADS 0
+#endif
+#define A3D_VK_MAX_RECORD_THREADS 16
+/* below this many batches per chunk the hand-off costs more than it saves */
+#define A3D_VK_RECORD_MIN_BATCHES 64
+
+typedef struct a3d_vk_recorder a3d_vk_recorder;
+
+/* one per job worker; a chunk is a single parallel for index, so only one thread touches it at a time */
+typedef struct {
+	/* per frame slot, reset wholesale once that slot's submit retires */
+	VkCommandPool pools[A3D_VK_FRAMES_IN_FLIGHT];
+	VkCommandBuffer cmds[A3D_VK_FRAMES_IN_FLIGHT];
+
+	/* current chunk */
+	const a3d_draw_batch* batches;
+	Uint32   batch_count;
+	bool     ok;
+} a3d_vk_record_worker;
+
+/* records the main pass's secondaries on the job system */
+struct a3d_vk_recorder {
+	a3d*     e;
+	a3d_vk_record_worker workers[A3D_VK_MAX_RECORD_THREADS];
+	Uint32   worker_count;
+
+	/* the frame being recorded, shared by every chunk */
+	Uint32   frame;
+	Uint32   image;
+};
+
+bool a3d_vk_create_recorder(a3d* e);
+void a3d_vk_destroy_recorder(a3d* e);
+void a3d_vk_record_batches(a3d* e, Uint32 frame, VkCommandBuffer cmd, const a3d_draw_batch* batches, Uint32 count);
+bool a3d_vk_record_secondary(
+	a3d* e, Uint32 frame, Uint32 image, const a3d_draw_batch* batches, Uint32 count,
+	VkCommandBuffer* out_cmds, Uint32* out_count
+);
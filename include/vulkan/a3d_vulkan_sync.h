@@ -0,0 +1,83 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "a3d.h"
+#include "vulkan/a3d_vulkan_buffer.h"
+
+/* destroys waiting on work still in flight; a full queue blocks until the oldest can run */
+#define A3D_VK_SYNC_MAX_DEFERRED 256
+/* cross queue waits a single submission can carry */
+#define A3D_VK_SYNC_MAX_WAITS 4
+
+typedef enum {
+	A3D_VK_QUEUE_GRAPHICS,
+	A3D_VK_QUEUE_TRANSFER,
+	A3D_VK_QUEUE_COMPUTE,
+	A3D_VK_QUEUE_COUNT
+} a3d_vk_queue_type;
+
+/* a value on one queue's timeline; 0 counts as reached before anything is submitted */
+typedef struct {
+	a3d_vk_queue_type queue;
+	Uint64   value;
+} a3d_vk_sync_point;
+
+typedef void (*a3d_vk_sync_fn)(a3d* e, void* data);
+
+typedef struct {
+	VkQueue  queue;
+	VkSemaphore timeline;
+	Uint64   submitted; /* last value handed out, signalled when that submission retires */
+	Uint64   completed; /* last value seen reached, only refreshed when a check needs more */
+} a3d_vk_timeline;
+
+/* runs once every queue has passed where it stood when this was queued */
+typedef struct {
+	Uint64   values[A3D_VK_QUEUE_COUNT];
+	a3d_vk_sync_fn fn; /* NULL for a plain buffer destroy */
+	void*    data;
+	a3d_buffer buffer;
+} a3d_vk_deferred;
+
+/* one vkQueueSubmit; the timeline signal is added by a3d_vk_sync_submit */
+typedef struct {
+	const VkCommandBuffer* cmds;
+	Uint32   cmd_count;
+	a3d_vk_sync_point waits[A3D_VK_SYNC_MAX_WAITS]; /* points on other queues, reached ones are dropped */
+	VkPipelineStageFlags wait_stages[A3D_VK_SYNC_MAX_WAITS];
+	Uint32   wait_count;
+
+	/* swapchain acquire and present only take binary semaphores */
+	VkSemaphore binary_wait;
+	VkPipelineStageFlags binary_wait_stage;
+	VkSemaphore binary_signal;
+} a3d_vk_submission;
+
+/*
+ * one timeline semaphore per queue, bumped by every submission to it. the cpu never owns a fence:
+ * anything reused or destroyed after the gpu is done with it remembers the point it was last used
+ * at and checks that against the cached completed value, which is only queried when it falls short
+ */
+struct a3d_vk_sync {
+	a3d_vk_timeline timelines[A3D_VK_QUEUE_COUNT];
+
+	/* ring, oldest first, so collecting stops at the first that isn't ready */
+	a3d_vk_deferred deferred[A3D_VK_SYNC_MAX_DEFERRED];
+	Uint32   deferred_head;
+	Uint32   deferred_count;
+};
+
+void a3d_vk_sync_collect(a3d* e);
+Uint64 a3d_vk_sync_completed(a3d* e, a3d_vk_queue_type queue);
+void a3d_vk_sync_defer(a3d* e, a3d_vk_sync_fn fn, void* data);
+void a3d_vk_sync_defer_buffer(a3d* e, a3d_buffer* buff);
+bool a3d_vk_sync_init(a3d* e);
+a3d_vk_sync_point a3d_vk_sync_last(a3d* e, a3d_vk_queue_type queue);
+a3d_vk_sync_point a3d_vk_sync_next(a3d* e, a3d_vk_queue_type queue);
+bool a3d_vk_sync_poll(a3d* e, a3d_vk_queue_type queue, Uint64* out_value);
+bool a3d_vk_sync_reached(a3d* e, a3d_vk_sync_point point);
+void a3d_vk_sync_shutdown(a3d* e);
+bool a3d_vk_sync_submit(a3d* e, a3d_vk_queue_type queue, const a3d_vk_submission* submission, a3d_vk_sync_point* out_point);
+bool a3d_vk_sync_wait(a3d* e, a3d_vk_sync_point point);
+bool a3d_vk_sync_wait_idle(a3d* e);
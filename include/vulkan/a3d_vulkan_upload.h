@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "a3d.h"
+#include "vulkan/a3d_vulkan_buffer.h"
+
+/* host visible ring that uploads are copied through */
+#define A3D_VK_STAGING_SIZE (32ull * 1024 * 1024)
+/* largest single copy; bigger uploads are split so they can't stall on a full ring */
+#define A3D_VK_STAGING_CHUNK (A3D_VK_STAGING_SIZE / 4)
+#define A3D_VK_UPLOAD_BATCHES 4
+
+typedef struct {
+	VkCommandBuffer cmd;
+	Uint64   value;    /* transfer timeline value signalled when the copies land */
+	Uint64   ring_end; /* ring head at submit, becomes the tail on retire */
+	Uint32   copy_count;
+	bool     pending;
+} a3d_vk_upload_batch;
+
+struct a3d_vk_uploader {
+	a3d_buffer staging;
+	/* monotonic byte counters, wrapped by A3D_VK_STAGING_SIZE */
+	Uint64   head;
+	Uint64   tail;
+
+	VkCommandPool cmd_pool;
+	a3d_vk_upload_batch batches[A3D_VK_UPLOAD_BATCHES];
+	Uint32   current;
+	bool     recording;
+};
+
+bool a3d_vk_upload_buffer(a3d* e, a3d_buffer* dst, VkDeviceSize dst_offset, const void* data, VkDeviceSize size);
+Uint64 a3d_vk_upload_completed(a3d* e);
+bool a3d_vk_upload_copy(
+	a3d* e, const a3d_buffer* src, VkDeviceSize src_offset, a3d_buffer* dst, VkDeviceSize dst_offset,
+	VkDeviceSize size, Uint64* out_value
+);
+bool a3d_vk_upload_flush(a3d* e);
+bool a3d_vk_upload_init(a3d* e);
+void a3d_vk_upload_shutdown(a3d* e);
+bool a3d_vk_upload_wait_idle(a3d* e);
@@ -0,0 +1,57 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(set = 0, binding = 0) uniform Camera {
+	mat4 view;
+	mat4 proj;
+	mat4 view_proj;
+} camera;
+
+/* one model matrix per draw item, selected by firstInstance; for packed meshes it also
+ * scales and offsets the snorm positions back out to the mesh box */
+layout(std430, set = 1, binding = 1) readonly buffer Models {
+	mat4 models[];
+} buffers[];
+
+/* the unscaled model's normal matrix per draw item, same index as the model */
+layout(std430, set = 1, binding = 1) readonly buffer Normals {
+	mat3 normals[];
+} normal_buffers[];
+
+/* gpu culled draws only: the draw item behind each instance, compacted per batch by shaders/cull.comp */
+layout(std430, set = 1, binding = 1) readonly buffer Instances {
+	uint items[];
+} instance_buffers[];
+
+/* indices into the bindless arrays */
+layout(push_constant) uniform Draw {
+	uint models;
+	uint normals;
+	uint instances; /* 0xffffffff when the instance is the draw item */
+} draw;
+
+layout(location = 0) in vec4 in_pos;    /* snorm16, -1..1 across the box */
+layout(location = 1) in vec4 in_color;  /* unorm8 */
+layout(location = 2) in vec2 in_normal; /* snorm16 octahedral */
+layout(location = 3) in vec2 in_uv;     /* half floats */
+layout(location = 0) out vec3 out_color;
+layout(location = 1) out vec3 out_normal;
+layout(location = 2) out vec2 out_uv;
+
+vec3 oct_decode(vec2 e)
+{
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return normalize(n);
+}
+
+void main()
+{
+	uint item = draw.instances == 0xffffffffu ? uint(gl_InstanceIndex) : instance_buffers[draw.instances].items[gl_InstanceIndex];
+	mat4 model = buffers[draw.models].models[item];
+	gl_Position = camera.view_proj * model * vec4(in_pos.xyz, 1.0);
+	out_color = in_color.rgb;
+	out_normal = normalize(normal_buffers[draw.normals].normals[item] * oct_decode(in_normal));
+	out_uv = in_uv;
+}
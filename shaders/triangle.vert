@@ -1,8 +1,28 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
 
-layout(push_constant) uniform Push {
-	mat4 mvp;
-} pc;
+layout(set = 0, binding = 0) uniform Camera {
+	mat4 view;
+	mat4 proj;
+	mat4 view_proj;
+} camera;
+
+/* one model matrix per draw item, selected by firstInstance */
+layout(std430, set = 1, binding = 1) readonly buffer Models {
+	mat4 models[];
+} buffers[];
+
+/* gpu culled draws only: the draw item behind each instance, compacted per batch by shaders/cull.comp */
+layout(std430, set = 1, binding = 1) readonly buffer Instances {
+	uint items[];
+} instance_buffers[];
+
+/* indices into the bindless arrays */
+layout(push_constant) uniform Draw {
+	uint models;
+	uint normals;
+	uint instances; /* 0xffffffff when the instance is the draw item */
+} draw;
 
 layout(location = 0) in vec2 in_pos;
 layout(location = 1) in vec3 in_color;
@@ -10,7 +30,8 @@ layout(location = 0) out vec3 out_color;
 
 void main()
 {
+	uint item = draw.instances == 0xffffffffu ? uint(gl_InstanceIndex) : instance_buffers[draw.instances].items[gl_InstanceIndex];
 	vec4 pos = vec4(in_pos, 0.0, 1.0);
-	gl_Position = pc.mvp * pos;
+	gl_Position = camera.view_proj * buffers[draw.models].models[item] * pos;
 	out_color = in_color;
 }
@@ -10,25 +10,41 @@
 
 #include "a3d.h"
 #include "a3d_event.h"
+#include "a3d_job.h"
 #include "a3d_logging.h"
+#include "a3d_profiler.h"
 #include "a3d_window.h"
 #include "a3d_renderer.h"
+#include "a3d_stream.h"
 #include "vulkan/a3d_vulkan.h"
+#include "vulkan/a3d_vulkan_headless.h"
 
 static void a3d_event_on_close_requested(a3d* e, const SDL_Event* ev);
 static void a3d_event_on_quit(a3d* e, const SDL_Event* ev);
 static void a3d_event_on_resize(a3d* e, const SDL_Event* ev);
+static bool create_renderer(a3d* e);
+static void stop_threads(void);
 
 void a3d_frame(a3d* e)
 {
 	if (!e)
 		return;
 
+	a3d_profiler_begin_frame();
+	A3D_PROFILE_BEGIN(frame_start);
+
 	/* input */
+	A3D_PROFILE_BEGIN(events_start);
 	a3d_pump_events(e);
+	A3D_PROFILE_END(events_start, "pump events");
+
+	/* sdl calls jobs handed back to this thread since the last frame */
+	a3d_job_run_main();
 
-	if (!e->running)
+	if (!e->running) {
+		A3D_PROFILE_END(frame_start, "frame");
 		return;
+	}
 
 	/* handle resize */
 	if (e->fb_resized) {
@@ -36,8 +52,12 @@ void a3d_frame(a3d* e)
 		e->fb_resized = false;
 	}
 
+	/* record copies for streamed meshes, they go out with this frame's uploads */
+	a3d_stream_update(e);
+
 	/* render */
 	a3d_vk_draw_frame(e);
+	A3D_PROFILE_END(frame_start, "frame");
 }
 
 bool a3d_init(a3d* e, const char* title, int width, int height)
@@ -45,8 +65,20 @@ bool a3d_init(a3d* e, const char* title, int width, int height)
 	/* zero engine */
 	memset(e, 0, sizeof(*e));
 
+	/* before any thread starts, so there is nothing to unwind; logging is still synchronous */
+	if (width <= 0 || height <= 0) {
+		A3D_LOG_ERROR("window needs a non-zero size, got %dx%d", width, height);
+		return false;
+	}
+
+	/* on failure logging just stays synchronous */
+	a3d_log_init(NULL);
+	/* and jobs run inline on the caller */
+	a3d_job_init(0);
+
 	if (!SDL_Init(SDL_INIT_VIDEO)) {
 		A3D_LOG_ERROR("failed to init SDL: %s", SDL_GetError());
+		stop_threads();
 		return false;
 	}
 
@@ -54,6 +86,7 @@ bool a3d_init(a3d* e, const char* title, int width, int height)
 	if (!e->window) {
 		A3D_LOG_ERROR("failed to create window");
 		SDL_Quit();
+		stop_threads();
 		return false;
 	}
 
@@ -69,26 +102,16 @@ bool a3d_init(a3d* e, const char* title, int width, int height)
 		A3D_LOG_ERROR("vulkan initialisation failed");
 		SDL_DestroyWindow(e->window);
 		SDL_Quit();
+		stop_threads();
 		return false;
 	}
 
 	/* init renderer */
-	e->renderer = malloc(sizeof *e->renderer);
-	if (!e->renderer) {
-		A3D_LOG_ERROR("failed to allocate renderer");
-		a3d_vk_shutdown(e);
-		SDL_DestroyWindow(e->window);
-		SDL_Quit();
-		return false;
-	}
-
-	if (!a3d_renderer_init(e->renderer)) {
-		A3D_LOG_ERROR("renderer initialisation failed");
-		free(e->renderer);
-		e->renderer = NULL;
+	if (!create_renderer(e)) {
 		a3d_vk_shutdown(e);
 		SDL_DestroyWindow(e->window);
 		SDL_Quit();
+		stop_threads();
 		return false;
 	}
 
@@ -103,8 +126,56 @@ bool a3d_init(a3d* e, const char* title, int width, int height)
 	return true;
 }
 
+bool a3d_init_headless(a3d* e, int width, int height)
+{
+	memset(e, 0, sizeof(*e));
+	e->headless = true;
+
+	/* before any thread starts, so there is nothing to unwind; logging is still synchronous */
+	if (width <= 0 || height <= 0) {
+		A3D_LOG_ERROR("headless target needs a non-zero size, got %dx%d", width, height);
+		return false;
+	}
+
+	a3d_log_init(NULL);
+	a3d_job_init(0);
+
+	/* events only, so quit requests still arrive; no video driver needed */
+	if (!SDL_Init(SDL_INIT_EVENTS)) {
+		A3D_LOG_ERROR("failed to init SDL: %s", SDL_GetError());
+		stop_threads();
+		return false;
+	}
+
+	e->vk.swapchain_extent.width = (Uint32)width;
+	e->vk.swapchain_extent.height = (Uint32)height;
+
+	if (!a3d_vk_init(e)) {
+		A3D_LOG_ERROR("headless vulkan initialisation failed");
+		SDL_Quit();
+		stop_threads();
+		return false;
+	}
+
+	if (!create_renderer(e)) {
+		a3d_vk_shutdown(e);
+		SDL_Quit();
+		stop_threads();
+		return false;
+	}
+
+	e->running = true;
+	a3d_add_event_handler(e, SDL_EVENT_QUIT, a3d_event_on_quit);
+
+	A3D_LOG_INFO("running headless at %dx%d", width, height);
+	return true;
+}
+
 void a3d_quit(a3d *e)
 {
+	a3d_stream_shutdown(e);
+	a3d_job_shutdown();
+
 	if (e->renderer) {
 		a3d_renderer_shutdown(e->renderer);
 		free(e->renderer);
@@ -112,16 +183,51 @@ void a3d_quit(a3d *e)
 	}
 
 	a3d_vk_shutdown(e);
-	SDL_DestroyWindow(e->window);
+	if (e->window)
+		SDL_DestroyWindow(e->window);
 	SDL_Quit();
+	a3d_log_shutdown();
+}
+
+void a3d_set_camera(a3d* e, mat4 view, mat4 proj)
+{
+	if (!e || !e->renderer)
+		return;
+
+	a3d_renderer_set_camera(e->renderer, view, proj);
 }
 
-bool a3d_submit_mesh(a3d* e, const a3d_mesh* mesh, const a3d_mvp* mvp)
+bool a3d_set_gpu_culling(a3d* e, bool enabled)
 {
 	if (!e || !e->renderer)
 		return false;
 
-	return a3d_renderer_draw_mesh(e->renderer, mesh, mvp);
+	if (enabled && !e->vk.gpu_cull) {
+		A3D_LOG_WARN("gpu culling unavailable, device lacks multiDrawIndirect");
+		return false;
+	}
+
+	a3d_renderer_set_gpu_culling(e->renderer, enabled);
+	return true;
+}
+
+void a3d_set_readback(a3d* e, a3d_readback_fn fn, void* user)
+{
+	if (!e || !e->vk.headless) {
+		A3D_LOG_WARN("a3d_set_readback only applies to headless engines");
+		return;
+	}
+
+	e->vk.headless->fn = fn;
+	e->vk.headless->user = user;
+}
+
+bool a3d_submit_mesh(a3d* e, const a3d_mesh* mesh, mat4 model)
+{
+	if (!e || !e->renderer)
+		return false;
+
+	return a3d_renderer_draw_mesh(e->renderer, mesh, model);
 }
 
 static void a3d_event_on_quit(a3d* e, const SDL_Event* ev)
@@ -140,4 +246,29 @@ static void a3d_event_on_resize(a3d* e, const SDL_Event* ev)
 {
 	(void)ev;
 	e->fb_resized = true;
-}
\ No newline at end of file
+}
+
+static bool create_renderer(a3d* e)
+{
+	e->renderer = malloc(sizeof *e->renderer);
+	if (!e->renderer) {
+		A3D_LOG_ERROR("failed to allocate renderer");
+		return false;
+	}
+
+	if (!a3d_renderer_init(e->renderer)) {
+		A3D_LOG_ERROR("renderer initialisation failed");
+		free(e->renderer);
+		e->renderer = NULL;
+		return false;
+	}
+
+	return true;
+}
+
+/* the job workers and the log writer, in the reverse of the order a3d_init starts them */
+static void stop_threads(void)
+{
+	a3d_job_shutdown();
+	a3d_log_shutdown();
+}
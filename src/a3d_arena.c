@@ -0,0 +1,124 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "a3d_arena.h"
+#include "a3d_logging.h"
+
+static a3d_arena_page* create_page(size_t size);
+
+void* a3d_arena_alloc(a3d_arena* a, size_t size, size_t align)
+{
+	if (size == 0)
+		size = 1;
+
+	a3d_arena_page* page = a->current;
+	for (;;) {
+		uintptr_t base = (uintptr_t)page->data;
+		size_t offset = ((base + page->used + align - 1) & ~(uintptr_t)(align - 1)) - base;
+		if (offset + size <= page->size) {
+			a->used += offset + size - page->used;
+			if (a->used > a->high_water)
+				a->high_water = a->used;
+
+			page->used = offset + size;
+			a->current = page;
+			a->last = page->data + offset;
+			return a->last;
+		}
+
+		/* the rest of this page is wasted until the next reset */
+		a->used += page->size - page->used;
+		page->used = page->size;
+
+		/* reuse the next page when it is big enough, otherwise splice in a new one */
+		if (page->next && page->next->size >= size + align) {
+			page = page->next;
+			page->used = 0;
+			continue;
+		}
+
+		size_t page_size = size + align > a->page_size ? size + align : a->page_size;
+		a3d_arena_page* fresh = create_page(page_size);
+		if (!fresh) {
+			A3D_LOG_ERROR("failed to grow arena by %zu bytes", page_size);
+			return NULL;
+		}
+		fresh->next = page->next;
+		page->next = fresh;
+		page = fresh;
+	}
+}
+
+void a3d_arena_destroy(a3d_arena* a)
+{
+	a3d_arena_page* page = a->pages;
+	while (page) {
+		a3d_arena_page* next = page->next;
+		free(page);
+		page = next;
+	}
+
+	memset(a, 0, sizeof *a);
+}
+
+void* a3d_arena_grow(a3d_arena* a, void* ptr, size_t old_size, size_t new_size, size_t align)
+{
+	if (!ptr)
+		return a3d_arena_alloc(a, new_size, align);
+
+	/* the newest allocation can usually just extend into the page */
+	a3d_arena_page* page = a->current;
+	if (ptr == a->last) {
+		size_t offset = (unsigned char*)ptr - page->data;
+		if (offset + new_size <= page->size) {
+			a->used += new_size - old_size;
+			if (a->used > a->high_water)
+				a->high_water = a->used;
+			page->used = offset + new_size;
+			return ptr;
+		}
+	}
+
+	void* fresh = a3d_arena_alloc(a, new_size, align);
+	if (fresh)
+		memcpy(fresh, ptr, old_size);
+	return fresh;
+}
+
+bool a3d_arena_init(a3d_arena* a, size_t initial_size)
+{
+	memset(a, 0, sizeof *a);
+	a->page_size = A3D_ARENA_PAGE_SIZE;
+
+	a->pages = create_page(initial_size > a->page_size ? initial_size : a->page_size);
+	if (!a->pages) {
+		A3D_LOG_ERROR("failed to allocate arena");
+		return false;
+	}
+
+	a->current = a->pages;
+	return true;
+}
+
+void a3d_arena_reset(a3d_arena* a)
+{
+	/* later pages are cleared lazily as alloc reaches them */
+	a->current = a->pages;
+	a->pages->used = 0;
+	a->used = 0;
+	a->last = NULL;
+}
+
+/* private */
+static a3d_arena_page* create_page(size_t size)
+{
+	a3d_arena_page* page = malloc(sizeof *page + size);
+	if (!page)
+		return NULL;
+
+	page->next = NULL;
+	page->size = size;
+	page->used = 0;
+	return page;
+}
@@ -0,0 +1,161 @@
+#include <math.h>
+
+#if defined(__AVX__)
+#	include <immintrin.h>
+#elif defined(__SSE2__)
+#	include <emmintrin.h>
+#endif
+
+#include "a3d_cull.h"
+
+static Uint32 cull_scalar(const a3d_frustum* frustum, const a3d_cull_bounds* b, Uint32 first, Uint32* out_visible, Uint32 visible);
+
+/* writes the indices of boxes touching the frustum, returns how many */
+Uint32 a3d_cull_aabbs(const a3d_frustum* frustum, const a3d_cull_bounds* b, Uint32* out_visible)
+{
+	Uint32 visible = 0;
+	Uint32 i = 0;
+
+#if defined(__AVX__)
+	__m256 zero = _mm256_setzero_ps();
+	__m256 sign = _mm256_set1_ps(-0.0f);
+	for (; i + 8 <= b->count; i += 8) {
+		__m256 cx = _mm256_load_ps(b->cx + i);
+		__m256 cy = _mm256_load_ps(b->cy + i);
+		__m256 cz = _mm256_load_ps(b->cz + i);
+		__m256 ex = _mm256_load_ps(b->ex + i);
+		__m256 ey = _mm256_load_ps(b->ey + i);
+		__m256 ez = _mm256_load_ps(b->ez + i);
+
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (Uint32 p = 0; p < 6; p++) {
+			const float* plane = frustum->planes[p];
+			__m256 nx = _mm256_set1_ps(plane[0]);
+			__m256 ny = _mm256_set1_ps(plane[1]);
+			__m256 nz = _mm256_set1_ps(plane[2]);
+
+			/* distance of the centre plus the box's projected radius */
+			__m256 d = _mm256_add_ps(_mm256_set1_ps(plane[3]), _mm256_add_ps(
+				_mm256_mul_ps(nx, cx), _mm256_add_ps(_mm256_mul_ps(ny, cy), _mm256_mul_ps(nz, cz))
+			));
+			__m256 r = _mm256_add_ps(
+				_mm256_mul_ps(_mm256_andnot_ps(sign, nx), ex),
+				_mm256_add_ps(_mm256_mul_ps(_mm256_andnot_ps(sign, ny), ey), _mm256_mul_ps(_mm256_andnot_ps(sign, nz), ez))
+			);
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(d, r), zero, _CMP_GE_OQ));
+		}
+
+		int mask = _mm256_movemask_ps(inside);
+		while (mask) {
+			int bit = __builtin_ctz(mask);
+			out_visible[visible++] = i + bit;
+			mask &= mask - 1;
+		}
+	}
+#elif defined(__SSE2__)
+	__m128 zero = _mm_setzero_ps();
+	__m128 sign = _mm_set1_ps(-0.0f);
+	for (; i + 4 <= b->count; i += 4) {
+		__m128 cx = _mm_load_ps(b->cx + i);
+		__m128 cy = _mm_load_ps(b->cy + i);
+		__m128 cz = _mm_load_ps(b->cz + i);
+		__m128 ex = _mm_load_ps(b->ex + i);
+		__m128 ey = _mm_load_ps(b->ey + i);
+		__m128 ez = _mm_load_ps(b->ez + i);
+
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (Uint32 p = 0; p < 6; p++) {
+			const float* plane = frustum->planes[p];
+			__m128 nx = _mm_set1_ps(plane[0]);
+			__m128 ny = _mm_set1_ps(plane[1]);
+			__m128 nz = _mm_set1_ps(plane[2]);
+
+			__m128 d = _mm_add_ps(_mm_set1_ps(plane[3]), _mm_add_ps(
+				_mm_mul_ps(nx, cx), _mm_add_ps(_mm_mul_ps(ny, cy), _mm_mul_ps(nz, cz))
+			));
+			__m128 r = _mm_add_ps(
+				_mm_mul_ps(_mm_andnot_ps(sign, nx), ex),
+				_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(sign, ny), ey), _mm_mul_ps(_mm_andnot_ps(sign, nz), ez))
+			);
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(d, r), zero));
+		}
+
+		int mask = _mm_movemask_ps(inside);
+		while (mask) {
+			int bit = __builtin_ctz(mask);
+			out_visible[visible++] = i + bit;
+			mask &= mask - 1;
+		}
+	}
+#endif
+
+	return cull_scalar(frustum, b, i, out_visible, visible);
+}
+
+void a3d_cull_transform_aabb(mat4 model, vec3 local_min, vec3 local_max, vec3 out_centre, vec3 out_extent)
+{
+	vec3 c = {
+		0.5f * (local_min[0] + local_max[0]),
+		0.5f * (local_min[1] + local_max[1]),
+		0.5f * (local_min[2] + local_max[2])
+	};
+	vec3 h = {
+		0.5f * (local_max[0] - local_min[0]),
+		0.5f * (local_max[1] - local_min[1]),
+		0.5f * (local_max[2] - local_min[2])
+	};
+
+	/* centre goes through the full matrix, extent through |upper 3x3| (arvo) */
+	for (Uint32 row = 0; row < 3; row++) {
+		out_centre[row] = model[0][row] * c[0] + model[1][row] * c[1] + model[2][row] * c[2] + model[3][row];
+		out_extent[row] = fabsf(model[0][row]) * h[0] + fabsf(model[1][row]) * h[1] + fabsf(model[2][row]) * h[2];
+	}
+}
+
+/* gribb-hartmann on a column-major matrix with vulkan's 0..1 clip depth */
+void a3d_frustum_from_matrix(a3d_frustum* frustum, mat4 m)
+{
+	for (Uint32 i = 0; i < 4; i++) {
+		float r0 = m[i][0];
+		float r1 = m[i][1];
+		float r2 = m[i][2];
+		float r3 = m[i][3];
+
+		frustum->planes[0][i] = r3 + r0; /* left */
+		frustum->planes[1][i] = r3 - r0; /* right */
+		frustum->planes[2][i] = r3 + r1; /* bottom */
+		frustum->planes[3][i] = r3 - r1; /* top */
+		frustum->planes[4][i] = r2;      /* near */
+		frustum->planes[5][i] = r3 - r2; /* far */
+	}
+
+	for (Uint32 p = 0; p < 6; p++) {
+		float* plane = frustum->planes[p];
+		float len = sqrtf(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+		if (len > 0.0f) {
+			plane[0] /= len;
+			plane[1] /= len;
+			plane[2] /= len;
+			plane[3] /= len;
+		}
+	}
+}
+
+/* private */
+static Uint32 cull_scalar(const a3d_frustum* frustum, const a3d_cull_bounds* b, Uint32 first, Uint32* out_visible, Uint32 visible)
+{
+	for (Uint32 i = first; i < b->count; i++) {
+		bool inside = true;
+		for (Uint32 p = 0; p < 6 && inside; p++) {
+			const float* plane = frustum->planes[p];
+			float d = plane[0] * b->cx[i] + plane[1] * b->cy[i] + plane[2] * b->cz[i] + plane[3];
+			float r = fabsf(plane[0]) * b->ex[i] + fabsf(plane[1]) * b->ey[i] + fabsf(plane[2]) * b->ez[i];
+			inside = d + r >= 0.0f;
+		}
+
+		if (inside)
+			out_visible[visible++] = i;
+	}
+
+	return visible;
+}
@@ -0,0 +1,49 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "a3d_image.h"
+#include "a3d_logging.h"
+
+bool a3d_image_write_ppm(const char* path, const void* rgba, Uint32 width, Uint32 height)
+{
+	FILE* file = fopen(path, "wb");
+	if (!file) {
+		A3D_LOG_ERROR("failed to open file %s", path);
+		return false;
+	}
+
+	/* binary rgb, alpha is dropped */
+	unsigned char* row = malloc((size_t)width * 3);
+	if (!row) {
+		A3D_LOG_ERROR("out of memory writing %s", path);
+		fclose(file);
+		return false;
+	}
+
+	bool ok = fprintf(file, "P6\n%u %u\n255\n", width, height) > 0;
+	const unsigned char* src = rgba;
+	for (Uint32 y = 0; ok && y < height; y++) {
+		for (Uint32 x = 0; x < width; x++) {
+			const unsigned char* px = src + ((size_t)y * width + x) * 4;
+			row[x * 3 + 0] = px[0];
+			row[x * 3 + 1] = px[1];
+			row[x * 3 + 2] = px[2];
+		}
+		ok = fwrite(row, 3, width, file) == width;
+	}
+
+	free(row);
+	ok = fclose(file) == 0 && ok;
+	if (!ok)
+		A3D_LOG_ERROR("short write for file %s", path);
+
+	return ok;
+}
+
+void a3d_image_write_readback(a3d* e, const void* pixels, Uint32 width, Uint32 height, Uint64 frame, void* user)
+{
+	(void)e;
+	char path[512];
+	snprintf(path, sizeof path, (const char*)user, (unsigned long)frame);
+	a3d_image_write_ppm(path, pixels, width, height);
+}
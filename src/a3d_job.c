@@ -0,0 +1,416 @@
+#include <stdlib.h>
+#include <SDL3/SDL.h>
+
+#include "a3d_job.h"
+#include "a3d_logging.h"
+
+/*
+ * chase-lev: the owner pushes and pops at bottom, thieves take from top. indices only grow and
+ * are compared as differences so wrapping is harmless. sdl atomics are sequentially consistent,
+ * which covers the store-load ordering pop and steal rely on
+ */
+typedef struct {
+	SDL_AtomicInt top;
+	char     pad0[64 - sizeof(SDL_AtomicInt)];
+	SDL_AtomicInt bottom;
+	char     pad1[64 - sizeof(SDL_AtomicInt)];
+	a3d_job  jobs[A3D_JOB_DEQUE_SIZE];
+} a3d_job_deque;
+
+/* index 0 belongs to the thread that called a3d_job_init */
+typedef struct {
+	a3d_job_deque deque;
+	SDL_Thread* thread;
+	Uint32   index;
+	Uint32   rng; /* xorshift, picks the first victim */
+} a3d_job_worker;
+
+static bool deque_pop(a3d_job_deque* d, a3d_job* out);
+static bool deque_push(a3d_job_deque* d, const a3d_job* job);
+static bool deque_steal(a3d_job_deque* d, a3d_job* out);
+static bool find_job(a3d_job_worker* w, a3d_job* out);
+static void push(const a3d_job* job);
+static void run(const a3d_job* job);
+static bool run_main_one(void);
+static int worker_main(void* data);
+
+static SDL_AtomicInt running;
+static SDL_AtomicInt sleeping;
+static a3d_job_worker* workers;
+static Uint32 worker_count; /* including the main thread */
+static SDL_TLSID worker_tls;
+static SDL_Semaphore* wake;
+static SDL_ThreadID main_thread;
+
+/* main thread affinity, for sdl calls that must not run anywhere else */
+static SDL_Mutex* main_lock;
+static a3d_job main_jobs[A3D_JOB_MAIN_QUEUE_SIZE];
+static Uint32 main_head;
+static Uint32 main_count;
+
+/* 0 threads starts one per logical core, leaving out the calling thread's */
+bool a3d_job_init(Uint32 threads)
+{
+	if (SDL_GetAtomicInt(&running))
+		return true;
+
+	if (threads == 0) {
+		int cores = SDL_GetNumLogicalCPUCores();
+		threads = cores > 1 ? (Uint32)cores - 1 : 0;
+	}
+	if (threads > A3D_JOB_MAX_WORKERS)
+		threads = A3D_JOB_MAX_WORKERS;
+
+	/* the deques hold a lot of jobs, keep them off the stack and out of the binary */
+	workers = calloc(threads + 1, sizeof *workers);
+	if (!workers) {
+		A3D_LOG_ERROR("failed to allocate %u job workers", threads + 1);
+		return false;
+	}
+	for (Uint32 i = 0; i <= threads; i++) {
+		workers[i].index = i;
+		workers[i].rng = 0x9e3779b9u * (i + 1);
+	}
+
+	main_lock = SDL_CreateMutex();
+	wake = SDL_CreateSemaphore(0);
+	if (!main_lock || !wake) {
+		A3D_LOG_ERROR("failed to create job sync objects: %s", SDL_GetError());
+		a3d_job_shutdown();
+		return false;
+	}
+
+	main_thread = SDL_GetCurrentThreadID();
+	if (!SDL_SetTLS(&worker_tls, &workers[0], NULL)) {
+		A3D_LOG_ERROR("failed to set job worker tls: %s", SDL_GetError());
+		a3d_job_shutdown();
+		return false;
+	}
+
+	/* both set before any worker reads them */
+	worker_count = threads + 1;
+	SDL_SetAtomicInt(&running, 1);
+
+	Uint32 started = 1;
+	for (Uint32 i = 1; i <= threads; i++) {
+		char name[16];
+		SDL_snprintf(name, sizeof name, "a3d_job_%u", i);
+		workers[i].thread = SDL_CreateThread(worker_main, name, &workers[i]);
+		if (!workers[i].thread) {
+			/* a worker without a thread just has an empty deque, the others carry on */
+			A3D_LOG_WARN("failed to create job thread %u: %s", i, SDL_GetError());
+			continue;
+		}
+		started++;
+	}
+
+	A3D_LOG_INFO("job system running on %u threads", started);
+	return true;
+}
+
+bool a3d_job_is_main_thread(void)
+{
+	return !SDL_GetAtomicInt(&running) || SDL_GetCurrentThreadID() == main_thread;
+}
+
+/* splits [0, count) into batch sized ranges and blocks until all of them ran; 0 picks a batch */
+void a3d_job_parallel_for(Uint32 count, Uint32 batch, a3d_job_fn fn, void* data)
+{
+	if (count == 0)
+		return;
+
+	/* a few ranges per thread so stealing can even out uneven work */
+	if (batch == 0) {
+		Uint32 threads = worker_count ? worker_count : 1;
+		batch = count / (threads * 4);
+		if (batch == 0)
+			batch = 1;
+	}
+
+	if (batch >= count || worker_count <= 1) {
+		fn(data, 0, count);
+		return;
+	}
+
+	a3d_job_counter counter = {0};
+	for (Uint32 first = 0; first < count; first += batch) {
+		Uint32 n = count - first < batch ? count - first : batch;
+		a3d_job_submit_range(fn, data, first, n, &counter);
+	}
+	a3d_job_wait(&counter);
+}
+
+/* called once a frame by a3d_frame, and by waits on the main thread */
+void a3d_job_run_main(void)
+{
+	if (!a3d_job_is_main_thread())
+		return;
+
+	while (run_main_one())
+		;
+}
+
+/* outstanding jobs are finished first; nothing may submit once this has started */
+void a3d_job_shutdown(void)
+{
+	if (SDL_GetAtomicInt(&running)) {
+		a3d_job job;
+		while (find_job(&workers[0], &job))
+			run(&job);
+		a3d_job_run_main();
+
+		SDL_SetAtomicInt(&running, 0);
+		for (Uint32 i = 1; i < worker_count; i++)
+			SDL_SignalSemaphore(wake);
+		for (Uint32 i = 1; i < worker_count; i++)
+			if (workers[i].thread)
+				SDL_WaitThread(workers[i].thread, NULL);
+		SDL_SetTLS(&worker_tls, NULL, NULL);
+	}
+
+	if (wake) {
+		SDL_DestroySemaphore(wake);
+		wake = NULL;
+	}
+	if (main_lock) {
+		SDL_DestroyMutex(main_lock);
+		main_lock = NULL;
+	}
+	main_head = 0;
+	main_count = 0;
+
+	free(workers);
+	workers = NULL;
+	worker_count = 0;
+}
+
+void a3d_job_submit(a3d_job_fn fn, void* data, a3d_job_counter* counter)
+{
+	a3d_job_submit_range(fn, data, 0, 1, counter);
+}
+
+/* queued for a3d_job_run_main, or run straight away when already on the main thread */
+void a3d_job_submit_main(a3d_job_fn fn, void* data, a3d_job_counter* counter)
+{
+	a3d_job job = {.fn = fn, .data = data, .first = 0, .count = 1, .counter = counter};
+	if (counter)
+		SDL_AddAtomicInt(&counter->pending, 1);
+
+	if (a3d_job_is_main_thread()) {
+		run(&job);
+		return;
+	}
+
+	for (;;) {
+		SDL_LockMutex(main_lock);
+		if (main_count < A3D_JOB_MAIN_QUEUE_SIZE) {
+			main_jobs[(main_head + main_count) % A3D_JOB_MAIN_QUEUE_SIZE] = job;
+			main_count++;
+			SDL_UnlockMutex(main_lock);
+			return;
+		}
+		SDL_UnlockMutex(main_lock);
+
+		/* full, help out while the main thread catches up */
+		a3d_job other;
+		a3d_job_worker* w = SDL_GetTLS(&worker_tls);
+		if (w && find_job(w, &other))
+			run(&other);
+		else
+			SDL_Delay(0);
+	}
+}
+
+void a3d_job_submit_range(a3d_job_fn fn, void* data, Uint32 first, Uint32 count, a3d_job_counter* counter)
+{
+	a3d_job job = {.fn = fn, .data = data, .first = first, .count = count, .counter = counter};
+	if (counter)
+		SDL_AddAtomicInt(&counter->pending, 1);
+	push(&job);
+}
+
+/* runs other jobs while waiting, so waiting from inside a job never starves the pool */
+void a3d_job_wait(a3d_job_counter* counter)
+{
+	a3d_job_worker* w = SDL_GetAtomicInt(&running) ? SDL_GetTLS(&worker_tls) : NULL;
+	Uint32 idle = 0;
+
+	while (SDL_GetAtomicInt(&counter->pending) > 0) {
+		a3d_job job;
+		if (w && w->index == 0 && run_main_one()) {
+			idle = 0;
+			continue;
+		}
+		if (w && find_job(w, &job)) {
+			run(&job);
+			idle = 0;
+			continue;
+		}
+
+		/* the last jobs are running elsewhere */
+		if (++idle < A3D_JOB_SPIN)
+			SDL_CPUPauseInstruction();
+		else
+			SDL_Delay(0);
+	}
+}
+
+Uint32 a3d_job_worker_count(void)
+{
+	return worker_count ? worker_count : 1;
+}
+
+/* private */
+static bool deque_pop(a3d_job_deque* d, a3d_job* out)
+{
+	int b = SDL_GetAtomicInt(&d->bottom) - 1;
+	SDL_SetAtomicInt(&d->bottom, b);
+	int t = SDL_GetAtomicInt(&d->top);
+
+	int size = (int)((Uint32)b - (Uint32)t);
+	if (size < 0) {
+		SDL_SetAtomicInt(&d->bottom, t);
+		return false;
+	}
+
+	*out = d->jobs[(Uint32)b & (A3D_JOB_DEQUE_SIZE - 1)];
+	if (size > 0)
+		return true;
+
+	/* the last one, a thief may be after it too */
+	bool won = SDL_CompareAndSwapAtomicInt(&d->top, t, t + 1);
+	SDL_SetAtomicInt(&d->bottom, t + 1);
+	return won;
+}
+
+static bool deque_push(a3d_job_deque* d, const a3d_job* job)
+{
+	int b = SDL_GetAtomicInt(&d->bottom);
+	int t = SDL_GetAtomicInt(&d->top);
+	if ((int)((Uint32)b - (Uint32)t) >= A3D_JOB_DEQUE_SIZE)
+		return false;
+
+	d->jobs[(Uint32)b & (A3D_JOB_DEQUE_SIZE - 1)] = *job;
+	SDL_MemoryBarrierRelease();
+	SDL_SetAtomicInt(&d->bottom, b + 1);
+	return true;
+}
+
+static bool deque_steal(a3d_job_deque* d, a3d_job* out)
+{
+	int t = SDL_GetAtomicInt(&d->top);
+	int b = SDL_GetAtomicInt(&d->bottom);
+	if ((int)((Uint32)b - (Uint32)t) <= 0)
+		return false;
+
+	/* copied before the cas, once top moves the owner may overwrite the slot */
+	SDL_MemoryBarrierAcquire();
+	a3d_job job = d->jobs[(Uint32)t & (A3D_JOB_DEQUE_SIZE - 1)];
+	if (!SDL_CompareAndSwapAtomicInt(&d->top, t, t + 1))
+		return false;
+
+	*out = job;
+	return true;
+}
+
+/* own deque newest first, then one steal round starting at a random victim */
+static bool find_job(a3d_job_worker* w, a3d_job* out)
+{
+	if (deque_pop(&w->deque, out))
+		return true;
+
+	Uint32 n = worker_count;
+	if (n <= 1)
+		return false;
+
+	w->rng ^= w->rng << 13;
+	w->rng ^= w->rng >> 17;
+	w->rng ^= w->rng << 5;
+
+	Uint32 start = w->rng % n;
+	for (Uint32 i = 0; i < n; i++) {
+		Uint32 victim = (start + i) % n;
+		if (victim != w->index && deque_steal(&workers[victim].deque, out))
+			return true;
+	}
+
+	return false;
+}
+
+/* onto the calling thread's deque; threads outside the pool and full deques run it in place */
+static void push(const a3d_job* job)
+{
+	a3d_job_worker* w = SDL_GetAtomicInt(&running) ? SDL_GetTLS(&worker_tls) : NULL;
+	if (!w || worker_count <= 1 || !deque_push(&w->deque, job)) {
+		run(job);
+		return;
+	}
+
+	if (SDL_GetAtomicInt(&sleeping) > 0)
+		SDL_SignalSemaphore(wake);
+}
+
+static void run(const a3d_job* job)
+{
+	job->fn(job->data, job->first, job->count);
+	if (job->counter)
+		SDL_AddAtomicInt(&job->counter->pending, -1);
+}
+
+static bool run_main_one(void)
+{
+	if (!main_lock)
+		return false;
+
+	SDL_LockMutex(main_lock);
+	if (main_count == 0) {
+		SDL_UnlockMutex(main_lock);
+		return false;
+	}
+	a3d_job job = main_jobs[main_head];
+	main_head = (main_head + 1) % A3D_JOB_MAIN_QUEUE_SIZE;
+	main_count--;
+	SDL_UnlockMutex(main_lock);
+
+	run(&job);
+	return true;
+}
+
+static int worker_main(void* data)
+{
+	a3d_job_worker* w = data;
+	SDL_SetTLS(&worker_tls, w, NULL);
+
+	Uint32 idle = 0;
+	while (SDL_GetAtomicInt(&running)) {
+		a3d_job job;
+		if (find_job(w, &job)) {
+			run(&job);
+			idle = 0;
+			continue;
+		}
+
+		if (++idle < A3D_JOB_SPIN) {
+			SDL_CPUPauseInstruction();
+			continue;
+		}
+
+		/*
+		 * a push either sees the increment and signals, or landed before it and the second look
+		 * finds it. extra signals only cost a spurious wake
+		 */
+		SDL_AddAtomicInt(&sleeping, 1);
+		if (find_job(w, &job)) {
+			SDL_AddAtomicInt(&sleeping, -1);
+			run(&job);
+			idle = 0;
+			continue;
+		}
+		if (SDL_GetAtomicInt(&running))
+			SDL_WaitSemaphore(wake);
+		SDL_AddAtomicInt(&sleeping, -1);
+		idle = 0;
+	}
+
+	return 0;
+}
@@ -0,0 +1,345 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL3/SDL.h>
+
+#include "a3d_logging.h"
+
+/* formatted on the calling thread, prefixed and written out on the writer thread */
+typedef struct {
+	Uint64   time_ns;
+	Uint64   thread;
+	const char* subsystem; /* string literals from the macros, never copied */
+	const char* file;
+	Sint32   line;
+	Uint32   seq; /* global order, the writer merges rings on it */
+	Sint32   suppressed;
+	int      level;
+	char     message[A3D_LOG_MESSAGE_SIZE];
+} a3d_log_record;
+
+/* single producer, single consumer; kept for the life of the process and reused once its thread exits */
+typedef struct a3d_log_ring {
+	SDL_AtomicInt head; /* written by the owning thread */
+	char     pad[64 - sizeof(SDL_AtomicInt)];
+	SDL_AtomicInt tail; /* written by the writer thread */
+	SDL_AtomicInt owned;
+	struct a3d_log_ring* next;
+	a3d_log_record records[A3D_LOG_RING_RECORDS];
+} a3d_log_ring;
+
+static void drain(void);
+static void emit_binary(const a3d_log_record* rec);
+static void emit_text(const a3d_log_record* rec);
+static bool rate_limit(a3d_log_site* site, Sint32* out_suppressed);
+static void release_ring(void* ring);
+static a3d_log_ring* thread_ring(void);
+static int writer_main(void* data);
+
+static SDL_AtomicInt running;
+static SDL_AtomicInt seq;
+static SDL_AtomicInt dropped;
+static a3d_log_ring* rings; /* push only, swapped in with a CAS */
+static SDL_TLSID ring_tls;
+static SDL_Semaphore* wake;
+static SDL_Thread* writer;
+static FILE* binary;
+
+/* blocks until everything logged so far has been written */
+void a3d_log_flush(void)
+{
+	if (!SDL_GetAtomicInt(&running))
+		return;
+
+	for (;;) {
+		bool empty = true;
+		for (a3d_log_ring* ring = SDL_GetAtomicPointer((void**)&rings); ring; ring = ring->next)
+			if (SDL_GetAtomicInt(&ring->head) != SDL_GetAtomicInt(&ring->tail))
+				empty = false;
+		if (empty)
+			break;
+
+		SDL_SignalSemaphore(wake);
+		SDL_Delay(1);
+	}
+}
+
+/* until this runs, and after a3d_log_shutdown, messages are written synchronously */
+bool a3d_log_init(const char* binary_path)
+{
+	if (SDL_GetAtomicInt(&running))
+		return true;
+
+	if (binary_path) {
+		binary = fopen(binary_path, "wb");
+		if (!binary) {
+			A3D_LOG_ERROR("failed to open file %s", binary_path);
+			return false;
+		}
+
+		a3d_log_binary_header header = {
+			.magic = A3D_LOG_BINARY_MAGIC,
+			.version = A3D_LOG_BINARY_VERSION
+		};
+		fwrite(&header, sizeof header, 1, binary);
+	}
+
+	/* so early exits, like a failed init returning from main, still get their errors out */
+	static bool registered;
+	if (!registered)
+		registered = atexit(a3d_log_shutdown) == 0;
+
+	wake = SDL_CreateSemaphore(0);
+	if (!wake) {
+		A3D_LOG_ERROR("failed to create log semaphore: %s", SDL_GetError());
+		a3d_log_shutdown();
+		return false;
+	}
+
+	/* set first so the writer doesn't exit straight away */
+	SDL_SetAtomicInt(&running, 1);
+	writer = SDL_CreateThread(writer_main, "a3d_log", NULL);
+	if (!writer) {
+		SDL_SetAtomicInt(&running, 0);
+		A3D_LOG_ERROR("failed to create log thread: %s", SDL_GetError());
+		a3d_log_shutdown();
+		return false;
+	}
+
+	return true;
+}
+
+/* other threads must have stopped logging, anything they push after the final drain is lost */
+void a3d_log_shutdown(void)
+{
+	if (writer) {
+		SDL_SetAtomicInt(&running, 0);
+		SDL_SignalSemaphore(wake);
+		SDL_WaitThread(writer, NULL);
+		writer = NULL;
+	}
+	drain();
+
+	if (wake) {
+		SDL_DestroySemaphore(wake);
+		wake = NULL;
+	}
+
+	if (binary) {
+		fclose(binary);
+		binary = NULL;
+	}
+}
+
+void a3d_log_write(
+	a3d_log_site* site, int level, const char* subsystem, const char* file, int line, const char* fmt, ...
+)
+{
+	Sint32 suppressed = 0;
+	if (!rate_limit(site, &suppressed))
+		return;
+
+	a3d_log_record local;
+	a3d_log_record* rec = &local;
+
+	a3d_log_ring* ring = SDL_GetAtomicInt(&running) ? thread_ring() : NULL;
+	int head = 0;
+	if (ring) {
+		head = SDL_GetAtomicInt(&ring->head);
+		int tail = SDL_GetAtomicInt(&ring->tail);
+
+		/* never block the caller, count it and move on */
+		if (head - tail == A3D_LOG_RING_RECORDS) {
+			SDL_AddAtomicInt(&dropped, 1);
+			return;
+		}
+		rec = &ring->records[head & (A3D_LOG_RING_RECORDS - 1)];
+
+		if (level >= A3D_LOG_LEVEL_ERROR || head - tail == A3D_LOG_RING_RECORDS / 2)
+			SDL_SignalSemaphore(wake);
+	}
+
+	rec->time_ns = SDL_GetTicksNS();
+	rec->thread = (Uint64)SDL_GetCurrentThreadID();
+	rec->subsystem = subsystem;
+	rec->file = file;
+	rec->line = line;
+	rec->seq = (Uint32)SDL_AddAtomicInt(&seq, 1);
+	rec->suppressed = suppressed;
+	rec->level = level;
+
+	va_list args;
+	va_start(args, fmt);
+	vsnprintf(rec->message, sizeof rec->message, fmt, args);
+	va_end(args);
+
+	if (!ring) {
+		emit_text(rec);
+		return;
+	}
+
+	SDL_MemoryBarrierRelease();
+	SDL_SetAtomicInt(&ring->head, head + 1);
+}
+
+/* private */
+/* oldest record across all rings first, until every ring is empty */
+static void drain(void)
+{
+	for (;;) {
+		a3d_log_ring* oldest = NULL;
+		a3d_log_record* oldest_rec = NULL;
+
+		for (a3d_log_ring* ring = SDL_GetAtomicPointer((void**)&rings); ring; ring = ring->next) {
+			int tail = SDL_GetAtomicInt(&ring->tail);
+			if (tail == SDL_GetAtomicInt(&ring->head))
+				continue;
+
+			SDL_MemoryBarrierAcquire();
+			a3d_log_record* rec = &ring->records[tail & (A3D_LOG_RING_RECORDS - 1)];
+			if (!oldest || (Sint32)(rec->seq - oldest_rec->seq) < 0) {
+				oldest = ring;
+				oldest_rec = rec;
+			}
+		}
+		if (!oldest)
+			break;
+
+		if (binary)
+			emit_binary(oldest_rec);
+		if (!binary || oldest_rec->level >= A3D_LOG_LEVEL_WARN)
+			emit_text(oldest_rec);
+
+		SDL_AddAtomicInt(&oldest->tail, 1);
+	}
+
+	int lost = SDL_SetAtomicInt(&dropped, 0);
+	if (lost)
+		fprintf(stderr, ANSI_FG_WHITE ANSI_BG_YELLOW " WARN  " ANSI_RESET " log rings full, dropped %d messages\n", lost);
+
+	fflush(stdout);
+	fflush(stderr);
+	if (binary)
+		fflush(binary);
+}
+
+static void emit_binary(const a3d_log_record* rec)
+{
+	size_t subsystem_len = strlen(rec->subsystem);
+	size_t file_len = strlen(rec->file);
+	size_t message_len = strlen(rec->message);
+
+	a3d_log_binary_record header = {
+		.time_ns = rec->time_ns,
+		.thread = rec->thread,
+		.seq = rec->seq,
+		.line = rec->line,
+		.suppressed = rec->suppressed,
+		.level = (Uint16)rec->level,
+		.subsystem_len = (Uint16)subsystem_len,
+		.file_len = (Uint16)file_len,
+		.message_len = (Uint16)message_len
+	};
+	fwrite(&header, sizeof header, 1, binary);
+	fwrite(rec->subsystem, 1, subsystem_len, binary);
+	fwrite(rec->file, 1, file_len, binary);
+	fwrite(rec->message, 1, message_len, binary);
+}
+
+/* one fprintf per record so lines from the synchronous path never interleave */
+static void emit_text(const a3d_log_record* rec)
+{
+	char note[48] = "";
+	if (rec->suppressed)
+		snprintf(note, sizeof note, " (%d similar suppressed)", rec->suppressed);
+
+	switch (rec->level) {
+	case A3D_LOG_LEVEL_DEBUG:
+		fprintf(stdout, ANSI_FG_WHITE ANSI_BG_MAGENTA " DEBUG " ANSI_RESET " %s%s\n", rec->message, note);
+		break;
+	case A3D_LOG_LEVEL_INFO:
+		fprintf(stdout, ANSI_FG_WHITE ANSI_BG_CYAN " INFO  " ANSI_RESET " %s%s\n", rec->message, note);
+		break;
+	case A3D_LOG_LEVEL_WARN:
+		fprintf(stderr, ANSI_FG_WHITE ANSI_BG_YELLOW " WARN  " ANSI_RESET " %s%s\n", rec->message, note);
+		break;
+	case A3D_LOG_LEVEL_ERROR:
+		fprintf(
+			stderr, ANSI_FG_WHITE ANSI_BG_RED " ERROR " ANSI_RESET " %s:%d: %s%s\n",
+			rec->file, rec->line, rec->message, note
+		);
+		break;
+	default:
+		fprintf(stdout, "%s%s\n", rec->message, note);
+		break;
+	}
+}
+
+/* at most A3D_LOG_RATE_BURST per site and window, the overflow is reported with the next one through */
+static bool rate_limit(a3d_log_site* site, Sint32* out_suppressed)
+{
+	if (A3D_LOG_RATE_BURST == 0)
+		return true;
+
+	int window = (int)(SDL_GetTicks() / A3D_LOG_RATE_WINDOW_MS);
+	int seen = SDL_GetAtomicInt(&site->window);
+	if (seen != window && SDL_CompareAndSwapAtomicInt(&site->window, seen, window)) {
+		SDL_SetAtomicInt(&site->count, 0);
+		*out_suppressed = SDL_SetAtomicInt(&site->suppressed, 0);
+	}
+
+	if (SDL_AddAtomicInt(&site->count, 1) < A3D_LOG_RATE_BURST)
+		return true;
+
+	SDL_AddAtomicInt(&site->suppressed, 1);
+	return false;
+}
+
+/* tls destructor; queued records stay put and are drained as usual */
+static void release_ring(void* ring)
+{
+	SDL_SetAtomicInt(&((a3d_log_ring*)ring)->owned, 0);
+}
+
+static a3d_log_ring* thread_ring(void)
+{
+	a3d_log_ring* ring = SDL_GetTLS(&ring_tls);
+	if (ring)
+		return ring;
+
+	/* rings left behind by exited threads first */
+	for (ring = SDL_GetAtomicPointer((void**)&rings); ring; ring = ring->next)
+		if (SDL_CompareAndSwapAtomicInt(&ring->owned, 0, 1))
+			break;
+
+	if (!ring) {
+		ring = calloc(1, sizeof *ring);
+		if (!ring)
+			return NULL;
+		SDL_SetAtomicInt(&ring->owned, 1);
+
+		do
+			ring->next = SDL_GetAtomicPointer((void**)&rings);
+		while (!SDL_CompareAndSwapAtomicPointer((void**)&rings, ring->next, ring));
+	}
+
+	if (!SDL_SetTLS(&ring_tls, ring, release_ring)) {
+		SDL_SetAtomicInt(&ring->owned, 0);
+		return NULL;
+	}
+
+	return ring;
+}
+
+static int writer_main(void* data)
+{
+	(void)data;
+
+	while (SDL_GetAtomicInt(&running)) {
+		SDL_WaitSemaphoreTimeout(wake, A3D_LOG_FLUSH_MS);
+		drain();
+	}
+
+	return 0;
+}
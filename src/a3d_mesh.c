@@ -1,26 +1,322 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cglm/cglm.h>
+#include <SDL3/SDL_atomic.h>
 #include <SDL3/SDL_stdinc.h>
 #include <vulkan/vulkan.h>
 
 #include "a3d.h"
 #include "a3d_logging.h"
 #include "a3d_mesh.h"
+#include "vulkan/a3d_vulkan_sync.h"
+#include "vulkan/a3d_vulkan_upload.h"
 
+static void box_bounds(a3d_mesh* mesh, const vec3 aabb_min, const vec3 aabb_max);
+static void compute_bounds(a3d_mesh* mesh, const a3d_vertex* vertices, Uint32 vertex_count);
+static bool create_buffers(a3d* e, a3d_mesh* mesh, const void* vertices, VkDeviceSize vertices_size, const Uint16* indices);
+
+/* ids are slots handed back on destroy, so they stay below the live mesh count and fit the sort key */
+static SDL_SpinLock id_lock;
+static Uint32 next_mesh_id = 1;
+static Uint32* free_ids;
+static Uint32 free_id_count;
+static Uint32 free_id_capacity;
+
+void a3d_bind_mesh(a3d* engine, const a3d_mesh* mesh, VkCommandBuffer* cmd)
+{
+	(void) engine;
+	VkDeviceSize offsets[] = {0};
+	vkCmdBindVertexBuffers(*cmd, 0, 1, &mesh->vertex_buffer.buff, offsets);
+	vkCmdBindIndexBuffer(*cmd, mesh->index_buffer.buff, 0, VK_INDEX_TYPE_UINT16);
+}
+
+/* pooled meshes give nothing back, their range is reclaimed with the pool. frames still in flight
+ * may draw it, so the buffers go once they retire */
 void a3d_destroy_mesh(a3d* e, a3d_mesh* mesh)
 {
-	a3d_vk_destroy_buffer(e, &mesh->vertex_buffer);
-	a3d_vk_destroy_buffer(e, &mesh->index_buffer);
+	if (mesh->pool) {
+		mesh->pool = NULL;
+		mesh->vertex_buffer = (a3d_buffer){0};
+		mesh->index_buffer = (a3d_buffer){0};
+	}
+	else {
+		a3d_vk_sync_defer_buffer(e, &mesh->vertex_buffer);
+		a3d_vk_sync_defer_buffer(e, &mesh->index_buffer);
+		A3D_LOG_INFO("mesh destroyed");
+	}
+	a3d_mesh_release_id(mesh->id);
+	mesh->id = 0;
 	mesh->vertex_count = 0;
 	mesh->index_count = 0;
-	A3D_LOG_INFO("mesh destroyed");
 }
 
-void a3d_draw_mesh(a3d* engine, const a3d_mesh* mesh, VkCommandBuffer* cmd)
+/* meshes created from the pool must not be drawn afterwards; frames already submitted still can */
+void a3d_destroy_mesh_pool(a3d* e, a3d_mesh_pool* pool)
+{
+	a3d_vk_sync_defer_buffer(e, &pool->vertex_buffer);
+	a3d_vk_sync_defer_buffer(e, &pool->index_buffer);
+	A3D_LOG_INFO(
+		"mesh pool destroyed, held %u meshes in %u vertices and %u indices",
+		pool->mesh_count, pool->vertex_count, pool->index_count
+	);
+	memset(pool, 0, sizeof *pool);
+}
+
+/* expects a3d_bind_mesh; instances index the model matrices in the per-frame storage buffer */
+void a3d_draw_mesh(a3d* engine, const a3d_mesh* mesh, VkCommandBuffer* cmd, Uint32 first_instance, Uint32 instance_count)
 {
 	(void) engine;
-	VkDeviceSize offsets[] = {0};
-	vkCmdBindVertexBuffers(*cmd, 0, 1, &mesh->vertex_buffer.buff, offsets);
-	vkCmdBindIndexBuffer(*cmd, mesh->index_buffer.buff, 0, VK_INDEX_TYPE_UINT16);
-	vkCmdDrawIndexed(*cmd, mesh->index_count, 1, 0, 0, 0);
+	vkCmdDrawIndexed(*cmd, mesh->index_count, instance_count, mesh->first_index, mesh->vertex_offset, first_instance);
+}
+
+bool a3d_create_mesh(
+	a3d* e, a3d_mesh* mesh, const a3d_vertex* vertices, Uint32 vertex_count,
+	const Uint16* indices, Uint32 index_count
+)
+{
+	/* vulkan has no zero sized buffers */
+	if (vertex_count == 0 || index_count == 0) {
+		A3D_LOG_ERROR("mesh needs vertices and indices, got %u and %u", vertex_count, index_count);
+		return false;
+	}
+
+	mesh->pool = NULL;
+	mesh->vertex_count = vertex_count;
+	mesh->index_count = index_count;
+	mesh->vertex_offset = 0;
+	mesh->first_index = 0;
+	mesh->lod_count = 0;
+	mesh->topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	mesh->format = A3D_VERTEX_FORMAT_FLOAT;
+	mesh->id = a3d_mesh_next_id();
+	compute_bounds(mesh, vertices, vertex_count);
+
+	return create_buffers(e, mesh, vertices, vertex_count * sizeof *vertices, indices);
+}
+
+bool a3d_create_mesh_pool(
+	a3d* e, a3d_mesh_pool* pool, a3d_vertex_format format, Uint32 vertex_capacity, Uint32 index_capacity
+)
+{
+	memset(pool, 0, sizeof *pool);
+	pool->format = format;
+
+	bool r = a3d_vk_create_buffer(
+		e, (VkDeviceSize)vertex_capacity * a3d_vertex_format_stride(format),
+		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &pool->vertex_buffer, NULL
+	);
+	if (!r) {
+		A3D_LOG_ERROR("failed to create pool vertex buffer for %u vertices", vertex_capacity);
+		return false;
+	}
+
+	r = a3d_vk_create_buffer(
+		e, index_capacity * sizeof(Uint16), VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &pool->index_buffer, NULL
+	);
+	if (!r) {
+		A3D_LOG_ERROR("failed to create pool index buffer for %u indices", index_capacity);
+		a3d_vk_destroy_buffer(e, &pool->vertex_buffer);
+		return false;
+	}
+
+	pool->vertex_capacity = vertex_capacity;
+	pool->index_capacity = index_capacity;
+
+	A3D_LOG_INFO("created mesh pool for %u vertices and %u indices", vertex_capacity, index_capacity);
+	return true;
+}
+
+/* all or nothing; the meshes sit back to back in the pool, each uploaded straight from its desc */
+bool a3d_create_meshes(a3d* e, a3d_mesh_pool* pool, a3d_mesh* meshes, const a3d_mesh_desc* descs, Uint32 count)
+{
+	Uint64 vertex_total = 0;
+	Uint64 index_total = 0;
+	for (Uint32 i = 0; i < count; i++) {
+		vertex_total += descs[i].vertex_count;
+		index_total += descs[i].index_count;
+	}
+
+	if (vertex_total > UINT32_MAX || index_total > UINT32_MAX) {
+		A3D_LOG_ERROR("%u meshes are too large for one pool", count);
+		return false;
+	}
+
+	Uint32 first_vertex;
+	Uint32 first_index;
+	if (!a3d_mesh_pool_reserve(pool, (Uint32)vertex_total, (Uint32)index_total, &first_vertex, &first_index))
+		return false;
+
+	/* the upload ring is the only copy, nothing is packed on the cpu first */
+	Uint32 stride = a3d_vertex_format_stride(pool->format);
+	Uint32 vertex_cursor = 0;
+	Uint32 index_cursor = 0;
+	for (Uint32 i = 0; i < count; i++) {
+		const a3d_mesh_desc* desc = &descs[i];
+		a3d_mesh* mesh = &meshes[i];
+
+		bool ok = a3d_vk_upload_buffer(
+			e, &pool->vertex_buffer, (VkDeviceSize)(first_vertex + vertex_cursor) * stride,
+			desc->vertices, (VkDeviceSize)desc->vertex_count * stride
+		) && a3d_vk_upload_buffer(
+			e, &pool->index_buffer, (VkDeviceSize)(first_index + index_cursor) * sizeof(Uint16),
+			desc->indices, (VkDeviceSize)desc->index_count * sizeof(Uint16)
+		);
+		if (!ok) {
+			A3D_LOG_ERROR("failed to upload %u pooled meshes", count);
+			for (Uint32 j = 0; j < i; j++)
+				a3d_mesh_release_id(meshes[j].id);
+			memset(meshes, 0, count * sizeof *meshes);
+			pool->vertex_count = first_vertex;
+			pool->index_count = first_index;
+			return false;
+		}
+
+		/* indices stay mesh local, vertexOffset rebases them at draw time */
+		mesh->pool = pool;
+		mesh->vertex_buffer = pool->vertex_buffer;
+		mesh->index_buffer = pool->index_buffer;
+		mesh->vertex_count = desc->vertex_count;
+		mesh->index_count = desc->index_count;
+		mesh->vertex_offset = (Sint32)(first_vertex + vertex_cursor);
+		mesh->first_index = first_index + index_cursor;
+		mesh->lod_count = 0;
+		mesh->topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+		mesh->format = pool->format;
+		mesh->id = a3d_mesh_next_id();
+		if (pool->format == A3D_VERTEX_FORMAT_PACKED)
+			box_bounds(mesh, desc->aabb_min, desc->aabb_max);
+		else
+			compute_bounds(mesh, desc->vertices, desc->vertex_count);
+
+		vertex_cursor += desc->vertex_count;
+		index_cursor += desc->index_count;
+	}
+
+	pool->mesh_count += count;
+
+	A3D_LOG_DEBUG("added %u meshes to pool, %u vertices and %u indices in use", count, pool->vertex_count, pool->index_count);
+	return true;
+}
+
+/* standalone mesh from vertices already run through a3d_pack_vertex against desc's box */
+bool a3d_create_packed_mesh(a3d* e, a3d_mesh* mesh, const a3d_mesh_desc* desc)
+{
+	if (desc->vertex_count == 0 || desc->index_count == 0) {
+		A3D_LOG_ERROR("mesh needs vertices and indices, got %u and %u", desc->vertex_count, desc->index_count);
+		return false;
+	}
+
+	mesh->pool = NULL;
+	mesh->vertex_count = desc->vertex_count;
+	mesh->index_count = desc->index_count;
+	mesh->vertex_offset = 0;
+	mesh->first_index = 0;
+	mesh->lod_count = 0;
+	mesh->topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	mesh->format = A3D_VERTEX_FORMAT_PACKED;
+	mesh->id = a3d_mesh_next_id();
+	box_bounds(mesh, desc->aabb_min, desc->aabb_max);
+
+	return create_buffers(
+		e, mesh, desc->vertices, (VkDeviceSize)desc->vertex_count * sizeof(a3d_vertex_packed), desc->indices
+	);
+}
+
+/* normals go through the unscaled model: its cofactor matrix, which is the inverse transpose up to
+ * a positive scale once the determinant's sign is applied. the shader renormalises, and unlike an
+ * inverse it never divides, so degenerate models give zero normals instead of nans. columns are
+ * vec4 to match std430's mat3 */
+void a3d_mesh_normal_matrix(mat4 model, vec4 out_normal[3])
+{
+	vec3 c[3];
+	glm_vec3_cross(model[1], model[2], c[0]);
+	glm_vec3_cross(model[2], model[0], c[1]);
+	glm_vec3_cross(model[0], model[1], c[2]);
+
+	float sign = glm_vec3_dot(model[0], c[0]) < 0.0f ? -1.0f : 1.0f;
+	for (Uint32 k = 0; k < 3; k++) {
+		glm_vec3_scale(c[k], sign, c[k]);
+		glm_vec4(c[k], 0.0f, out_normal[k]);
+	}
+}
+
+/* the model matrix the vertex shader gets; packed positions come in as -1..1 across the box,
+ * so the dequantising scale and offset are folded in here rather than paid per vertex */
+void a3d_mesh_shader_model(const a3d_mesh* mesh, mat4 model, mat4 out_model)
+{
+	if (mesh->format != A3D_VERTEX_FORMAT_PACKED) {
+		glm_mat4_copy(model, out_model);
+		return;
+	}
+
+	vec4 centre = {0.0f, 0.0f, 0.0f, 1.0f};
+	vec3 half_extent;
+	for (Uint32 k = 0; k < 3; k++) {
+		centre[k] = 0.5f * (mesh->aabb_min[k] + mesh->aabb_max[k]);
+		half_extent[k] = 0.5f * (mesh->aabb_max[k] - mesh->aabb_min[k]);
+	}
+
+	/* model * translate(centre) * scale(half_extent) */
+	vec4 origin;
+	glm_mat4_mulv(model, centre, origin);
+	for (Uint32 c = 0; c < 3; c++)
+		glm_vec4_scale(model[c], half_extent[c], out_model[c]);
+	glm_vec4_copy(origin, out_model[3]);
+}
+
+/* bump allocates a range for the caller to upload into */
+bool a3d_mesh_pool_reserve(
+	a3d_mesh_pool* pool, Uint32 vertex_count, Uint32 index_count, Uint32* out_first_vertex, Uint32* out_first_index
+)
+{
+	if ((Uint64)pool->vertex_count + vertex_count > pool->vertex_capacity ||
+	    (Uint64)pool->index_count + index_count > pool->index_capacity) {
+		A3D_LOG_ERROR(
+			"mesh pool full: %u vertices and %u indices requested, %u and %u left",
+			vertex_count, index_count,
+			pool->vertex_capacity - pool->vertex_count, pool->index_capacity - pool->index_count
+		);
+		return false;
+	}
+
+	*out_first_vertex = pool->vertex_count;
+	*out_first_index = pool->index_count;
+	pool->vertex_count += vertex_count;
+	pool->index_count += index_count;
+	return true;
+}
+
+/* any thread; the most recently released id first, 0 is never handed out */
+Uint32 a3d_mesh_next_id(void)
+{
+	SDL_LockSpinlock(&id_lock);
+	Uint32 id = free_id_count ? free_ids[--free_id_count] : next_mesh_id++;
+	SDL_UnlockSpinlock(&id_lock);
+	return id;
+}
+
+/* any thread; 0 is ignored. an id the free list can't grow to hold is simply never reused */
+void a3d_mesh_release_id(Uint32 id)
+{
+	if (id == 0)
+		return;
+
+	SDL_LockSpinlock(&id_lock);
+	if (free_id_count == free_id_capacity) {
+		Uint32 capacity = free_id_capacity ? free_id_capacity * 2 : 64;
+		Uint32* ids = realloc(free_ids, capacity * sizeof *ids);
+		if (!ids) {
+			SDL_UnlockSpinlock(&id_lock);
+			return;
+		}
+		free_ids = ids;
+		free_id_capacity = capacity;
+	}
+	free_ids[free_id_count++] = id;
+	SDL_UnlockSpinlock(&id_lock);
 }
 
 bool a3d_init_triangle(a3d* e, a3d_mesh* mesh)
@@ -36,31 +332,94 @@ bool a3d_init_triangle(a3d* e, a3d_mesh* mesh)
 
 	Uint16 indices[] = {0, 1, 2};
 
-	mesh->vertex_count = 3;
-	mesh->index_count = 3;
-	mesh->topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	if (!a3d_create_mesh(e, mesh, vertices, 3, indices, 3))
+		return false;
+
+	A3D_LOG_INFO("created triangle mesh");
+
+	return true;
+}
+
+/* private */
+static void box_bounds(a3d_mesh* mesh, const vec3 aabb_min, const vec3 aabb_max)
+{
+	glm_vec3_copy((float*)aabb_min, mesh->aabb_min);
+	glm_vec3_copy((float*)aabb_max, mesh->aabb_max);
+
+	/* the vertices are quantised, so the sphere is the one around the box */
+	vec3 half_extent;
+	for (Uint32 k = 0; k < 3; k++) {
+		mesh->sphere[k] = 0.5f * (aabb_min[k] + aabb_max[k]);
+		half_extent[k] = 0.5f * (aabb_max[k] - aabb_min[k]);
+	}
+	mesh->sphere[3] = glm_vec3_norm(half_extent);
+}
+
+static void compute_bounds(a3d_mesh* mesh, const a3d_vertex* vertices, Uint32 vertex_count)
+{
+	/* vertices are flat for now, z stays 0 */
+	vec3 lo = {0.0f, 0.0f, 0.0f};
+	vec3 hi = {0.0f, 0.0f, 0.0f};
+	for (Uint32 i = 0; i < vertex_count; i++) {
+		for (Uint32 k = 0; k < 2; k++) {
+			float v = vertices[i].position[k];
+			if (i == 0 || v < lo[k])
+				lo[k] = v;
+			if (i == 0 || v > hi[k])
+				hi[k] = v;
+		}
+	}
 
-	/* vertex buffer */
+	glm_vec3_copy(lo, mesh->aabb_min);
+	glm_vec3_copy(hi, mesh->aabb_max);
+
+	/* sphere around the box centre, tightened against the actual vertices */
+	vec3 centre = {0.5f * (lo[0] + hi[0]), 0.5f * (lo[1] + hi[1]), 0.5f * (lo[2] + hi[2])};
+	float radius_sq = 0.0f;
+	for (Uint32 i = 0; i < vertex_count; i++) {
+		float dx = vertices[i].position[0] - centre[0];
+		float dy = vertices[i].position[1] - centre[1];
+		float d = dx * dx + dy * dy;
+		if (d > radius_sq)
+			radius_sq = d;
+	}
+
+	mesh->sphere[0] = centre[0];
+	mesh->sphere[1] = centre[1];
+	mesh->sphere[2] = centre[2];
+	mesh->sphere[3] = sqrtf(radius_sq);
+}
+
+static bool create_buffers(a3d* e, a3d_mesh* mesh, const void* vertices, VkDeviceSize vertices_size, const Uint16* indices)
+{
+	VkDeviceSize indices_size = mesh->index_count * sizeof *indices;
+
+	/* vertex buffer, filled through the staging ring */
 	bool r = a3d_vk_create_buffer(
-		e, sizeof(vertices), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		&mesh->vertex_buffer, vertices
+		e, vertices_size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &mesh->vertex_buffer, NULL
 	);
 	if (!r)
 		return false;
 
 	/* index buffer */
 	r = a3d_vk_create_buffer(
-		e, sizeof(indices), VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		&mesh->index_buffer, indices
+		e, indices_size, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &mesh->index_buffer, NULL
 	);
 	if (!r) {
 		a3d_vk_destroy_buffer(e, &mesh->vertex_buffer);
 		return false;
 	}
 
-	A3D_LOG_INFO("created triangle mesh");
+	/* the copies land before the next frame that draws the mesh */
+	if (!a3d_vk_upload_buffer(e, &mesh->vertex_buffer, 0, vertices, vertices_size) ||
+	    !a3d_vk_upload_buffer(e, &mesh->index_buffer, 0, indices, indices_size)) {
+		A3D_LOG_ERROR("failed to upload mesh data");
+		a3d_vk_destroy_buffer(e, &mesh->vertex_buffer);
+		a3d_vk_destroy_buffer(e, &mesh->index_buffer);
+		return false;
+	}
 
 	return true;
 }
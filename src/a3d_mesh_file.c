@@ -0,0 +1,247 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vulkan/vulkan.h>
+
+#include "a3d.h"
+#include "a3d_logging.h"
+#include "a3d_mesh.h"
+#include "a3d_mesh_file.h"
+#include "vulkan/a3d_vulkan_upload.h"
+
+static bool indices_fit(const a3d_mesh_file_header* h, const Uint16* indices);
+static bool stream_fits(Uint64 offset, Uint64 count, Uint64 stride, Uint64 file_size);
+static bool validate(const a3d_mesh_file_header* h, size_t file_size, const char* path);
+
+/* counts, lods and bounds from the header, for streams placed at first_vertex and first_index */
+void a3d_mesh_file_apply(const a3d_mesh_file_header* h, Uint32 first_vertex, Uint32 first_index, a3d_mesh* mesh)
+{
+	mesh->vertex_count = h->vertex_count;
+	mesh->index_count = h->lods[0].index_count;
+	mesh->vertex_offset = (Sint32)first_vertex;
+	mesh->first_index = first_index + h->lods[0].first_index;
+	mesh->topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	mesh->format = (a3d_vertex_format)h->vertex_format;
+	mesh->id = a3d_mesh_next_id();
+
+	mesh->lod_count = h->lod_count;
+	for (Uint32 i = 0; i < h->lod_count; i++) {
+		mesh->lods[i] = (a3d_mesh_lod){
+			.first_index = first_index + h->lods[i].first_index,
+			.index_count = h->lods[i].index_count,
+			.distance = h->lods[i].distance
+		};
+	}
+
+	/* precomputed, so the vertex pages are never touched on the cpu */
+	memcpy(mesh->aabb_min, h->aabb_min, sizeof mesh->aabb_min);
+	memcpy(mesh->aabb_max, h->aabb_max, sizeof mesh->aabb_max);
+	memcpy(mesh->sphere, h->sphere, sizeof mesh->sphere);
+}
+
+void a3d_mesh_file_close(a3d_mesh_file_view* view)
+{
+	if (view->header)
+		munmap((void*)view->header, view->size);
+	memset(view, 0, sizeof *view);
+}
+
+/* safe to call from any thread, nothing here touches the engine */
+bool a3d_mesh_file_open(const char* path, a3d_mesh_file_view* out_view)
+{
+	memset(out_view, 0, sizeof *out_view);
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		A3D_LOG_ERROR("failed to open file %s", path);
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(a3d_mesh_file_header)) {
+		A3D_LOG_ERROR("%s is too small to be a mesh file", path);
+		close(fd);
+		return false;
+	}
+
+	void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd); /* the mapping keeps the file alive */
+	if (data == MAP_FAILED) {
+		A3D_LOG_ERROR("failed to map %s", path);
+		return false;
+	}
+
+	const a3d_mesh_file_header* h = data;
+	if (!validate(h, (size_t)st.st_size, path)) {
+		munmap(data, (size_t)st.st_size);
+		return false;
+	}
+
+	/* read once front to back by the staging copies */
+	posix_madvise(data, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL);
+
+	out_view->header = h;
+	out_view->vertices = (const char*)data + h->vertex_offset;
+	out_view->indices = (const char*)data + h->index_offset;
+	out_view->size = (size_t)st.st_size;
+	return true;
+}
+
+/* the streams are copied from the mapping straight into the staging ring, nothing is parsed */
+bool a3d_load_mesh_file(a3d* e, a3d_mesh_pool* pool, const char* path, a3d_mesh* mesh)
+{
+	a3d_mesh_file_view file;
+	if (!a3d_mesh_file_open(path, &file))
+		return false;
+
+	const a3d_mesh_file_header* h = file.header;
+	VkDeviceSize vertices_size = (VkDeviceSize)h->vertex_count * h->vertex_size;
+	VkDeviceSize indices_size = (VkDeviceSize)h->index_count * sizeof(Uint16);
+
+	memset(mesh, 0, sizeof *mesh);
+	Uint32 first_vertex = 0;
+	Uint32 first_index = 0;
+	if (pool) {
+		if (pool->format != h->vertex_format) {
+			A3D_LOG_ERROR("%s is vertex format %u, the pool holds %u", path, h->vertex_format, pool->format);
+			a3d_mesh_file_close(&file);
+			return false;
+		}
+		if (!a3d_mesh_pool_reserve(pool, h->vertex_count, h->index_count, &first_vertex, &first_index)) {
+			a3d_mesh_file_close(&file);
+			return false;
+		}
+		mesh->pool = pool;
+		mesh->vertex_buffer = pool->vertex_buffer;
+		mesh->index_buffer = pool->index_buffer;
+	}
+	else {
+		bool r = a3d_vk_create_buffer(
+			e, vertices_size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &mesh->vertex_buffer, NULL
+		);
+		if (r) {
+			r = a3d_vk_create_buffer(
+				e, indices_size, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &mesh->index_buffer, NULL
+			);
+			if (!r)
+				a3d_vk_destroy_buffer(e, &mesh->vertex_buffer);
+		}
+		if (!r) {
+			A3D_LOG_ERROR("failed to create buffers for %s", path);
+			a3d_mesh_file_close(&file);
+			return false;
+		}
+	}
+
+	bool ok = a3d_vk_upload_buffer(
+		e, &mesh->vertex_buffer, (VkDeviceSize)first_vertex * h->vertex_size, file.vertices, vertices_size
+	) && a3d_vk_upload_buffer(
+		e, &mesh->index_buffer, first_index * sizeof(Uint16), file.indices, indices_size
+	);
+
+	if (!ok) {
+		/* a pool range stays reserved, it is only reclaimed with the pool */
+		A3D_LOG_ERROR("failed to upload %s", path);
+		a3d_mesh_file_close(&file);
+		if (!pool) {
+			a3d_vk_destroy_buffer(e, &mesh->vertex_buffer);
+			a3d_vk_destroy_buffer(e, &mesh->index_buffer);
+		}
+		memset(mesh, 0, sizeof *mesh);
+		return false;
+	}
+
+	a3d_mesh_file_apply(h, first_vertex, first_index, mesh);
+
+	A3D_LOG_DEBUG(
+		"loaded %s: %u vertices, %u indices, %u lods",
+		path, h->vertex_count, h->index_count, h->lod_count
+	);
+	a3d_mesh_file_close(&file);
+	return true;
+}
+
+/* private */
+/* one pass over the mapping; a corrupt index would have the gpu fetch past the vertex buffer */
+static bool indices_fit(const a3d_mesh_file_header* h, const Uint16* indices)
+{
+	Uint16 highest = 0;
+	for (Uint32 i = 0; i < h->index_count; i++)
+		if (indices[i] > highest)
+			highest = indices[i];
+	return highest < h->vertex_count;
+}
+
+static bool stream_fits(Uint64 offset, Uint64 count, Uint64 stride, Uint64 file_size)
+{
+	if (offset % A3D_MESH_FILE_ALIGN || offset < sizeof(a3d_mesh_file_header) || offset > file_size)
+		return false;
+	return count <= (file_size - offset) / stride;
+}
+
+/* the header, then the index values, which are already mapped so scanning them is cheap */
+static bool validate(const a3d_mesh_file_header* h, size_t file_size, const char* path)
+{
+	if (h->magic != A3D_MESH_FILE_MAGIC) {
+		A3D_LOG_ERROR("%s is not a mesh file", path);
+		return false;
+	}
+
+	if (h->version != A3D_MESH_FILE_VERSION) {
+		A3D_LOG_ERROR("%s is mesh file version %u, expected %u", path, h->version, A3D_MESH_FILE_VERSION);
+		return false;
+	}
+
+	if (h->vertex_format >= A3D_VERTEX_FORMAT_COUNT) {
+		A3D_LOG_ERROR("%s has unknown vertex format %u", path, h->vertex_format);
+		return false;
+	}
+
+	/* the streams are uploaded as is, so their layout must match the engine's exactly */
+	Uint32 stride = a3d_vertex_format_stride((a3d_vertex_format)h->vertex_format);
+	if (h->vertex_size != stride || h->index_size != sizeof(Uint16)) {
+		A3D_LOG_ERROR(
+			"%s has %u byte vertices and %u byte indices, expected %u and %zu",
+			path, h->vertex_size, h->index_size, stride, sizeof(Uint16)
+		);
+		return false;
+	}
+
+	/* empty streams would become zero sized buffers */
+	if (h->vertex_count == 0 || h->index_count == 0) {
+		A3D_LOG_ERROR("%s has %u vertices and %u indices", path, h->vertex_count, h->index_count);
+		return false;
+	}
+
+	if (!stream_fits(h->vertex_offset, h->vertex_count, stride, file_size) ||
+	    !stream_fits(h->index_offset, h->index_count, sizeof(Uint16), file_size)) {
+		A3D_LOG_ERROR("%s has streams outside the file", path);
+		return false;
+	}
+
+	if (h->lod_count == 0 || h->lod_count > A3D_MESH_FILE_MAX_LODS || h->lod_count > A3D_MESH_MAX_LODS) {
+		A3D_LOG_ERROR("%s has %u lods", path, h->lod_count);
+		return false;
+	}
+
+	for (Uint32 i = 0; i < h->lod_count; i++) {
+		const a3d_mesh_file_lod* lod = &h->lods[i];
+		if ((Uint64)lod->first_index + lod->index_count > h->index_count || lod->index_count % 3) {
+			A3D_LOG_ERROR("%s lod %u has a bad index range", path, i);
+			return false;
+		}
+	}
+
+	if (!indices_fit(h, (const Uint16*)((const char*)h + h->index_offset))) {
+		A3D_LOG_ERROR("%s has indices past its %u vertices", path, h->vertex_count);
+		return false;
+	}
+
+	return true;
+}
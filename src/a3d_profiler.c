@@ -0,0 +1,138 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <SDL3/SDL.h>
+
+#include "a3d_logging.h"
+#include "a3d_profiler.h"
+
+/* seq is ticket + 1 once the slot holds that ticket's event, 0 while it is being written */
+typedef struct {
+	SDL_AtomicInt seq;
+	a3d_profile_event event;
+} a3d_profile_slot;
+
+static void write_json_string(FILE* file, const char* s);
+
+static a3d_profile_slot ring[A3D_PROFILER_EVENTS];
+static SDL_AtomicInt head;
+static SDL_AtomicInt frame_counter;
+
+void a3d_profiler_begin_frame(void)
+{
+	SDL_AddAtomicInt(&frame_counter, 1);
+}
+
+/* copies up to max_count of the newest events, oldest first; slots caught mid-write are skipped */
+Uint32 a3d_profiler_collect(a3d_profile_event* out_events, Uint32 max_count)
+{
+	Uint32 end = (Uint32)SDL_GetAtomicInt(&head);
+	Uint32 available = end < A3D_PROFILER_EVENTS ? end : A3D_PROFILER_EVENTS;
+	if (max_count > available)
+		max_count = available;
+
+	Uint32 count = 0;
+	for (Uint32 ticket = end - max_count; ticket != end; ticket++) {
+		a3d_profile_slot* slot = &ring[ticket & (A3D_PROFILER_EVENTS - 1)];
+
+		int seq = SDL_GetAtomicInt(&slot->seq);
+		if (seq != (int)(ticket + 1))
+			continue;
+
+		a3d_profile_event event = slot->event;
+		SDL_MemoryBarrierAcquire();
+		if (SDL_GetAtomicInt(&slot->seq) != seq)
+			continue;
+
+		out_events[count++] = event;
+	}
+
+	return count;
+}
+
+Uint64 a3d_profiler_frame(void)
+{
+	return (Uint32)SDL_GetAtomicInt(&frame_counter);
+}
+
+void a3d_profiler_record(const char* name, Uint64 start_ns, Uint64 end_ns, bool gpu)
+{
+	a3d_profiler_record_frame(name, start_ns, end_ns, a3d_profiler_frame(), gpu);
+}
+
+/* any thread; one atomic add to claim a slot, no locks */
+void a3d_profiler_record_frame(const char* name, Uint64 start_ns, Uint64 end_ns, Uint64 frame, bool gpu)
+{
+	Uint32 ticket = (Uint32)SDL_AddAtomicInt(&head, 1);
+	a3d_profile_slot* slot = &ring[ticket & (A3D_PROFILER_EVENTS - 1)];
+
+	SDL_SetAtomicInt(&slot->seq, 0);
+	slot->event = (a3d_profile_event){
+		.name = name,
+		.start_ns = start_ns,
+		.end_ns = end_ns,
+		.thread = gpu ? 0 : (Uint64)SDL_GetCurrentThreadID(),
+		.frame = frame,
+		.gpu = gpu
+	};
+	SDL_MemoryBarrierRelease();
+	SDL_SetAtomicInt(&slot->seq, (int)(ticket + 1));
+}
+
+/* chrome://tracing / perfetto json, cpu threads under pid 1 and the gpu under pid 2 */
+bool a3d_profiler_write_trace(const char* path)
+{
+	a3d_profile_event* events = malloc(A3D_PROFILER_EVENTS * sizeof *events);
+	if (!events) {
+		A3D_LOG_ERROR("out of memory writing trace %s", path);
+		return false;
+	}
+	Uint32 count = a3d_profiler_collect(events, A3D_PROFILER_EVENTS);
+
+	FILE* file = fopen(path, "w");
+	if (!file) {
+		A3D_LOG_ERROR("failed to open file %s", path);
+		free(events);
+		return false;
+	}
+
+	fprintf(file, "{\"traceEvents\":[\n");
+	for (Uint32 i = 0; i < count; i++) {
+		const a3d_profile_event* ev = &events[i];
+		fprintf(file, "%s{\"name\":", i ? "," : "");
+		write_json_string(file, ev->name);
+		fprintf(
+			file, ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%" SDL_PRIu64 ",\"args\":{\"frame\":%" SDL_PRIu64 "}}\n",
+			ev->start_ns / 1000.0, (ev->end_ns - ev->start_ns) / 1000.0, ev->gpu ? 2 : 1, ev->thread, ev->frame
+		);
+	}
+	fprintf(file, "]}\n");
+
+	bool ok = fclose(file) == 0;
+	free(events);
+
+	if (!ok) {
+		A3D_LOG_ERROR("short write for file %s", path);
+		return false;
+	}
+
+	A3D_LOG_INFO("wrote %u profile events to %s", count, path);
+	return true;
+}
+
+/* private */
+
+/* quoted, with the characters json does not allow raw escaped */
+static void write_json_string(FILE* file, const char* s)
+{
+	fputc('"', file);
+	for (; *s; s++) {
+		unsigned char c = (unsigned char)*s;
+		if (c == '"' || c == '\\')
+			fprintf(file, "\\%c", c);
+		else if (c < 0x20)
+			fprintf(file, "\\u%04x", c);
+		else
+			fputc(c, file);
+	}
+	fputc('"', file);
+}
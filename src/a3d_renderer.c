@@ -1,8 +1,26 @@
+#define A3D_LOG_SUBSYSTEM RENDERER
+
 #include <stdlib.h>
+#include <string.h>
+#include <cglm/cglm.h>
 
+#include "a3d_cull.h"
+#include "a3d_job.h"
+#include "a3d_profiler.h"
 #include "a3d_renderer.h"
 #include "a3d_logging.h"
 
+/* items are only read and each range writes its own slice of bounds, so jobs need no locking */
+typedef struct {
+	const a3d_draw_item* items;
+	a3d_cull_bounds* bounds;
+} a3d_bounds_job;
+
+static Uint32 depth_bits(const a3d_camera* camera, mat4 model);
+static Uint64 make_key(Uint32 pipeline, Uint32 material, Uint32 mesh, Uint32 depth);
+static void radix_sort(a3d_sort_entry* entries, a3d_sort_entry* tmp, Uint32 count);
+static void transform_bounds(void* data, Uint32 first, Uint32 count);
+
 void a3d_renderer_begin_frame(a3d_renderer* r)
 {
 	if (!r) {
@@ -10,11 +28,25 @@ void a3d_renderer_begin_frame(a3d_renderer* r)
 		return;
 	}
 
+	/* the arena we reuse last served the frame that has now retired */
+	r->arena_index = (r->arena_index + 1) % A3D_VK_FRAMES_IN_FLIGHT;
+	a3d_arena* arena = &r->arenas[r->arena_index];
+	a3d_arena_reset(arena);
+
+	r->capacity = r->last_count > A3D_RENDERER_INITIAL_ITEMS ? r->last_count : A3D_RENDERER_INITIAL_ITEMS;
+	r->items = a3d_arena_alloc(arena, r->capacity * sizeof *r->items, A3D_ALIGNOF(a3d_draw_item));
+	if (!r->items)
+		r->capacity = 0;
+
 	r->count = 0;
+	r->sorted = NULL;
+	r->visible_count = 0;
+	r->batches = NULL;
+	r->batch_count = 0;
 	r->frame_active = true;
 }
 
-bool a3d_renderer_draw_mesh(a3d_renderer* r, const a3d_mesh* mesh, const a3d_mvp* mvp)
+bool a3d_renderer_draw_mesh(a3d_renderer* r, const a3d_mesh* mesh, mat4 model)
 {
 
 	if (!r) {
@@ -25,18 +57,30 @@ bool a3d_renderer_draw_mesh(a3d_renderer* r, const a3d_mesh* mesh, const a3d_mvp
 	if (!r->frame_active)
 		A3D_LOG_WARN("a3d_renderer_draw_mesh called outside begin/end_frame");
 
-	if (r->count >= A3D_RENDERER_MAX_DRAW_CALLS) {
-		A3D_LOG_WARN("renderer queue full; dropping draw call");
+	if (!mesh || !model) {
+		A3D_LOG_ERROR("renderer_draw_mesh: bad args");
 		return false;
 	}
 
-	if (!mesh || !mvp) {
-		A3D_LOG_ERROR("renderer_draw_mesh: bad args");
-		return false;
+	if (r->count == r->capacity) {
+		Uint32 capacity = r->capacity ? r->capacity * 2 : A3D_RENDERER_INITIAL_ITEMS;
+		a3d_draw_item* items = a3d_arena_grow(
+			&r->arenas[r->arena_index], r->items,
+			r->capacity * sizeof *items, capacity * sizeof *items, A3D_ALIGNOF(a3d_draw_item)
+		);
+		if (!items) {
+			A3D_LOG_ERROR("failed to grow draw queue to %u items", capacity);
+			return false;
+		}
+		r->items = items;
+		r->capacity = capacity;
 	}
 
-	r->items[r->count].mesh = mesh;
-	r->items[r->count].mvp = *mvp;
+	/* a pipeline per vertex format and no materials yet */
+	a3d_draw_item* item = &r->items[r->count];
+	item->mesh = mesh;
+	item->key = make_key(mesh->format, 0, mesh->id, depth_bits(&r->camera, model));
+	glm_mat4_copy(model, item->model);
 	r->count++;
 
 	return true;
@@ -50,6 +94,116 @@ void a3d_renderer_end_frame(a3d_renderer* r)
 	}
 
 	r->frame_active = false;
+	r->last_count = r->count;
+	if (r->count == 0)
+		return;
+
+	A3D_PROFILE_BEGIN(sort_start);
+	a3d_arena* arena = &r->arenas[r->arena_index];
+	Uint32 padded = A3D_CULL_PAD(r->count);
+	float* soa = a3d_arena_alloc(arena, 6 * padded * sizeof *soa, 32);
+	Uint32* visible = a3d_arena_alloc(arena, r->count * sizeof *visible, A3D_ALIGNOF(Uint32));
+	a3d_sort_entry* entries = a3d_arena_alloc(arena, r->count * sizeof *entries, A3D_ALIGNOF(a3d_sort_entry));
+	a3d_sort_entry* tmp = a3d_arena_alloc(arena, r->count * sizeof *tmp, A3D_ALIGNOF(a3d_sort_entry));
+	a3d_draw_item* sorted = a3d_arena_alloc(arena, r->count * sizeof *sorted, A3D_ALIGNOF(a3d_draw_item));
+	a3d_draw_batch* batches = a3d_arena_alloc(arena, r->count * sizeof *batches, A3D_ALIGNOF(a3d_draw_batch));
+	if (!soa || !visible || !entries || !tmp || !sorted || !batches) {
+		A3D_LOG_ERROR("out of frame memory sorting %u draw items", r->count);
+		A3D_PROFILE_END(sort_start, "renderer sort");
+		return;
+	}
+
+	/* the compute pass culls instead, hand it everything */
+	Uint32 visible_count = r->count;
+	if (r->gpu_culling) {
+		for (Uint32 i = 0; i < r->count; i++)
+			visible[i] = i;
+	}
+	else {
+		/* world space boxes in soa form for the simd cull */
+		a3d_cull_bounds bounds = {
+			.cx = soa,
+			.cy = soa + padded,
+			.cz = soa + 2 * padded,
+			.ex = soa + 3 * padded,
+			.ey = soa + 4 * padded,
+			.ez = soa + 5 * padded,
+			.count = r->count
+		};
+		a3d_bounds_job job = {.items = r->items, .bounds = &bounds};
+		if (r->count >= A3D_RENDERER_PARALLEL_ITEMS)
+			a3d_job_parallel_for(r->count, A3D_RENDERER_JOB_BATCH, transform_bounds, &job);
+		else
+			transform_bounds(&job, 0, r->count);
+
+		a3d_frustum frustum;
+		a3d_frustum_from_matrix(&frustum, r->camera.view_proj);
+		visible_count = a3d_cull_aabbs(&frustum, &bounds, visible);
+	}
+
+	/* only survivors get sorted */
+	for (Uint32 i = 0; i < visible_count; i++) {
+		entries[i].key = r->items[visible[i]].key;
+		entries[i].index = visible[i];
+	}
+	radix_sort(entries, tmp, visible_count);
+
+	for (Uint32 i = 0; i < visible_count; i++)
+		sorted[i] = r->items[entries[i].index];
+
+	/* mesh sits above depth in the key, so equal meshes are now adjacent */
+	Uint32 batch_count = 0;
+	for (Uint32 i = 0; i < visible_count; i++) {
+		a3d_draw_batch* batch = batch_count ? &batches[batch_count - 1] : NULL;
+		if (batch && batch->mesh == sorted[i].mesh) {
+			batch->count++;
+			continue;
+		}
+
+		batches[batch_count++] = (a3d_draw_batch){
+			.mesh = sorted[i].mesh,
+			.first = i,
+			.count = 1
+		};
+	}
+
+	r->sorted = sorted;
+	r->visible_count = visible_count;
+	r->batches = batches;
+	r->batch_count = batch_count;
+	A3D_PROFILE_END(sort_start, "renderer sort");
+}
+
+a3d_arena* a3d_renderer_frame_arena(a3d_renderer* r)
+{
+	return r ? &r->arenas[r->arena_index] : NULL;
+}
+
+size_t a3d_renderer_arena_high_water(a3d_renderer* r)
+{
+	size_t high_water = 0;
+	for (Uint32 i = 0; r && i < A3D_VK_FRAMES_IN_FLIGHT; i++)
+		if (r->arenas[i].high_water > high_water)
+			high_water = r->arenas[i].high_water;
+	return high_water;
+}
+
+void a3d_renderer_get_batches(a3d_renderer* r, const a3d_draw_batch** out_batches, Uint32* out_count)
+{
+	if (!r) {
+		*out_batches = NULL;
+		*out_count = 0;
+		return;
+	}
+
+	/* only valid after a3d_renderer_end_frame */
+	*out_batches = r->batches;
+	*out_count = r->batch_count;
+}
+
+const a3d_camera* a3d_renderer_get_camera(a3d_renderer* r)
+{
+	return r ? &r->camera : NULL;
 }
 
 void a3d_renderer_get_draw_items(a3d_renderer* r, const a3d_draw_item** out_items, Uint32* out_count)
@@ -60,8 +214,9 @@ void a3d_renderer_get_draw_items(a3d_renderer* r, const a3d_draw_item** out_item
 		return;
 	}
 
-	*out_items = r->items;
-	*out_count = r->count;
+	/* only valid after a3d_renderer_end_frame */
+	*out_items = r->sorted;
+	*out_count = r->sorted ? r->visible_count : 0;
 }
 
 bool a3d_renderer_init(a3d_renderer* r)
@@ -73,17 +228,134 @@ bool a3d_renderer_init(a3d_renderer* r)
 
 	A3D_LOG_INFO("initialising renderer");
 
-	r->count = 0;
-	r->frame_active = false;
+	memset(r, 0, sizeof *r);
+	for (Uint32 i = 0; i < A3D_VK_FRAMES_IN_FLIGHT; i++) {
+		if (!a3d_arena_init(&r->arenas[i], A3D_RENDERER_ARENA_SIZE)) {
+			A3D_LOG_ERROR("failed to create frame arena %u", i);
+			a3d_renderer_shutdown(r);
+			return false;
+		}
+	}
+
+	mat4 identity;
+	glm_mat4_identity(identity);
+	a3d_camera_set(&r->camera, identity, identity);
 
 	A3D_LOG_INFO("initialised renderer");
 	return true;
 }
 
+void a3d_renderer_set_camera(a3d_renderer* r, mat4 view, mat4 proj)
+{
+	if (!r) {
+		A3D_LOG_ERROR("a3d_renderer_set_camera called without renderer");
+		return;
+	}
+
+	a3d_camera_set(&r->camera, view, proj);
+}
+
+void a3d_renderer_set_gpu_culling(a3d_renderer* r, bool enabled)
+{
+	if (!r) {
+		A3D_LOG_ERROR("a3d_renderer_set_gpu_culling called without renderer");
+		return;
+	}
+
+	r->gpu_culling = enabled;
+}
+
 void a3d_renderer_shutdown(a3d_renderer* r)
 {
 	if (!r)
 		return;
 
 	A3D_LOG_INFO("shutting down renderer");
+	A3D_LOG_INFO("frame arena high-water mark: %zu bytes", a3d_renderer_arena_high_water(r));
+
+	for (Uint32 i = 0; i < A3D_VK_FRAMES_IN_FLIGHT; i++)
+		a3d_arena_destroy(&r->arenas[i]);
+}
+
+/* private */
+static Uint32 depth_bits(const a3d_camera* camera, mat4 model)
+{
+	/* view space distance of the object origin, camera looks down -z */
+	vec4 origin;
+	glm_mat4_mulv((vec4*)camera->view, model[3], origin);
+	float depth = -origin[2];
+	if (!(depth > 0.0f))
+		return 0;
+
+	/* positive floats order like their bit patterns, keep the top bits */
+	Uint32 bits;
+	memcpy(&bits, &depth, sizeof bits);
+	return bits >> (32 - A3D_SORT_KEY_DEPTH_BITS);
+}
+
+static Uint64 make_key(Uint32 pipeline, Uint32 material, Uint32 mesh, Uint32 depth)
+{
+	Uint64 key = pipeline & ((1u << A3D_SORT_KEY_PIPELINE_BITS) - 1);
+	key = (key << A3D_SORT_KEY_MATERIAL_BITS) | (material & ((1u << A3D_SORT_KEY_MATERIAL_BITS) - 1));
+	key = (key << A3D_SORT_KEY_MESH_BITS) | (mesh & ((1u << A3D_SORT_KEY_MESH_BITS) - 1));
+	key = (key << A3D_SORT_KEY_DEPTH_BITS) | (depth & ((1u << A3D_SORT_KEY_DEPTH_BITS) - 1));
+	return key;
+}
+
+/* lsd radix sort on 8 bit digits, stable, result ends up in entries */
+static void radix_sort(a3d_sort_entry* entries, a3d_sort_entry* tmp, Uint32 count)
+{
+	Uint32 histograms[8][256];
+	memset(histograms, 0, sizeof histograms);
+
+	for (Uint32 i = 0; i < count; i++)
+		for (Uint32 d = 0; d < 8; d++)
+			histograms[d][(entries[i].key >> (d * 8)) & 0xff]++;
+
+	a3d_sort_entry* src = entries;
+	a3d_sort_entry* dst = tmp;
+	for (Uint32 d = 0; d < 8; d++) {
+		Uint32* h = histograms[d];
+
+		/* unused key fields leave whole digits constant */
+		if (count == 0 || h[(src[0].key >> (d * 8)) & 0xff] == count)
+			continue;
+
+		Uint32 sum = 0;
+		for (Uint32 b = 0; b < 256; b++) {
+			Uint32 c = h[b];
+			h[b] = sum;
+			sum += c;
+		}
+
+		for (Uint32 i = 0; i < count; i++)
+			dst[h[(src[i].key >> (d * 8)) & 0xff]++] = src[i];
+
+		a3d_sort_entry* swap = src;
+		src = dst;
+		dst = swap;
+	}
+
+	if (src != entries)
+		memcpy(entries, src, count * sizeof *entries);
+}
+
+static void transform_bounds(void* data, Uint32 first, Uint32 count)
+{
+	a3d_bounds_job* job = data;
+	a3d_cull_bounds* bounds = job->bounds;
+
+	for (Uint32 i = first; i < first + count; i++) {
+		const a3d_mesh* mesh = job->items[i].mesh;
+		vec3 centre;
+		vec3 extent;
+		a3d_cull_transform_aabb((vec4*)job->items[i].model, (float*)mesh->aabb_min, (float*)mesh->aabb_max, centre, extent);
+
+		bounds->cx[i] = centre[0];
+		bounds->cy[i] = centre[1];
+		bounds->cz[i] = centre[2];
+		bounds->ex[i] = extent[0];
+		bounds->ey[i] = extent[1];
+		bounds->ez[i] = extent[2];
+	}
 }
@@ -0,0 +1,534 @@
+#include <stdlib.h>
+#include <string.h>
+#include <SDL3/SDL.h>
+#include <cglm/cglm.h>
+
+#include "a3d.h"
+#include "a3d_logging.h"
+#include "a3d_mesh.h"
+#include "a3d_mesh_file.h"
+#include "a3d_stream.h"
+#include "vulkan/a3d_vulkan_upload.h"
+
+static void free_slot(a3d_streamer* s, Uint32 slot);
+static void heap_push(a3d_streamer* s, Uint32 index);
+static void heap_remove(a3d_streamer* s, Uint32 heap_index);
+static void heap_sift(a3d_streamer* s, Uint32 heap_index);
+static int loader_main(void* data);
+static a3d_stream_request* lookup(a3d_streamer* s, a3d_stream_handle handle, Uint32* out_index);
+static bool record_copies(a3d* e, Uint32 slot_index, VkDeviceSize* budget);
+static void release(a3d_streamer* s, Uint32 index);
+static VkDeviceSize staged_size(const a3d_mesh_file_header* h, VkDeviceSize* out_indices_offset);
+static bool stage_file(a3d_streamer* s, const char* path, Uint32 slot, a3d_mesh_file_header* out_header);
+
+/* queued requests are dropped outright; anything a loader or the gpu holds is released once they let go */
+void a3d_stream_cancel(a3d* e, a3d_stream_handle handle)
+{
+	a3d_streamer* s = e->streamer;
+	if (!s)
+		return;
+
+	SDL_LockMutex(s->lock);
+
+	Uint32 index;
+	a3d_stream_request* req = lookup(s, handle, &index);
+	if (req && !req->cancelled) {
+		switch (req->state) {
+		case A3D_STREAM_QUEUED:
+			heap_remove(s, req->heap_index);
+			release(s, index);
+			break;
+		case A3D_STREAM_STAGED:
+			free_slot(s, req->slot);
+			release(s, index);
+			break;
+		case A3D_STREAM_LOADING:
+		case A3D_STREAM_UPLOADING:
+			req->cancelled = true;
+			break;
+		default:
+			/* the pool range of a resident mesh stays reserved, frames in flight may still draw it */
+			release(s, index);
+			break;
+		}
+	}
+
+	SDL_UnlockMutex(s->lock);
+}
+
+/* NULL until the copies have landed; valid until the handle is cancelled */
+const a3d_mesh* a3d_stream_get_mesh(a3d* e, a3d_stream_handle handle)
+{
+	a3d_streamer* s = e->streamer;
+	if (!s)
+		return NULL;
+
+	SDL_LockMutex(s->lock);
+	a3d_stream_request* req = lookup(s, handle, NULL);
+	const a3d_mesh* mesh = req && req->state == A3D_STREAM_RESIDENT ? &req->mesh : NULL;
+	SDL_UnlockMutex(s->lock);
+	return mesh;
+}
+
+a3d_stream_state a3d_stream_get_state(a3d* e, a3d_stream_handle handle)
+{
+	a3d_streamer* s = e->streamer;
+	if (!s)
+		return A3D_STREAM_INVALID;
+
+	SDL_LockMutex(s->lock);
+	a3d_stream_request* req = lookup(s, handle, NULL);
+	a3d_stream_state state = req ? req->state : A3D_STREAM_INVALID;
+	SDL_UnlockMutex(s->lock);
+	return state;
+}
+
+bool a3d_stream_init(a3d* e, a3d_mesh_pool* pool)
+{
+	if (e->streamer)
+		return true;
+
+	if (!pool) {
+		A3D_LOG_ERROR("streaming needs a mesh pool to place meshes in");
+		return false;
+	}
+
+	a3d_streamer* s = calloc(1, sizeof *s);
+	if (!s) {
+		A3D_LOG_ERROR("failed to allocate streamer");
+		return false;
+	}
+	e->streamer = s;
+	s->pool = pool;
+
+	for (Uint32 i = 0; i < A3D_STREAM_MAX_REQUESTS; i++) {
+		s->requests[i].generation = 1;
+		s->free_list[i] = A3D_STREAM_MAX_REQUESTS - 1 - i;
+	}
+	s->free_count = A3D_STREAM_MAX_REQUESTS;
+	s->free_slots = A3D_STREAM_SLOTS;
+
+	bool ok = a3d_vk_create_buffer(
+		e, A3D_STREAM_SLOTS * A3D_STREAM_SLOT_SIZE, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&s->staging, NULL
+	);
+	if (!ok) {
+		A3D_LOG_ERROR("failed to create streaming staging buffer");
+		a3d_stream_shutdown(e);
+		return false;
+	}
+
+	s->lock = SDL_CreateMutex();
+	s->work = SDL_CreateCondition();
+	if (!s->lock || !s->work) {
+		A3D_LOG_ERROR("failed to create streaming locks: %s", SDL_GetError());
+		a3d_stream_shutdown(e);
+		return false;
+	}
+
+	s->running = true;
+	for (Uint32 i = 0; i < A3D_STREAM_THREADS; i++) {
+		s->threads[i] = SDL_CreateThread(loader_main, "a3d_stream", s);
+		if (!s->threads[i]) {
+			A3D_LOG_ERROR("failed to create loader thread: %s", SDL_GetError());
+			a3d_stream_shutdown(e);
+			return false;
+		}
+	}
+
+	A3D_LOG_INFO(
+		"streaming with %d loaders and %d x %" SDL_PRIu64 " byte staging slots",
+		A3D_STREAM_THREADS, A3D_STREAM_SLOTS, (Uint64)A3D_STREAM_SLOT_SIZE
+	);
+	return true;
+}
+
+/* projected radius over the view distance, roughly the fraction of the screen height the mesh covers */
+float a3d_stream_priority(const a3d_camera* camera, mat4 model, const vec4 sphere)
+{
+	vec4 centre = {sphere[0], sphere[1], sphere[2], 1.0f};
+	vec4 world;
+	vec4 view;
+	glm_mat4_mulv(model, centre, world);
+	glm_mat4_mulv((vec4*)camera->view, world, view);
+
+	float scale = glm_vec3_norm(model[0]);
+	scale = glm_max(scale, glm_vec3_norm(model[1]));
+	scale = glm_max(scale, glm_vec3_norm(model[2]));
+	float radius = sphere[3] * scale;
+
+	/* inside the sphere it covers the whole screen */
+	float distance = glm_max(glm_vec3_norm(view), radius);
+	if (distance <= 0.0f)
+		return 0.0f;
+
+	return radius * camera->proj[1][1] / distance;
+}
+
+/* the mesh file is read on a loader thread, the handle becomes resident a few frames later */
+a3d_stream_handle a3d_stream_request_mesh(a3d* e, const char* path, float priority)
+{
+	a3d_streamer* s = e->streamer;
+	if (!s) {
+		A3D_LOG_ERROR("streaming is not initialised");
+		return 0;
+	}
+
+	size_t len = strlen(path) + 1;
+	char* copy = malloc(len);
+	if (!copy) {
+		A3D_LOG_ERROR("failed to allocate stream request for %s", path);
+		return 0;
+	}
+	memcpy(copy, path, len);
+
+	SDL_LockMutex(s->lock);
+
+	if (!s->free_count) {
+		SDL_UnlockMutex(s->lock);
+		A3D_LOG_ERROR("too many stream requests, %d live", A3D_STREAM_MAX_REQUESTS);
+		free(copy);
+		return 0;
+	}
+
+	Uint32 index = s->free_list[--s->free_count];
+	a3d_stream_request* req = &s->requests[index];
+	req->state = A3D_STREAM_QUEUED;
+	req->cancelled = false;
+	req->priority = priority;
+	req->path = copy;
+	heap_push(s, index);
+	a3d_stream_handle handle = ((Uint32)req->generation << 16) | index;
+
+	SDL_SignalCondition(s->work);
+	SDL_UnlockMutex(s->lock);
+	return handle;
+}
+
+/* only reorders queued requests, anything already loading keeps going */
+void a3d_stream_set_priority(a3d* e, a3d_stream_handle handle, float priority)
+{
+	a3d_streamer* s = e->streamer;
+	if (!s)
+		return;
+
+	SDL_LockMutex(s->lock);
+	a3d_stream_request* req = lookup(s, handle, NULL);
+	if (req) {
+		req->priority = priority;
+		if (req->state == A3D_STREAM_QUEUED)
+			heap_sift(s, req->heap_index);
+	}
+	SDL_UnlockMutex(s->lock);
+}
+
+/* outstanding requests are dropped; meshes already resident stay in the pool */
+void a3d_stream_shutdown(a3d* e)
+{
+	a3d_streamer* s = e->streamer;
+	if (!s)
+		return;
+
+	if (s->lock) {
+		SDL_LockMutex(s->lock);
+		s->running = false;
+		SDL_BroadcastCondition(s->work);
+		SDL_UnlockMutex(s->lock);
+	}
+
+	for (Uint32 i = 0; i < A3D_STREAM_THREADS; i++)
+		if (s->threads[i])
+			SDL_WaitThread(s->threads[i], NULL);
+
+	/* recorded copies may still read the staging slots */
+	if (e->vk.uploader)
+		a3d_vk_upload_wait_idle(e);
+	a3d_vk_destroy_buffer(e, &s->staging);
+
+	for (Uint32 i = 0; i < A3D_STREAM_MAX_REQUESTS; i++)
+		free(s->requests[i].path);
+
+	if (s->work)
+		SDL_DestroyCondition(s->work);
+	if (s->lock)
+		SDL_DestroyMutex(s->lock);
+
+	free(s);
+	e->streamer = NULL;
+	A3D_LOG_INFO("destroyed streamer");
+}
+
+/* render thread, once per frame before the draw: record staged copies within the budget and
+ * flip finished uploads to resident. the copies go out with the frame's upload flush */
+void a3d_stream_update(a3d* e)
+{
+	a3d_streamer* s = e->streamer;
+	if (!s)
+		return;
+
+	Uint64 done = a3d_vk_upload_completed(e);
+	VkDeviceSize budget = A3D_STREAM_FRAME_BUDGET;
+
+	SDL_LockMutex(s->lock);
+
+	for (Uint32 i = 0; i < A3D_STREAM_SLOTS; i++) {
+		a3d_stream_slot* slot = &s->slots[i];
+		if (!slot->used)
+			continue;
+
+		Uint32 index = slot->request;
+		a3d_stream_request* req = &s->requests[index];
+
+		if (req->state == A3D_STREAM_UPLOADING && slot->value <= done) {
+			free_slot(s, i);
+			if (req->cancelled) {
+				release(s, index);
+				continue;
+			}
+
+			req->state = A3D_STREAM_RESIDENT;
+			A3D_LOG_DEBUG("streamed %s", req->path);
+		}
+		else if (req->state == A3D_STREAM_STAGED) {
+			record_copies(e, i, &budget);
+		}
+	}
+
+	SDL_UnlockMutex(s->lock);
+}
+
+/* private */
+static void free_slot(a3d_streamer* s, Uint32 slot)
+{
+	s->slots[slot].used = false;
+	s->free_slots++;
+	SDL_SignalCondition(s->work);
+}
+
+static void heap_push(a3d_streamer* s, Uint32 index)
+{
+	Uint32 at = s->heap_count++;
+	s->heap[at] = index;
+	s->requests[index].heap_index = at;
+	heap_sift(s, at);
+}
+
+static void heap_remove(a3d_streamer* s, Uint32 heap_index)
+{
+	Uint32 last = --s->heap_count;
+	if (heap_index == last)
+		return;
+
+	s->heap[heap_index] = s->heap[last];
+	s->requests[s->heap[heap_index]].heap_index = heap_index;
+	heap_sift(s, heap_index);
+}
+
+/* moves an entry up or down after its priority changed */
+static void heap_sift(a3d_streamer* s, Uint32 heap_index)
+{
+	Uint32 i = heap_index;
+	Uint32 index = s->heap[i];
+	float priority = s->requests[index].priority;
+
+	while (i > 0) {
+		Uint32 parent = (i - 1) / 2;
+		if (s->requests[s->heap[parent]].priority >= priority)
+			break;
+		s->heap[i] = s->heap[parent];
+		s->requests[s->heap[i]].heap_index = i;
+		i = parent;
+	}
+
+	for (;;) {
+		Uint32 child = i * 2 + 1;
+		if (child >= s->heap_count)
+			break;
+		if (child + 1 < s->heap_count &&
+		    s->requests[s->heap[child + 1]].priority > s->requests[s->heap[child]].priority)
+			child++;
+		if (s->requests[s->heap[child]].priority <= priority)
+			break;
+		s->heap[i] = s->heap[child];
+		s->requests[s->heap[i]].heap_index = i;
+		i = child;
+	}
+
+	s->heap[i] = index;
+	s->requests[index].heap_index = i;
+}
+
+static int loader_main(void* data)
+{
+	a3d_streamer* s = data;
+
+	SDL_LockMutex(s->lock);
+	for (;;) {
+		while (s->running && (!s->heap_count || !s->free_slots))
+			SDL_WaitCondition(s->work, s->lock);
+		if (!s->running)
+			break;
+
+		Uint32 index = s->heap[0];
+		heap_remove(s, 0);
+
+		Uint32 slot = 0;
+		while (s->slots[slot].used)
+			slot++;
+		s->slots[slot] = (a3d_stream_slot){.request = index, .used = true};
+		s->free_slots--;
+
+		a3d_stream_request* req = &s->requests[index];
+		req->state = A3D_STREAM_LOADING;
+		req->slot = slot;
+
+		/* the path is only freed on release, which waits for this load while it is in flight */
+		const char* path = req->path;
+		SDL_UnlockMutex(s->lock);
+
+		a3d_mesh_file_header header;
+		bool ok = stage_file(s, path, slot, &header);
+
+		SDL_LockMutex(s->lock);
+		if (req->cancelled) {
+			free_slot(s, slot);
+			release(s, index);
+		}
+		else if (ok) {
+			req->header = header;
+			req->state = A3D_STREAM_STAGED;
+		}
+		else {
+			free_slot(s, slot);
+			req->state = A3D_STREAM_FAILED;
+		}
+	}
+	SDL_UnlockMutex(s->lock);
+
+	return 0;
+}
+
+static a3d_stream_request* lookup(a3d_streamer* s, a3d_stream_handle handle, Uint32* out_index)
+{
+	Uint32 index = handle & 0xffff;
+	if (index >= A3D_STREAM_MAX_REQUESTS)
+		return NULL;
+
+	a3d_stream_request* req = &s->requests[index];
+	if (req->state == A3D_STREAM_INVALID || req->generation != handle >> 16)
+		return NULL;
+
+	if (out_index)
+		*out_index = index;
+	return req;
+}
+
+/* called with the lock held */
+static bool record_copies(a3d* e, Uint32 slot_index, VkDeviceSize* budget)
+{
+	a3d_streamer* s = e->streamer;
+	a3d_stream_slot* slot = &s->slots[slot_index];
+	a3d_stream_request* req = &s->requests[slot->request];
+	const a3d_mesh_file_header* h = &req->header;
+
+	VkDeviceSize indices_offset;
+	VkDeviceSize size = staged_size(h, &indices_offset);
+
+	/* the first copy of the frame always goes, so one big mesh can't starve */
+	if (size > *budget && *budget != A3D_STREAM_FRAME_BUDGET)
+		return false;
+	*budget = size > *budget ? 0 : *budget - size;
+
+	Uint32 first_vertex;
+	Uint32 first_index;
+	if (!a3d_mesh_pool_reserve(s->pool, h->vertex_count, h->index_count, &first_vertex, &first_index)) {
+		A3D_LOG_ERROR("no room in the mesh pool for %s", req->path);
+		free_slot(s, slot_index);
+		req->state = A3D_STREAM_FAILED;
+		return false;
+	}
+
+	VkDeviceSize base = slot_index * A3D_STREAM_SLOT_SIZE;
+	Uint64 value = 0;
+	bool ok = a3d_vk_upload_copy(
+		e, &s->staging, base, &s->pool->vertex_buffer, (VkDeviceSize)first_vertex * h->vertex_size,
+		(VkDeviceSize)h->vertex_count * h->vertex_size, &value
+	) && a3d_vk_upload_copy(
+		e, &s->staging, base + indices_offset, &s->pool->index_buffer, first_index * sizeof(Uint16),
+		(VkDeviceSize)h->index_count * sizeof(Uint16), &value
+	);
+	if (!ok) {
+		/* the pool range stays reserved, it is only reclaimed with the pool */
+		A3D_LOG_ERROR("failed to record copies for %s", req->path);
+		free_slot(s, slot_index);
+		req->state = A3D_STREAM_FAILED;
+		return false;
+	}
+
+	memset(&req->mesh, 0, sizeof req->mesh);
+	req->mesh.pool = s->pool;
+	req->mesh.vertex_buffer = s->pool->vertex_buffer;
+	req->mesh.index_buffer = s->pool->index_buffer;
+	a3d_mesh_file_apply(h, first_vertex, first_index, &req->mesh);
+
+	slot->value = value;
+	req->state = A3D_STREAM_UPLOADING;
+	return true;
+}
+
+/* back onto the free list; stale handles fail lookup from here on */
+static void release(a3d_streamer* s, Uint32 index)
+{
+	a3d_stream_request* req = &s->requests[index];
+	free(req->path);
+	a3d_mesh_release_id(req->mesh.id);
+
+	Uint16 generation = req->generation;
+	memset(req, 0, sizeof *req);
+	req->generation = (Uint16)(generation + 1) ? (Uint16)(generation + 1) : 1;
+
+	s->free_list[s->free_count++] = index;
+}
+
+/* vertices at the start of a slot, indices after them on the next 16 byte boundary */
+static VkDeviceSize staged_size(const a3d_mesh_file_header* h, VkDeviceSize* out_indices_offset)
+{
+	VkDeviceSize vertices_size = (VkDeviceSize)h->vertex_count * h->vertex_size;
+	*out_indices_offset = (vertices_size + 15) & ~(VkDeviceSize)15;
+	return *out_indices_offset + (VkDeviceSize)h->index_count * sizeof(Uint16);
+}
+
+/* loader thread, without the lock; the slot is this thread's until it hands it back */
+static bool stage_file(a3d_streamer* s, const char* path, Uint32 slot, a3d_mesh_file_header* out_header)
+{
+	a3d_mesh_file_view file;
+	if (!a3d_mesh_file_open(path, &file))
+		return false;
+
+	const a3d_mesh_file_header* h = file.header;
+	if (h->vertex_format != s->pool->format) {
+		A3D_LOG_ERROR("%s is vertex format %u, the stream pool holds %u", path, h->vertex_format, s->pool->format);
+		a3d_mesh_file_close(&file);
+		return false;
+	}
+
+	VkDeviceSize indices_offset;
+	VkDeviceSize size = staged_size(h, &indices_offset);
+	if (size > A3D_STREAM_SLOT_SIZE) {
+		A3D_LOG_ERROR(
+			"%s needs %" SDL_PRIu64 " bytes of staging, slots hold %" SDL_PRIu64,
+			path, (Uint64)size, (Uint64)A3D_STREAM_SLOT_SIZE
+		);
+		a3d_mesh_file_close(&file);
+		return false;
+	}
+
+	char* dst = (char*)s->staging.alloc->mapped + slot * A3D_STREAM_SLOT_SIZE;
+	memcpy(dst, file.vertices, (size_t)h->vertex_count * h->vertex_size);
+	memcpy(dst + indices_offset, file.indices, (size_t)h->index_count * sizeof(Uint16));
+
+	*out_header = *h;
+	a3d_mesh_file_close(&file);
+	return true;
+}
@@ -2,10 +2,9 @@
 
 #include "a3d_transform.h"
 
-void a3d_mvp_compose(mat4 out, const a3d_mvp* in)
+void a3d_camera_set(a3d_camera* camera, mat4 view, mat4 proj)
 {
-	mat4 pv;
-	/* cglm api doesnt use const for input mats. cast away const here */
-	glm_mat4_mul((vec4*)in->proj, (vec4*)in->view, pv);
-	glm_mat4_mul(pv, (vec4*)in->model, out);
-}
\ No newline at end of file
+	glm_mat4_copy(view, camera->view);
+	glm_mat4_copy(proj, camera->proj);
+	glm_mat4_mul(proj, view, camera->view_proj);
+}
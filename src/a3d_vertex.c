@@ -0,0 +1,107 @@
+#include <math.h>
+#include <string.h>
+
+#include "a3d_vertex.h"
+
+static Uint16 float_to_half(float f);
+static Sint16 snorm16(float v);
+static Uint8 unorm8(float v);
+
+/* positions are quantised against the box the mesh is stored with, normal, colour and uv may be NULL */
+void a3d_pack_vertex(
+	const float position[3], const float normal[3], const float colour[4], const float uv[2],
+	const float aabb_min[3], const float aabb_max[3], a3d_vertex_packed* out
+)
+{
+	memset(out, 0, sizeof *out);
+
+	for (Uint32 k = 0; k < 3; k++) {
+		float centre = 0.5f * (aabb_min[k] + aabb_max[k]);
+		float half_extent = 0.5f * (aabb_max[k] - aabb_min[k]);
+		out->position[k] = half_extent > 0.0f ? snorm16((position[k] - centre) / half_extent) : 0;
+	}
+
+	/* project onto the octahedron, then fold the lower half over the diagonals */
+	float n[3] = {0.0f, 0.0f, 1.0f};
+	if (normal)
+		memcpy(n, normal, sizeof n);
+	float l1 = fabsf(n[0]) + fabsf(n[1]) + fabsf(n[2]);
+	float x = l1 > 0.0f ? n[0] / l1 : 0.0f;
+	float y = l1 > 0.0f ? n[1] / l1 : 0.0f;
+	if (n[2] < 0.0f) {
+		float fx = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		float fy = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = fx;
+		y = fy;
+	}
+	out->normal[0] = snorm16(x);
+	out->normal[1] = snorm16(y);
+
+	for (Uint32 k = 0; k < 4; k++)
+		out->colour[k] = colour ? unorm8(colour[k]) : 255;
+
+	if (uv) {
+		out->uv[0] = float_to_half(uv[0]);
+		out->uv[1] = float_to_half(uv[1]);
+	}
+}
+
+Uint32 a3d_vertex_format_stride(a3d_vertex_format format)
+{
+	switch (format) {
+	case A3D_VERTEX_FORMAT_FLOAT:
+		return sizeof(a3d_vertex);
+	case A3D_VERTEX_FORMAT_PACKED:
+		return sizeof(a3d_vertex_packed);
+	default:
+		return 0;
+	}
+}
+
+/* private */
+/* round to nearest, overflow goes to infinity and tiny values through the denormals to zero */
+static Uint16 float_to_half(float f)
+{
+	Uint32 bits;
+	memcpy(&bits, &f, sizeof bits);
+
+	Uint32 sign = (bits >> 16) & 0x8000;
+	Uint32 exponent = (bits >> 23) & 0xff;
+	Uint32 mantissa = bits & 0x7fffff;
+
+	if (exponent == 0xff)
+		return (Uint16)(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+
+	Sint32 e = (Sint32)exponent - 127 + 15;
+	if (e >= 31)
+		return (Uint16)(sign | 0x7c00);
+
+	if (e <= 0) {
+		if (e < -10)
+			return (Uint16)sign;
+		mantissa |= 0x800000;
+		Uint32 shift = (Uint32)(14 - e);
+		Uint32 half = mantissa >> shift;
+		if ((mantissa >> (shift - 1)) & 1)
+			half++;
+		return (Uint16)(sign | half);
+	}
+
+	/* a carry out of the mantissa correctly bumps the exponent */
+	Uint32 half = sign | ((Uint32)e << 10) | (mantissa >> 13);
+	if (mantissa & 0x1000)
+		half++;
+	return (Uint16)half;
+}
+
+static Sint16 snorm16(float v)
+{
+	v = v < -1.0f ? -1.0f : v > 1.0f ? 1.0f : v;
+	return (Sint16)lrintf(v * 32767.0f);
+}
+
+static Uint8 unorm8(float v)
+{
+	v = v < 0.0f ? 0.0f : v > 1.0f ? 1.0f : v;
+	return (Uint8)lrintf(v * 255.0f);
+}
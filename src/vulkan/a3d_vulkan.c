@@ -1,3 +1,5 @@
+#define A3D_LOG_SUBSYSTEM VULKAN
+
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -8,10 +10,21 @@
 #include "a3d.h"
 #include "a3d_logging.h"
 #include "a3d_mesh.h"
+#include "a3d_profiler.h"
 #include "a3d_renderer.h"
-#include "a3d_transform.h"
 #include "vulkan/a3d_vulkan.h"
+#include "vulkan/a3d_vulkan_bindless.h"
+#include "vulkan/a3d_vulkan_descriptor.h"
+#include "vulkan/a3d_vulkan_gpu_cull.h"
+#include "vulkan/a3d_vulkan_graph.h"
+#include "vulkan/a3d_vulkan_headless.h"
+#include "vulkan/a3d_vulkan_memory.h"
+#include "vulkan/a3d_vulkan_profiler.h"
+#include "vulkan/a3d_vulkan_record.h"
+#include "vulkan/a3d_vulkan_sync.h"
+#include "vulkan/a3d_vulkan_upload.h"
 #include "vulkan/a3d_vulkan_pipeline.h"
+#include "vulkan/a3d_vulkan_pipeline_cache.h"
 
 #if A3D_VK_VALIDATION
 #include "vulkan/a3d_vulkan_debug.h"
@@ -20,11 +33,25 @@ static const char* const validation_layers[] = {
 };
 #endif
 
+/* what the frame graph's passes need from a3d_vk_record_command_buffer */
+typedef struct {
+	const a3d_draw_batch* batches;
+	Uint32   batch_count;
+	VkCommandBuffer secondaries[A3D_VK_MAX_RECORD_THREADS];
+	Uint32   secondary_count;
+} a3d_vk_frame_record;
+
 static VkFormat choose_depth_fmt(a3d* e);
 static VkExtent2D choose_extent(const VkSurfaceCapabilitiesKHR* caps, SDL_Window* window);
 static VkSurfaceFormatKHR choose_surface_format( const VkSurfaceFormatKHR* fmts, Uint32 fmts_count);
 static VkPresentModeKHR choose_present_mode(const VkPresentModeKHR* modes, Uint32 modes_count);
-static Uint32 find_memory_type(a3d* e, Uint32 type_filter, VkMemoryPropertyFlags properties);
+static void collect_retired_swapchains(a3d* e);
+static void cull_pass(a3d* e, VkCommandBuffer cmd, Uint32 frame, Uint32 image, void* data);
+static void destroy_retired_swapchains(a3d* e, Uint32 count);
+static void drop_acquire(a3d* e, a3d_vk_frame* frame);
+static void main_pass(a3d* e, VkCommandBuffer cmd, Uint32 frame, Uint32 image, void* data);
+static void readback_pass(a3d* e, VkCommandBuffer cmd, Uint32 frame, Uint32 image, void* data);
+static void retire_swapchain(a3d* e);
 
 /* public */
 bool a3d_vk_allocate_command_buffers(a3d* e)
@@ -35,16 +62,20 @@ bool a3d_vk_allocate_command_buffers(a3d* e)
 		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
 		.commandPool = e->vk.cmd_pool,
 		.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-		.commandBufferCount = e->vk.swapchain_images_count
+		.commandBufferCount = A3D_VK_FRAMES_IN_FLIGHT
 	};
 
-	VkResult r = vkAllocateCommandBuffers(e->vk.logical, &buff_alloc_info, e->vk.cmd_buffs);
+	VkCommandBuffer cmd_buffs[A3D_VK_FRAMES_IN_FLIGHT];
+	VkResult r = vkAllocateCommandBuffers(e->vk.logical, &buff_alloc_info, cmd_buffs);
 	if (r != VK_SUCCESS) {
 		A3D_LOG_ERROR("failed to allocate command buffers with code %d", r);
 		return false;
 	}
 
-	A3D_LOG_INFO("allocated %u command buffers", e->vk.swapchain_images_count);
+	for (Uint32 i = 0; i < A3D_VK_FRAMES_IN_FLIGHT; i++)
+		e->vk.frames[i].cmd = cmd_buffs[i];
+
+	A3D_LOG_INFO("allocated %u command buffers", A3D_VK_FRAMES_IN_FLIGHT);
 	return true;
 }
 
@@ -68,152 +99,77 @@ bool a3d_vk_create_command_pool(a3d* e)
 	return true;
 }
 
-bool a3d_vk_create_depth_resources(a3d* e)
+/*
+ * the cull pass and the readback only exist when gpu culling or headless mode want them, so
+ * toggling gpu culling rebuilds the graph. the depth buffer is a transient the graph owns
+ */
+bool a3d_vk_create_frame_graph(a3d* e)
 {
-	e->vk.depth_fmt = choose_depth_fmt(e);
-	if (e->vk.depth_fmt == VK_FORMAT_UNDEFINED)
-		return false;
+	A3D_LOG_INFO("creating frame graph");
 
-	VkImageCreateInfo image_info = {
-		.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
-		.imageType = VK_IMAGE_TYPE_2D,
-		.format = e->vk.depth_fmt,
-		.extent = {
-			e->vk.swapchain_extent.width,
-			e->vk.swapchain_extent.height,
-			1
-		},
-		.mipLevels = 1,
-		.arrayLayers = 1,
-		.samples = VK_SAMPLE_COUNT_1_BIT,
-		.tiling = VK_IMAGE_TILING_OPTIMAL,
-		.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
-		.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
-		.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
-	};
-
-	VkResult r = vkCreateImage(e->vk.logical, &image_info, NULL, &e->vk.depth_image);
-	if (r != VK_SUCCESS) {
-		A3D_LOG_ERROR("failed to create depth_image with code %d", r);
-		return false;
-	}
-
-	VkMemoryRequirements mem_req;
-	vkGetImageMemoryRequirements(e->vk.logical, e->vk.depth_image, &mem_req);
-
-	Uint32 mem_index = find_memory_type(e, mem_req.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-	if (mem_index == UINT32_MAX) {
-		A3D_LOG_ERROR("no suitable memory type found for depth image");
-		/* cleanup created image */
-		if (e->vk.depth_image) {
-			vkDestroyImage(e->vk.logical, e->vk.depth_image, NULL);
-			e->vk.depth_image = VK_NULL_HANDLE;
+	if (!e->vk.graph) {
+		e->vk.graph = calloc(1, sizeof *e->vk.graph);
+		if (!e->vk.graph) {
+			A3D_LOG_ERROR("failed to allocate frame graph");
+			return false;
 		}
-		return false;
 	}
-
-	VkMemoryAllocateInfo alloc_info = {
-		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-		.allocationSize = mem_req.size,
-		.memoryTypeIndex = mem_index
-	};
-
-	r = vkAllocateMemory(e->vk.logical, &alloc_info, NULL, &e->vk.depth_mem);
-	if (r != VK_SUCCESS) {
-		A3D_LOG_ERROR("failed to allocate image memory with code %d", r);
-		if (e->vk.depth_image) {
-			vkDestroyImage(e->vk.logical, e->vk.depth_image, NULL);
-			e->vk.depth_image = VK_NULL_HANDLE;
-		}
-		return false;
+	else {
+		a3d_vk_graph_destroy(e, e->vk.graph);
 	}
+	a3d_vk_graph* g = e->vk.graph;
 
-	r = vkBindImageMemory(e->vk.logical, e->vk.depth_image, e->vk.depth_mem, 0);
-	if (r != VK_SUCCESS) {
-		A3D_LOG_ERROR("failed to bind image memory with code %d", r);
-		if (e->vk.depth_mem) {
-			vkFreeMemory(e->vk.logical, e->vk.depth_mem, NULL);
-			e->vk.depth_mem = VK_NULL_HANDLE;
-		}
-		if (e->vk.depth_image) {
-			vkDestroyImage(e->vk.logical, e->vk.depth_image, NULL);
-			e->vk.depth_image = VK_NULL_HANDLE;
-		}
+	if (e->vk.depth_fmt == VK_FORMAT_UNDEFINED)
+		e->vk.depth_fmt = choose_depth_fmt(e);
+	if (e->vk.depth_fmt == VK_FORMAT_UNDEFINED)
 		return false;
-	}
-
-	VkImageAspectFlags aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
-	if (e->vk.depth_fmt == VK_FORMAT_D24_UNORM_S8_UINT || e->vk.depth_fmt == VK_FORMAT_D32_SFLOAT_S8_UINT)
-		aspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
 
-	VkImageViewCreateInfo view_info = {
-		.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
-		.image = e->vk.depth_image,
-		.viewType = VK_IMAGE_VIEW_TYPE_2D,
-		.format = e->vk.depth_fmt,
-		.subresourceRange = {
-			.aspectMask = aspect,
-			.levelCount = 1,
-			.layerCount = 1
-		}
-	};
+	bool gpu_driven = e->vk.gpu_cull && e->renderer && e->renderer->gpu_culling;
+	e->vk.graph_gpu_cull = gpu_driven;
 
-	r = vkCreateImageView(e->vk.logical, &view_info, NULL, &e->vk.depth_view);
-	if (r != VK_SUCCESS) {
-		A3D_LOG_ERROR("failed to create image view with code %d", r);
-		/* cleanup image, memory */
-		if (e->vk.depth_mem) {
-			vkFreeMemory(e->vk.logical, e->vk.depth_mem, NULL);
-			e->vk.depth_mem = VK_NULL_HANDLE;
-		}
-		if (e->vk.depth_image) {
-			vkDestroyImage(e->vk.logical, e->vk.depth_image, NULL);
-			e->vk.depth_image = VK_NULL_HANDLE;
-		}
+	/* presentation waits for the acquire semaphore at colour output; headless targets are fenced */
+	e->vk.backbuffer = a3d_vk_graph_import_image(
+		g, "backbuffer", e->vk.swapchain_fmt, e->vk.swapchain_extent,
+		e->vk.swapchain_images, e->vk.swapchain_views, e->vk.swapchain_images_count,
+		e->headless ? 0 : VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+		e->headless ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
+	);
+	a3d_vk_graph_set_output(g, e->vk.backbuffer);
+	Uint32 depth = a3d_vk_graph_create_image(g, "depth", e->vk.depth_fmt, 0, 0);
+
+	/* the cull buffers are per frame slot, so the fence covers whatever touched them last */
+	Uint32 draws = UINT32_MAX;
+	Uint32 instances = UINT32_MAX;
+	if (gpu_driven) {
+		draws = a3d_vk_graph_import_buffer(g, "culled draws", 0);
+		instances = a3d_vk_graph_import_buffer(g, "culled instances", 0);
+		Uint32 cull = a3d_vk_graph_add_pass(g, "gpu cull", A3D_VK_GRAPH_COMPUTE, cull_pass);
+		a3d_vk_graph_use(g, cull, draws, A3D_VK_GRAPH_STORAGE_WRITE);
+		a3d_vk_graph_use(g, cull, instances, A3D_VK_GRAPH_STORAGE_WRITE);
+	}
+
+	e->vk.main_pass = a3d_vk_graph_add_pass(g, "gpu render pass", A3D_VK_GRAPH_RASTER, main_pass);
+	a3d_vk_graph_use(g, e->vk.main_pass, e->vk.backbuffer, A3D_VK_GRAPH_COLOUR);
+	a3d_vk_graph_clear(g, e->vk.main_pass, e->vk.backbuffer, e->vk.clear_col);
+	a3d_vk_graph_use(g, e->vk.main_pass, depth, A3D_VK_GRAPH_DEPTH);
+	a3d_vk_graph_clear(g, e->vk.main_pass, depth, (VkClearValue){.depthStencil = {1.0f, 0}});
+	if (gpu_driven) {
+		a3d_vk_graph_use(g, e->vk.main_pass, draws, A3D_VK_GRAPH_INDIRECT);
+		a3d_vk_graph_use(g, e->vk.main_pass, instances, A3D_VK_GRAPH_STORAGE_READ);
+	}
+
+	if (e->headless) {
+		Uint32 readback = a3d_vk_graph_add_pass(g, "gpu readback", A3D_VK_GRAPH_TRANSFER, readback_pass);
+		a3d_vk_graph_use(g, readback, e->vk.backbuffer, A3D_VK_GRAPH_TRANSFER_SRC);
+		a3d_vk_graph_set_side_effect(g, readback);
+	}
+
+	if (!a3d_vk_graph_compile(e, g)) {
+		A3D_LOG_ERROR("failed to compile frame graph");
 		return false;
 	}
 
-	A3D_LOG_INFO("depth buffer created");
-	return true;
-}
-
-bool a3d_vk_create_framebuffers(a3d* e)
-{
-	A3D_LOG_INFO("creating framebuffers");
-
-	A3D_LOG_INFO("depth_view=%p depth_fmt=%d", (void*)e->vk.depth_view, e->vk.depth_fmt);
-
-	for (Uint32 i = 0; i < e->vk.swapchain_images_count; i++) {
-		VkImageView attachments[] = {
-			e->vk.swapchain_views[i],
-			e->vk.depth_view
-		};
-
-		VkFramebufferCreateInfo fb_info = {
-			.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
-			.renderPass = e->vk.render_pass,
-			.attachmentCount = 2,
-			.pAttachments = attachments,
-			.width = e->vk.swapchain_extent.width,
-			.height = e->vk.swapchain_extent.height,
-			.layers = 1
-		};
-
-		VkResult r = vkCreateFramebuffer(e->vk.logical, &fb_info, NULL, &e->vk.fbs[i]);
-		if (r != VK_SUCCESS) {
-			A3D_LOG_ERROR("failed to create framebuffer %u with code %d", i, r);
-			/* cleanup any previously created framebuffers */
-			for (Uint32 j = 0; j < i; j++) {
-				if (e->vk.fbs[j]) {
-					vkDestroyFramebuffer(e->vk.logical, e->vk.fbs[j], NULL);
-					e->vk.fbs[j] = VK_NULL_HANDLE;
-				}
-			}
-			return false;
-		}
-		A3D_LOG_INFO("created framebuffer %u", i);
-	}
-
+	A3D_LOG_INFO("created frame graph");
 	return true;
 }
 
@@ -256,14 +212,24 @@ bool a3d_vk_create_image_views(a3d* e)
 bool a3d_vk_create_logical_device(a3d* e)
 {
 	float priority = 1.0f;
-	Uint32 unique_families[2] = {
+	Uint32 families[4] = {
 		e->vk.graphics_family,
-		e->vk.present_family
+		e->vk.present_family,
+		e->vk.transfer_family,
+		e->vk.compute_family
 	};
-	Uint32 unique_count = (e->vk.present_family == e->vk.graphics_family) ? 1 : 2;
+	Uint32 unique_families[4];
+	Uint32 unique_count = 0;
+	for (Uint32 i = 0; i < 4; i++) {
+		bool seen = false;
+		for (Uint32 j = 0; j < unique_count; j++)
+			seen |= unique_families[j] == families[i];
+		if (!seen)
+			unique_families[unique_count++] = families[i];
+	}
 
 	/* init queues info */
-	VkDeviceQueueCreateInfo queues_info[2];
+	VkDeviceQueueCreateInfo queues_info[4];
 	for (Uint32 i = 0; i < unique_count; i++) {
 		queues_info[i].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
 		queues_info[i].pNext = NULL;
@@ -273,10 +239,77 @@ bool a3d_vk_create_logical_device(a3d* e)
 		queues_info[i].pQueuePriorities = &priority;
 	}
 
-	Uint32 device_extensions_count = 1;
+	/* gpu culling needs count draws whose firstInstance picks the model matrix */
+	VkPhysicalDeviceVulkan12Features supported12 = {
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES
+	};
+	VkPhysicalDeviceFeatures2 supported = {
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+		.pNext = &supported12
+	};
+	/* the 1.3 feature struct may only be chained for a 1.3 device */
+	VkPhysicalDeviceProperties props;
+	vkGetPhysicalDeviceProperties(e->vk.physical, &props);
+	VkPhysicalDeviceVulkan13Features supported13 = {
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES
+	};
+	if (props.apiVersion >= VK_API_VERSION_1_3)
+		supported12.pNext = &supported13;
+
+	vkGetPhysicalDeviceFeatures2(e->vk.physical, &supported);
+	e->vk.multi_draw_indirect = supported.features.multiDrawIndirect && supported.features.drawIndirectFirstInstance;
+
+	/* every submission signals a timeline, there is no fence fallback */
+	if (!supported12.timelineSemaphore) {
+		A3D_LOG_ERROR("device lacks timeline semaphores, which queue synchronisation needs");
+		return false;
+	}
+
+	/* the bindless set has no fallback, every pipeline layout includes it */
+	bool descriptor_indexing = supported12.runtimeDescriptorArray && supported12.descriptorBindingPartiallyBound &&
+		supported12.descriptorBindingUpdateUnusedWhilePending &&
+		supported12.descriptorBindingSampledImageUpdateAfterBind &&
+		supported12.descriptorBindingStorageBufferUpdateAfterBind &&
+		/* push constant indices are dynamically uniform, which needs these rather than nonuniform indexing */
+		supported.features.shaderStorageBufferArrayDynamicIndexing &&
+		supported.features.shaderSampledImageArrayDynamicIndexing;
+	if (!descriptor_indexing) {
+		A3D_LOG_ERROR("device lacks the descriptor indexing features the bindless set needs");
+		return false;
+	}
+	e->vk.dynamic_rendering = A3D_VK_DYNAMIC_RENDERING && supported13.dynamicRendering && supported13.synchronization2;
+
+	/* the frame graph records passes without render pass objects */
+	VkPhysicalDeviceVulkan13Features features13 = {
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+		.synchronization2 = VK_TRUE,
+		.dynamicRendering = VK_TRUE
+	};
+
+	/* every queue submission signals a timeline semaphore, draws index the bindless arrays */
+	VkPhysicalDeviceVulkan12Features features12 = {
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+		.pNext = e->vk.dynamic_rendering ? &features13 : NULL,
+		.timelineSemaphore = VK_TRUE,
+		.runtimeDescriptorArray = VK_TRUE,
+		.descriptorBindingPartiallyBound = VK_TRUE,
+		.descriptorBindingUpdateUnusedWhilePending = VK_TRUE,
+		.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE,
+		.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE
+	};
+	VkPhysicalDeviceFeatures features = {
+		.drawIndirectFirstInstance = e->vk.multi_draw_indirect,
+		.multiDrawIndirect = e->vk.multi_draw_indirect,
+		.shaderSampledImageArrayDynamicIndexing = VK_TRUE,
+		.shaderStorageBufferArrayDynamicIndexing = VK_TRUE
+	};
+
+	Uint32 device_extensions_count = e->headless ? 0 : 1;
 	const char* device_extensions[] = {"VK_KHR_swapchain"};
 	VkDeviceCreateInfo device_info = {
 		.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+		.pNext = &features12,
+		.pEnabledFeatures = &features,
 		.queueCreateInfoCount = unique_count,
 		.pQueueCreateInfos = queues_info,
 		.enabledExtensionCount = device_extensions_count,
@@ -292,98 +325,20 @@ bool a3d_vk_create_logical_device(a3d* e)
 	/* retrieve queue handles */
 	vkGetDeviceQueue(e->vk.logical, e->vk.graphics_family, 0, &e->vk.graphics_queue);
 	vkGetDeviceQueue(e->vk.logical, e->vk.present_family, 0, &e->vk.present_queue);
+	vkGetDeviceQueue(e->vk.logical, e->vk.transfer_family, 0, &e->vk.transfer_queue);
+	vkGetDeviceQueue(e->vk.logical, e->vk.compute_family, 0, &e->vk.compute_queue);
 
 	A3D_LOG_INFO("logical device created");
 	A3D_LOG_INFO("    graphics family: %u", e->vk.graphics_family);
 	A3D_LOG_INFO("    present family: %u", e->vk.present_family);
+	A3D_LOG_INFO("    transfer family: %u", e->vk.transfer_family);
+	A3D_LOG_INFO("    compute family: %u", e->vk.compute_family);
+	A3D_LOG_INFO("    multi draw indirect: %s", e->vk.multi_draw_indirect ? "yes" : "no");
+	A3D_LOG_INFO("    dynamic rendering: %s", e->vk.dynamic_rendering ? "yes" : "no");
 
 	return true;
 }
 
-bool a3d_vk_create_render_pass(a3d* e)
-{
-	A3D_LOG_INFO("creating render pass");
-
-	VkAttachmentDescription colour_attach = {
-		.format = e->vk.swapchain_fmt,
-		.samples = VK_SAMPLE_COUNT_1_BIT,
-		.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-		.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-		.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-		.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-		.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-		.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
-	};
-
-	VkAttachmentDescription depth_attach = {
-		.format = e->vk.depth_fmt,
-		.samples = VK_SAMPLE_COUNT_1_BIT,
-		.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-		.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-		.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-		.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-		.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-		.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
-	};
-
-	VkAttachmentDescription attachments[] = {
-		colour_attach,
-		depth_attach
-	};
-
-	VkAttachmentReference col_ref = {
-		.attachment = 0,
-		.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
-	};
-
-	VkAttachmentReference depth_ref = {
-		.attachment = 1,
-		.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
-	};
-
-	VkSubpassDescription subpass = {
-		.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
-		.colorAttachmentCount = 1,
-		.pColorAttachments = &col_ref,
-		.pDepthStencilAttachment = &depth_ref
-	};
-
-	/* include depth in dependency */
-	VkSubpassDependency dependency = {
-		.srcSubpass = VK_SUBPASS_EXTERNAL,
-		.dstSubpass = 0,
-		.srcStageMask =
-			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
-			VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
-		.dstStageMask =
-			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
-			VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
-		.srcAccessMask = 0,
-		.dstAccessMask =
-			VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
-			VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT
-	};
-
-	VkRenderPassCreateInfo render_pass_info = {
-		.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
-		.attachmentCount = 2,
-		.pAttachments = attachments,
-		.subpassCount = 1,
-		.pSubpasses = &subpass,
-		.dependencyCount = 1,
-		.pDependencies = &dependency
-	};
-
-	VkResult r = vkCreateRenderPass(e->vk.logical, &render_pass_info, NULL, &e->vk.render_pass);
-	if (r != VK_SUCCESS) {
-		A3D_LOG_ERROR("failed to create render pass with code %d", r);
-		return false;
-	}
-
-	A3D_LOG_INFO("created render pass");
-	return true;
-}
-
 bool a3d_vk_create_swapchain(a3d* e)
 {
 	VkPhysicalDevice device = e->vk.physical;
@@ -449,7 +404,7 @@ bool a3d_vk_create_swapchain(a3d* e)
 		.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
 		.presentMode = best_mode,
 		.clipped = VK_TRUE,
-		.oldSwapchain = VK_NULL_HANDLE
+		.oldSwapchain = e->vk.retired_count ? e->vk.retired_swapchains[e->vk.retired_count - 1] : VK_NULL_HANDLE
 	};
 	
 	Uint32 queue_indecies[] = {
@@ -496,19 +451,29 @@ bool a3d_vk_create_sync_objects(a3d* e)
 		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO
 	};
 
-	VkFenceCreateInfo fence_info = {
-		.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-		.flags = VK_FENCE_CREATE_SIGNALED_BIT
-	};
-
-	if (vkCreateSemaphore(e->vk.logical, &semaphore_info, NULL, &e->vk.image_available) != VK_SUCCESS ||
-		vkCreateSemaphore(e->vk.logical, &semaphore_info, NULL, &e->vk.render_finished) != VK_SUCCESS ||
-		vkCreateFence(e->vk.logical, &fence_info, NULL, &e->vk.in_flight) != VK_SUCCESS) {
+	/* the swapchain only takes binary semaphores, everything else waits on the queue timelines */
+	for (Uint32 i = 0; i < A3D_VK_FRAMES_IN_FLIGHT; i++) {
+		a3d_vk_frame* frame = &e->vk.frames[i];
+		if (vkCreateSemaphore(e->vk.logical, &semaphore_info, NULL, &frame->image_available) != VK_SUCCESS) {
+			A3D_LOG_ERROR("failed to create sync objects for frame %u", i);
+			return false;
+		}
+		frame->value = 0;
+	}
 
-		A3D_LOG_ERROR("failed to create sync objects");
-		return false;
+	/* one per swapchain image slot, so a semaphore is never re-signalled
+	 * while a present on that image may still be waiting on it */
+	for (Uint32 i = 0; i < SDL_arraysize(e->vk.render_finished); i++) {
+		if (vkCreateSemaphore(e->vk.logical, &semaphore_info, NULL, &e->vk.render_finished[i]) != VK_SUCCESS) {
+			A3D_LOG_ERROR("failed to create render finished semaphore %u", i);
+			return false;
+		}
+		e->vk.images_in_flight[i] = 0;
 	}
-	A3D_LOG_INFO("created sync objects");
+
+	e->vk.frame_index = 0;
+
+	A3D_LOG_INFO("created sync objects for %u frames in flight", A3D_VK_FRAMES_IN_FLIGHT);
 	return true;
 }
 
@@ -521,48 +486,19 @@ void a3d_vk_destroy_command_pool(a3d* e)
 	}
 }
 
-void a3d_vk_destroy_depth_resources(a3d* e)
+void a3d_vk_destroy_frame_graph(a3d* e)
 {
-	if (e->vk.depth_view) {
-		vkDestroyImageView(e->vk.logical, e->vk.depth_view, NULL);
-		e->vk.depth_view = VK_NULL_HANDLE;
-	}
-	if (e->vk.depth_image) {
-		vkDestroyImage(e->vk.logical, e->vk.depth_image, NULL);
-		e->vk.depth_image = VK_NULL_HANDLE;
-	}
-	if (e->vk.depth_mem) {
-		vkFreeMemory(e->vk.logical, e->vk.depth_mem, NULL);
-		e->vk.depth_mem = VK_NULL_HANDLE;
-	}
-	e->vk.depth_fmt = VK_FORMAT_UNDEFINED;
-	A3D_LOG_INFO("depth resources destroyed");
-}
-
-void a3d_vk_destroy_framebuffers(a3d* e)
-{
-	for (Uint32 i = 0; i < e->vk.swapchain_images_count; i++) {
-		if (e->vk.fbs[i]) {
-			vkDestroyFramebuffer(e->vk.logical, e->vk.fbs[i], NULL);
-			e->vk.fbs[i] = VK_NULL_HANDLE;
-		}
-	}
-	A3D_LOG_INFO("destroyed framebuffers");
-}
+	if (!e->vk.graph)
+		return;
 
-void a3d_vk_destroy_render_pass(a3d* e)
-{
-	if (e->vk.render_pass) {
-		vkDestroyRenderPass(e->vk.logical, e->vk.render_pass, NULL);
-		e->vk.render_pass = VK_NULL_HANDLE;
-		A3D_LOG_INFO("destroyed render pass");
-	}
+	a3d_vk_graph_destroy(e, e->vk.graph);
+	free(e->vk.graph);
+	e->vk.graph = NULL;
+	A3D_LOG_INFO("destroyed frame graph");
 }
 
-void a3d_vk_destroy_swapchain(a3d* e)
+void a3d_vk_destroy_image_views(a3d* e)
 {
-
-	/* destroy image views */
 	for (Uint32 i = 0; i < e->vk.swapchain_images_count; i++) {
 		if (e->vk.swapchain_views[i]) {
 			vkDestroyImageView(e->vk.logical, e->vk.swapchain_views[i], NULL);
@@ -570,6 +506,11 @@ void a3d_vk_destroy_swapchain(a3d* e)
 		}
 	}
 	A3D_LOG_INFO("vulkan destroyed image views");
+}
+
+void a3d_vk_destroy_swapchain(a3d* e)
+{
+	a3d_vk_destroy_image_views(e);
 
 	/* destroy swapchain */
 	if (e->vk.swapchain) {
@@ -577,33 +518,57 @@ void a3d_vk_destroy_swapchain(a3d* e)
 		e->vk.swapchain = VK_NULL_HANDLE;
 		A3D_LOG_INFO("vulkan destroyed swapchain");
 	}
+
+	for (Uint32 i = 0; i < e->vk.retired_count; i++)
+		vkDestroySwapchainKHR(e->vk.logical, e->vk.retired_swapchains[i], NULL);
+	if (e->vk.retired_count)
+		A3D_LOG_INFO("vulkan destroyed %u retired swapchains", e->vk.retired_count);
+	e->vk.retired_count = 0;
 }
 
 void a3d_vk_destroy_sync_objects(a3d* e)
 {
-	if (e->vk.image_available)
-		vkDestroySemaphore(e->vk.logical, e->vk.image_available, NULL);
-	if (e->vk.render_finished)
-		vkDestroySemaphore(e->vk.logical, e->vk.render_finished, NULL);
-	if (e->vk.in_flight)
-		vkDestroyFence(e->vk.logical, e->vk.in_flight, NULL);
+	for (Uint32 i = 0; i < A3D_VK_FRAMES_IN_FLIGHT; i++) {
+		a3d_vk_frame* frame = &e->vk.frames[i];
+		if (frame->image_available)
+			vkDestroySemaphore(e->vk.logical, frame->image_available, NULL);
+
+		frame->image_available = VK_NULL_HANDLE;
+		frame->value = 0;
+	}
+
+	for (Uint32 i = 0; i < SDL_arraysize(e->vk.render_finished); i++) {
+		if (e->vk.render_finished[i])
+			vkDestroySemaphore(e->vk.logical, e->vk.render_finished[i], NULL);
 
-	e->vk.image_available = VK_NULL_HANDLE;
-	e->vk.render_finished = VK_NULL_HANDLE;
-	e->vk.in_flight = VK_NULL_HANDLE;
+		e->vk.render_finished[i] = VK_NULL_HANDLE;
+		e->vk.images_in_flight[i] = 0;
+	}
 
 	A3D_LOG_INFO("sync objects destroyed");
 }
 
 bool a3d_vk_draw_frame(a3d* e)
 {
-	vkWaitForFences(e->vk.logical, 1, &e->vk.in_flight, VK_TRUE, UINT64_MAX);
-	vkResetFences(e->vk.logical, 1, &e->vk.in_flight);
+	if (e->headless)
+		return a3d_vk_headless_draw_frame(e);
+
+	Uint32 frame_index = e->vk.frame_index;
+	a3d_vk_frame* frame = &e->vk.frames[frame_index];
+
+	/* only blocks if the gpu is still A3D_VK_FRAMES_IN_FLIGHT frames behind */
+	if (!a3d_vk_sync_wait(e, (a3d_vk_sync_point){A3D_VK_QUEUE_GRAPHICS, frame->value})) {
+		A3D_LOG_ERROR("failed to wait for frame %u", frame_index);
+		return false;
+	}
+	a3d_vk_sync_collect(e);
+
+	collect_retired_swapchains(e);
 
 	Uint32 image_index = 0;
 	VkResult r = vkAcquireNextImageKHR(
 		e->vk.logical, e->vk.swapchain, UINT64_MAX,
-		e->vk.image_available, VK_NULL_HANDLE, &image_index
+		frame->image_available, VK_NULL_HANDLE, &image_index
 	);
 	if (r == VK_ERROR_OUT_OF_DATE_KHR) {
 		A3D_LOG_WARN("vkAcquireNextImageKHR: swapchain out of date");
@@ -615,44 +580,67 @@ bool a3d_vk_draw_frame(a3d* e)
 		return false;
 	}
 
-	if (!a3d_vk_record_command_buffer(e, image_index, e->vk.clear_col)) {
-		A3D_LOG_ERROR("failed to re-record command buffer for image %u", image_index);
+	/* another slot may still be rendering into this image, usually already reached */
+	if (!a3d_vk_sync_wait(e, (a3d_vk_sync_point){A3D_VK_QUEUE_GRAPHICS, e->vk.images_in_flight[image_index]})) {
+		A3D_LOG_ERROR("failed to wait for image %u", image_index);
+		drop_acquire(e, frame);
+		return false;
+	}
+
+	A3D_PROFILE_BEGIN(record_start);
+	if (!a3d_vk_record_command_buffer(e, frame_index, image_index, e->vk.clear_col)) {
+		A3D_LOG_ERROR("failed to record command buffer for image %u", image_index);
+		drop_acquire(e, frame);
 		return false;
 	}
+	A3D_PROFILE_END(record_start, "record");
 
-	/* submit recorded command buffer */
-	VkSemaphore wait_semaphores[] = {e->vk.image_available};
-	VkSemaphore signal_semaphores[] = {e->vk.render_finished};
-	VkPipelineStageFlags wait_stages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+	A3D_PROFILE_BEGIN(submit_start);
 
-	VkSubmitInfo submit = {
-		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-		.waitSemaphoreCount = 1,
-		.pWaitSemaphores = wait_semaphores,
-		.pWaitDstStageMask = wait_stages,
-		.commandBufferCount = 1,
-		.pCommandBuffers = &e->vk.cmd_buffs[image_index],
-		.signalSemaphoreCount = 1,
-		.pSignalSemaphores = signal_semaphores
+	/* hand pending copies to the transfer queue before the draws that read them */
+	if (!a3d_vk_upload_flush(e)) {
+		A3D_LOG_ERROR("failed to flush uploads");
+		drop_acquire(e, frame);
+		return false;
+	}
+
+	/* submit recorded command buffer, after the uploads it draws from */
+	a3d_vk_submission submission = {
+		.cmds = &frame->cmd,
+		.cmd_count = 1,
+		.waits = {a3d_vk_sync_last(e, A3D_VK_QUEUE_TRANSFER)},
+		.wait_stages = {VK_PIPELINE_STAGE_VERTEX_INPUT_BIT},
+		.wait_count = 1,
+		.binary_wait = frame->image_available,
+		.binary_wait_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+		.binary_signal = e->vk.render_finished[image_index]
 	};
 
-	r = vkQueueSubmit(e->vk.graphics_queue, 1, &submit, e->vk.in_flight);
-	if (r != VK_SUCCESS) {
-		A3D_LOG_ERROR("vkQueueSubmit failed with code %d", r);
+	a3d_vk_sync_point point;
+	if (!a3d_vk_sync_submit(e, A3D_VK_QUEUE_GRAPHICS, &submission, &point)) {
+		drop_acquire(e, frame);
 		return false;
 	}
+	frame->value = point.value;
+	e->vk.images_in_flight[image_index] = point.value;
+	a3d_vk_profiler_submitted(e, frame_index);
+	A3D_PROFILE_END(submit_start, "submit");
+
+	e->vk.frame_index = (frame_index + 1) % A3D_VK_FRAMES_IN_FLIGHT;
 
 	/* present to screen */
 	VkPresentInfoKHR present_info = {
 		.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
 		.waitSemaphoreCount = 1,
-		.pWaitSemaphores = signal_semaphores,
+		.pWaitSemaphores = &e->vk.render_finished[image_index],
 		.swapchainCount = 1,
 		.pSwapchains = &e->vk.swapchain,
 		.pImageIndices = &image_index
 	};
 
+	A3D_PROFILE_BEGIN(present_start);
 	r = vkQueuePresentKHR(e->vk.present_queue, &present_info);
+	A3D_PROFILE_END(present_start, "present");
 	if (r == VK_ERROR_OUT_OF_DATE_KHR || r == VK_SUBOPTIMAL_KHR) {
 		A3D_LOG_WARN("swapchain needs recreation, present returned with code %d", r);
 		a3d_vk_recreate_swapchain(e);
@@ -669,11 +657,15 @@ bool a3d_vk_init(a3d* e)
 {
 	A3D_LOG_INFO("initialising vulkan instance");
 
+	/* headless needs no surface extensions at all */
 	Uint32 extensions_count = 0;
-	const char* const* sdl_extensions = SDL_Vulkan_GetInstanceExtensions(&extensions_count);
-	if (!sdl_extensions) {
-		A3D_LOG_ERROR("failed to retrieve vulkan extensions: %s", SDL_GetError());
-		return false;
+	const char* const* sdl_extensions = NULL;
+	if (!e->headless) {
+		sdl_extensions = SDL_Vulkan_GetInstanceExtensions(&extensions_count);
+		if (!sdl_extensions) {
+			A3D_LOG_ERROR("failed to retrieve vulkan extensions: %s", SDL_GetError());
+			return false;
+		}
 	}
 
 	A3D_LOG_INFO("retrieved %u vulkan extensions from SDL", extensions_count);
@@ -728,7 +720,7 @@ bool a3d_vk_init(a3d* e)
 #endif
 
 	/* create window surface */
-	bool created_surface = SDL_Vulkan_CreateSurface(e->window, e->vk.instance, NULL, &e->vk.surface);
+	bool created_surface = e->headless || SDL_Vulkan_CreateSurface(e->window, e->vk.instance, NULL, &e->vk.surface);
 
 	if (!created_surface) {
 		A3D_LOG_ERROR("failed to create surface: %s", SDL_GetError());
@@ -736,7 +728,7 @@ bool a3d_vk_init(a3d* e)
 		e->vk.instance = VK_NULL_HANDLE;
 		return false;
 	}
-	else {
+	else if (!e->headless) {
 		A3D_LOG_INFO("attached SDL vulkan surface");
 	}
 
@@ -751,38 +743,66 @@ bool a3d_vk_init(a3d* e)
 		return false;
 	}
 
-	/* init swapchain & image views */
-	if (!a3d_vk_create_swapchain(e)) {
-		A3D_LOG_ERROR("failed to create swapchain");
+	/* queue timelines, before anything submits */
+	if (!a3d_vk_sync_init(e)) {
+		A3D_LOG_ERROR("failed to create queue timelines");
 		return false;
 	}
 
-	if (!a3d_vk_create_image_views(e)) {
-		A3D_LOG_ERROR("failed to create image views");
+	/* a missing cache only costs compile time */
+	if (!a3d_vk_pipeline_cache_init(e))
+		A3D_LOG_WARN("continuing without a pipeline cache");
+
+	if (!a3d_vk_memory_init(e)) {
+		A3D_LOG_ERROR("failed to create memory allocator");
+		return false;
+	}
+
+	if (!a3d_vk_upload_init(e)) {
+		A3D_LOG_ERROR("failed to create uploader");
 		return false;
 	}
 
-	/* depth resources */
-	if (!a3d_vk_create_depth_resources(e)) {
-		A3D_LOG_ERROR("failed to create depth resources");
+	/* init swapchain & image views, or the offscreen targets standing in for them */
+	if (e->headless) {
+		if (!a3d_vk_create_headless(e)) {
+			A3D_LOG_ERROR("failed to create headless targets");
+			return false;
+		}
+	}
+	else {
+		if (!a3d_vk_create_swapchain(e)) {
+			A3D_LOG_ERROR("failed to create swapchain");
+			return false;
+		}
+
+		if (!a3d_vk_create_image_views(e)) {
+			A3D_LOG_ERROR("failed to create image views");
+			return false;
+		}
+	}
+
+	/* render passes, framebuffers and the depth buffer */
+	if (!a3d_vk_create_frame_graph(e)) {
+		A3D_LOG_ERROR("failed to create frame graph");
 		return false;
 	}
 
-	/* render pass */
-	if (!a3d_vk_create_render_pass(e)) {
-		A3D_LOG_ERROR("failed to create render pass");
+	/* global arrays of images, buffers and samplers, before anything registers into them */
+	if (!a3d_vk_create_bindless(e)) {
+		A3D_LOG_ERROR("failed to create bindless set");
 		return false;
 	}
 
-	/* graphics pipeline */
-	if (!a3d_vk_create_graphics_pipeline(e)) {
-		A3D_LOG_ERROR("failed to create graphics pipeline");
+	/* per-frame camera and model buffers */
+	if (!a3d_vk_create_descriptors(e)) {
+		A3D_LOG_ERROR("failed to create descriptors");
 		return false;
 	}
 
-	/* framebuffer */
-	if (!a3d_vk_create_framebuffers(e)) {
-		A3D_LOG_ERROR("failed to create framebuffers");
+	/* graphics pipeline */
+	if (!a3d_vk_create_graphics_pipeline(e)) {
+		A3D_LOG_ERROR("failed to create graphics pipeline");
 		return false;
 	}
 
@@ -797,6 +817,24 @@ bool a3d_vk_init(a3d* e)
 		return false;
 	}
 
+	if (!a3d_vk_create_recorder(e)) {
+		A3D_LOG_ERROR("failed to create recorder");
+		return false;
+	}
+
+	/* optional, the cpu path covers devices without multi draw indirect */
+	if (e->vk.multi_draw_indirect && !a3d_vk_create_gpu_cull(e)) {
+		A3D_LOG_ERROR("failed to create gpu culling");
+		return false;
+	}
+
+#if A3D_PROFILER
+	if (!a3d_vk_create_profiler(e)) {
+		A3D_LOG_ERROR("failed to create gpu profiler");
+		return false;
+	}
+#endif
+
 	/* sync objects */
 	if (!a3d_vk_create_sync_objects(e)) {
 		A3D_LOG_ERROR("failed to create sync objects");
@@ -1062,8 +1100,12 @@ bool a3d_vk_pick_queue_families(a3d* e, VkPhysicalDevice device)
 	Uint32 present_family = UINT32_MAX;
 
 	for (Uint32 i = 0; i < families_count; i++) {
+		/* headless never presents, graphics stands in so the family bookkeeping holds */
 		VkBool32 can_present = VK_FALSE;
-		vkGetPhysicalDeviceSurfaceSupportKHR(device, i, e->vk.surface, &can_present);
+		if (e->headless)
+			can_present = (families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+		else
+			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, e->vk.surface, &can_present);
 
 		if ((families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) &&
 		graphics_family == UINT32_MAX)
@@ -1086,31 +1128,90 @@ bool a3d_vk_pick_queue_families(a3d* e, VkPhysicalDevice device)
 		return false;
 	}
 
+	/* a transfer-only family maps to the copy engines and runs beside graphics */
+	Uint32 transfer_family = graphics_family;
+	for (Uint32 i = 0; i < families_count; i++) {
+		VkQueueFlags flags = families[i].queueFlags;
+		if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+			transfer_family = i;
+			break;
+		}
+	}
+
+	/* a compute family without graphics runs beside it as async compute */
+	Uint32 compute_family = graphics_family;
+	for (Uint32 i = 0; i < families_count; i++) {
+		VkQueueFlags flags = families[i].queueFlags;
+		if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT)) {
+			compute_family = i;
+			break;
+		}
+	}
+
 	A3D_LOG_INFO("got queue families");
 	A3D_LOG_DEBUG("    graphics: %u", graphics_family);
 	A3D_LOG_DEBUG("    presentation: %u", present_family);
+	A3D_LOG_DEBUG("    transfer: %u", transfer_family);
+	A3D_LOG_DEBUG("    compute: %u", compute_family);
 
 	e->vk.graphics_family = graphics_family;
 	e->vk.present_family = present_family;
+	e->vk.transfer_family = transfer_family;
+	e->vk.compute_family = compute_family;
 	return true;
 }
 
-bool a3d_vk_record_command_buffers(a3d* e)
+bool a3d_vk_record_command_buffer(a3d* e, Uint32 frame, Uint32 image, VkClearValue clear)
 {
-	A3D_LOG_INFO("recording command buffers");
+	VkCommandBuffer* cmd = &e->vk.frames[frame].cmd;
 
-	for (Uint32 i = 0; i < e->vk.swapchain_images_count; i++) {
-		if (!a3d_vk_record_command_buffer(e, i, e->vk.clear_col))
+	const a3d_draw_item* items = NULL;
+	Uint32 item_count = 0;
+	a3d_renderer_get_draw_items(e->renderer, &items, &item_count);
+
+	const a3d_camera* camera = a3d_renderer_get_camera(e->renderer);
+	if (!a3d_vk_write_frame_data(e, frame, camera, items, item_count)) {
+		A3D_LOG_ERROR("failed to write frame data");
+		return false;
+	}
+
+	const a3d_draw_batch* batches = NULL;
+	Uint32 batch_count = 0;
+	a3d_renderer_get_batches(e->renderer, &batches, &batch_count);
+
+	/* the renderer skipped its own cull, so every item goes to the compute pass */
+	bool gpu_driven = e->renderer->gpu_culling && e->vk.gpu_cull;
+	if (gpu_driven != e->vk.graph_gpu_cull) {
+		/* the graph may be in use by the other frames, and the cull pass comes or goes */
+		if (!a3d_vk_sync_wait(e, a3d_vk_sync_last(e, A3D_VK_QUEUE_GRAPHICS))) {
+			A3D_LOG_ERROR("failed to wait for frames in flight");
 			return false;
+		}
+
+		if (!a3d_vk_create_frame_graph(e)) {
+			A3D_LOG_ERROR("failed to rebuild frame graph");
+			return false;
+		}
 	}
 
-	A3D_LOG_INFO("recorded all command buffers");
-	return true;
-}
+	if (gpu_driven && !a3d_vk_gpu_cull_prepare(e, frame, camera, batches, batch_count)) {
+		A3D_LOG_ERROR("failed to prepare gpu culling");
+		return false;
+	}
+
+	/* large frames are split across the job workers as secondaries */
+	a3d_vk_frame_record record = {
+		.batches = batches,
+		.batch_count = batch_count
+	};
+	bool secondary = !gpu_driven && e->vk.recorder->worker_count > 1 && batch_count >= 2 * A3D_VK_RECORD_MIN_BATCHES;
+	if (secondary && !a3d_vk_record_secondary(e, frame, image, batches, batch_count, record.secondaries, &record.secondary_count)) {
+		A3D_LOG_ERROR("failed to record secondary command buffers");
+		return false;
+	}
+	a3d_vk_graph_set_secondary(e->vk.graph, e->vk.main_pass, secondary);
+	a3d_vk_graph_clear(e->vk.graph, e->vk.main_pass, e->vk.backbuffer, clear);
 
-bool a3d_vk_record_command_buffer(a3d* e, Uint32 i, VkClearValue clear)
-{
-	VkCommandBuffer* cmd = &e->vk.cmd_buffs[i];
 	vkResetCommandBuffer(*cmd, 0);
 
 	VkCommandBufferBeginInfo buffer_begin_info = {
@@ -1123,45 +1224,20 @@ bool a3d_vk_record_command_buffer(a3d* e, Uint32 i, VkClearValue clear)
 		return false;
 	}
 
-	/* IMPORTANT: must match render pass attachmentCount (colour + depth) */
-	VkClearValue clears[2];
-	clears[0] = clear;
-	clears[1].depthStencil.depth = 1.0f;
-	clears[1].depthStencil.stencil = 0;
-
-	VkRenderPassBeginInfo render_pass_begin_info = {
-		.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-		.renderPass = e->vk.render_pass,
-		.framebuffer = e->vk.fbs[i],
-		.renderArea = {
-			.offset = {0, 0},
-			.extent = e->vk.swapchain_extent,
-		},
-		.clearValueCount = 2,
-		.pClearValues = clears
-	};
-
-	vkCmdBeginRenderPass(*cmd, &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
-	vkCmdBindPipeline(*cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, e->vk.pipeline);
-
-	const a3d_draw_item* items = NULL;
-	Uint32 item_count = 0;
-	a3d_renderer_get_draw_items(e->renderer, &items, &item_count);
-	for (Uint32 j = 0; j < item_count; j++) {
-		const a3d_mesh* mesh = items[j].mesh;
-		const a3d_mvp* mvp = &items[j].mvp;
-		mat4 mvp_mat;
-		a3d_mvp_compose(mvp_mat, mvp);
+	/* reads back what this slot timed last time round */
+	a3d_vk_profiler_begin(e, frame, *cmd);
+	Uint32 frame_scope = a3d_vk_profiler_scope_begin(e, frame, *cmd, "gpu frame");
 
-		vkCmdPushConstants(*cmd, e->vk.pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(mat4), mvp_mat);
-
-		if (mesh && mvp)
-			a3d_draw_mesh(e, mesh, cmd);
+	/* cull, render and read back, with the barriers between them */
+	if (!a3d_vk_graph_execute(e, e->vk.graph, *cmd, frame, image, &record)) {
+		A3D_LOG_ERROR("failed to record frame graph");
+		vkEndCommandBuffer(*cmd);
+		return false;
 	}
 
-	vkCmdEndRenderPass(e->vk.cmd_buffs[i]);
+	a3d_vk_profiler_scope_end(e, frame, *cmd, frame_scope);
 
-	r = vkEndCommandBuffer(e->vk.cmd_buffs[i]);
+	r = vkEndCommandBuffer(*cmd);
 	if (r != VK_SUCCESS) {
 		A3D_LOG_ERROR("vkEndCommandBuffer failed with code %d", r);
 		return false;
@@ -1181,16 +1257,24 @@ bool a3d_vk_recreate_swapchain(a3d* e)
 		return false;
 	}
 
-	vkDeviceWaitIdle(e->vk.logical);
+	/* only the frames recorded against the old images have to finish, not the whole device */
+	if (!a3d_vk_sync_wait(e, a3d_vk_sync_last(e, A3D_VK_QUEUE_GRAPHICS))) {
+		A3D_LOG_ERROR("failed to wait for frames in flight");
+		return false;
+	}
 
 	A3D_LOG_INFO("recreating swapchain with window %dx%d", width, height);
 
-	/* destroy old objects */
-	a3d_vk_destroy_framebuffers(e);
-	a3d_vk_destroy_depth_resources(e);
-	a3d_vk_destroy_graphics_pipeline(e);
-	a3d_vk_destroy_render_pass(e);
-	a3d_vk_destroy_swapchain(e);
+	/* destroy old objects, the pipeline has dynamic viewport and scissor and survives */
+	a3d_vk_destroy_frame_graph(e);
+	a3d_vk_destroy_image_views(e);
+
+	/*
+	 * the wait above covers rendering but not presentation, so the old swapchain is destroyed only
+	 * once a later graphics submission finishes. the driver hands resources over from the newest
+	 */
+	retire_swapchain(e);
+	VkFormat old_fmt = e->vk.swapchain_fmt;
 
 	/* recreate objects */
 	if (!a3d_vk_create_swapchain(e)) {
@@ -1203,35 +1287,25 @@ bool a3d_vk_recreate_swapchain(a3d* e)
 		return false;
 	}
 
-	if (!a3d_vk_create_depth_resources(e)) {
-		A3D_LOG_ERROR("failed to recreate depth resources");
+	if (!a3d_vk_create_frame_graph(e)) {
+		A3D_LOG_ERROR("failed to recreate frame graph");
 		return false;
 	}
 
-	if (!a3d_vk_create_render_pass(e)) {
-		A3D_LOG_ERROR("failed to recreate render pass");
-		return false;
-	}
+	/* pipelines stay compatible with the rebuilt render pass, or the attachments, as long as the formats match */
+	if (e->vk.swapchain_fmt != old_fmt) {
+		A3D_LOG_INFO("surface format changed, rebuilding pipeline");
+		a3d_vk_destroy_graphics_pipeline(e);
 
-	if (!a3d_vk_create_graphics_pipeline(e)) {
-		A3D_LOG_ERROR("failed to recreate graphics pipeline");
-		return false;
+		if (!a3d_vk_create_graphics_pipeline(e)) {
+			A3D_LOG_ERROR("failed to recreate graphics pipeline");
+			return false;
+		}
 	}
 
-	if (!a3d_vk_create_framebuffers(e)) {
-		A3D_LOG_ERROR("failed to recreate framebuffers");
-		return false;
-	}
-
-	a3d_vk_destroy_command_pool(e);
-	if (!a3d_vk_create_command_pool(e)) {
-		A3D_LOG_ERROR("failed to recreate command pool");
-		return false;
-	}
-	if (!a3d_vk_allocate_command_buffers(e)) {
-		A3D_LOG_ERROR("failed to allocate command buffers after recreate");
-		return false;
-	}
+	/* old images are gone, nothing can be in flight against the new ones */
+	for (Uint32 i = 0; i < SDL_arraysize(e->vk.images_in_flight); i++)
+		e->vk.images_in_flight[i] = 0;
 
 	A3D_LOG_INFO("swapchain recreation complete");
 	return true;
@@ -1252,13 +1326,24 @@ void a3d_vk_shutdown(a3d* e)
 	A3D_LOG_INFO("GPU finished work, destroying resources");
 
 	a3d_vk_destroy_sync_objects(e);
+	a3d_vk_destroy_profiler(e);
+	a3d_vk_destroy_gpu_cull(e);
+	a3d_vk_destroy_recorder(e);
 	a3d_vk_destroy_command_pool(e);
 	a3d_vk_destroy_graphics_pipeline(e);
-	a3d_vk_destroy_framebuffers(e);
-	a3d_vk_destroy_depth_resources(e);
-	a3d_vk_destroy_render_pass(e);
+	a3d_vk_destroy_frame_graph(e);
+	a3d_vk_destroy_headless(e);
 	a3d_vk_destroy_swapchain(e);
 
+	a3d_vk_destroy_descriptors(e);
+	a3d_vk_destroy_bindless(e);
+	a3d_vk_pipeline_cache_shutdown(e);
+	a3d_vk_upload_shutdown(e);
+	/* runs the deferred destroys, which free into the allocator */
+	a3d_vk_sync_shutdown(e);
+	a3d_vk_memory_log_stats(e);
+	a3d_vk_memory_shutdown(e);
+
 #if A3D_VK_VALIDATION
 	a3d_vk_debug_shutdown(e);
 #endif
@@ -1283,6 +1368,7 @@ void a3d_vk_shutdown(a3d* e)
 }
 
 /* private */
+/* every slot has cycled through a newer swapchain since, so the presents from it have drained */
 static VkFormat choose_depth_fmt(a3d* e)
 {
 	VkFormat candidates[] = {
@@ -1347,15 +1433,104 @@ static VkSurfaceFormatKHR choose_surface_format( const VkSurfaceFormatKHR* fmts,
 	return fmts[0]; /* fallback */
 }
 
-static Uint32 find_memory_type(a3d* e, Uint32 type_filter, VkMemoryPropertyFlags properties)
+/* destroys the retired swapchains whose graphics value has been reached, without blocking */
+static void collect_retired_swapchains(a3d* e)
 {
-	VkPhysicalDeviceMemoryProperties mem_properties;
-	vkGetPhysicalDeviceMemoryProperties(e->vk.physical, &mem_properties);
+	if (!e->vk.retired_count)
+		return;
+
+	Uint64 done;
+	if (!a3d_vk_sync_poll(e, A3D_VK_QUEUE_GRAPHICS, &done))
+		return;
 
-	for (Uint32 i = 0; i < mem_properties.memoryTypeCount; i++) {
-		if ((type_filter & (1 << i)) && (mem_properties.memoryTypes[i].propertyFlags & properties) == properties)
-			return i;
+	/* oldest first with rising values, so the reached ones are always at the front */
+	Uint32 reached = 0;
+	while (reached < e->vk.retired_count && e->vk.retired_values[reached] <= done)
+		reached++;
+	destroy_retired_swapchains(e, reached);
+}
+
+static void cull_pass(a3d* e, VkCommandBuffer cmd, Uint32 frame, Uint32 image, void* data)
+{
+	(void)image;
+	(void)data;
+	a3d_vk_gpu_cull_dispatch(e, frame, cmd);
+}
+
+/* the oldest count of them */
+static void destroy_retired_swapchains(a3d* e, Uint32 count)
+{
+	for (Uint32 i = 0; i < count; i++) {
+		vkDestroySwapchainKHR(e->vk.logical, e->vk.retired_swapchains[i], NULL);
+		A3D_LOG_DEBUG("destroyed retired swapchain");
+	}
+	for (Uint32 i = count; i < e->vk.retired_count; i++) {
+		e->vk.retired_swapchains[i - count] = e->vk.retired_swapchains[i];
+		e->vk.retired_values[i - count] = e->vk.retired_values[i];
 	}
-	A3D_LOG_ERROR("failed to find suitable memory type");
-	return UINT32_MAX;
+	e->vk.retired_count -= count;
+}
+
+/*
+ * a frame that fails after acquiring leaves image_available signalled, and the slot's next acquire
+ * would signal it again. an empty batch consumes the signal, and the slot's wait covers it before
+ * the semaphore is reused. the image itself stays acquired, as nothing was rendered to present
+ */
+static void drop_acquire(a3d* e, a3d_vk_frame* frame)
+{
+	a3d_vk_submission submission = {
+		.binary_wait = frame->image_available,
+		.binary_wait_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT
+	};
+
+	a3d_vk_sync_point point;
+	if (!a3d_vk_sync_submit(e, A3D_VK_QUEUE_GRAPHICS, &submission, &point)) {
+		A3D_LOG_ERROR("failed to consume the acquire semaphore of an abandoned frame");
+		return;
+	}
+	frame->value = point.value;
+}
+
+static void main_pass(a3d* e, VkCommandBuffer cmd, Uint32 frame, Uint32 image, void* data)
+{
+	(void)image;
+	a3d_vk_frame_record* record = data;
+
+	if (e->vk.graph_gpu_cull)
+		a3d_vk_gpu_cull_draw(e, frame, cmd);
+	else if (record->secondary_count)
+		vkCmdExecuteCommands(cmd, record->secondary_count, record->secondaries);
+	else
+		a3d_vk_record_batches(e, frame, cmd, record->batches, record->batch_count);
+}
+
+static void readback_pass(a3d* e, VkCommandBuffer cmd, Uint32 frame, Uint32 image, void* data)
+{
+	(void)frame;
+	(void)data;
+	a3d_vk_headless_record_readback(e, image, cmd);
+}
+
+/* a resize every frame can outrun the graphics timeline, then the oldest is waited out to make room */
+static void retire_swapchain(a3d* e)
+{
+	if (!e->vk.swapchain)
+		return;
+
+	/* full: wait the oldest out, with an empty batch standing in if nothing was submitted since */
+	if (e->vk.retired_count == A3D_VK_MAX_RETIRED_SWAPCHAINS) {
+		a3d_vk_sync_point oldest = {A3D_VK_QUEUE_GRAPHICS, e->vk.retired_values[0]};
+		a3d_vk_submission empty = {0};
+		bool submitted = oldest.value <= a3d_vk_sync_last(e, A3D_VK_QUEUE_GRAPHICS).value ||
+			a3d_vk_sync_submit(e, A3D_VK_QUEUE_GRAPHICS, &empty, NULL);
+		if (!submitted || !a3d_vk_sync_wait(e, oldest))
+			A3D_LOG_WARN("failed to wait out the oldest retired swapchain, destroying it anyway");
+		destroy_retired_swapchains(e, 1);
+	}
+
+	/* presents queued up to now come before the next graphics submission finishes */
+	e->vk.retired_swapchains[e->vk.retired_count] = e->vk.swapchain;
+	e->vk.retired_values[e->vk.retired_count] = a3d_vk_sync_next(e, A3D_VK_QUEUE_GRAPHICS).value;
+	e->vk.retired_count++;
+	e->vk.swapchain = VK_NULL_HANDLE;
 }
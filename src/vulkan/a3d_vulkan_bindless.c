@@ -0,0 +1,315 @@
+#define A3D_LOG_SUBSYSTEM VULKAN
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <vulkan/vulkan.h>
+
+#include "a3d.h"
+#include "a3d_logging.h"
+#include "vulkan/a3d_vulkan_bindless.h"
+#include "vulkan/a3d_vulkan_buffer.h"
+#include "vulkan/a3d_vulkan_sync.h"
+
+static Uint32 alloc_slot(a3d* e, a3d_vk_bindless_type type);
+static void choose_capacities(a3d* e, Uint32* out_capacities);
+static Uint32 clamp_limit(Uint32 count, Uint32 per_stage, Uint32 per_set);
+static void release_slot(a3d* e, void* data);
+
+static const VkDescriptorType descriptor_types[A3D_VK_BINDLESS_TYPE_COUNT] = {
+	[A3D_VK_BINDLESS_SAMPLED_IMAGE] = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+	[A3D_VK_BINDLESS_STORAGE_BUFFER] = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+	[A3D_VK_BINDLESS_SAMPLER] = VK_DESCRIPTOR_TYPE_SAMPLER
+};
+
+static const char* const type_names[A3D_VK_BINDLESS_TYPE_COUNT] = {"sampled image", "storage buffer", "sampler"};
+
+/* the whole buffer; returns A3D_VK_BINDLESS_NONE if the array is full */
+Uint32 a3d_vk_bindless_add_buffer(a3d* e, const a3d_buffer* buff)
+{
+	Uint32 index = alloc_slot(e, A3D_VK_BINDLESS_STORAGE_BUFFER);
+	if (index == A3D_VK_BINDLESS_NONE)
+		return index;
+
+	VkDescriptorBufferInfo buffer_info = {
+		.buffer = buff->buff,
+		.offset = 0,
+		.range = VK_WHOLE_SIZE
+	};
+
+	VkWriteDescriptorSet write = {
+		.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+		.dstSet = e->vk.bindless->set,
+		.dstBinding = A3D_VK_BINDLESS_STORAGE_BUFFER,
+		.dstArrayElement = index,
+		.descriptorCount = 1,
+		.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		.pBufferInfo = &buffer_info
+	};
+
+	vkUpdateDescriptorSets(e->vk.logical, 1, &write, 0, NULL);
+	return index;
+}
+
+/* layout is what the image will be in whenever a shader samples it */
+Uint32 a3d_vk_bindless_add_image(a3d* e, VkImageView view, VkImageLayout layout)
+{
+	Uint32 index = alloc_slot(e, A3D_VK_BINDLESS_SAMPLED_IMAGE);
+	if (index == A3D_VK_BINDLESS_NONE)
+		return index;
+
+	VkDescriptorImageInfo image_info = {
+		.imageView = view,
+		.imageLayout = layout
+	};
+
+	VkWriteDescriptorSet write = {
+		.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+		.dstSet = e->vk.bindless->set,
+		.dstBinding = A3D_VK_BINDLESS_SAMPLED_IMAGE,
+		.dstArrayElement = index,
+		.descriptorCount = 1,
+		.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+		.pImageInfo = &image_info
+	};
+
+	vkUpdateDescriptorSets(e->vk.logical, 1, &write, 0, NULL);
+	return index;
+}
+
+Uint32 a3d_vk_bindless_add_sampler(a3d* e, VkSampler sampler)
+{
+	Uint32 index = alloc_slot(e, A3D_VK_BINDLESS_SAMPLER);
+	if (index == A3D_VK_BINDLESS_NONE)
+		return index;
+
+	VkDescriptorImageInfo image_info = {
+		.sampler = sampler
+	};
+
+	VkWriteDescriptorSet write = {
+		.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+		.dstSet = e->vk.bindless->set,
+		.dstBinding = A3D_VK_BINDLESS_SAMPLER,
+		.dstArrayElement = index,
+		.descriptorCount = 1,
+		.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER,
+		.pImageInfo = &image_info
+	};
+
+	vkUpdateDescriptorSets(e->vk.logical, 1, &write, 0, NULL);
+	return index;
+}
+
+/* frames already submitted may still index the slot, it is handed out again once they retire */
+void a3d_vk_bindless_free(a3d* e, a3d_vk_bindless_type type, Uint32 index)
+{
+	if (!e->vk.bindless || index == A3D_VK_BINDLESS_NONE)
+		return;
+
+	/* array and slot packed into the pointer, so nothing has to be allocated per free */
+	a3d_vk_sync_defer(e, release_slot, (void*)(uintptr_t)((Uint32)type << 24 | index));
+}
+
+bool a3d_vk_create_bindless(a3d* e)
+{
+	A3D_LOG_INFO("creating bindless descriptor set");
+
+	a3d_vk_bindless* b = calloc(1, sizeof *b);
+	if (!b) {
+		A3D_LOG_ERROR("failed to allocate bindless set");
+		return false;
+	}
+	e->vk.bindless = b;
+
+	Uint32 capacities[A3D_VK_BINDLESS_TYPE_COUNT];
+	choose_capacities(e, capacities);
+
+	for (Uint32 t = 0; t < A3D_VK_BINDLESS_TYPE_COUNT; t++) {
+		a3d_vk_bindless_array* array = &b->arrays[t];
+		array->capacity = capacities[t];
+		array->free = malloc(capacities[t] * sizeof *array->free);
+		if (!array->free) {
+			A3D_LOG_ERROR("failed to allocate %s slots", type_names[t]);
+			a3d_vk_destroy_bindless(e);
+			return false;
+		}
+	}
+
+	/* slots are written while the set is bound, and most of them are empty at any time */
+	VkDescriptorSetLayoutBinding bindings[A3D_VK_BINDLESS_TYPE_COUNT];
+	VkDescriptorBindingFlags binding_flags[A3D_VK_BINDLESS_TYPE_COUNT];
+	VkDescriptorPoolSize pool_sizes[A3D_VK_BINDLESS_TYPE_COUNT];
+	for (Uint32 t = 0; t < A3D_VK_BINDLESS_TYPE_COUNT; t++) {
+		bindings[t] = (VkDescriptorSetLayoutBinding){
+			.binding = t,
+			.descriptorType = descriptor_types[t],
+			.descriptorCount = capacities[t],
+			.stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS | VK_SHADER_STAGE_COMPUTE_BIT
+		};
+		binding_flags[t] = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+			VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT |
+			VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT;
+		pool_sizes[t] = (VkDescriptorPoolSize){
+			.type = descriptor_types[t],
+			.descriptorCount = capacities[t]
+		};
+	}
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfo flags_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+		.bindingCount = A3D_VK_BINDLESS_TYPE_COUNT,
+		.pBindingFlags = binding_flags
+	};
+
+	VkDescriptorSetLayoutCreateInfo layout_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.pNext = &flags_info,
+		.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT,
+		.bindingCount = A3D_VK_BINDLESS_TYPE_COUNT,
+		.pBindings = bindings
+	};
+
+	VkResult r = vkCreateDescriptorSetLayout(e->vk.logical, &layout_info, NULL, &b->layout);
+	if (r != VK_SUCCESS) {
+		A3D_LOG_ERROR("vkCreateDescriptorSetLayout failed with code %d", r);
+		a3d_vk_destroy_bindless(e);
+		return false;
+	}
+
+	VkDescriptorPoolCreateInfo pool_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT,
+		.maxSets = 1,
+		.poolSizeCount = A3D_VK_BINDLESS_TYPE_COUNT,
+		.pPoolSizes = pool_sizes
+	};
+
+	r = vkCreateDescriptorPool(e->vk.logical, &pool_info, NULL, &b->pool);
+	if (r != VK_SUCCESS) {
+		A3D_LOG_ERROR("vkCreateDescriptorPool failed with code %d", r);
+		a3d_vk_destroy_bindless(e);
+		return false;
+	}
+
+	VkDescriptorSetAllocateInfo allocate_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.descriptorPool = b->pool,
+		.descriptorSetCount = 1,
+		.pSetLayouts = &b->layout
+	};
+
+	r = vkAllocateDescriptorSets(e->vk.logical, &allocate_info, &b->set);
+	if (r != VK_SUCCESS) {
+		A3D_LOG_ERROR("vkAllocateDescriptorSets failed with code %d", r);
+		a3d_vk_destroy_bindless(e);
+		return false;
+	}
+
+	A3D_LOG_INFO(
+		"created bindless set with %u images, %u buffers and %u samplers",
+		capacities[A3D_VK_BINDLESS_SAMPLED_IMAGE], capacities[A3D_VK_BINDLESS_STORAGE_BUFFER],
+		capacities[A3D_VK_BINDLESS_SAMPLER]
+	);
+	return true;
+}
+
+void a3d_vk_destroy_bindless(a3d* e)
+{
+	a3d_vk_bindless* b = e->vk.bindless;
+	if (!b)
+		return;
+
+	for (Uint32 t = 0; t < A3D_VK_BINDLESS_TYPE_COUNT; t++) {
+		if (b->arrays[t].used)
+			A3D_LOG_DEBUG("%u %s slots still in use", b->arrays[t].used, type_names[t]);
+		free(b->arrays[t].free);
+	}
+
+	/* frees the set too */
+	if (b->pool)
+		vkDestroyDescriptorPool(e->vk.logical, b->pool, NULL);
+	if (b->layout)
+		vkDestroyDescriptorSetLayout(e->vk.logical, b->layout, NULL);
+
+	free(b);
+	e->vk.bindless = NULL;
+	A3D_LOG_INFO("destroyed bindless set");
+}
+
+/* private */
+static Uint32 alloc_slot(a3d* e, a3d_vk_bindless_type type)
+{
+	a3d_vk_bindless_array* array = &e->vk.bindless->arrays[type];
+
+	/* reuse first so the live indices stay packed at the bottom */
+	Uint32 index;
+	if (array->free_count)
+		index = array->free[--array->free_count];
+	else if (array->next < array->capacity)
+		index = array->next++;
+	else {
+		A3D_LOG_ERROR("all %u %s slots are in use", array->capacity, type_names[type]);
+		return A3D_VK_BINDLESS_NONE;
+	}
+
+	array->used++;
+	return index;
+}
+
+static Uint32 clamp_limit(Uint32 count, Uint32 per_stage, Uint32 per_set)
+{
+	if (count > per_stage)
+		count = per_stage;
+	return count < per_set ? count : per_set;
+}
+
+static void choose_capacities(a3d* e, Uint32* out_capacities)
+{
+	VkPhysicalDeviceVulkan12Properties props12 = {
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES
+	};
+	VkPhysicalDeviceProperties2 props = {
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+		.pNext = &props12
+	};
+	vkGetPhysicalDeviceProperties2(e->vk.physical, &props);
+
+	Uint32 images = clamp_limit(
+		A3D_VK_BINDLESS_IMAGES, props12.maxPerStageDescriptorUpdateAfterBindSampledImages,
+		props12.maxDescriptorSetUpdateAfterBindSampledImages
+	);
+	Uint32 buffers = clamp_limit(
+		A3D_VK_BINDLESS_BUFFERS, props12.maxPerStageDescriptorUpdateAfterBindStorageBuffers,
+		props12.maxDescriptorSetUpdateAfterBindStorageBuffers
+	);
+	Uint32 samplers = clamp_limit(
+		A3D_VK_BINDLESS_SAMPLERS, props12.maxPerStageDescriptorUpdateAfterBindSamplers,
+		props12.maxDescriptorSetUpdateAfterBindSamplers
+	);
+
+	/* images and buffers share one per stage budget, leave room for the per-frame set */
+	Uint32 resources = props12.maxPerStageUpdateAfterBindResources;
+	resources = resources > 16 ? resources - 16 : 0;
+	if (images + buffers > resources) {
+		images = resources / 2 < images ? resources / 2 : images;
+		buffers = resources - images < buffers ? resources - images : buffers;
+	}
+
+	out_capacities[A3D_VK_BINDLESS_SAMPLED_IMAGE] = images;
+	out_capacities[A3D_VK_BINDLESS_STORAGE_BUFFER] = buffers;
+	out_capacities[A3D_VK_BINDLESS_SAMPLER] = samplers;
+}
+
+/* runs once the frames that could still read the slot have retired */
+static void release_slot(a3d* e, void* data)
+{
+	/* the set may already be gone at shutdown */
+	a3d_vk_bindless* b = e->vk.bindless;
+	if (!b)
+		return;
+
+	Uint32 packed = (Uint32)(uintptr_t)data;
+	a3d_vk_bindless_array* array = &b->arrays[packed >> 24];
+	array->free[array->free_count++] = packed & 0xffffff;
+	array->used--;
+}
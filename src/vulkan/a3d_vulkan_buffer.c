@@ -1,3 +1,5 @@
+#define A3D_LOG_SUBSYSTEM VULKAN
+
 #include <string.h>
 #include <vulkan/vulkan.h>
 
@@ -5,14 +7,12 @@
 #include "a3d_logging.h"
 #include "vulkan/a3d_vulkan_buffer.h"
 
-static Uint32 find_memory_type(a3d* e, Uint32 type_filter, VkMemoryPropertyFlags properties);
-
 bool a3d_vk_create_buffer(
 	a3d* e, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags props,
 	a3d_buffer* out_buff, const void* initial_data
 )
 {
-	A3D_LOG_INFO("creating buffer of %lu bytes", (Uint64)size);
+	A3D_LOG_DEBUG("creating buffer of %" SDL_PRIu64 " bytes", (Uint64)size);
 
 	VkBufferCreateInfo buffer_info = {
 		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
@@ -21,6 +21,15 @@ bool a3d_vk_create_buffer(
 		.sharingMode = VK_SHARING_MODE_EXCLUSIVE
 	};
 
+	/* upload targets are written on the transfer queue and read on graphics,
+	 * concurrent sharing saves the ownership transfer barriers */
+	Uint32 families[] = {e->vk.graphics_family, e->vk.transfer_family};
+	if ((usage & VK_BUFFER_USAGE_TRANSFER_DST_BIT) && e->vk.transfer_family != e->vk.graphics_family) {
+		buffer_info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+		buffer_info.queueFamilyIndexCount = 2;
+		buffer_info.pQueueFamilyIndices = families;
+	}
+
 	VkResult result = vkCreateBuffer(e->vk.logical, &buffer_info, NULL, &out_buff->buff);
 	if (result != VK_SUCCESS) {
 		A3D_LOG_ERROR("vkCreateBuffer failed with code %d", result);
@@ -30,56 +39,37 @@ bool a3d_vk_create_buffer(
 	VkMemoryRequirements mem_requirements;
 	vkGetBufferMemoryRequirements(e->vk.logical, out_buff->buff, &mem_requirements);
 
-	/* check type index before passing */
-	Uint32 type_index = find_memory_type(e, mem_requirements.memoryTypeBits, props);
-	if (type_index == UINT32_MAX) {
-		A3D_LOG_ERROR("no suitable memory type for buffer");
+	out_buff->alloc = a3d_vk_memory_alloc(e, &mem_requirements, props);
+	if (!out_buff->alloc) {
+		A3D_LOG_ERROR("failed to allocate memory for buffer");
 		vkDestroyBuffer(e->vk.logical, out_buff->buff, NULL);
 		out_buff->buff = VK_NULL_HANDLE;
 		return false;
 	}
-	VkMemoryAllocateInfo allocate_info = {
-		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-		.allocationSize = mem_requirements.size,
-		.memoryTypeIndex = type_index
-	};
-	
-	result = vkAllocateMemory(e->vk.logical, &allocate_info, NULL, &out_buff->mem);
+	out_buff->offset = out_buff->alloc->offset;
+
+	result = vkBindBufferMemory(e->vk.logical, out_buff->buff, out_buff->alloc->memory, out_buff->offset);
 	if (result != VK_SUCCESS) {
-		A3D_LOG_ERROR("vkAllocateMemory failed with code %d", result);
+		A3D_LOG_ERROR("vkBindBufferMemory failed with code %d", result);
+		a3d_vk_memory_free(e, out_buff->alloc);
+		out_buff->alloc = NULL;
 		vkDestroyBuffer(e->vk.logical, out_buff->buff, NULL);
 		out_buff->buff = VK_NULL_HANDLE;
 		return false;
 	}
 
-	/* upload initial data */
+	/* upload initial data through the block's persistent mapping */
 	if (initial_data) {
-		void* data = NULL;
-		result = vkMapMemory(e->vk.logical, out_buff->mem, 0, size, 0, &data);
-		if (result != VK_SUCCESS) {
-			A3D_LOG_ERROR("vkMapMemory failed with code %d", result);
-			vkFreeMemory(e->vk.logical, out_buff->mem, NULL);
-			out_buff->mem = VK_NULL_HANDLE;
-			vkDestroyBuffer(e->vk.logical, out_buff->buff, NULL);
-			out_buff->buff = VK_NULL_HANDLE;
+		if (!out_buff->alloc->mapped) {
+			A3D_LOG_ERROR("initial data needs host visible memory");
+			a3d_vk_destroy_buffer(e, out_buff);
 			return false;
 		}
-		memcpy(data, initial_data, size);
-		vkUnmapMemory(e->vk.logical, out_buff->mem);
-	}
-
-	result = vkBindBufferMemory(e->vk.logical, out_buff->buff, out_buff->mem, 0);
-	if (result != VK_SUCCESS) {
-		A3D_LOG_ERROR("vkBindBufferMemory failed with code %d", result);
-		vkFreeMemory(e->vk.logical, out_buff->mem, NULL);
-		out_buff->mem = VK_NULL_HANDLE;
-		vkDestroyBuffer(e->vk.logical, out_buff->buff, NULL);
-		out_buff->buff = VK_NULL_HANDLE;
-		return false;
+		memcpy(out_buff->alloc->mapped, initial_data, size);
 	}
 
 	out_buff->size = size;
-	A3D_LOG_INFO("created buffer");
+	A3D_LOG_DEBUG("created buffer");
 
 	return true;
 }
@@ -91,24 +81,12 @@ void a3d_vk_destroy_buffer(a3d* e, a3d_buffer* buff)
 		buff->buff = VK_NULL_HANDLE;
 	}
 
-	if (buff->mem) {
-		vkFreeMemory(e->vk.logical, buff->mem, NULL);
-		buff->mem = VK_NULL_HANDLE;
+	if (buff->alloc) {
+		a3d_vk_memory_free(e, buff->alloc);
+		buff->alloc = NULL;
 	}
 
+	buff->offset = 0;
 	buff->size = 0;
-	A3D_LOG_INFO("destroyed buffer");
-}
-
-static Uint32 find_memory_type(a3d* e, Uint32 type_filter, VkMemoryPropertyFlags properties)
-{
-	VkPhysicalDeviceMemoryProperties mem_properties;
-	vkGetPhysicalDeviceMemoryProperties(e->vk.physical, &mem_properties);
-
-	for (Uint32 i = 0; i < mem_properties.memoryTypeCount; i++) {
-		if ((type_filter & (1 << i)) && (mem_properties.memoryTypes[i].propertyFlags & properties) == properties)
-			return i;
-	}
-	A3D_LOG_ERROR("failed to find suitable memory type");
-	return UINT32_MAX;
+	A3D_LOG_DEBUG("destroyed buffer");
 }
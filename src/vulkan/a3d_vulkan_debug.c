@@ -1,3 +1,5 @@
+#define A3D_LOG_SUBSYSTEM VULKAN
+
 #include <vulkan/vulkan.h>
 
 #include "vulkan/a3d_vulkan_debug.h"
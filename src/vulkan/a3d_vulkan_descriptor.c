@@ -0,0 +1,240 @@
+#define A3D_LOG_SUBSYSTEM VULKAN
+
+#include <stdlib.h>
+#include <string.h>
+#include <vulkan/vulkan.h>
+
+#include "a3d.h"
+#include "a3d_logging.h"
+#include "a3d_renderer.h"
+#include "vulkan/a3d_vulkan_bindless.h"
+#include "vulkan/a3d_vulkan_buffer.h"
+#include "vulkan/a3d_vulkan_descriptor.h"
+
+static bool create_models_buffer(a3d* e, a3d_vk_frame_data* frame, Uint32 capacity);
+static bool create_storage(a3d* e, VkDeviceSize size, a3d_buffer* out_buffer, Uint32* out_index);
+static void write_set(a3d* e, a3d_vk_frame_data* frame);
+
+bool a3d_vk_create_descriptors(a3d* e)
+{
+	A3D_LOG_INFO("creating descriptors");
+
+	a3d_vk_descriptors* d = calloc(1, sizeof *d);
+	if (!d) {
+		A3D_LOG_ERROR("failed to allocate descriptors");
+		return false;
+	}
+	e->vk.descriptors = d;
+
+	/* the model matrices are reached through the bindless set instead */
+	VkDescriptorSetLayoutBinding binding = {
+		.binding = 0,
+		.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+		.descriptorCount = 1,
+		.stageFlags = VK_SHADER_STAGE_VERTEX_BIT
+	};
+
+	VkDescriptorSetLayoutCreateInfo layout_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.bindingCount = 1,
+		.pBindings = &binding
+	};
+
+	VkResult r = vkCreateDescriptorSetLayout(e->vk.logical, &layout_info, NULL, &d->layout);
+	if (r != VK_SUCCESS) {
+		A3D_LOG_ERROR("vkCreateDescriptorSetLayout failed with code %d", r);
+		a3d_vk_destroy_descriptors(e);
+		return false;
+	}
+
+	VkDescriptorPoolSize pool_size = {
+		.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+		.descriptorCount = A3D_VK_FRAMES_IN_FLIGHT
+	};
+
+	VkDescriptorPoolCreateInfo pool_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.maxSets = A3D_VK_FRAMES_IN_FLIGHT,
+		.poolSizeCount = 1,
+		.pPoolSizes = &pool_size
+	};
+
+	r = vkCreateDescriptorPool(e->vk.logical, &pool_info, NULL, &d->pool);
+	if (r != VK_SUCCESS) {
+		A3D_LOG_ERROR("vkCreateDescriptorPool failed with code %d", r);
+		a3d_vk_destroy_descriptors(e);
+		return false;
+	}
+
+	VkDescriptorSetLayout layouts[A3D_VK_FRAMES_IN_FLIGHT];
+	VkDescriptorSet sets[A3D_VK_FRAMES_IN_FLIGHT];
+	for (Uint32 i = 0; i < A3D_VK_FRAMES_IN_FLIGHT; i++)
+		layouts[i] = d->layout;
+
+	VkDescriptorSetAllocateInfo allocate_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.descriptorPool = d->pool,
+		.descriptorSetCount = A3D_VK_FRAMES_IN_FLIGHT,
+		.pSetLayouts = layouts
+	};
+
+	r = vkAllocateDescriptorSets(e->vk.logical, &allocate_info, sets);
+	if (r != VK_SUCCESS) {
+		A3D_LOG_ERROR("vkAllocateDescriptorSets failed with code %d", r);
+		a3d_vk_destroy_descriptors(e);
+		return false;
+	}
+
+	/* host visible so the cpu writes them in place every frame */
+	for (Uint32 i = 0; i < A3D_VK_FRAMES_IN_FLIGHT; i++) {
+		a3d_vk_frame_data* frame = &d->frames[i];
+		frame->set = sets[i];
+		frame->models_index = A3D_VK_BINDLESS_NONE;
+		frame->normals_index = A3D_VK_BINDLESS_NONE;
+
+		bool ok = a3d_vk_create_buffer(
+			e, sizeof(a3d_camera), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&frame->camera, NULL
+		);
+		if (!ok || !create_models_buffer(e, frame, A3D_VK_MODELS_INITIAL_CAPACITY)) {
+			A3D_LOG_ERROR("failed to create frame %u buffers", i);
+			a3d_vk_destroy_descriptors(e);
+			return false;
+		}
+
+		write_set(e, frame);
+	}
+
+	A3D_LOG_INFO("created descriptors for %u frames", A3D_VK_FRAMES_IN_FLIGHT);
+	return true;
+}
+
+void a3d_vk_destroy_descriptors(a3d* e)
+{
+	a3d_vk_descriptors* d = e->vk.descriptors;
+	if (!d)
+		return;
+
+	for (Uint32 i = 0; i < A3D_VK_FRAMES_IN_FLIGHT; i++) {
+		a3d_vk_bindless_free(e, A3D_VK_BINDLESS_STORAGE_BUFFER, d->frames[i].models_index);
+		a3d_vk_bindless_free(e, A3D_VK_BINDLESS_STORAGE_BUFFER, d->frames[i].normals_index);
+		a3d_vk_destroy_buffer(e, &d->frames[i].camera);
+		a3d_vk_destroy_buffer(e, &d->frames[i].models);
+		a3d_vk_destroy_buffer(e, &d->frames[i].normals);
+	}
+
+	/* frees the sets too */
+	if (d->pool)
+		vkDestroyDescriptorPool(e->vk.logical, d->pool, NULL);
+	if (d->layout)
+		vkDestroyDescriptorSetLayout(e->vk.logical, d->layout, NULL);
+
+	free(d);
+	e->vk.descriptors = NULL;
+	A3D_LOG_INFO("destroyed descriptors");
+}
+
+bool a3d_vk_write_frame_data(a3d* e, Uint32 frame, const a3d_camera* camera, const a3d_draw_item* items, Uint32 count)
+{
+	a3d_vk_frame_data* data = &e->vk.descriptors->frames[frame];
+
+	/* the slot's last submit has retired, so its buffers and set are no longer read */
+	if (count > data->models_capacity) {
+		Uint32 capacity = data->models_capacity > A3D_VK_MODELS_INITIAL_CAPACITY ?
+			data->models_capacity : A3D_VK_MODELS_INITIAL_CAPACITY;
+		while (capacity < count)
+			capacity *= 2;
+
+		/* on failure the old buffer stays, this frame is dropped and the next one tries again */
+		if (!create_models_buffer(e, data, capacity)) {
+			A3D_LOG_ERROR("failed to grow model buffer to %u matrices", capacity);
+			return false;
+		}
+	}
+
+	memcpy(data->camera.alloc->mapped, camera, sizeof *camera);
+
+	/* the box scale folded into packed models would skew their normals, so those get their own */
+	mat4* models = data->models.alloc->mapped;
+	vec4 (*normals)[3] = data->normals.alloc->mapped;
+	for (Uint32 i = 0; i < count; i++) {
+		if (items[i].mesh->format == A3D_VERTEX_FORMAT_FLOAT) {
+			memcpy(models[i], items[i].model, sizeof(mat4));
+			continue;
+		}
+		a3d_mesh_shader_model(items[i].mesh, (vec4*)items[i].model, models[i]);
+		a3d_mesh_normal_matrix((vec4*)items[i].model, normals[i]);
+	}
+
+	return true;
+}
+
+/* private */
+/* the frame keeps its current buffers and slots unless all the replacements exist */
+static bool create_models_buffer(a3d* e, a3d_vk_frame_data* frame, Uint32 capacity)
+{
+	a3d_buffer models = {0};
+	a3d_buffer normals = {0};
+	Uint32 models_index;
+	Uint32 normals_index;
+
+	if (!create_storage(e, capacity * sizeof(mat4), &models, &models_index))
+		return false;
+	if (!create_storage(e, capacity * sizeof(vec4[3]), &normals, &normals_index)) {
+		a3d_vk_bindless_free(e, A3D_VK_BINDLESS_STORAGE_BUFFER, models_index);
+		a3d_vk_destroy_buffer(e, &models);
+		return false;
+	}
+
+	a3d_vk_bindless_free(e, A3D_VK_BINDLESS_STORAGE_BUFFER, frame->models_index);
+	a3d_vk_bindless_free(e, A3D_VK_BINDLESS_STORAGE_BUFFER, frame->normals_index);
+	a3d_vk_destroy_buffer(e, &frame->models);
+	a3d_vk_destroy_buffer(e, &frame->normals);
+	frame->models = models;
+	frame->normals = normals;
+	frame->models_index = models_index;
+	frame->normals_index = normals_index;
+	frame->models_capacity = capacity;
+	return true;
+}
+
+/* a fresh bindless slot every time, the old one may still be read by the other frames' draws */
+static bool create_storage(a3d* e, VkDeviceSize size, a3d_buffer* out_buffer, Uint32* out_index)
+{
+	bool ok = a3d_vk_create_buffer(
+		e, size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		out_buffer, NULL
+	);
+	if (!ok)
+		return false;
+
+	*out_index = a3d_vk_bindless_add_buffer(e, out_buffer);
+	if (*out_index == A3D_VK_BINDLESS_NONE) {
+		a3d_vk_destroy_buffer(e, out_buffer);
+		return false;
+	}
+
+	return true;
+}
+
+static void write_set(a3d* e, a3d_vk_frame_data* frame)
+{
+	VkDescriptorBufferInfo camera_info = {
+		.buffer = frame->camera.buff,
+		.offset = 0,
+		.range = sizeof(a3d_camera)
+	};
+
+	VkWriteDescriptorSet write = {
+		.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+		.dstSet = frame->set,
+		.dstBinding = 0,
+		.descriptorCount = 1,
+		.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+		.pBufferInfo = &camera_info
+	};
+
+	vkUpdateDescriptorSets(e->vk.logical, 1, &write, 0, NULL);
+}
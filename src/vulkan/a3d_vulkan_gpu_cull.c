@@ -0,0 +1,438 @@
+#define A3D_LOG_SUBSYSTEM VULKAN
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vulkan/vulkan.h>
+
+#include "a3d.h"
+#include "a3d_arena.h"
+#include "a3d_cull.h"
+#include "a3d_logging.h"
+#include "a3d_mesh.h"
+#include "a3d_renderer.h"
+#include "vulkan/a3d_vulkan_bindless.h"
+#include "vulkan/a3d_vulkan_buffer.h"
+#include "vulkan/a3d_vulkan_descriptor.h"
+#include "vulkan/a3d_vulkan_gpu_cull.h"
+#include "vulkan/a3d_vulkan_pipeline.h"
+
+#define A3D_SHADER_CULL_PATH "shaders/cull.comp.spv"
+
+static bool create_batch_buffers(a3d* e, a3d_vk_cull_frame* frame, Uint32 capacity);
+static bool create_item_buffers(a3d* e, a3d_vk_cull_frame* frame, Uint32 capacity);
+static void write_set(a3d* e, a3d_vk_cull_frame* frame, VkBuffer models);
+
+bool a3d_vk_create_gpu_cull(a3d* e)
+{
+	A3D_LOG_INFO("creating gpu culling");
+
+	a3d_vk_gpu_cull* c = calloc(1, sizeof *c);
+	if (!c) {
+		A3D_LOG_ERROR("failed to allocate gpu culling");
+		return false;
+	}
+	e->vk.gpu_cull = c;
+
+	VkDescriptorSetLayoutBinding bindings[5] = {
+		{.binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER},
+		{.binding = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER},
+		{.binding = 2, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER},
+		{.binding = 3, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER},
+		{.binding = 4, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER}
+	};
+	for (Uint32 i = 0; i < 5; i++) {
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo layout_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.bindingCount = 5,
+		.pBindings = bindings
+	};
+
+	VkResult r = vkCreateDescriptorSetLayout(e->vk.logical, &layout_info, NULL, &c->layout);
+	if (r != VK_SUCCESS) {
+		A3D_LOG_ERROR("vkCreateDescriptorSetLayout failed with code %d", r);
+		a3d_vk_destroy_gpu_cull(e);
+		return false;
+	}
+
+	VkDescriptorPoolSize pool_sizes[2] = {
+		{.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, .descriptorCount = A3D_VK_FRAMES_IN_FLIGHT},
+		{.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 4 * A3D_VK_FRAMES_IN_FLIGHT}
+	};
+
+	VkDescriptorPoolCreateInfo pool_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.maxSets = A3D_VK_FRAMES_IN_FLIGHT,
+		.poolSizeCount = 2,
+		.pPoolSizes = pool_sizes
+	};
+
+	r = vkCreateDescriptorPool(e->vk.logical, &pool_info, NULL, &c->pool);
+	if (r != VK_SUCCESS) {
+		A3D_LOG_ERROR("vkCreateDescriptorPool failed with code %d", r);
+		a3d_vk_destroy_gpu_cull(e);
+		return false;
+	}
+
+	VkDescriptorSetLayout layouts[A3D_VK_FRAMES_IN_FLIGHT];
+	VkDescriptorSet sets[A3D_VK_FRAMES_IN_FLIGHT];
+	for (Uint32 i = 0; i < A3D_VK_FRAMES_IN_FLIGHT; i++)
+		layouts[i] = c->layout;
+
+	VkDescriptorSetAllocateInfo allocate_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.descriptorPool = c->pool,
+		.descriptorSetCount = A3D_VK_FRAMES_IN_FLIGHT,
+		.pSetLayouts = layouts
+	};
+
+	r = vkAllocateDescriptorSets(e->vk.logical, &allocate_info, sets);
+	if (r != VK_SUCCESS) {
+		A3D_LOG_ERROR("vkAllocateDescriptorSets failed with code %d", r);
+		a3d_vk_destroy_gpu_cull(e);
+		return false;
+	}
+
+	VkPipelineLayoutCreateInfo pipeline_layout_info = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.setLayoutCount = 1,
+		.pSetLayouts = &c->layout
+	};
+
+	r = vkCreatePipelineLayout(e->vk.logical, &pipeline_layout_info, NULL, &c->pipeline_layout);
+	if (r != VK_SUCCESS) {
+		A3D_LOG_ERROR("vkCreatePipelineLayout failed with code %d", r);
+		a3d_vk_destroy_gpu_cull(e);
+		return false;
+	}
+
+	if (!a3d_vk_create_compute_pipeline(e, A3D_SHADER_CULL_PATH, c->pipeline_layout, &c->pipeline)) {
+		A3D_LOG_ERROR("failed to create cull pipeline");
+		a3d_vk_destroy_gpu_cull(e);
+		return false;
+	}
+
+	for (Uint32 i = 0; i < A3D_VK_FRAMES_IN_FLIGHT; i++) {
+		a3d_vk_cull_frame* frame = &c->frames[i];
+		frame->set = sets[i];
+		frame->instances_index = A3D_VK_BINDLESS_NONE;
+
+		bool ok = a3d_vk_create_buffer(
+			e, sizeof(a3d_vk_cull_params), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&frame->params, NULL
+		);
+		if (!ok || !create_item_buffers(e, frame, A3D_VK_CULL_INITIAL_CAPACITY) ||
+		    !create_batch_buffers(e, frame, A3D_VK_CULL_INITIAL_BATCHES)) {
+			A3D_LOG_ERROR("failed to create frame %u cull buffers", i);
+			a3d_vk_destroy_gpu_cull(e);
+			return false;
+		}
+
+		write_set(e, frame, e->vk.descriptors->frames[i].models.buff);
+	}
+
+	A3D_LOG_INFO("created gpu culling for %u frames", A3D_VK_FRAMES_IN_FLIGHT);
+	return true;
+}
+
+void a3d_vk_destroy_gpu_cull(a3d* e)
+{
+	a3d_vk_gpu_cull* c = e->vk.gpu_cull;
+	if (!c)
+		return;
+
+	for (Uint32 i = 0; i < A3D_VK_FRAMES_IN_FLIGHT; i++) {
+		a3d_vk_destroy_buffer(e, &c->frames[i].params);
+		a3d_vk_bindless_free(e, A3D_VK_BINDLESS_STORAGE_BUFFER, c->frames[i].instances_index);
+		a3d_vk_destroy_buffer(e, &c->frames[i].objects);
+		a3d_vk_destroy_buffer(e, &c->frames[i].instances);
+		a3d_vk_destroy_buffer(e, &c->frames[i].templates);
+		a3d_vk_destroy_buffer(e, &c->frames[i].commands);
+	}
+
+	if (c->pipeline)
+		vkDestroyPipeline(e->vk.logical, c->pipeline, NULL);
+	if (c->pipeline_layout)
+		vkDestroyPipelineLayout(e->vk.logical, c->pipeline_layout, NULL);
+
+	/* frees the sets too */
+	if (c->pool)
+		vkDestroyDescriptorPool(e->vk.logical, c->pool, NULL);
+	if (c->layout)
+		vkDestroyDescriptorSetLayout(e->vk.logical, c->layout, NULL);
+
+	free(c);
+	e->vk.gpu_cull = NULL;
+	A3D_LOG_INFO("destroyed gpu culling");
+}
+
+/* the frame graph's cull pass: reset the commands, then cull and compact; the graph orders it before the draws */
+void a3d_vk_gpu_cull_dispatch(a3d* e, Uint32 frame, VkCommandBuffer cmd)
+{
+	a3d_vk_gpu_cull* c = e->vk.gpu_cull;
+	a3d_vk_cull_frame* data = &c->frames[frame];
+	if (data->item_count == 0)
+		return;
+
+	VkBufferCopy region = {
+		.size = data->batch_count * sizeof(VkDrawIndexedIndirectCommand)
+	};
+	vkCmdCopyBuffer(cmd, data->templates.buff, data->commands.buff, 1, &region);
+
+	VkMemoryBarrier cleared = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+	};
+	vkCmdPipelineBarrier(
+		cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0, 1, &cleared, 0, NULL, 0, NULL
+	);
+
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, c->pipeline);
+	vkCmdBindDescriptorSets(
+		cmd, VK_PIPELINE_BIND_POINT_COMPUTE, c->pipeline_layout,
+		0, 1, &data->set, 0, NULL
+	);
+	vkCmdDispatch(cmd, (data->item_count + A3D_VK_CULL_WORKGROUP - 1) / A3D_VK_CULL_WORKGROUP, 1, 1);
+}
+
+/* inside the render pass: one multi draw per vertex/index buffer pair, a command per batch */
+void a3d_vk_gpu_cull_draw(a3d* e, Uint32 frame, VkCommandBuffer cmd)
+{
+	a3d_vk_cull_frame* data = &e->vk.gpu_cull->frames[frame];
+	if (data->item_count == 0)
+		return;
+
+	/* a group shares buffers, so it shares a vertex format too */
+	VkPipeline bound_pipeline = VK_NULL_HANDLE;
+	for (Uint32 g = 0; g < data->group_count; g++) {
+		const a3d_draw_batch* group = &data->groups[g];
+		if (bound_pipeline != e->vk.pipelines[group->mesh->format]) {
+			a3d_vk_bind_graphics_pipeline(e, frame, cmd, group->mesh->format);
+			bound_pipeline = e->vk.pipelines[group->mesh->format];
+
+			/* instances go through the compacted item indices instead of straight to the models */
+			vkCmdPushConstants(
+				cmd, e->vk.pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+				offsetof(a3d_vk_draw_constants, instances), sizeof(Uint32), &data->instances_index
+			);
+		}
+
+		/* batches nothing survived in draw with no instances */
+		a3d_bind_mesh(e, group->mesh, &cmd);
+		vkCmdDrawIndexedIndirect(
+			cmd, data->commands.buff, group->first * sizeof(VkDrawIndexedIndirectCommand),
+			group->count, sizeof(VkDrawIndexedIndirectCommand)
+		);
+	}
+}
+
+bool a3d_vk_gpu_cull_prepare(
+	a3d* e, Uint32 frame, const a3d_camera* camera, const a3d_draw_batch* batches, Uint32 batch_count
+)
+{
+	a3d_vk_cull_frame* data = &e->vk.gpu_cull->frames[frame];
+
+	Uint32 item_count = 0;
+	for (Uint32 j = 0; j < batch_count; j++)
+		item_count += batches[j].count;
+
+	data->item_count = 0;
+	data->batch_count = 0;
+	data->group_count = 0;
+	if (item_count == 0)
+		return true;
+
+	a3d_draw_batch* groups = a3d_arena_alloc(
+		a3d_renderer_frame_arena(e->renderer), batch_count * sizeof *groups, A3D_ALIGNOF(a3d_draw_batch)
+	);
+	if (!groups) {
+		A3D_LOG_ERROR("out of frame memory grouping %u batches", batch_count);
+		return false;
+	}
+
+	/* batches sharing buffers are adjacent, so each group is a contiguous command range */
+	Uint32 group_count = 0;
+	for (Uint32 j = 0; j < batch_count; j++) {
+		const a3d_mesh* mesh = batches[j].mesh;
+		a3d_draw_batch* group = group_count ? &groups[group_count - 1] : NULL;
+		if (group && group->mesh->vertex_buffer.buff == mesh->vertex_buffer.buff &&
+		    group->mesh->index_buffer.buff == mesh->index_buffer.buff) {
+			group->count++;
+			continue;
+		}
+
+		groups[group_count++] = (a3d_draw_batch){
+			.mesh = mesh,
+			.first = j,
+			.count = 1
+		};
+	}
+
+	/* the slot's last submit has retired, so its buffers and set are no longer read */
+	bool rewrite = false;
+	if (item_count > data->capacity) {
+		Uint32 capacity = data->capacity;
+		while (capacity < item_count)
+			capacity *= 2;
+
+		if (!create_item_buffers(e, data, capacity)) {
+			A3D_LOG_ERROR("failed to grow cull buffers to %u items", capacity);
+			return false;
+		}
+		rewrite = true;
+	}
+
+	if (batch_count > data->batch_capacity) {
+		Uint32 capacity = data->batch_capacity;
+		while (capacity < batch_count)
+			capacity *= 2;
+
+		a3d_vk_destroy_buffer(e, &data->templates);
+		a3d_vk_destroy_buffer(e, &data->commands);
+		if (!create_batch_buffers(e, data, capacity)) {
+			A3D_LOG_ERROR("failed to grow cull command buffers to %u batches", capacity);
+			return false;
+		}
+		rewrite = true;
+	}
+
+	/* the model buffer may have grown underneath us */
+	VkBuffer models = e->vk.descriptors->frames[frame].models.buff;
+	if (rewrite || data->models != models)
+		write_set(e, data, models);
+
+	a3d_vk_cull_params* params = data->params.alloc->mapped;
+	a3d_frustum frustum;
+	a3d_frustum_from_matrix(&frustum, (vec4*)camera->view_proj);
+	memcpy(params->planes, frustum.planes, sizeof params->planes);
+	params->count = item_count;
+
+	/* every item of a batch shares its mesh and command, only the model matrix differs */
+	a3d_vk_cull_object* objects = data->objects.alloc->mapped;
+	VkDrawIndexedIndirectCommand* templates = data->templates.alloc->mapped;
+	for (Uint32 j = 0; j < batch_count; j++) {
+		const a3d_mesh* mesh = batches[j].mesh;
+		templates[j] = (VkDrawIndexedIndirectCommand){
+			.indexCount = mesh->index_count,
+			.instanceCount = 0,
+			.firstIndex = mesh->first_index,
+			.vertexOffset = mesh->vertex_offset,
+			.firstInstance = batches[j].first
+		};
+
+		/* the model matrices carry the packed dequantisation, so packed boxes are the snorm cube */
+		bool packed = mesh->format == A3D_VERTEX_FORMAT_PACKED;
+		a3d_vk_cull_object object = {
+			.aabb_min = {
+				packed ? -1.0f : mesh->aabb_min[0], packed ? -1.0f : mesh->aabb_min[1],
+				packed ? -1.0f : mesh->aabb_min[2], 1.0f
+			},
+			.aabb_max = {
+				packed ? 1.0f : mesh->aabb_max[0], packed ? 1.0f : mesh->aabb_max[1],
+				packed ? 1.0f : mesh->aabb_max[2], 1.0f
+			},
+			.batch = j,
+			.base = batches[j].first
+		};
+
+		for (Uint32 i = batches[j].first; i < batches[j].first + batches[j].count; i++)
+			objects[i] = object;
+	}
+
+	data->item_count = item_count;
+	data->batch_count = batch_count;
+	data->groups = groups;
+	data->group_count = group_count;
+	return true;
+}
+
+/* private */
+static bool create_batch_buffers(a3d* e, a3d_vk_cull_frame* frame, Uint32 capacity)
+{
+	bool ok = a3d_vk_create_buffer(
+		e, capacity * sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&frame->templates, NULL
+	);
+	if (ok) {
+		ok = a3d_vk_create_buffer(
+			e, capacity * sizeof(VkDrawIndexedIndirectCommand),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &frame->commands, NULL
+		);
+		if (!ok)
+			a3d_vk_destroy_buffer(e, &frame->templates);
+	}
+
+	frame->batch_capacity = ok ? capacity : 0;
+	return ok;
+}
+
+/* the frame keeps its current buffers and instance slot unless all the replacements exist */
+static bool create_item_buffers(a3d* e, a3d_vk_cull_frame* frame, Uint32 capacity)
+{
+	a3d_buffer objects = {0};
+	a3d_buffer instances = {0};
+
+	bool ok = a3d_vk_create_buffer(
+		e, capacity * sizeof(a3d_vk_cull_object), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&objects, NULL
+	);
+	if (!ok)
+		return false;
+
+	ok = a3d_vk_create_buffer(
+		e, capacity * sizeof(Uint32), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &instances, NULL
+	);
+	Uint32 instances_index = ok ? a3d_vk_bindless_add_buffer(e, &instances) : A3D_VK_BINDLESS_NONE;
+	if (instances_index == A3D_VK_BINDLESS_NONE) {
+		a3d_vk_destroy_buffer(e, &instances);
+		a3d_vk_destroy_buffer(e, &objects);
+		return false;
+	}
+
+	/* a fresh slot, the old one may still be read by the other frames' draws */
+	a3d_vk_bindless_free(e, A3D_VK_BINDLESS_STORAGE_BUFFER, frame->instances_index);
+	a3d_vk_destroy_buffer(e, &frame->objects);
+	a3d_vk_destroy_buffer(e, &frame->instances);
+	frame->objects = objects;
+	frame->instances = instances;
+	frame->instances_index = instances_index;
+	frame->capacity = capacity;
+	return true;
+}
+
+static void write_set(a3d* e, a3d_vk_cull_frame* frame, VkBuffer models)
+{
+	VkDescriptorBufferInfo infos[5] = {
+		{.buffer = frame->params.buff, .offset = 0, .range = sizeof(a3d_vk_cull_params)},
+		{.buffer = models, .offset = 0, .range = VK_WHOLE_SIZE},
+		{.buffer = frame->objects.buff, .offset = 0, .range = VK_WHOLE_SIZE},
+		{.buffer = frame->commands.buff, .offset = 0, .range = VK_WHOLE_SIZE},
+		{.buffer = frame->instances.buff, .offset = 0, .range = VK_WHOLE_SIZE}
+	};
+
+	VkWriteDescriptorSet writes[5];
+	for (Uint32 i = 0; i < 5; i++) {
+		writes[i] = (VkWriteDescriptorSet){
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = frame->set,
+			.dstBinding = i,
+			.descriptorCount = 1,
+			.descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.pBufferInfo = &infos[i]
+		};
+	}
+
+	vkUpdateDescriptorSets(e->vk.logical, 5, writes, 0, NULL);
+	frame->models = models;
+}
@@ -0,0 +1,1147 @@
+#define A3D_LOG_SUBSYSTEM VULKAN
+
+#include <string.h>
+#include <vulkan/vulkan.h>
+
+#include "a3d.h"
+#include "a3d_logging.h"
+#include "vulkan/a3d_vulkan_graph.h"
+#include "vulkan/a3d_vulkan_memory.h"
+#include "vulkan/a3d_vulkan_profiler.h"
+
+#define WRITE_ACCESS ( \
+	VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | \
+	VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT \
+)
+
+/* stages of 0 stand for the pass's shader stages */
+static const struct {
+	VkPipelineStageFlags stages;
+	VkAccessFlags access;
+	VkImageLayout layout;
+	VkImageUsageFlags image_usage;
+	bool     write;
+	bool     attachment;
+} usages[A3D_VK_GRAPH_USAGE_COUNT] = {
+	[A3D_VK_GRAPH_COLOUR] = {
+		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+		VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+		VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, true, true
+	},
+	[A3D_VK_GRAPH_DEPTH] = {
+		VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+		VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+		VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, true, true
+	},
+	[A3D_VK_GRAPH_SAMPLED] = {
+		0, VK_ACCESS_SHADER_READ_BIT,
+		VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT, false, false
+	},
+	[A3D_VK_GRAPH_STORAGE_READ] = {
+		0, VK_ACCESS_SHADER_READ_BIT,
+		VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, false, false
+	},
+	[A3D_VK_GRAPH_STORAGE_WRITE] = {
+		0, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+		VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, true, false
+	},
+	[A3D_VK_GRAPH_INDIRECT] = {
+		VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+		VK_IMAGE_LAYOUT_UNDEFINED, 0, false, false
+	},
+	[A3D_VK_GRAPH_TRANSFER_SRC] = {
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+		VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT, false, false
+	},
+	[A3D_VK_GRAPH_TRANSFER_DST] = {
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT, true, false
+	}
+};
+
+static Uint32 add_resource(a3d_vk_graph* g, const char* name);
+static VkImageAspectFlags aspect_of(VkFormat format);
+static void begin_rendering(const a3d_vk_graph* g, const a3d_vk_graph_pass* p, VkCommandBuffer cmd, Uint32 image);
+static bool collect_attachments(a3d_vk_graph* g, a3d_vk_graph_pass* p);
+static bool create_render_pass(a3d* e, a3d_vk_graph* g, a3d_vk_graph_pass* p);
+static void cull(a3d_vk_graph* g);
+static bool hazard(
+	const a3d_vk_graph_state* s, VkPipelineStageFlags stages, VkAccessFlags access, VkImageLayout layout,
+	bool write, VkPipelineStageFlags* out_src, VkAccessFlags* out_src_access
+);
+static bool place_transients(a3d* e, a3d_vk_graph* g);
+static void record_barrier(const a3d_vk_graph* g, const a3d_vk_graph_barrier* b, VkCommandBuffer cmd, Uint32 image);
+static void release(a3d* e, a3d_vk_graph* g);
+static bool simulate(a3d_vk_graph* g, bool record, a3d_vk_graph_state* out_final);
+static VkPipelineStageFlags stages_of(const a3d_vk_graph_pass* p, a3d_vk_graph_usage usage);
+static void update(a3d_vk_graph_state* s, VkPipelineStageFlags stages, VkAccessFlags access, VkImageLayout layout, bool write, bool barrier);
+
+Uint32 a3d_vk_graph_add_pass(a3d_vk_graph* g, const char* name, a3d_vk_graph_pass_type type, a3d_vk_graph_fn fn)
+{
+	if (g->pass_count == A3D_VK_GRAPH_MAX_PASSES) {
+		A3D_LOG_ERROR("frame graph is out of passes adding %s", name);
+		g->invalid = true;
+		return UINT32_MAX;
+	}
+
+	Uint32 index = g->pass_count++;
+	g->passes[index] = (a3d_vk_graph_pass){
+		.name = name,
+		.type = type,
+		.fn = fn
+	};
+	return index;
+}
+
+/* only the value may change once compiled, e.g. every frame for the clear colour */
+void a3d_vk_graph_clear(a3d_vk_graph* g, Uint32 pass, Uint32 resource, VkClearValue value)
+{
+	if (pass >= g->pass_count)
+		return;
+
+	a3d_vk_graph_pass* p = &g->passes[pass];
+	for (Uint32 i = 0; i < p->access_count; i++) {
+		a3d_vk_graph_access* a = &p->accesses[i];
+		if (a->resource == resource && usages[a->usage].attachment) {
+			if (!a->clear && g->compiled) {
+				A3D_LOG_ERROR("%s can't start clearing %s after compile", p->name, g->resources[resource].name);
+				return;
+			}
+			a->clear = true;
+			a->clear_value = value;
+			return;
+		}
+	}
+
+	A3D_LOG_ERROR("%s clears %s without using it as an attachment", p->name, resource < g->resource_count ? g->resources[resource].name : "?");
+	g->invalid = true;
+}
+
+bool a3d_vk_graph_compile(a3d* e, a3d_vk_graph* g)
+{
+	if (g->invalid) {
+		A3D_LOG_ERROR("frame graph has declaration errors, not compiling");
+		return false;
+	}
+	release(e, g);
+	g->dynamic = e->vk.dynamic_rendering;
+
+	cull(g);
+
+	/* lifetimes in pass order, only live passes count */
+	for (Uint32 r = 0; r < g->resource_count; r++) {
+		g->resources[r].first_use = UINT32_MAX;
+		g->resources[r].last_use = 0;
+	}
+	for (Uint32 i = 0; i < g->pass_count; i++) {
+		a3d_vk_graph_pass* p = &g->passes[i];
+		if (!p->live)
+			continue;
+
+		for (Uint32 j = 0; j < p->access_count; j++) {
+			a3d_vk_graph_resource* res = &g->resources[p->accesses[j].resource];
+			if (res->first_use == UINT32_MAX)
+				res->first_use = i;
+			res->last_use = i;
+			res->usage |= usages[p->accesses[j].usage].image_usage;
+		}
+	}
+
+	if (!place_transients(e, g)) {
+		release(e, g);
+		return false;
+	}
+
+	/* a dry run finds where every resource ends the frame, which is where transients start the next one */
+	a3d_vk_graph_state final[A3D_VK_GRAPH_MAX_RESOURCES];
+	if (!simulate(g, false, final)) {
+		release(e, g);
+		return false;
+	}
+
+	for (Uint32 r = 0; r < g->resource_count; r++) {
+		a3d_vk_graph_resource* res = &g->resources[r];
+		if (res->imported || res->first_use == UINT32_MAX)
+			continue;
+
+		/* the previous tenant of the memory, this frame or, for the first one, the last of the frame before */
+		Uint32 prev = r;
+		Uint32 last = r;
+		for (Uint32 o = 0; o < g->resource_count; o++) {
+			const a3d_vk_graph_resource* other = &g->resources[o];
+			if (o == r || other->imported || other->first_use == UINT32_MAX || other->slot != res->slot)
+				continue;
+			if (other->first_use < res->first_use && (prev == r || other->first_use > g->resources[prev].first_use))
+				prev = o;
+			if (other->first_use > g->resources[last].first_use)
+				last = o;
+		}
+		if (prev == r)
+			prev = last;
+
+		res->initial = (a3d_vk_graph_state){
+			.layout = VK_IMAGE_LAYOUT_UNDEFINED,
+			.write_stages = final[prev].write_stages | final[prev].read_stages,
+			.write_access = final[prev].write_access
+		};
+	}
+
+	if (!simulate(g, true, final)) {
+		release(e, g);
+		return false;
+	}
+
+	Uint32 live = 0;
+	for (Uint32 i = 0; i < g->pass_count; i++) {
+		a3d_vk_graph_pass* p = &g->passes[i];
+		if (!p->live)
+			continue;
+		live++;
+
+		if (p->type != A3D_VK_GRAPH_RASTER)
+			continue;
+		if (!collect_attachments(g, p) || (!g->dynamic && !create_render_pass(e, g, p))) {
+			release(e, g);
+			return false;
+		}
+	}
+
+	g->barrier_count = 0;
+	for (Uint32 i = 0; i < g->pass_count; i++) {
+		const a3d_vk_graph_barrier* b = &g->passes[i].barrier;
+		if (g->passes[i].live && (b->src_stages || b->dst_stages || b->image_count))
+			g->barrier_count++;
+	}
+	if (g->tail.src_stages || g->tail.image_count)
+		g->barrier_count++;
+
+	g->compiled = true;
+	A3D_LOG_INFO(
+		"compiled frame graph: %u of %u passes, %u barriers, %lu KiB transient (%lu KiB without aliasing)%s",
+		live, g->pass_count, g->barrier_count,
+		(unsigned long)(g->transient_size / 1024), (unsigned long)(g->unaliased_size / 1024),
+		g->dynamic ? ", dynamic rendering" : ""
+	);
+	return true;
+}
+
+/* zero extent follows the swapchain, resolved at compile */
+Uint32 a3d_vk_graph_create_image(a3d_vk_graph* g, const char* name, VkFormat format, Uint32 width, Uint32 height)
+{
+	Uint32 index = add_resource(g, name);
+	if (index == UINT32_MAX)
+		return index;
+
+	a3d_vk_graph_resource* res = &g->resources[index];
+	res->is_image = true;
+	res->format = format;
+	res->extent = (VkExtent2D){width, height};
+	res->aspect = aspect_of(format);
+	res->image_count = 1;
+	return index;
+}
+
+/* leaves the graph empty, ready to be declared again */
+void a3d_vk_graph_destroy(a3d* e, a3d_vk_graph* g)
+{
+	release(e, g);
+	memset(g, 0, sizeof *g);
+}
+
+bool a3d_vk_graph_execute(a3d* e, a3d_vk_graph* g, VkCommandBuffer cmd, Uint32 frame, Uint32 image, void* data)
+{
+	if (!g->compiled) {
+		A3D_LOG_ERROR("executing a frame graph that isn't compiled");
+		return false;
+	}
+
+	for (Uint32 i = 0; i < g->pass_count; i++) {
+		a3d_vk_graph_pass* p = &g->passes[i];
+		if (!p->live)
+			continue;
+
+		/* timestamps can't go inside a pass recorded from secondaries, so they bracket the whole pass */
+		Uint32 scope = a3d_vk_profiler_scope_begin(e, frame, cmd, p->name);
+		record_barrier(g, &p->barrier, cmd, image);
+
+		if (p->type != A3D_VK_GRAPH_RASTER) {
+			p->fn(e, cmd, frame, image, data);
+			a3d_vk_profiler_scope_end(e, frame, cmd, scope);
+			continue;
+		}
+
+		if (g->dynamic) {
+			begin_rendering(g, p, cmd, image);
+			p->fn(e, cmd, frame, image, data);
+			vkCmdEndRendering(cmd);
+			a3d_vk_profiler_scope_end(e, frame, cmd, scope);
+			continue;
+		}
+
+		/* in attachment order, like the render pass */
+		VkClearValue clears[A3D_VK_GRAPH_MAX_ACCESSES];
+		Uint32 clear_count = 0;
+		for (Uint32 j = 0; j < p->access_count; j++)
+			if (usages[p->accesses[j].usage].attachment)
+				clears[clear_count++] = p->accesses[j].clear_value;
+
+		VkRenderPassBeginInfo begin_info = {
+			.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+			.renderPass = p->render_pass,
+			.framebuffer = p->fbs[image % p->fb_count],
+			.renderArea = {
+				.offset = {0, 0},
+				.extent = p->extent
+			},
+			.clearValueCount = clear_count,
+			.pClearValues = clears
+		};
+
+		vkCmdBeginRenderPass(
+			cmd, &begin_info,
+			p->secondary ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE
+		);
+		p->fn(e, cmd, frame, image, data);
+		vkCmdEndRenderPass(cmd);
+		a3d_vk_profiler_scope_end(e, frame, cmd, scope);
+	}
+
+	record_barrier(g, &g->tail, cmd, image);
+	return true;
+}
+
+VkFramebuffer a3d_vk_graph_framebuffer(const a3d_vk_graph* g, Uint32 pass, Uint32 image)
+{
+	if (pass >= g->pass_count || !g->passes[pass].fb_count)
+		return VK_NULL_HANDLE;
+
+	const a3d_vk_graph_pass* p = &g->passes[pass];
+	return p->fbs[image % p->fb_count];
+}
+
+/* ready_stages is where whatever wrote it outside the graph finished, 0 if a cpu wait already covers it */
+Uint32 a3d_vk_graph_import_buffer(a3d_vk_graph* g, const char* name, VkPipelineStageFlags ready_stages)
+{
+	Uint32 index = add_resource(g, name);
+	if (index == UINT32_MAX)
+		return index;
+
+	a3d_vk_graph_resource* res = &g->resources[index];
+	res->imported = true;
+	res->initial.write_stages = ready_stages;
+	return index;
+}
+
+/* several images rotate behind one resource, picked by the image index passed to execute */
+Uint32 a3d_vk_graph_import_image(
+	a3d_vk_graph* g, const char* name, VkFormat format, VkExtent2D extent,
+	const VkImage* images, const VkImageView* views, Uint32 count,
+	VkPipelineStageFlags ready_stages, VkImageLayout final_layout
+)
+{
+	if (count == 0 || count > A3D_VK_GRAPH_MAX_IMAGES) {
+		A3D_LOG_ERROR("can't import %u images as %s", count, name);
+		g->invalid = true;
+		return UINT32_MAX;
+	}
+
+	Uint32 index = add_resource(g, name);
+	if (index == UINT32_MAX)
+		return index;
+
+	a3d_vk_graph_resource* res = &g->resources[index];
+	res->imported = true;
+	res->is_image = true;
+	res->format = format;
+	res->extent = extent;
+	res->aspect = aspect_of(format);
+	res->image_count = count;
+	res->final_layout = final_layout;
+	res->initial.write_stages = ready_stages;
+	for (Uint32 i = 0; i < count; i++) {
+		res->images[i] = images[i];
+		res->views[i] = views[i];
+	}
+	return index;
+}
+
+/* pipelines are built against this; any render pass with the same formats is compatible */
+VkRenderPass a3d_vk_graph_render_pass(const a3d_vk_graph* g, Uint32 pass)
+{
+	return pass < g->pass_count ? g->passes[pass].render_pass : VK_NULL_HANDLE;
+}
+
+/* for pipelines and secondaries under dynamic rendering, pointing into the graph */
+void a3d_vk_graph_rendering_formats(const a3d_vk_graph* g, Uint32 pass, VkPipelineRenderingCreateInfo* info)
+{
+	*info = (VkPipelineRenderingCreateInfo){
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO
+	};
+	if (pass >= g->pass_count)
+		return;
+
+	const a3d_vk_graph_pass* p = &g->passes[pass];
+	info->colorAttachmentCount = p->colour_count;
+	info->pColorAttachmentFormats = p->colour_formats;
+	info->depthAttachmentFormat = p->depth_format;
+}
+
+void a3d_vk_graph_set_output(a3d_vk_graph* g, Uint32 resource)
+{
+	if (resource < g->resource_count)
+		g->resources[resource].output = true;
+}
+
+/* per frame, before executing; the render pass is begun for inline or secondary contents to match */
+void a3d_vk_graph_set_secondary(a3d_vk_graph* g, Uint32 pass, bool secondary)
+{
+	if (pass < g->pass_count)
+		g->passes[pass].secondary = secondary;
+}
+
+void a3d_vk_graph_set_side_effect(a3d_vk_graph* g, Uint32 pass)
+{
+	if (pass < g->pass_count)
+		g->passes[pass].side_effect = true;
+}
+
+void a3d_vk_graph_use(a3d_vk_graph* g, Uint32 pass, Uint32 resource, a3d_vk_graph_usage usage)
+{
+	if (pass >= g->pass_count || resource >= g->resource_count || usage >= A3D_VK_GRAPH_USAGE_COUNT) {
+		A3D_LOG_ERROR("frame graph use with pass %u, resource %u, usage %d", pass, resource, usage);
+		g->invalid = true;
+		return;
+	}
+
+	a3d_vk_graph_pass* p = &g->passes[pass];
+	const a3d_vk_graph_resource* res = &g->resources[resource];
+
+	bool shader = usages[usage].stages == 0;
+	bool ok = p->access_count < A3D_VK_GRAPH_MAX_ACCESSES &&
+		(!usages[usage].attachment || (p->type == A3D_VK_GRAPH_RASTER && res->is_image)) &&
+		(!shader || p->type != A3D_VK_GRAPH_TRANSFER) &&
+		(usage != A3D_VK_GRAPH_INDIRECT || !res->is_image);
+	for (Uint32 i = 0; i < p->access_count; i++)
+		ok = ok && p->accesses[i].resource != resource;
+
+	if (!ok) {
+		A3D_LOG_ERROR("%s can't use %s with usage %d", p->name, res->name, usage);
+		g->invalid = true;
+		return;
+	}
+
+	p->accesses[p->access_count++] = (a3d_vk_graph_access){
+		.resource = resource,
+		.usage = usage
+	};
+}
+
+/* private */
+static Uint32 add_resource(a3d_vk_graph* g, const char* name)
+{
+	if (g->resource_count == A3D_VK_GRAPH_MAX_RESOURCES) {
+		A3D_LOG_ERROR("frame graph is out of resources adding %s", name);
+		g->invalid = true;
+		return UINT32_MAX;
+	}
+
+	Uint32 index = g->resource_count++;
+	g->resources[index] = (a3d_vk_graph_resource){.name = name};
+	return index;
+}
+
+static VkImageAspectFlags aspect_of(VkFormat format)
+{
+	switch (format) {
+	case VK_FORMAT_D16_UNORM:
+	case VK_FORMAT_X8_D24_UNORM_PACK32:
+	case VK_FORMAT_D32_SFLOAT:
+		return VK_IMAGE_ASPECT_DEPTH_BIT;
+	case VK_FORMAT_D16_UNORM_S8_UINT:
+	case VK_FORMAT_D24_UNORM_S8_UINT:
+	case VK_FORMAT_D32_SFLOAT_S8_UINT:
+		return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+	default:
+		return VK_IMAGE_ASPECT_COLOR_BIT;
+	}
+}
+
+static void begin_rendering(const a3d_vk_graph* g, const a3d_vk_graph_pass* p, VkCommandBuffer cmd, Uint32 image)
+{
+	VkRenderingAttachmentInfo colours[A3D_VK_GRAPH_MAX_ACCESSES];
+	VkRenderingAttachmentInfo depth;
+	Uint32 colour_count = 0;
+	bool has_depth = false;
+
+	/* the barrier in front of the pass already has the attachments in their layouts */
+	for (Uint32 i = 0; i < p->access_count; i++) {
+		const a3d_vk_graph_access* a = &p->accesses[i];
+		if (!usages[a->usage].attachment)
+			continue;
+
+		const a3d_vk_graph_resource* res = &g->resources[a->resource];
+		VkRenderingAttachmentInfo info = {
+			.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+			.imageView = res->views[image % res->image_count],
+			.imageLayout = usages[a->usage].layout,
+			.loadOp = a->clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD,
+			.storeOp = a->store ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE,
+			.clearValue = a->clear_value
+		};
+
+		if (a->usage == A3D_VK_GRAPH_DEPTH) {
+			depth = info;
+			has_depth = true;
+		}
+		else {
+			colours[colour_count++] = info;
+		}
+	}
+
+	VkRenderingInfo rendering_info = {
+		.sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
+		.flags = p->secondary ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT : 0,
+		.renderArea = {
+			.offset = {0, 0},
+			.extent = p->extent
+		},
+		.layerCount = 1,
+		.colorAttachmentCount = colour_count,
+		.pColorAttachments = colours,
+		.pDepthAttachment = has_depth ? &depth : NULL
+	};
+
+	vkCmdBeginRendering(cmd, &rendering_info);
+}
+
+/* formats, size and framebuffer count of a raster pass, whichever way it is recorded */
+static bool collect_attachments(a3d_vk_graph* g, a3d_vk_graph_pass* p)
+{
+	p->attachment_count = 0;
+	p->colour_count = 0;
+	p->depth_format = VK_FORMAT_UNDEFINED;
+	p->fb_count = 1;
+
+	for (Uint32 i = 0; i < p->access_count; i++) {
+		const a3d_vk_graph_access* a = &p->accesses[i];
+		if (!usages[a->usage].attachment)
+			continue;
+
+		const a3d_vk_graph_resource* res = &g->resources[a->resource];
+		if (a->usage == A3D_VK_GRAPH_DEPTH) {
+			if (p->depth_format != VK_FORMAT_UNDEFINED) {
+				A3D_LOG_ERROR("%s has more than one depth attachment", p->name);
+				return false;
+			}
+			p->depth_format = res->format;
+		}
+		else {
+			p->colour_formats[p->colour_count++] = res->format;
+		}
+
+		if (p->attachment_count++ == 0)
+			p->extent = res->extent;
+		else if (res->extent.width != p->extent.width || res->extent.height != p->extent.height) {
+			A3D_LOG_ERROR("%s has attachments of different sizes", p->name);
+			return false;
+		}
+		if (res->image_count > p->fb_count)
+			p->fb_count = res->image_count;
+	}
+
+	if (p->attachment_count == 0) {
+		A3D_LOG_ERROR("raster pass %s has no attachments", p->name);
+		return false;
+	}
+
+	return true;
+}
+
+static bool create_render_pass(a3d* e, a3d_vk_graph* g, a3d_vk_graph_pass* p)
+{
+	VkAttachmentDescription attachments[A3D_VK_GRAPH_MAX_ACCESSES];
+	VkAttachmentReference colour_refs[A3D_VK_GRAPH_MAX_ACCESSES];
+	VkAttachmentReference depth_ref;
+	const a3d_vk_graph_resource* attached[A3D_VK_GRAPH_MAX_ACCESSES];
+	Uint32 colour_count = 0;
+	Uint32 n = 0;
+
+	for (Uint32 i = 0; i < p->access_count; i++) {
+		const a3d_vk_graph_access* a = &p->accesses[i];
+		if (!usages[a->usage].attachment)
+			continue;
+
+		const a3d_vk_graph_resource* res = &g->resources[a->resource];
+		attached[n] = res;
+
+		VkAttachmentLoadOp load = VK_ATTACHMENT_LOAD_OP_LOAD;
+		if (a->clear)
+			load = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		else if (a->initial_layout == VK_IMAGE_LAYOUT_UNDEFINED)
+			load = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+
+		attachments[n] = (VkAttachmentDescription){
+			.format = res->format,
+			.samples = VK_SAMPLE_COUNT_1_BIT,
+			.loadOp = load,
+			.storeOp = a->store ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE,
+			.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+			.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+			.initialLayout = a->initial_layout,
+			.finalLayout = a->final_layout
+		};
+
+		VkAttachmentReference ref = {
+			.attachment = n++,
+			.layout = usages[a->usage].layout
+		};
+		if (a->usage == A3D_VK_GRAPH_DEPTH)
+			depth_ref = ref;
+		else
+			colour_refs[colour_count++] = ref;
+	}
+
+	VkSubpassDescription subpass = {
+		.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+		.colorAttachmentCount = colour_count,
+		.pColorAttachments = colour_refs,
+		.pDepthStencilAttachment = p->depth_format != VK_FORMAT_UNDEFINED ? &depth_ref : NULL
+	};
+
+	/* whatever hazards compile folded in, instead of barriers around the pass */
+	VkSubpassDependency dependencies[2];
+	Uint32 dependency_count = 0;
+	if (p->entry.dstStageMask)
+		dependencies[dependency_count++] = p->entry;
+	if (p->exit.srcStageMask)
+		dependencies[dependency_count++] = p->exit;
+
+	VkRenderPassCreateInfo render_pass_info = {
+		.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+		.attachmentCount = p->attachment_count,
+		.pAttachments = attachments,
+		.subpassCount = 1,
+		.pSubpasses = &subpass,
+		.dependencyCount = dependency_count,
+		.pDependencies = dependencies
+	};
+
+	VkResult r = vkCreateRenderPass(e->vk.logical, &render_pass_info, NULL, &p->render_pass);
+	if (r != VK_SUCCESS) {
+		A3D_LOG_ERROR("failed to create render pass for %s with code %d", p->name, r);
+		return false;
+	}
+
+	for (Uint32 i = 0; i < p->fb_count; i++) {
+		VkImageView views[A3D_VK_GRAPH_MAX_ACCESSES];
+		for (Uint32 j = 0; j < p->attachment_count; j++)
+			views[j] = attached[j]->views[i % attached[j]->image_count];
+
+		VkFramebufferCreateInfo fb_info = {
+			.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+			.renderPass = p->render_pass,
+			.attachmentCount = p->attachment_count,
+			.pAttachments = views,
+			.width = p->extent.width,
+			.height = p->extent.height,
+			.layers = 1
+		};
+
+		r = vkCreateFramebuffer(e->vk.logical, &fb_info, NULL, &p->fbs[i]);
+		if (r != VK_SUCCESS) {
+			A3D_LOG_ERROR("failed to create framebuffer %u for %s with code %d", i, p->name, r);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/* back to front: a pass lives if it has side effects or writes something a live pass or the outside reads */
+static void cull(a3d_vk_graph* g)
+{
+	bool needed[A3D_VK_GRAPH_MAX_RESOURCES];
+	for (Uint32 r = 0; r < g->resource_count; r++)
+		needed[r] = g->resources[r].output;
+
+	for (Uint32 i = g->pass_count; i-- > 0;) {
+		a3d_vk_graph_pass* p = &g->passes[i];
+		p->live = p->side_effect;
+		for (Uint32 j = 0; j < p->access_count; j++)
+			if (usages[p->accesses[j].usage].write && needed[p->accesses[j].resource])
+				p->live = true;
+
+		if (!p->live) {
+			A3D_LOG_DEBUG("culled pass %s, nothing reads what it writes", p->name);
+			continue;
+		}
+
+		/* a clear hides every earlier write, a load or a read needs them */
+		for (Uint32 j = 0; j < p->access_count; j++) {
+			const a3d_vk_graph_access* a = &p->accesses[j];
+			if (a->clear)
+				needed[a->resource] = false;
+			else if (!usages[a->usage].write || usages[a->usage].attachment)
+				needed[a->resource] = true;
+		}
+	}
+}
+
+/* whether an access needs a barrier against what came before, and what it has to wait for */
+static bool hazard(
+	const a3d_vk_graph_state* s, VkPipelineStageFlags stages, VkAccessFlags access, VkImageLayout layout,
+	bool write, VkPipelineStageFlags* out_src, VkAccessFlags* out_src_access
+)
+{
+	*out_src = 0;
+	*out_src_access = 0;
+
+	/* a layout transition is a write too */
+	if (write || s->layout != layout) {
+		*out_src = s->write_stages | s->read_stages;
+		*out_src_access = s->write_access;
+		return *out_src || s->layout != layout;
+	}
+
+	/* read after read, or after a write these stages already see */
+	if (!s->write_stages || ((stages & ~s->visible_stages) == 0 && (access & ~s->visible_access) == 0))
+		return false;
+
+	*out_src = s->write_stages;
+	*out_src_access = s->write_access;
+	return true;
+}
+
+/* images are created up front to learn their requirements, then packed into as few allocations as lifetimes allow */
+static bool place_transients(a3d* e, a3d_vk_graph* g)
+{
+	Uint32 order[A3D_VK_GRAPH_MAX_RESOURCES];
+	Uint32 count = 0;
+
+	for (Uint32 r = 0; r < g->resource_count; r++) {
+		a3d_vk_graph_resource* res = &g->resources[r];
+		if (res->imported || !res->is_image || res->first_use == UINT32_MAX)
+			continue;
+
+		VkExtent2D extent = res->extent;
+		if (extent.width == 0 || extent.height == 0)
+			extent = e->vk.swapchain_extent;
+		res->extent = extent;
+
+		VkImageCreateInfo image_info = {
+			.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+			.imageType = VK_IMAGE_TYPE_2D,
+			.format = res->format,
+			.extent = {extent.width, extent.height, 1},
+			.mipLevels = 1,
+			.arrayLayers = 1,
+			.samples = VK_SAMPLE_COUNT_1_BIT,
+			.tiling = VK_IMAGE_TILING_OPTIMAL,
+			.usage = res->usage,
+			.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+		};
+
+		VkResult result = vkCreateImage(e->vk.logical, &image_info, NULL, &res->images[0]);
+		if (result != VK_SUCCESS) {
+			A3D_LOG_ERROR("failed to create transient %s with code %d", res->name, result);
+			return false;
+		}
+		vkGetImageMemoryRequirements(e->vk.logical, res->images[0], &res->reqs);
+		g->unaliased_size += res->reqs.size;
+
+		/* largest first, so smaller images fill in behind them */
+		Uint32 at = count++;
+		while (at > 0 && g->resources[order[at - 1]].reqs.size < res->reqs.size) {
+			order[at] = order[at - 1];
+			at--;
+		}
+		order[at] = r;
+	}
+
+	VkMemoryRequirements slot_reqs[A3D_VK_GRAPH_MAX_RESOURCES];
+	for (Uint32 i = 0; i < count; i++) {
+		a3d_vk_graph_resource* res = &g->resources[order[i]];
+
+		Uint32 slot = g->slot_count;
+		for (Uint32 s = 0; s < g->slot_count && slot == g->slot_count; s++) {
+			if (!(slot_reqs[s].memoryTypeBits & res->reqs.memoryTypeBits))
+				continue;
+
+			bool overlaps = false;
+			for (Uint32 j = 0; j < i; j++) {
+				const a3d_vk_graph_resource* other = &g->resources[order[j]];
+				if (other->slot == s && !(other->last_use < res->first_use || res->last_use < other->first_use))
+					overlaps = true;
+			}
+			if (!overlaps)
+				slot = s;
+		}
+
+		res->slot = slot;
+		if (slot == g->slot_count) {
+			slot_reqs[g->slot_count++] = res->reqs;
+			continue;
+		}
+
+		VkMemoryRequirements* reqs = &slot_reqs[slot];
+		if (res->reqs.size > reqs->size)
+			reqs->size = res->reqs.size;
+		if (res->reqs.alignment > reqs->alignment)
+			reqs->alignment = res->reqs.alignment;
+		reqs->memoryTypeBits &= res->reqs.memoryTypeBits;
+	}
+
+	for (Uint32 s = 0; s < g->slot_count; s++) {
+		g->slots[s] = a3d_vk_memory_alloc_image(e, &slot_reqs[s], VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		if (!g->slots[s]) {
+			A3D_LOG_ERROR("failed to allocate transient memory");
+			return false;
+		}
+		g->transient_size += slot_reqs[s].size;
+	}
+
+	for (Uint32 i = 0; i < count; i++) {
+		a3d_vk_graph_resource* res = &g->resources[order[i]];
+		const a3d_vk_allocation* slot = g->slots[res->slot];
+
+		VkResult r = vkBindImageMemory(e->vk.logical, res->images[0], slot->memory, slot->offset);
+		if (r != VK_SUCCESS) {
+			A3D_LOG_ERROR("failed to bind transient %s with code %d", res->name, r);
+			return false;
+		}
+
+		VkImageViewCreateInfo view_info = {
+			.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+			.image = res->images[0],
+			.viewType = VK_IMAGE_VIEW_TYPE_2D,
+			.format = res->format,
+			.subresourceRange = {
+				.aspectMask = res->aspect,
+				.levelCount = 1,
+				.layerCount = 1
+			}
+		};
+
+		r = vkCreateImageView(e->vk.logical, &view_info, NULL, &res->views[0]);
+		if (r != VK_SUCCESS) {
+			A3D_LOG_ERROR("failed to create view of transient %s with code %d", res->name, r);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void record_barrier(const a3d_vk_graph* g, const a3d_vk_graph_barrier* b, VkCommandBuffer cmd, Uint32 image)
+{
+	if (!b->src_stages && !b->dst_stages && !b->image_count)
+		return;
+
+	if (g->dynamic) {
+		VkImageMemoryBarrier2 images[A3D_VK_GRAPH_MAX_ACCESSES];
+		for (Uint32 i = 0; i < b->image_count; i++) {
+			const a3d_vk_graph_resource* res = &g->resources[b->image_resources[i]];
+			images[i] = b->images[i];
+			images[i].image = res->images[image % res->image_count];
+		}
+
+		/* the image barriers carry their own stages, the memory barrier only what is left */
+		VkMemoryBarrier2 memory = {
+			.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+			.srcStageMask = b->src_stages,
+			.srcAccessMask = b->src_access,
+			.dstStageMask = b->dst_stages,
+			.dstAccessMask = b->dst_access
+		};
+
+		VkDependencyInfo dependency = {
+			.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+			.memoryBarrierCount = b->src_stages || b->dst_stages ? 1 : 0,
+			.pMemoryBarriers = &memory,
+			.imageMemoryBarrierCount = b->image_count,
+			.pImageMemoryBarriers = images
+		};
+		vkCmdPipelineBarrier2(cmd, &dependency);
+		return;
+	}
+
+	VkImageMemoryBarrier images[A3D_VK_GRAPH_MAX_ACCESSES];
+	for (Uint32 i = 0; i < b->image_count; i++) {
+		const a3d_vk_graph_resource* res = &g->resources[b->image_resources[i]];
+		const VkImageMemoryBarrier2* from = &b->images[i];
+		images[i] = (VkImageMemoryBarrier){
+			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+			.srcAccessMask = (VkAccessFlags)from->srcAccessMask,
+			.dstAccessMask = (VkAccessFlags)from->dstAccessMask,
+			.oldLayout = from->oldLayout,
+			.newLayout = from->newLayout,
+			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.image = res->images[image % res->image_count],
+			.subresourceRange = from->subresourceRange
+		};
+	}
+
+	VkMemoryBarrier memory = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.srcAccessMask = b->src_access,
+		.dstAccessMask = b->dst_access
+	};
+
+	/* one pair of stage masks covers everything */
+	VkPipelineStageFlags src = b->src_stages;
+	VkPipelineStageFlags dst = b->dst_stages;
+	for (Uint32 i = 0; i < b->image_count; i++) {
+		src |= (VkPipelineStageFlags)b->images[i].srcStageMask;
+		dst |= (VkPipelineStageFlags)b->images[i].dstStageMask;
+	}
+
+	vkCmdPipelineBarrier(
+		cmd,
+		src ? src : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+		dst ? dst : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+		0, b->src_access || b->dst_access ? 1 : 0, &memory, 0, NULL, b->image_count, images
+	);
+}
+
+/* the objects compile made, declarations stay */
+static void release(a3d* e, a3d_vk_graph* g)
+{
+	for (Uint32 i = 0; i < g->pass_count; i++) {
+		a3d_vk_graph_pass* p = &g->passes[i];
+		for (Uint32 j = 0; j < p->fb_count; j++)
+			if (p->fbs[j])
+				vkDestroyFramebuffer(e->vk.logical, p->fbs[j], NULL);
+		if (p->render_pass)
+			vkDestroyRenderPass(e->vk.logical, p->render_pass, NULL);
+
+		p->render_pass = VK_NULL_HANDLE;
+		memset(p->fbs, 0, sizeof p->fbs);
+		p->fb_count = 0;
+	}
+
+	for (Uint32 r = 0; r < g->resource_count; r++) {
+		a3d_vk_graph_resource* res = &g->resources[r];
+		if (res->imported)
+			continue;
+
+		if (res->views[0])
+			vkDestroyImageView(e->vk.logical, res->views[0], NULL);
+		if (res->images[0])
+			vkDestroyImage(e->vk.logical, res->images[0], NULL);
+		res->views[0] = VK_NULL_HANDLE;
+		res->images[0] = VK_NULL_HANDLE;
+		res->usage = 0;
+	}
+
+	for (Uint32 s = 0; s < g->slot_count; s++)
+		a3d_vk_memory_free(e, g->slots[s]);
+	g->slot_count = 0;
+	g->transient_size = 0;
+	g->unaliased_size = 0;
+	g->compiled = false;
+}
+
+/*
+ * walks the live passes tracking every resource's state. recording places each hazard where it costs
+ * least: attachment transitions become render pass layouts, hazards of raster passes their entry
+ * dependency, and everything left over one batched barrier per pass
+ */
+static bool simulate(a3d_vk_graph* g, bool record, a3d_vk_graph_state* out_final)
+{
+	a3d_vk_graph_state states[A3D_VK_GRAPH_MAX_RESOURCES];
+	a3d_vk_graph_access* last[A3D_VK_GRAPH_MAX_RESOURCES];
+	a3d_vk_graph_pass* last_pass[A3D_VK_GRAPH_MAX_RESOURCES];
+	for (Uint32 r = 0; r < g->resource_count; r++) {
+		states[r] = g->resources[r].initial;
+		last[r] = NULL;
+		last_pass[r] = NULL;
+	}
+	if (record)
+		memset(&g->tail, 0, sizeof g->tail);
+
+	for (Uint32 i = 0; i < g->pass_count; i++) {
+		a3d_vk_graph_pass* p = &g->passes[i];
+		if (!p->live)
+			continue;
+
+		if (record) {
+			memset(&p->barrier, 0, sizeof p->barrier);
+			memset(&p->entry, 0, sizeof p->entry);
+			memset(&p->exit, 0, sizeof p->exit);
+		}
+
+		for (Uint32 j = 0; j < p->access_count; j++) {
+			a3d_vk_graph_access* a = &p->accesses[j];
+			const a3d_vk_graph_resource* res = &g->resources[a->resource];
+			a3d_vk_graph_state* s = &states[a->resource];
+
+			VkPipelineStageFlags stages = stages_of(p, a->usage);
+			VkAccessFlags access = usages[a->usage].access;
+			VkImageLayout layout = res->is_image ? usages[a->usage].layout : VK_IMAGE_LAYOUT_UNDEFINED;
+			bool write = usages[a->usage].write;
+			bool attachment = usages[a->usage].attachment;
+
+			/* transients start every frame undefined, possibly on top of another image's memory */
+			bool first = !res->imported && res->first_use == i;
+			if (first && !a->clear && (!write || attachment)) {
+				A3D_LOG_ERROR("%s reads %s before anything writes it", p->name, res->name);
+				return false;
+			}
+
+			VkPipelineStageFlags src = 0;
+			VkAccessFlags src_access = 0;
+			bool needed = hazard(s, stages, access, layout, write, &src, &src_access);
+			bool transition = res->is_image && s->layout != layout;
+
+			if (record) {
+				a->initial_layout = layout;
+				a->final_layout = layout;
+				a->store = false;
+
+				/* the previous user's contents only matter if this one doesn't overwrite them all */
+				if (last[a->resource] && !a->clear && !first)
+					last[a->resource]->store = true;
+
+				VkImageLayout old = a->clear || first ? VK_IMAGE_LAYOUT_UNDEFINED : s->layout;
+				a3d_vk_graph_pass* prev = last_pass[a->resource];
+				bool prev_attachment = prev && usages[last[a->resource]->usage].attachment;
+
+				if (!needed) {
+				}
+				else if (!g->dynamic && p->type == A3D_VK_GRAPH_RASTER && (attachment || !transition)) {
+					/* the render pass transitions its own attachments, everything else is a plain dependency */
+					if (attachment)
+						a->initial_layout = old;
+					p->entry.srcSubpass = VK_SUBPASS_EXTERNAL;
+					p->entry.dstSubpass = 0;
+					p->entry.srcStageMask |= src ? src : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+					p->entry.dstStageMask |= stages;
+					p->entry.srcAccessMask |= src_access;
+					p->entry.dstAccessMask |= access;
+				}
+				else if (!g->dynamic && transition && prev_attachment && prev->type == A3D_VK_GRAPH_RASTER) {
+					/* the previous render pass leaves it in this layout and waits for itself on the way out */
+					last[a->resource]->final_layout = layout;
+					prev->exit.srcSubpass = 0;
+					prev->exit.dstSubpass = VK_SUBPASS_EXTERNAL;
+					prev->exit.srcStageMask |= src ? src : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+					prev->exit.dstStageMask |= stages;
+					prev->exit.srcAccessMask |= src_access;
+					prev->exit.dstAccessMask |= access;
+				}
+				else if (transition) {
+					a3d_vk_graph_barrier* b = &p->barrier;
+					b->image_resources[b->image_count] = a->resource;
+					b->images[b->image_count++] = (VkImageMemoryBarrier2){
+						.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+						.srcStageMask = src,
+						.srcAccessMask = src_access,
+						.dstStageMask = stages,
+						.dstAccessMask = access,
+						.oldLayout = old,
+						.newLayout = layout,
+						.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+						.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+						.subresourceRange = {
+							.aspectMask = res->aspect,
+							.levelCount = 1,
+							.layerCount = 1
+						}
+					};
+				}
+				else {
+					p->barrier.src_stages |= src;
+					p->barrier.dst_stages |= stages;
+					p->barrier.src_access |= src_access;
+					p->barrier.dst_access |= access;
+				}
+			}
+
+			update(s, stages, access, layout, write, needed);
+			last[a->resource] = a;
+			last_pass[a->resource] = p;
+		}
+	}
+
+	/* hand imports back in the layout the outside expects */
+	for (Uint32 r = 0; r < g->resource_count; r++) {
+		const a3d_vk_graph_resource* res = &g->resources[r];
+		a3d_vk_graph_state* s = &states[r];
+		if (!last[r])
+			continue;
+
+		if (record && res->output)
+			last[r]->store = true;
+
+		if (!res->imported || res->final_layout == VK_IMAGE_LAYOUT_UNDEFINED || res->final_layout == s->layout)
+			continue;
+
+		/* whatever reads it next syncs through a semaphore, so no dependency is needed on the way out */
+		if (record && !g->dynamic && last_pass[r]->type == A3D_VK_GRAPH_RASTER && usages[last[r]->usage].attachment) {
+			last[r]->final_layout = res->final_layout;
+		}
+		else if (record) {
+			a3d_vk_graph_barrier* b = &g->tail;
+			b->image_resources[b->image_count] = r;
+			b->images[b->image_count++] = (VkImageMemoryBarrier2){
+				.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+				.srcStageMask = s->write_stages | s->read_stages,
+				.srcAccessMask = s->write_access,
+				.oldLayout = s->layout,
+				.newLayout = res->final_layout,
+				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.subresourceRange = {
+					.aspectMask = res->aspect,
+					.levelCount = 1,
+					.layerCount = 1
+				}
+			};
+		}
+		s->layout = res->final_layout;
+	}
+
+	for (Uint32 r = 0; r < g->resource_count; r++)
+		out_final[r] = states[r];
+	return true;
+}
+
+static VkPipelineStageFlags stages_of(const a3d_vk_graph_pass* p, a3d_vk_graph_usage usage)
+{
+	if (usages[usage].stages)
+		return usages[usage].stages;
+
+	return p->type == A3D_VK_GRAPH_COMPUTE
+		? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+		: VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+}
+
+/* after the access, with barrier saying whether one was placed in front of it */
+static void update(a3d_vk_graph_state* s, VkPipelineStageFlags stages, VkAccessFlags access, VkImageLayout layout, bool write, bool barrier)
+{
+	if (write) {
+		s->write_stages = stages;
+		s->write_access = access & WRITE_ACCESS;
+		s->read_stages = 0;
+		s->visible_stages = 0;
+		s->visible_access = 0;
+	}
+	else if (s->layout != layout) {
+		/* the transition finished before these stages, chaining behind them covers it */
+		s->write_stages = stages;
+		s->write_access = 0;
+		s->read_stages = stages;
+		s->visible_stages = stages;
+		s->visible_access = access;
+	}
+	else {
+		s->read_stages |= stages;
+		if (barrier) {
+			s->visible_stages |= stages;
+			s->visible_access |= access;
+		}
+	}
+	s->layout = layout;
+}
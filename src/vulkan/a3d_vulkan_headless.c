@@ -0,0 +1,254 @@
+#define A3D_LOG_SUBSYSTEM VULKAN
+
+#include <stdlib.h>
+#include <vulkan/vulkan.h>
+
+#include "a3d.h"
+#include "a3d_logging.h"
+#include "a3d_profiler.h"
+#include "vulkan/a3d_vulkan.h"
+#include "vulkan/a3d_vulkan_buffer.h"
+#include "vulkan/a3d_vulkan_headless.h"
+#include "vulkan/a3d_vulkan_memory.h"
+#include "vulkan/a3d_vulkan_profiler.h"
+#include "vulkan/a3d_vulkan_sync.h"
+#include "vulkan/a3d_vulkan_upload.h"
+
+static bool create_target(a3d* e, Uint32 i);
+static void deliver(a3d* e, Uint32 slot);
+
+bool a3d_vk_create_headless(a3d* e)
+{
+	A3D_LOG_INFO(
+		"creating %u headless targets at %ux%u", A3D_VK_FRAMES_IN_FLIGHT,
+		e->vk.swapchain_extent.width, e->vk.swapchain_extent.height
+	);
+
+	a3d_vk_headless* h = calloc(1, sizeof *h);
+	if (!h) {
+		A3D_LOG_ERROR("failed to allocate headless targets");
+		return false;
+	}
+	e->vk.headless = h;
+
+	/* stand in for the swapchain so the frame graph imports them like swapchain images */
+	e->vk.swapchain_fmt = A3D_VK_HEADLESS_FORMAT;
+	e->vk.swapchain_images_count = A3D_VK_FRAMES_IN_FLIGHT;
+
+	for (Uint32 i = 0; i < A3D_VK_FRAMES_IN_FLIGHT; i++) {
+		if (!create_target(e, i)) {
+			A3D_LOG_ERROR("failed to create headless target %u", i);
+			a3d_vk_destroy_headless(e);
+			return false;
+		}
+	}
+
+	A3D_LOG_INFO("created headless targets");
+	return true;
+}
+
+void a3d_vk_destroy_headless(a3d* e)
+{
+	a3d_vk_headless* h = e->vk.headless;
+	if (!h)
+		return;
+
+	/* the device is idle at shutdown, hand over whatever is still waiting */
+	a3d_vk_headless_flush(e);
+	a3d_vk_destroy_image_views(e);
+
+	for (Uint32 i = 0; i < A3D_VK_FRAMES_IN_FLIGHT; i++) {
+		if (e->vk.swapchain_images[i]) {
+			vkDestroyImage(e->vk.logical, e->vk.swapchain_images[i], NULL);
+			e->vk.swapchain_images[i] = VK_NULL_HANDLE;
+		}
+		a3d_vk_memory_free(e, h->image_mem[i]);
+		a3d_vk_destroy_buffer(e, &h->readback[i]);
+	}
+
+	free(h);
+	e->vk.headless = NULL;
+	A3D_LOG_INFO("destroyed headless targets");
+}
+
+bool a3d_vk_headless_draw_frame(a3d* e)
+{
+	a3d_vk_headless* h = e->vk.headless;
+	Uint32 frame_index = e->vk.frame_index;
+	a3d_vk_frame* frame = &e->vk.frames[frame_index];
+
+	/* the slot's previous frame has landed in its readback buffer once this returns */
+	if (!a3d_vk_sync_wait(e, (a3d_vk_sync_point){A3D_VK_QUEUE_GRAPHICS, frame->value})) {
+		A3D_LOG_ERROR("failed to wait for headless frame %u", frame_index);
+		return false;
+	}
+	deliver(e, frame_index);
+	a3d_vk_sync_collect(e);
+
+	/* no acquire, each slot renders into its own target */
+	A3D_PROFILE_BEGIN(record_start);
+	if (!a3d_vk_record_command_buffer(e, frame_index, frame_index, e->vk.clear_col)) {
+		A3D_LOG_ERROR("failed to record headless frame");
+		return false;
+	}
+	A3D_PROFILE_END(record_start, "record");
+
+	A3D_PROFILE_BEGIN(submit_start);
+
+	if (!a3d_vk_upload_flush(e)) {
+		A3D_LOG_ERROR("failed to flush uploads");
+		return false;
+	}
+
+	a3d_vk_submission submission = {
+		.cmds = &frame->cmd,
+		.cmd_count = 1,
+		.waits = {a3d_vk_sync_last(e, A3D_VK_QUEUE_TRANSFER)},
+		.wait_stages = {VK_PIPELINE_STAGE_VERTEX_INPUT_BIT},
+		.wait_count = 1
+	};
+
+	a3d_vk_sync_point point;
+	if (!a3d_vk_sync_submit(e, A3D_VK_QUEUE_GRAPHICS, &submission, &point))
+		return false;
+	frame->value = point.value;
+	a3d_vk_profiler_submitted(e, frame_index);
+	A3D_PROFILE_END(submit_start, "submit");
+
+	h->frame_numbers[frame_index] = h->frame_count++;
+	h->pending[frame_index] = true;
+	e->vk.frame_index = (frame_index + 1) % A3D_VK_FRAMES_IN_FLIGHT;
+	return true;
+}
+
+/* delivers every submitted frame, oldest first; blocks until they finish */
+void a3d_vk_headless_flush(a3d* e)
+{
+	for (Uint32 i = 0; i < A3D_VK_FRAMES_IN_FLIGHT; i++) {
+		Uint32 slot = (e->vk.frame_index + i) % A3D_VK_FRAMES_IN_FLIGHT;
+		if (!e->vk.headless->pending[slot])
+			continue;
+
+		if (!a3d_vk_sync_wait(e, (a3d_vk_sync_point){A3D_VK_QUEUE_GRAPHICS, e->vk.frames[slot].value})) {
+			A3D_LOG_ERROR("failed to wait for headless frame %u", slot);
+			return;
+		}
+		deliver(e, slot);
+	}
+}
+
+/* the frame graph's readback pass, which gets the target in TRANSFER_SRC_OPTIMAL and waits for the render pass */
+void a3d_vk_headless_record_readback(a3d* e, Uint32 image, VkCommandBuffer cmd)
+{
+	a3d_vk_headless* h = e->vk.headless;
+
+	VkBufferImageCopy region = {
+		.bufferOffset = 0,
+		.bufferRowLength = 0,
+		.bufferImageHeight = 0,
+		.imageSubresource = {
+			.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+			.mipLevel = 0,
+			.baseArrayLayer = 0,
+			.layerCount = 1
+		},
+		.imageOffset = {0, 0, 0},
+		.imageExtent = {e->vk.swapchain_extent.width, e->vk.swapchain_extent.height, 1}
+	};
+	vkCmdCopyImageToBuffer(
+		cmd, e->vk.swapchain_images[image], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		h->readback[image].buff, 1, &region
+	);
+
+	VkMemoryBarrier copied = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_HOST_READ_BIT
+	};
+	vkCmdPipelineBarrier(
+		cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+		0, 1, &copied, 0, NULL, 0, NULL
+	);
+}
+
+/* private */
+static bool create_target(a3d* e, Uint32 i)
+{
+	a3d_vk_headless* h = e->vk.headless;
+	VkExtent2D extent = e->vk.swapchain_extent;
+
+	VkImageCreateInfo image_info = {
+		.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+		.imageType = VK_IMAGE_TYPE_2D,
+		.format = A3D_VK_HEADLESS_FORMAT,
+		.extent = {extent.width, extent.height, 1},
+		.mipLevels = 1,
+		.arrayLayers = 1,
+		.samples = VK_SAMPLE_COUNT_1_BIT,
+		.tiling = VK_IMAGE_TILING_OPTIMAL,
+		.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+		.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+		.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+	};
+
+	VkResult r = vkCreateImage(e->vk.logical, &image_info, NULL, &e->vk.swapchain_images[i]);
+	if (r != VK_SUCCESS) {
+		A3D_LOG_ERROR("vkCreateImage failed with code %d", r);
+		return false;
+	}
+
+	VkMemoryRequirements reqs;
+	vkGetImageMemoryRequirements(e->vk.logical, e->vk.swapchain_images[i], &reqs);
+
+	/* optimal tiling, so it stays out of the blocks the readback buffers come from */
+	h->image_mem[i] = a3d_vk_memory_alloc_image(e, &reqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	if (!h->image_mem[i])
+		return false;
+
+	r = vkBindImageMemory(e->vk.logical, e->vk.swapchain_images[i], h->image_mem[i]->memory, h->image_mem[i]->offset);
+	if (r != VK_SUCCESS) {
+		A3D_LOG_ERROR("vkBindImageMemory failed with code %d", r);
+		return false;
+	}
+
+	VkImageViewCreateInfo view_info = {
+		.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+		.image = e->vk.swapchain_images[i],
+		.viewType = VK_IMAGE_VIEW_TYPE_2D,
+		.format = A3D_VK_HEADLESS_FORMAT,
+		.subresourceRange = {
+			.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+			.levelCount = 1,
+			.layerCount = 1
+		}
+	};
+
+	r = vkCreateImageView(e->vk.logical, &view_info, NULL, &e->vk.swapchain_views[i]);
+	if (r != VK_SUCCESS) {
+		A3D_LOG_ERROR("vkCreateImageView failed with code %d", r);
+		return false;
+	}
+
+	/* tightly packed rgba8 rows, what the callback receives */
+	return a3d_vk_create_buffer(
+		e, (VkDeviceSize)extent.width * extent.height * 4, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&h->readback[i], NULL
+	);
+}
+
+static void deliver(a3d* e, Uint32 slot)
+{
+	a3d_vk_headless* h = e->vk.headless;
+	if (!h->pending[slot])
+		return;
+
+	h->pending[slot] = false;
+	if (h->fn) {
+		h->fn(
+			e, h->readback[slot].alloc->mapped,
+			e->vk.swapchain_extent.width, e->vk.swapchain_extent.height,
+			h->frame_numbers[slot], h->user
+		);
+	}
+}
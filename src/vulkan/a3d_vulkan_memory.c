@@ -0,0 +1,551 @@
+#define A3D_LOG_SUBSYSTEM VULKAN
+
+#include <stdlib.h>
+#include <string.h>
+#include <vulkan/vulkan.h>
+
+#include "a3d.h"
+#include "a3d_logging.h"
+#include "vulkan/a3d_vulkan_memory.h"
+
+static a3d_vk_allocation* alloc_from(a3d* e, a3d_vk_pool* pools, const VkMemoryRequirements* reqs, VkMemoryPropertyFlags props);
+static VkDeviceSize align_up(VkDeviceSize v, VkDeviceSize alignment);
+static Uint32 bucket_of(VkDeviceSize size);
+static a3d_vk_allocation* carve_range(a3d_vk_block* block, a3d_vk_allocation* range, VkDeviceSize offset, VkDeviceSize size);
+static a3d_vk_block* create_block(a3d* e, a3d_vk_pool* pool, Uint32 type_index, VkDeviceSize size, bool dedicated);
+static void destroy_block(a3d* e, a3d_vk_block* block);
+static a3d_vk_allocation* find_fit(a3d_vk_pool* pool, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize* out_offset);
+static Uint32 find_memory_type(a3d_vk_allocator* a, Uint32 type_filter, VkMemoryPropertyFlags properties);
+static bool fits(const a3d_vk_allocation* range, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize* out_offset);
+static Uint32 heap_of(a3d_vk_allocator* a, Uint32 type_index);
+static void link_free(a3d_vk_allocation* range);
+static Uint32 pool_empty_blocks(a3d_vk_pool* pool);
+static void unlink_free(a3d_vk_allocation* range);
+
+/* buffers and linear images */
+a3d_vk_allocation* a3d_vk_memory_alloc(a3d* e, const VkMemoryRequirements* reqs, VkMemoryPropertyFlags props)
+{
+	return alloc_from(e, e->vk.allocator->pools, reqs, props);
+}
+
+/* optimal tiling images, from their own blocks */
+a3d_vk_allocation* a3d_vk_memory_alloc_image(a3d* e, const VkMemoryRequirements* reqs, VkMemoryPropertyFlags props)
+{
+	return alloc_from(e, e->vk.allocator->image_pools, reqs, props);
+}
+
+VkDeviceSize a3d_vk_memory_defragment(a3d* e, a3d_vk_defrag_fn fn, void* user)
+{
+	a3d_vk_allocator* a = e->vk.allocator;
+	VkDeviceSize released = 0;
+
+	for (Uint32 p = 0; p < 2 * a->props.memoryTypeCount; p++) {
+		Uint32 t = p % a->props.memoryTypeCount;
+		a3d_vk_pool* pool = p < a->props.memoryTypeCount ? &a->pools[t] : &a->image_pools[t];
+
+		/* mark sparse blocks first so relocations never land back in them */
+		for (a3d_vk_block* b = pool->blocks; b; b = b->next) {
+			float occupancy = (float)b->used / (float)b->size;
+			b->draining = !b->dedicated && b->alloc_count > 0 && occupancy < A3D_VK_MEMORY_DEFRAG_OCCUPANCY;
+		}
+
+		a3d_vk_block* b = pool->blocks;
+		while (b) {
+			a3d_vk_block* next = b->next;
+			if (!b->draining) {
+				b = next;
+				continue;
+			}
+
+			/* the callback frees the range it is handed, so always restart from the head */
+			VkDeviceSize size = b->size;
+			Uint32 before;
+			do {
+				a3d_vk_allocation* r = b->ranges;
+				while (r && r->free)
+					r = r->next;
+				if (!r)
+					break;
+
+				before = b->alloc_count;
+				fn(e, r, user);
+			} while (b->alloc_count > 0 && b->alloc_count < before);
+
+			b->draining = false;
+			if (b->alloc_count == 0 && pool_empty_blocks(pool) > 1) {
+				destroy_block(e, b);
+				released += size;
+			}
+			else if (b->alloc_count > 0) {
+				A3D_LOG_WARN("defrag left %u allocations in a block of type %u", b->alloc_count, t);
+			}
+			b = next;
+		}
+	}
+
+	if (released)
+		A3D_LOG_INFO("defrag released %" SDL_PRIu64 " bytes", (Uint64)released);
+	return released;
+}
+
+void a3d_vk_memory_free(a3d* e, a3d_vk_allocation* alloc)
+{
+	if (!alloc)
+		return;
+
+	a3d_vk_allocator* a = e->vk.allocator;
+	a3d_vk_block* block = alloc->block;
+
+	Uint32 heap = heap_of(a, block->type_index);
+	a->heaps[heap].used -= alloc->size;
+	a->heaps[heap].alloc_count--;
+	block->used -= alloc->size;
+	block->alloc_count--;
+
+	alloc->free = true;
+	alloc->mapped = NULL;
+
+	/* coalesce with free neighbours, the merged range moves to the bucket of its new size */
+	a3d_vk_allocation* next = alloc->next;
+	if (next && next->free) {
+		unlink_free(next);
+		alloc->size += next->size;
+		alloc->next = next->next;
+		if (next->next)
+			next->next->prev = alloc;
+		free(next);
+	}
+
+	a3d_vk_allocation* prev = alloc->prev;
+	if (prev && prev->free) {
+		unlink_free(prev);
+		prev->size += alloc->size;
+		prev->next = alloc->next;
+		if (alloc->next)
+			alloc->next->prev = prev;
+		free(alloc);
+		alloc = prev;
+	}
+	link_free(alloc);
+
+	/* keep one empty block per pool around to absorb load/unload churn */
+	if (block->alloc_count == 0 && !block->draining)
+		if (block->dedicated || pool_empty_blocks(block->pool) > 1)
+			destroy_block(e, block);
+}
+
+void a3d_vk_memory_get_stats(a3d* e, a3d_vk_heap_stats* out_heaps, Uint32* out_count)
+{
+	a3d_vk_allocator* a = e->vk.allocator;
+
+	*out_count = a->props.memoryHeapCount;
+	if (out_heaps)
+		memcpy(out_heaps, a->heaps, a->props.memoryHeapCount * sizeof *out_heaps);
+}
+
+bool a3d_vk_memory_init(a3d* e)
+{
+	a3d_vk_allocator* a = calloc(1, sizeof *a);
+	if (!a) {
+		A3D_LOG_ERROR("failed to allocate memory allocator");
+		return false;
+	}
+
+	vkGetPhysicalDeviceMemoryProperties(e->vk.physical, &a->props);
+
+	VkPhysicalDeviceProperties dev_props;
+	vkGetPhysicalDeviceProperties(e->vk.physical, &dev_props);
+	a->max_device_allocations = dev_props.limits.maxMemoryAllocationCount;
+
+	/* small heaps (e.g. 256MB BAR) get smaller blocks so one pool can't exhaust them */
+	for (Uint32 i = 0; i < a->props.memoryTypeCount; i++) {
+		VkDeviceSize heap_size = a->props.memoryHeaps[heap_of(a, i)].size;
+		VkDeviceSize size = A3D_VK_MEMORY_BLOCK_SIZE;
+		if (size > heap_size / 8)
+			size = heap_size / 8;
+		a->block_size[i] = size;
+	}
+
+	e->vk.allocator = a;
+	A3D_LOG_INFO(
+		"memory allocator ready: %u types, %u heaps, %u allocations max",
+		a->props.memoryTypeCount, a->props.memoryHeapCount, a->max_device_allocations
+	);
+
+	return true;
+}
+
+void a3d_vk_memory_log_stats(a3d* e)
+{
+	a3d_vk_allocator* a = e->vk.allocator;
+	if (!a)
+		return;
+
+	A3D_LOG_INFO("device memory (%u/%u allocations):", a->device_allocations, a->max_device_allocations);
+	for (Uint32 i = 0; i < a->props.memoryHeapCount; i++) {
+		const a3d_vk_heap_stats* s = &a->heaps[i];
+		if (!s->block_count)
+			continue;
+
+		float usage = s->reserved ? 100.0f * (float)s->used / (float)s->reserved : 0.0f;
+		A3D_LOG_INFO(
+			"\theap[%u]: %" SDL_PRIu64 "/%" SDL_PRIu64 " bytes used (%.1f%%) in %u blocks, %u allocations",
+			i, (Uint64)s->used, (Uint64)s->reserved, usage, s->block_count, s->alloc_count
+		);
+	}
+}
+
+void a3d_vk_memory_shutdown(a3d* e)
+{
+	a3d_vk_allocator* a = e->vk.allocator;
+	if (!a)
+		return;
+
+	for (Uint32 p = 0; p < 2 * a->props.memoryTypeCount; p++) {
+		Uint32 t = p % a->props.memoryTypeCount;
+		a3d_vk_pool* pool = p < a->props.memoryTypeCount ? &a->pools[t] : &a->image_pools[t];
+		while (pool->blocks) {
+			if (pool->blocks->alloc_count)
+				A3D_LOG_WARN("leaked %u allocations in memory type %u", pool->blocks->alloc_count, t);
+			destroy_block(e, pool->blocks);
+		}
+	}
+
+	free(a);
+	e->vk.allocator = NULL;
+	A3D_LOG_INFO("memory allocator destroyed");
+}
+
+/* private */
+static a3d_vk_allocation* alloc_from(a3d* e, a3d_vk_pool* pools, const VkMemoryRequirements* reqs, VkMemoryPropertyFlags props)
+{
+	a3d_vk_allocator* a = e->vk.allocator;
+
+	Uint32 type_index = find_memory_type(a, reqs->memoryTypeBits, props);
+	if (type_index == UINT32_MAX) {
+		A3D_LOG_ERROR("no suitable memory type for allocation");
+		return NULL;
+	}
+
+	VkDeviceSize alignment = reqs->alignment ? reqs->alignment : 1;
+	a3d_vk_pool* pool = &pools[type_index];
+	a3d_vk_allocation* range = NULL;
+	VkDeviceSize offset = 0;
+	bool fresh = false;
+
+	/* anything over half a block would mostly waste the rest of it */
+	bool dedicated = reqs->size > a->block_size[type_index] / 2;
+	if (!dedicated)
+		range = find_fit(pool, reqs->size, alignment, &offset);
+
+	if (!range) {
+		VkDeviceSize size = dedicated ? reqs->size : a->block_size[type_index];
+		a3d_vk_block* created = create_block(e, pool, type_index, size, dedicated);
+		if (!created)
+			return NULL;
+
+		range = created->ranges;
+		offset = 0;
+		fresh = true;
+	}
+
+	a3d_vk_block* block = range->block;
+	a3d_vk_allocation* alloc = carve_range(block, range, offset, reqs->size);
+	if (!alloc) {
+		A3D_LOG_ERROR("failed to allocate range node");
+		/* nothing else can be in a block made for this request */
+		if (fresh)
+			destroy_block(e, block);
+		return NULL;
+	}
+
+	block->used += alloc->size;
+	block->alloc_count++;
+
+	Uint32 heap = heap_of(a, type_index);
+	a->heaps[heap].used += alloc->size;
+	a->heaps[heap].alloc_count++;
+
+	return alloc;
+}
+
+static VkDeviceSize align_up(VkDeviceSize v, VkDeviceSize alignment)
+{
+	return (v + alignment - 1) / alignment * alignment;
+}
+
+static Uint32 bucket_of(VkDeviceSize size)
+{
+	Uint32 bucket = 0;
+	while (size >>= 1)
+		bucket++;
+	return bucket;
+}
+
+/* both split nodes are allocated up front, so a failure leaves the range as it was */
+static a3d_vk_allocation* carve_range(a3d_vk_block* block, a3d_vk_allocation* range, VkDeviceSize offset, VkDeviceSize size)
+{
+	bool has_pad = offset > range->offset;
+	bool has_tail = range->size - (offset - range->offset) > size;
+	a3d_vk_allocation* pad = has_pad ? malloc(sizeof *pad) : NULL;
+	a3d_vk_allocation* tail = has_tail ? malloc(sizeof *tail) : NULL;
+	if ((has_pad && !pad) || (has_tail && !tail)) {
+		free(pad);
+		free(tail);
+		return NULL;
+	}
+
+	unlink_free(range);
+
+	/* split off alignment padding in front as its own free range */
+	if (pad) {
+		*pad = (a3d_vk_allocation){
+			.block = block,
+			.memory = block->memory,
+			.offset = range->offset,
+			.size = offset - range->offset,
+			.free = true,
+			.prev = range->prev,
+			.next = range
+		};
+		if (range->prev)
+			range->prev->next = pad;
+		else
+			block->ranges = pad;
+		range->prev = pad;
+		range->offset = offset;
+		range->size -= pad->size;
+		link_free(pad);
+	}
+
+	/* and the tail */
+	if (tail) {
+		*tail = (a3d_vk_allocation){
+			.block = block,
+			.memory = block->memory,
+			.offset = range->offset + size,
+			.size = range->size - size,
+			.free = true,
+			.prev = range,
+			.next = range->next
+		};
+		if (range->next)
+			range->next->prev = tail;
+		range->next = tail;
+		range->size = size;
+		link_free(tail);
+	}
+
+	range->free = false;
+	range->mapped = block->mapped ? (char*)block->mapped + range->offset : NULL;
+	return range;
+}
+
+static a3d_vk_block* create_block(a3d* e, a3d_vk_pool* pool, Uint32 type_index, VkDeviceSize size, bool dedicated)
+{
+	a3d_vk_allocator* a = e->vk.allocator;
+
+	if (a->device_allocations >= a->max_device_allocations) {
+		A3D_LOG_ERROR("maxMemoryAllocationCount (%u) reached", a->max_device_allocations);
+		return NULL;
+	}
+
+	a3d_vk_block* block = calloc(1, sizeof *block);
+	a3d_vk_allocation* range = malloc(sizeof *range);
+	if (!block || !range) {
+		A3D_LOG_ERROR("failed to allocate memory block");
+		free(block);
+		free(range);
+		return NULL;
+	}
+
+	VkMemoryAllocateInfo allocate_info = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+		.allocationSize = size,
+		.memoryTypeIndex = type_index
+	};
+
+	VkResult r = vkAllocateMemory(e->vk.logical, &allocate_info, NULL, &block->memory);
+	if (r != VK_SUCCESS) {
+		A3D_LOG_ERROR("vkAllocateMemory failed with code %d", r);
+		free(block);
+		free(range);
+		return NULL;
+	}
+
+	/* memory can only be mapped once, so host visible blocks stay mapped for life */
+	if (a->props.memoryTypes[type_index].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+		r = vkMapMemory(e->vk.logical, block->memory, 0, VK_WHOLE_SIZE, 0, &block->mapped);
+		if (r != VK_SUCCESS) {
+			A3D_LOG_ERROR("vkMapMemory failed with code %d", r);
+			vkFreeMemory(e->vk.logical, block->memory, NULL);
+			free(block);
+			free(range);
+			return NULL;
+		}
+	}
+
+	*range = (a3d_vk_allocation){
+		.block = block,
+		.memory = block->memory,
+		.offset = 0,
+		.size = size,
+		.free = true
+	};
+
+	block->pool = pool;
+	block->size = size;
+	block->type_index = type_index;
+	block->dedicated = dedicated;
+	block->ranges = range;
+	block->next = pool->blocks;
+	pool->blocks = block;
+	link_free(range);
+
+	Uint32 heap = heap_of(a, type_index);
+	a->heaps[heap].reserved += size;
+	a->heaps[heap].block_count++;
+	a->device_allocations++;
+
+	A3D_LOG_DEBUG(
+		"allocated %s block of %" SDL_PRIu64 " bytes in memory type %u",
+		dedicated ? "dedicated" : "pooled", (Uint64)size, type_index
+	);
+	return block;
+}
+
+static void destroy_block(a3d* e, a3d_vk_block* block)
+{
+	a3d_vk_allocator* a = e->vk.allocator;
+
+	/* unlink */
+	a3d_vk_block** link = &block->pool->blocks;
+	while (*link != block)
+		link = &(*link)->next;
+	*link = block->next;
+
+	if (block->mapped)
+		vkUnmapMemory(e->vk.logical, block->memory);
+	vkFreeMemory(e->vk.logical, block->memory, NULL);
+
+	a3d_vk_allocation* r = block->ranges;
+	while (r) {
+		a3d_vk_allocation* next = r->next;
+		if (r->free)
+			unlink_free(r);
+		free(r);
+		r = next;
+	}
+
+	Uint32 heap = heap_of(a, block->type_index);
+	a->heaps[heap].reserved -= block->size;
+	a->heaps[heap].block_count--;
+	a->device_allocations--;
+
+	A3D_LOG_DEBUG("freed block of %" SDL_PRIu64 " bytes in memory type %u", (Uint64)block->size, block->type_index);
+	free(block);
+}
+
+/*
+ * the request's own bucket may hold ranges too small, so it is walked for the smallest that fits.
+ * every range in a higher bucket is larger than the request, so the first non-empty one only has to
+ * be walked past ranges that fail on alignment or sit in draining blocks
+ */
+static a3d_vk_allocation* find_fit(a3d_vk_pool* pool, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize* out_offset)
+{
+	Uint32 bucket = bucket_of(size);
+	a3d_vk_allocation* best = NULL;
+
+	for (a3d_vk_allocation* r = pool->buckets[bucket]; r; r = r->free_next) {
+		VkDeviceSize offset;
+		if ((!best || r->size < best->size) && fits(r, size, alignment, &offset)) {
+			best = r;
+			*out_offset = offset;
+		}
+	}
+	if (best)
+		return best;
+
+	Uint64 above = bucket + 1 < A3D_VK_MEMORY_BUCKETS ? pool->nonempty & ~((2ull << bucket) - 1) : 0;
+	while (above) {
+		Uint32 b = bucket_of(above & (~above + 1));
+		for (a3d_vk_allocation* r = pool->buckets[b]; r; r = r->free_next)
+			if (fits(r, size, alignment, out_offset))
+				return r;
+		above &= above - 1;
+	}
+
+	return NULL;
+}
+
+static Uint32 find_memory_type(a3d_vk_allocator* a, Uint32 type_filter, VkMemoryPropertyFlags properties)
+{
+	for (Uint32 i = 0; i < a->props.memoryTypeCount; i++) {
+		if ((type_filter & (1 << i)) && (a->props.memoryTypes[i].propertyFlags & properties) == properties)
+			return i;
+	}
+	return UINT32_MAX;
+}
+
+static bool fits(const a3d_vk_allocation* range, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize* out_offset)
+{
+	if (range->block->draining || range->size < size)
+		return false;
+
+	VkDeviceSize offset = align_up(range->offset, alignment);
+	if (offset + size > range->offset + range->size)
+		return false;
+
+	*out_offset = offset;
+	return true;
+}
+
+static Uint32 heap_of(a3d_vk_allocator* a, Uint32 type_index)
+{
+	return a->props.memoryTypes[type_index].heapIndex;
+}
+
+/* dedicated blocks never take a second allocation, so their ranges stay out of the buckets */
+static void link_free(a3d_vk_allocation* range)
+{
+	if (range->block->dedicated)
+		return;
+
+	a3d_vk_pool* pool = range->block->pool;
+	Uint32 bucket = bucket_of(range->size);
+	range->free_prev = NULL;
+	range->free_next = pool->buckets[bucket];
+	if (range->free_next)
+		range->free_next->free_prev = range;
+	pool->buckets[bucket] = range;
+	pool->nonempty |= 1ull << bucket;
+}
+
+static Uint32 pool_empty_blocks(a3d_vk_pool* pool)
+{
+	Uint32 count = 0;
+	for (a3d_vk_block* b = pool->blocks; b; b = b->next)
+		if (!b->dedicated && b->alloc_count == 0)
+			count++;
+	return count;
+}
+
+/* the bucket is found from the size, so call this before a free range's size changes */
+static void unlink_free(a3d_vk_allocation* range)
+{
+	if (range->block->dedicated)
+		return;
+
+	a3d_vk_pool* pool = range->block->pool;
+	Uint32 bucket = bucket_of(range->size);
+	if (range->free_prev)
+		range->free_prev->free_next = range->free_next;
+	else
+		pool->buckets[bucket] = range->free_next;
+	if (range->free_next)
+		range->free_next->free_prev = range->free_prev;
+	range->free_prev = range->free_next = NULL;
+
+	if (!pool->buckets[bucket])
+		pool->nonempty &= ~(1ull << bucket);
+}
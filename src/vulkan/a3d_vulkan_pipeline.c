@@ -1,3 +1,5 @@
+#define A3D_LOG_SUBSYSTEM VULKAN
+
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -6,101 +8,181 @@
 
 #include "a3d_logging.h"
 #include "a3d_mesh.h"
-#include "a3d_transform.h"
+#include "vulkan/a3d_vulkan_bindless.h"
+#include "vulkan/a3d_vulkan_descriptor.h"
+#include "vulkan/a3d_vulkan_graph.h"
 #include "vulkan/a3d_vulkan_pipeline.h"
 
 #define A3D_SHADER_VERTEX_PATH "shaders/triangle.vert.spv"
+#define A3D_SHADER_PACKED_VERTEX_PATH "shaders/packed.vert.spv"
 #define A3D_SHADER_FRAGMENT_PATH "shaders/triangle.frag.spv"
 
+/* what a3d_vk_create_graphics_pipeline builds each vertex format's input state from */
+typedef struct {
+	const char* shader;
+	Uint32   stride;
+	Uint32   attribute_count;
+	VkVertexInputAttributeDescription attributes[4];
+} a3d_vk_vertex_layout;
+
+/* colour is location 1 in every layout so the fragment shader is shared */
+static const a3d_vk_vertex_layout vertex_layouts[A3D_VERTEX_FORMAT_COUNT] = {
+	[A3D_VERTEX_FORMAT_FLOAT] = {
+		.shader = A3D_SHADER_VERTEX_PATH,
+		.stride = sizeof(a3d_vertex),
+		.attribute_count = 2,
+		.attributes = {
+			{.location = 0, .format = VK_FORMAT_R32G32_SFLOAT, .offset = offsetof(a3d_vertex, position)},
+			{.location = 1, .format = VK_FORMAT_R32G32B32_SFLOAT, .offset = offsetof(a3d_vertex, colour)}
+		}
+	},
+	[A3D_VERTEX_FORMAT_PACKED] = {
+		.shader = A3D_SHADER_PACKED_VERTEX_PATH,
+		.stride = sizeof(a3d_vertex_packed),
+		.attribute_count = 4,
+		.attributes = {
+			{.location = 0, .format = VK_FORMAT_R16G16B16A16_SNORM, .offset = offsetof(a3d_vertex_packed, position)},
+			{.location = 1, .format = VK_FORMAT_R8G8B8A8_UNORM, .offset = offsetof(a3d_vertex_packed, colour)},
+			{.location = 2, .format = VK_FORMAT_R16G16_SNORM, .offset = offsetof(a3d_vertex_packed, normal)},
+			{.location = 3, .format = VK_FORMAT_R16G16_SFLOAT, .offset = offsetof(a3d_vertex_packed, uv)}
+		}
+	}
+};
+
 static bool read_file_binary(const char* path, unsigned char** data, size_t* size);
 static VkShaderModule create_shader_module(a3d* e, const unsigned char* data, size_t size);
+static VkShaderModule load_shader_module(a3d* e, const char* path);
 
-bool a3d_vk_create_graphics_pipeline(a3d* e)
+/* binds the pipeline with the frame's set, the bindless set and the dynamic state it leaves open */
+void a3d_vk_bind_graphics_pipeline(a3d* e, Uint32 frame, VkCommandBuffer cmd, a3d_vertex_format format)
 {
-	A3D_LOG_INFO("creating graphics pipeline");
+	VkDescriptorSet sets[2] = {e->vk.descriptors->frames[frame].set, e->vk.bindless->set};
+	a3d_vk_draw_constants constants = {
+		.models = e->vk.descriptors->frames[frame].models_index,
+		.normals = e->vk.descriptors->frames[frame].normals_index,
+		.instances = A3D_VK_BINDLESS_NONE
+	};
 
-	unsigned char* vertex_data = NULL;
-	unsigned char* fragment_data = NULL;
-	size_t vertex_size = 0;
-	size_t fragment_size = 0;
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, e->vk.pipelines[format]);
+	vkCmdBindDescriptorSets(
+		cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, e->vk.pipeline_layout,
+		0, 2, sets, 0, NULL
+	);
+	vkCmdPushConstants(
+		cmd, e->vk.pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+		0, sizeof(constants), &constants
+	);
 
-	if (!read_file_binary(A3D_SHADER_VERTEX_PATH, &vertex_data, &vertex_size))
-		return false;
+	VkViewport viewport = {
+		.x = 0.0f,
+		.y = 0.0f,
+		.width = e->vk.swapchain_extent.width,
+		.height = e->vk.swapchain_extent.height,
+		.minDepth = 0.0f,
+		.maxDepth = 1.0f
+	};
 
-	if (!read_file_binary(A3D_SHADER_FRAGMENT_PATH, &fragment_data, &fragment_size)) {
-		free(vertex_data);
-		return false;
-	}
+	VkRect2D scissor = {
+		.offset = {0, 0},
+		.extent = e->vk.swapchain_extent
+	};
 
-	VkShaderModule vertex_module = create_shader_module(e, vertex_data, vertex_size);
-	VkShaderModule fragment_module = create_shader_module(e, fragment_data, fragment_size);
+	vkCmdSetViewport(cmd, 0, 1, &viewport);
+	vkCmdSetScissor(cmd, 0, 1, &scissor);
+}
 
-	free(vertex_data);
-	free(fragment_data);
+bool a3d_vk_create_compute_pipeline(a3d* e, const char* path, VkPipelineLayout layout, VkPipeline* out_pipeline)
+{
+	A3D_LOG_INFO("creating compute pipeline from %s", path);
 
-	if (!vertex_module || !fragment_module) {
-		if (vertex_module)
-			vkDestroyShaderModule(e->vk.logical, vertex_module, NULL);
-		if (fragment_module)
-			vkDestroyShaderModule(e->vk.logical, fragment_module, NULL);
+	unsigned char* data = NULL;
+	size_t size = 0;
+	if (!read_file_binary(path, &data, &size))
 		return false;
-	}
 
-	/* shader stages */
-	VkPipelineShaderStageCreateInfo vertex_stage = {
-		.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-		.stage = VK_SHADER_STAGE_VERTEX_BIT,
-		.module = vertex_module,
-		.pName = "main"
-	};
+	VkShaderModule module = create_shader_module(e, data, size);
+	free(data);
+	if (!module)
+		return false;
 
-	VkPipelineShaderStageCreateInfo fragment_stage = {
-		.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-		.stage = VK_SHADER_STAGE_FRAGMENT_BIT,
-		.module = fragment_module,
-		.pName = "main"
+	VkComputePipelineCreateInfo pipeline_info = {
+		.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+		.stage = {
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			.stage = VK_SHADER_STAGE_COMPUTE_BIT,
+			.module = module,
+			.pName = "main"
+		},
+		.layout = layout
 	};
 
-	VkPipelineShaderStageCreateInfo stages[] = {vertex_stage, fragment_stage};
+	VkResult result = vkCreateComputePipelines(e->vk.logical, e->vk.pipeline_cache, 1, &pipeline_info, NULL, out_pipeline);
+	vkDestroyShaderModule(e->vk.logical, module, NULL);
 
-	/*
-	VkPipelineVertexInputStateCreateInfo vertex_input = {
-		.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-		.vertexBindingDescriptionCount = 0,
-		.pVertexBindingDescriptions = NULL,
-		.vertexAttributeDescriptionCount = 0,
-		.pVertexAttributeDescriptions = NULL,
-	};
-	*/
+	if (result != VK_SUCCESS) {
+		A3D_LOG_ERROR("vkCreateComputePipelines failed with code %d", result);
+		*out_pipeline = VK_NULL_HANDLE;
+		return false;
+	}
 
-	VkVertexInputBindingDescription binding = {
-		.binding = 0,
-		.stride = sizeof(a3d_vertex),
-		.inputRate = VK_VERTEX_INPUT_RATE_VERTEX
-	};
+	A3D_LOG_INFO("compute pipeline created");
+	return true;
+}
 
-	VkVertexInputAttributeDescription attributes[2] = {
-		{
-			.binding = 0,
-			.location = 0,
-			.format = VK_FORMAT_R32G32_SFLOAT,
-			.offset = offsetof(a3d_vertex, position)
-		},
-		{
-			.binding = 0,
-			.location = 1,
-			.format = VK_FORMAT_R32G32B32_SFLOAT,
-			.offset = offsetof(a3d_vertex, colour)
+/* one pipeline per vertex format, all sharing the layout and fixed function state */
+bool a3d_vk_create_graphics_pipeline(a3d* e)
+{
+	A3D_LOG_INFO("creating graphics pipelines");
+
+	VkShaderModule fragment_module = load_shader_module(e, A3D_SHADER_FRAGMENT_PATH);
+	if (!fragment_module)
+		return false;
+
+	VkShaderModule vertex_modules[A3D_VERTEX_FORMAT_COUNT] = {0};
+	for (Uint32 f = 0; f < A3D_VERTEX_FORMAT_COUNT; f++) {
+		vertex_modules[f] = load_shader_module(e, vertex_layouts[f].shader);
+		if (!vertex_modules[f]) {
+			for (Uint32 i = 0; i < f; i++)
+				vkDestroyShaderModule(e->vk.logical, vertex_modules[i], NULL);
+			vkDestroyShaderModule(e->vk.logical, fragment_module, NULL);
+			return false;
 		}
-	};
+	}
 
-	VkPipelineVertexInputStateCreateInfo vertex_input = {
-		.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-		.vertexBindingDescriptionCount = 1,
-		.pVertexBindingDescriptions = &binding,
-		.vertexAttributeDescriptionCount = 2,
-		.pVertexAttributeDescriptions = attributes,
-	};
+	/* shader stages and vertex input, generated per format */
+	VkPipelineShaderStageCreateInfo stages[A3D_VERTEX_FORMAT_COUNT][2];
+	VkVertexInputBindingDescription bindings[A3D_VERTEX_FORMAT_COUNT];
+	VkPipelineVertexInputStateCreateInfo vertex_inputs[A3D_VERTEX_FORMAT_COUNT];
+	for (Uint32 f = 0; f < A3D_VERTEX_FORMAT_COUNT; f++) {
+		const a3d_vk_vertex_layout* layout = &vertex_layouts[f];
+
+		stages[f][0] = (VkPipelineShaderStageCreateInfo){
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			.stage = VK_SHADER_STAGE_VERTEX_BIT,
+			.module = vertex_modules[f],
+			.pName = "main"
+		};
+		stages[f][1] = (VkPipelineShaderStageCreateInfo){
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			.stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+			.module = fragment_module,
+			.pName = "main"
+		};
+
+		bindings[f] = (VkVertexInputBindingDescription){
+			.binding = 0,
+			.stride = layout->stride,
+			.inputRate = VK_VERTEX_INPUT_RATE_VERTEX
+		};
+
+		vertex_inputs[f] = (VkPipelineVertexInputStateCreateInfo){
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+			.vertexBindingDescriptionCount = 1,
+			.pVertexBindingDescriptions = &bindings[f],
+			.vertexAttributeDescriptionCount = layout->attribute_count,
+			.pVertexAttributeDescriptions = layout->attributes
+		};
+	}
 
 	VkPipelineInputAssemblyStateCreateInfo input_assembly = {
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
@@ -108,27 +190,22 @@ bool a3d_vk_create_graphics_pipeline(a3d* e)
 		.primitiveRestartEnable = VK_FALSE,
 	};
 
-	/* viewport & scissor */
-	VkViewport viewport = {
-		.x = 0.0f,
-		.y = 0.0f,
-		.width = e->vk.swapchain_extent.width,
-		.height = e->vk.swapchain_extent.height,
-		.minDepth = 0.0f,
-		.maxDepth = 1.0f
+	/* viewport & scissor, set per command buffer so a resize keeps the pipeline */
+	VkPipelineViewportStateCreateInfo viewport_state = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+		.viewportCount = 1,
+		.scissorCount = 1
 	};
 
-	VkRect2D scissor = {
-		.offset = {0, 0},
-		.extent = e->vk.swapchain_extent
+	VkDynamicState dynamic_states[] = {
+		VK_DYNAMIC_STATE_VIEWPORT,
+		VK_DYNAMIC_STATE_SCISSOR
 	};
 
-	VkPipelineViewportStateCreateInfo viewport_state = {
-		.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
-		.viewportCount = 1,
-		.pViewports = &viewport,
-		.scissorCount = 1,
-		.pScissors = &scissor
+	VkPipelineDynamicStateCreateInfo dynamic_state = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+		.dynamicStateCount = 2,
+		.pDynamicStates = dynamic_states
 	};
 
 	/* rasterizer */
@@ -164,17 +241,19 @@ bool a3d_vk_create_graphics_pipeline(a3d* e)
 		.pAttachments = &color_blend_attachment
 	};
 
+	/* pipeline layout, set 0 holds the per-frame camera, set 1 the bindless arrays the push constants index */
+	VkDescriptorSetLayout set_layouts[2] = {e->vk.descriptors->layout, e->vk.bindless->layout};
+
 	VkPushConstantRange push_range = {
-		.stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+		.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
 		.offset = 0,
-		.size = sizeof(mat4)
+		.size = sizeof(a3d_vk_draw_constants)
 	};
 
-	/* pipeline layout */
 	VkPipelineLayoutCreateInfo layout_info = {
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-		.setLayoutCount = 0,
-		.pSetLayouts = NULL,
+		.setLayoutCount = 2,
+		.pSetLayouts = set_layouts,
 		.pushConstantRangeCount = 1,
 		.pPushConstantRanges = &push_range
 	};
@@ -182,7 +261,8 @@ bool a3d_vk_create_graphics_pipeline(a3d* e)
 	VkResult result = vkCreatePipelineLayout(e->vk.logical, &layout_info, NULL, &e->vk.pipeline_layout);
 	if (result != VK_SUCCESS) {
 		A3D_LOG_ERROR("vkCreatePipelineLayout failed with code %d", result);
-		vkDestroyShaderModule(e->vk.logical, vertex_module, NULL);
+		for (Uint32 f = 0; f < A3D_VERTEX_FORMAT_COUNT; f++)
+			vkDestroyShaderModule(e->vk.logical, vertex_modules[f], NULL);
 		vkDestroyShaderModule(e->vk.logical, fragment_module, NULL);
 		return false;
 	}
@@ -197,49 +277,60 @@ bool a3d_vk_create_graphics_pipeline(a3d* e)
 		.stencilTestEnable = VK_FALSE
 	};
 
-	VkGraphicsPipelineCreateInfo pipeline_info = {
-		.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-		.stageCount = 2,
-		.pStages = stages,
-		.pVertexInputState = &vertex_input,
-		.pInputAssemblyState = &input_assembly,
-		.pViewportState = &viewport_state,
-		.pRasterizationState = &rasterizer,
-		.pMultisampleState = &multisampling,
-		.pDepthStencilState = &depth_state,
-		.pColorBlendState = &color_blend_state,
-		.pDynamicState = NULL,
-		.layout = e->vk.pipeline_layout,
-		.renderPass = e->vk.render_pass,
-		.subpass = 0
-	};
+	/* without a render pass the pipeline is built against the main pass's attachment formats */
+	VkPipelineRenderingCreateInfo rendering_info;
+	a3d_vk_graph_rendering_formats(e->vk.graph, e->vk.main_pass, &rendering_info);
+
+	VkGraphicsPipelineCreateInfo pipeline_infos[A3D_VERTEX_FORMAT_COUNT];
+	for (Uint32 f = 0; f < A3D_VERTEX_FORMAT_COUNT; f++) {
+		pipeline_infos[f] = (VkGraphicsPipelineCreateInfo){
+			.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+			.pNext = e->vk.dynamic_rendering ? &rendering_info : NULL,
+			.stageCount = 2,
+			.pStages = stages[f],
+			.pVertexInputState = &vertex_inputs[f],
+			.pInputAssemblyState = &input_assembly,
+			.pViewportState = &viewport_state,
+			.pRasterizationState = &rasterizer,
+			.pMultisampleState = &multisampling,
+			.pDepthStencilState = &depth_state,
+			.pColorBlendState = &color_blend_state,
+			.pDynamicState = &dynamic_state,
+			.layout = e->vk.pipeline_layout,
+			.renderPass = a3d_vk_graph_render_pass(e->vk.graph, e->vk.main_pass),
+			.subpass = 0
+		};
+	}
 
 	result = vkCreateGraphicsPipelines(
-		e->vk.logical, VK_NULL_HANDLE, 1,
-		&pipeline_info,NULL, &e->vk.pipeline
+		e->vk.logical, e->vk.pipeline_cache, A3D_VERTEX_FORMAT_COUNT,
+		pipeline_infos, NULL, e->vk.pipelines
 	);
 
 	/* shader modules not needed after pipeline baked */
-	vkDestroyShaderModule(e->vk.logical, vertex_module, NULL);
+	for (Uint32 f = 0; f < A3D_VERTEX_FORMAT_COUNT; f++)
+		vkDestroyShaderModule(e->vk.logical, vertex_modules[f], NULL);
 	vkDestroyShaderModule(e->vk.logical, fragment_module, NULL);
 
 	if (result != VK_SUCCESS) {
 		A3D_LOG_ERROR("vkCreateGraphicsPipelines failed with code %d", result);
-		vkDestroyPipelineLayout(e->vk.logical, e->vk.pipeline_layout, NULL);
-		e->vk.pipeline_layout = VK_NULL_HANDLE;
+		/* some may have been created before the failure */
+		a3d_vk_destroy_graphics_pipeline(e);
 		return false;
 	}
 
-	A3D_LOG_INFO("graphics pipeline created");
+	A3D_LOG_INFO("created %d graphics pipelines", A3D_VERTEX_FORMAT_COUNT);
 	return true;
 }
 
 void a3d_vk_destroy_graphics_pipeline(a3d* e)
 {
-	if (e->vk.pipeline) {
-		vkDestroyPipeline(e->vk.logical, e->vk.pipeline, NULL);
-		e->vk.pipeline = VK_NULL_HANDLE;
-		A3D_LOG_INFO("destroyed graphics pipeline");
+	for (Uint32 f = 0; f < A3D_VERTEX_FORMAT_COUNT; f++) {
+		if (e->vk.pipelines[f]) {
+			vkDestroyPipeline(e->vk.logical, e->vk.pipelines[f], NULL);
+			e->vk.pipelines[f] = VK_NULL_HANDLE;
+			A3D_LOG_INFO("destroyed graphics pipeline %u", f);
+		}
 	}
 
 	if (e->vk.pipeline_layout) {
@@ -311,3 +402,15 @@ static VkShaderModule create_shader_module(a3d* engine, const unsigned char* dat
 
 	return module;
 }
+
+static VkShaderModule load_shader_module(a3d* e, const char* path)
+{
+	unsigned char* data = NULL;
+	size_t size = 0;
+	if (!read_file_binary(path, &data, &size))
+		return VK_NULL_HANDLE;
+
+	VkShaderModule module = create_shader_module(e, data, size);
+	free(data);
+	return module;
+}
@@ -0,0 +1,203 @@
+#define A3D_LOG_SUBSYSTEM VULKAN
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL3/SDL.h>
+#include <vulkan/vulkan.h>
+
+#include "a3d.h"
+#include "a3d_logging.h"
+#include "vulkan/a3d_vulkan_pipeline_cache.h"
+
+static Uint64 checksum(const void* data, size_t size);
+static void make_header(a3d* e, a3d_vk_pipeline_cache_header* header, const void* data, size_t size);
+static void* read_cache_file(a3d* e, size_t* out_size);
+static bool validate_blob(a3d* e, const void* data, size_t size);
+
+bool a3d_vk_pipeline_cache_init(a3d* e)
+{
+	size_t size = 0;
+	void* data = read_cache_file(e, &size);
+
+	VkPipelineCacheCreateInfo cache_info = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+		.initialDataSize = size,
+		.pInitialData = data
+	};
+
+	VkResult r = vkCreatePipelineCache(e->vk.logical, &cache_info, NULL, &e->vk.pipeline_cache);
+	if (r != VK_SUCCESS && data) {
+		/* the driver disagreed with a blob we accepted, start over empty */
+		A3D_LOG_WARN("vkCreatePipelineCache rejected %zu cached bytes with code %d", size, r);
+		cache_info.initialDataSize = 0;
+		cache_info.pInitialData = NULL;
+		r = vkCreatePipelineCache(e->vk.logical, &cache_info, NULL, &e->vk.pipeline_cache);
+	}
+	free(data);
+
+	if (r != VK_SUCCESS) {
+		A3D_LOG_ERROR("vkCreatePipelineCache failed with code %d", r);
+		e->vk.pipeline_cache = VK_NULL_HANDLE;
+		return false;
+	}
+
+	A3D_LOG_INFO("created pipeline cache from %zu bytes", size);
+	return true;
+}
+
+bool a3d_vk_pipeline_cache_save(a3d* e)
+{
+	if (!e->vk.pipeline_cache)
+		return false;
+
+	size_t size = 0;
+	VkResult r = vkGetPipelineCacheData(e->vk.logical, e->vk.pipeline_cache, &size, NULL);
+	if (r != VK_SUCCESS || size == 0) {
+		A3D_LOG_WARN("no pipeline cache data to save (code %d)", r);
+		return false;
+	}
+
+	void* data = malloc(size);
+	if (!data) {
+		A3D_LOG_ERROR("out of memory saving %zu byte pipeline cache", size);
+		return false;
+	}
+
+	r = vkGetPipelineCacheData(e->vk.logical, e->vk.pipeline_cache, &size, data);
+	if (r != VK_SUCCESS) {
+		A3D_LOG_ERROR("vkGetPipelineCacheData failed with code %d", r);
+		free(data);
+		return false;
+	}
+
+	a3d_vk_pipeline_cache_header header;
+	make_header(e, &header, data, size);
+
+	/* write beside the old file and swap, a crash never leaves a torn cache */
+	const char* tmp_path = A3D_VK_PIPELINE_CACHE_PATH ".tmp";
+	FILE* file = fopen(tmp_path, "wb");
+	if (!file) {
+		A3D_LOG_ERROR("failed to open file %s", tmp_path);
+		free(data);
+		return false;
+	}
+
+	bool ok = fwrite(&header, sizeof header, 1, file) == 1 && fwrite(data, 1, size, file) == size;
+	ok = fclose(file) == 0 && ok;
+	free(data);
+
+	if (!ok || !SDL_RenamePath(tmp_path, A3D_VK_PIPELINE_CACHE_PATH)) {
+		A3D_LOG_ERROR("failed to write pipeline cache %s: %s", A3D_VK_PIPELINE_CACHE_PATH, ok ? SDL_GetError() : "short write");
+		SDL_RemovePath(tmp_path);
+		return false;
+	}
+
+	A3D_LOG_INFO("saved %zu byte pipeline cache to %s", size, A3D_VK_PIPELINE_CACHE_PATH);
+	return true;
+}
+
+void a3d_vk_pipeline_cache_shutdown(a3d* e)
+{
+	if (!e->vk.pipeline_cache)
+		return;
+
+	a3d_vk_pipeline_cache_save(e);
+
+	vkDestroyPipelineCache(e->vk.logical, e->vk.pipeline_cache, NULL);
+	e->vk.pipeline_cache = VK_NULL_HANDLE;
+	A3D_LOG_INFO("destroyed pipeline cache");
+}
+
+/* private */
+static Uint64 checksum(const void* data, size_t size)
+{
+	const Uint8* bytes = data;
+	Uint64 hash = 0xcbf29ce484222325ull;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+static void make_header(a3d* e, a3d_vk_pipeline_cache_header* header, const void* data, size_t size)
+{
+	VkPhysicalDeviceProperties props;
+	vkGetPhysicalDeviceProperties(e->vk.physical, &props);
+
+	memset(header, 0, sizeof *header);
+	header->magic = A3D_VK_PIPELINE_CACHE_MAGIC;
+	header->version = A3D_VK_PIPELINE_CACHE_VERSION;
+	header->vendor_id = props.vendorID;
+	header->device_id = props.deviceID;
+	header->driver_version = props.driverVersion;
+	memcpy(header->uuid, props.pipelineCacheUUID, VK_UUID_SIZE);
+	header->data_size = size;
+	header->checksum = data ? checksum(data, size) : 0;
+}
+
+/* returns the driver blob only if it was written by this exact device and driver */
+static void* read_cache_file(a3d* e, size_t* out_size)
+{
+	*out_size = 0;
+
+	FILE* file = fopen(A3D_VK_PIPELINE_CACHE_PATH, "rb");
+	if (!file) {
+		A3D_LOG_INFO("no pipeline cache at %s, starting cold", A3D_VK_PIPELINE_CACHE_PATH);
+		return NULL;
+	}
+
+	a3d_vk_pipeline_cache_header header;
+	a3d_vk_pipeline_cache_header expected;
+	make_header(e, &expected, NULL, 0);
+
+	if (fread(&header, sizeof header, 1, file) != 1 ||
+	    header.magic != expected.magic || header.version != expected.version ||
+	    header.vendor_id != expected.vendor_id || header.device_id != expected.device_id ||
+	    header.driver_version != expected.driver_version ||
+	    memcmp(header.uuid, expected.uuid, VK_UUID_SIZE) != 0 ||
+	    header.data_size == 0) {
+		A3D_LOG_WARN("discarding stale pipeline cache %s", A3D_VK_PIPELINE_CACHE_PATH);
+		fclose(file);
+		return NULL;
+	}
+
+	size_t size = (size_t)header.data_size;
+	void* data = malloc(size);
+	if (!data) {
+		A3D_LOG_ERROR("out of memory reading %zu byte pipeline cache", size);
+		fclose(file);
+		return NULL;
+	}
+
+	size_t read = fread(data, 1, size, file);
+	fclose(file);
+
+	if (read != size || checksum(data, size) != header.checksum || !validate_blob(e, data, size)) {
+		A3D_LOG_WARN("discarding corrupt pipeline cache %s", A3D_VK_PIPELINE_CACHE_PATH);
+		free(data);
+		return NULL;
+	}
+
+	*out_size = size;
+	return data;
+}
+
+/* the driver's own header has to agree with ours too */
+static bool validate_blob(a3d* e, const void* data, size_t size)
+{
+	VkPipelineCacheHeaderVersionOne blob;
+	if (size < sizeof blob)
+		return false;
+	memcpy(&blob, data, sizeof blob);
+
+	VkPhysicalDeviceProperties props;
+	vkGetPhysicalDeviceProperties(e->vk.physical, &props);
+
+	return blob.headerSize >= sizeof blob &&
+	       blob.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+	       blob.vendorID == props.vendorID &&
+	       blob.deviceID == props.deviceID &&
+	       memcmp(blob.pipelineCacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
@@ -0,0 +1,154 @@
+#define A3D_LOG_SUBSYSTEM VULKAN
+
+#include <stdlib.h>
+#include <vulkan/vulkan.h>
+
+#include "a3d.h"
+#include "a3d_logging.h"
+#include "a3d_profiler.h"
+#include "vulkan/a3d_vulkan_profiler.h"
+
+static void collect(a3d* e, Uint32 frame);
+
+bool a3d_vk_create_profiler(a3d* e)
+{
+	Uint32 families_count = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(e->vk.physical, &families_count, NULL);
+	VkQueueFamilyProperties* families = malloc(families_count * sizeof *families);
+	if (!families) {
+		A3D_LOG_ERROR("failed to allocate queue family properties");
+		return false;
+	}
+	vkGetPhysicalDeviceQueueFamilyProperties(e->vk.physical, &families_count, families);
+	Uint32 valid_bits = families[e->vk.graphics_family].timestampValidBits;
+	free(families);
+
+	/* optional, cpu scopes still work without it */
+	if (valid_bits == 0) {
+		A3D_LOG_WARN("graphics queue has no timestamps, gpu profiling disabled");
+		return true;
+	}
+
+	a3d_vk_profiler* p = calloc(1, sizeof *p);
+	if (!p) {
+		A3D_LOG_ERROR("failed to allocate profiler");
+		return false;
+	}
+	e->vk.profiler = p;
+
+	VkPhysicalDeviceProperties props;
+	vkGetPhysicalDeviceProperties(e->vk.physical, &props);
+	p->period = props.limits.timestampPeriod;
+	p->mask = valid_bits >= 64 ? UINT64_MAX : ((Uint64)1 << valid_bits) - 1;
+
+	VkQueryPoolCreateInfo pool_info = {
+		.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+		.queryType = VK_QUERY_TYPE_TIMESTAMP,
+		.queryCount = 2 * A3D_VK_PROFILER_SCOPES
+	};
+
+	for (Uint32 i = 0; i < A3D_VK_FRAMES_IN_FLIGHT; i++) {
+		VkResult r = vkCreateQueryPool(e->vk.logical, &pool_info, NULL, &p->pools[i]);
+		if (r != VK_SUCCESS) {
+			A3D_LOG_ERROR("failed to create timestamp query pool with code %d", r);
+			a3d_vk_destroy_profiler(e);
+			return false;
+		}
+	}
+
+	A3D_LOG_INFO("created gpu profiler, %u valid timestamp bits at %.2f ns per tick", valid_bits, p->period);
+	return true;
+}
+
+void a3d_vk_destroy_profiler(a3d* e)
+{
+	a3d_vk_profiler* p = e->vk.profiler;
+	if (!p)
+		return;
+
+	for (Uint32 i = 0; i < A3D_VK_FRAMES_IN_FLIGHT; i++)
+		if (p->pools[i])
+			vkDestroyQueryPool(e->vk.logical, p->pools[i], NULL);
+
+	free(p);
+	e->vk.profiler = NULL;
+	A3D_LOG_INFO("destroyed gpu profiler");
+}
+
+/* right after vkBeginCommandBuffer, once the slot's timeline value has been waited on */
+void a3d_vk_profiler_begin(a3d* e, Uint32 frame, VkCommandBuffer cmd)
+{
+	a3d_vk_profiler* p = e->vk.profiler;
+	if (!p)
+		return;
+
+	if (p->pending[frame])
+		collect(e, frame);
+
+	vkCmdResetQueryPool(cmd, p->pools[frame], 0, 2 * A3D_VK_PROFILER_SCOPES);
+	p->scope_count[frame] = 0;
+}
+
+/* outside any render pass; returns a handle for a3d_vk_profiler_scope_end */
+Uint32 a3d_vk_profiler_scope_begin(a3d* e, Uint32 frame, VkCommandBuffer cmd, const char* name)
+{
+	a3d_vk_profiler* p = e->vk.profiler;
+	if (!p || p->scope_count[frame] == A3D_VK_PROFILER_SCOPES)
+		return UINT32_MAX;
+
+	Uint32 scope = p->scope_count[frame]++;
+	p->names[frame][scope] = name;
+	vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, p->pools[frame], 2 * scope);
+	return scope;
+}
+
+void a3d_vk_profiler_scope_end(a3d* e, Uint32 frame, VkCommandBuffer cmd, Uint32 scope)
+{
+	a3d_vk_profiler* p = e->vk.profiler;
+	if (!p || scope == UINT32_MAX)
+		return;
+
+	vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, p->pools[frame], 2 * scope + 1);
+}
+
+void a3d_vk_profiler_submitted(a3d* e, Uint32 frame)
+{
+	a3d_vk_profiler* p = e->vk.profiler;
+	if (!p || p->scope_count[frame] == 0)
+		return;
+
+	p->submit_ns[frame] = SDL_GetTicksNS();
+	p->frames[frame] = a3d_profiler_frame();
+	p->pending[frame] = true;
+}
+
+/* private */
+static void collect(a3d* e, Uint32 frame)
+{
+	a3d_vk_profiler* p = e->vk.profiler;
+	p->pending[frame] = false;
+
+	Uint64 ticks[2 * A3D_VK_PROFILER_SCOPES];
+	Uint32 count = p->scope_count[frame];
+
+	/* no wait flag, the slot's wait already covers it; NOT_READY means a scope was never closed */
+	VkResult r = vkGetQueryPoolResults(
+		e->vk.logical, p->pools[frame], 0, 2 * count,
+		sizeof ticks, ticks, sizeof *ticks, VK_QUERY_RESULT_64_BIT
+	);
+	if (r != VK_SUCCESS) {
+		A3D_LOG_DEBUG("skipping gpu timings for slot %u, results returned code %d", frame, r);
+		return;
+	}
+
+	/* no calibrated timestamps, so the first one is pinned to the submit time */
+	Uint64 base = ticks[0];
+	for (Uint32 i = 0; i < count; i++) {
+		Uint64 start = (Uint64)(((ticks[2 * i] - base) & p->mask) * p->period);
+		Uint64 end = (Uint64)(((ticks[2 * i + 1] - base) & p->mask) * p->period);
+		a3d_profiler_record_frame(
+			p->names[frame][i], p->submit_ns[frame] + start,
+			p->submit_ns[frame] + end, p->frames[frame], true
+		);
+	}
+}
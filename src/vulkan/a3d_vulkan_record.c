@@ -0,0 +1,225 @@
+#define A3D_LOG_SUBSYSTEM VULKAN
+
+#include <stdlib.h>
+#include <SDL3/SDL.h>
+#include <vulkan/vulkan.h>
+
+#include "a3d.h"
+#include "a3d_job.h"
+#include "a3d_logging.h"
+#include "a3d_mesh.h"
+#include "a3d_renderer.h"
+#include "vulkan/a3d_vulkan_graph.h"
+#include "vulkan/a3d_vulkan_pipeline.h"
+#include "vulkan/a3d_vulkan_record.h"
+
+static bool create_worker_pools(a3d* e, a3d_vk_record_worker* w);
+static bool record_chunk(a3d_vk_recorder* rec, a3d_vk_record_worker* w);
+static void record_chunks(void* data, Uint32 first, Uint32 count);
+
+bool a3d_vk_create_recorder(a3d* e)
+{
+	a3d_vk_recorder* rec = calloc(1, sizeof *rec);
+	if (!rec) {
+		A3D_LOG_ERROR("failed to allocate recorder");
+		return false;
+	}
+	rec->e = e;
+	e->vk.recorder = rec;
+
+	/* more chunks than job workers would only queue behind each other */
+	Uint32 count = a3d_job_worker_count();
+	if (A3D_VK_RECORD_THREADS != 0 && count > A3D_VK_RECORD_THREADS)
+		count = A3D_VK_RECORD_THREADS;
+	if (count > A3D_VK_MAX_RECORD_THREADS)
+		count = A3D_VK_MAX_RECORD_THREADS;
+
+	for (Uint32 i = 0; i < count; i++) {
+		if (!create_worker_pools(e, &rec->workers[i])) {
+			a3d_vk_destroy_recorder(e);
+			return false;
+		}
+		rec->worker_count++;
+	}
+
+	A3D_LOG_INFO("recording up to %u secondaries on the job system", rec->worker_count);
+	return true;
+}
+
+void a3d_vk_destroy_recorder(a3d* e)
+{
+	a3d_vk_recorder* rec = e->vk.recorder;
+	if (!rec)
+		return;
+
+	/* workers past worker_count never got pools, the failed one may have some */
+	for (Uint32 i = 0; i < A3D_VK_MAX_RECORD_THREADS; i++) {
+		a3d_vk_record_worker* w = &rec->workers[i];
+
+		/* frees the secondaries too */
+		for (Uint32 f = 0; f < A3D_VK_FRAMES_IN_FLIGHT; f++)
+			if (w->pools[f])
+				vkDestroyCommandPool(e->vk.logical, w->pools[f], NULL);
+	}
+
+	free(rec);
+	e->vk.recorder = NULL;
+	A3D_LOG_INFO("destroyed recorder");
+}
+
+void a3d_vk_record_batches(a3d* e, Uint32 frame, VkCommandBuffer cmd, const a3d_draw_batch* batches, Uint32 count)
+{
+	/* batches arrive sorted by state, so only rebind when it actually changes */
+	VkPipeline bound_pipeline = VK_NULL_HANDLE;
+	VkBuffer bound_vertices = VK_NULL_HANDLE;
+	VkBuffer bound_indices = VK_NULL_HANDLE;
+
+	/* instance i of a batch reads models[first + i] through gl_InstanceIndex */
+	for (Uint32 j = 0; j < count; j++) {
+		const a3d_mesh* mesh = batches[j].mesh;
+		if (!mesh)
+			continue;
+
+		if (bound_pipeline != e->vk.pipelines[mesh->format]) {
+			a3d_vk_bind_graphics_pipeline(e, frame, cmd, mesh->format);
+			bound_pipeline = e->vk.pipelines[mesh->format];
+		}
+
+		if (bound_vertices != mesh->vertex_buffer.buff || bound_indices != mesh->index_buffer.buff) {
+			a3d_bind_mesh(e, mesh, &cmd);
+			bound_vertices = mesh->vertex_buffer.buff;
+			bound_indices = mesh->index_buffer.buff;
+		}
+
+		a3d_draw_mesh(e, mesh, &cmd, batches[j].first, batches[j].count);
+	}
+}
+
+bool a3d_vk_record_secondary(
+	a3d* e, Uint32 frame, Uint32 image, const a3d_draw_batch* batches, Uint32 count,
+	VkCommandBuffer* out_cmds, Uint32* out_count
+)
+{
+	a3d_vk_recorder* rec = e->vk.recorder;
+
+	Uint32 workers = count / A3D_VK_RECORD_MIN_BATCHES;
+	if (workers > rec->worker_count)
+		workers = rec->worker_count;
+	if (workers == 0)
+		workers = 1;
+
+	/* contiguous chunks keep each secondary's bind elision intact */
+	rec->frame = frame;
+	rec->image = image;
+	Uint32 per_worker = count / workers;
+	Uint32 remainder = count % workers;
+	Uint32 first = 0;
+	for (Uint32 i = 0; i < workers; i++) {
+		a3d_vk_record_worker* w = &rec->workers[i];
+		w->batches = batches + first;
+		w->batch_count = per_worker + (i < remainder ? 1 : 0);
+		first += w->batch_count;
+	}
+
+	/* one chunk per index; the caller records some of them while it waits */
+	a3d_job_parallel_for(workers, 1, record_chunks, rec);
+
+	bool ok = true;
+	for (Uint32 i = 0; i < workers; i++) {
+		ok = ok && rec->workers[i].ok;
+		out_cmds[i] = rec->workers[i].cmds[frame];
+	}
+
+	*out_count = workers;
+	return ok;
+}
+
+/* private */
+static bool create_worker_pools(a3d* e, a3d_vk_record_worker* w)
+{
+	for (Uint32 f = 0; f < A3D_VK_FRAMES_IN_FLIGHT; f++) {
+		VkCommandPoolCreateInfo cmd_pool_info = {
+			.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+			.queueFamilyIndex = e->vk.graphics_family,
+			.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT
+		};
+
+		VkResult r = vkCreateCommandPool(e->vk.logical, &cmd_pool_info, NULL, &w->pools[f]);
+		if (r != VK_SUCCESS) {
+			A3D_LOG_ERROR("failed to create record command pool with code %d", r);
+			return false;
+		}
+
+		VkCommandBufferAllocateInfo allocate_info = {
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+			.commandPool = w->pools[f],
+			.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+			.commandBufferCount = 1
+		};
+
+		r = vkAllocateCommandBuffers(e->vk.logical, &allocate_info, &w->cmds[f]);
+		if (r != VK_SUCCESS) {
+			A3D_LOG_ERROR("failed to allocate secondary command buffer with code %d", r);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool record_chunk(a3d_vk_recorder* rec, a3d_vk_record_worker* w)
+{
+	a3d* e = rec->e;
+	VkCommandBuffer cmd = w->cmds[rec->frame];
+
+	/* the frame's last submit has retired, so the whole pool can go at once */
+	vkResetCommandPool(e->vk.logical, w->pools[rec->frame], 0);
+
+	/* under dynamic rendering the pass is described by its formats instead of a render pass */
+	VkPipelineRenderingCreateInfo formats;
+	a3d_vk_graph_rendering_formats(e->vk.graph, e->vk.main_pass, &formats);
+	VkCommandBufferInheritanceRenderingInfo rendering = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO,
+		.colorAttachmentCount = formats.colorAttachmentCount,
+		.pColorAttachmentFormats = formats.pColorAttachmentFormats,
+		.depthAttachmentFormat = formats.depthAttachmentFormat,
+		.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT
+	};
+
+	VkCommandBufferInheritanceInfo inheritance = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+		.pNext = e->vk.dynamic_rendering ? &rendering : NULL,
+		.renderPass = a3d_vk_graph_render_pass(e->vk.graph, e->vk.main_pass),
+		.subpass = 0,
+		.framebuffer = a3d_vk_graph_framebuffer(e->vk.graph, e->vk.main_pass, rec->image)
+	};
+
+	VkCommandBufferBeginInfo begin_info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+		.pInheritanceInfo = &inheritance
+	};
+
+	VkResult r = vkBeginCommandBuffer(cmd, &begin_info);
+	if (r != VK_SUCCESS) {
+		A3D_LOG_ERROR("vkBeginCommandBuffer failed with code %d", r);
+		return false;
+	}
+
+	a3d_vk_record_batches(e, rec->frame, cmd, w->batches, w->batch_count);
+
+	r = vkEndCommandBuffer(cmd);
+	if (r != VK_SUCCESS) {
+		A3D_LOG_ERROR("vkEndCommandBuffer failed with code %d", r);
+		return false;
+	}
+
+	return true;
+}
+
+static void record_chunks(void* data, Uint32 first, Uint32 count)
+{
+	a3d_vk_recorder* rec = data;
+	for (Uint32 i = first; i < first + count; i++)
+		rec->workers[i].ok = record_chunk(rec, &rec->workers[i]);
+}
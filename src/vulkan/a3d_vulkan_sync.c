@@ -0,0 +1,348 @@
+#define A3D_LOG_SUBSYSTEM VULKAN
+
+#include <stdlib.h>
+#include <vulkan/vulkan.h>
+
+#include "a3d.h"
+#include "a3d_logging.h"
+#include "vulkan/a3d_vulkan_buffer.h"
+#include "vulkan/a3d_vulkan_sync.h"
+
+static bool deferred_ready(a3d* e, const a3d_vk_deferred* d);
+static void push_deferred(a3d* e, a3d_vk_deferred* d);
+static void run_deferred(a3d* e, a3d_vk_deferred* d);
+
+static const char* const queue_names[A3D_VK_QUEUE_COUNT] = {"graphics", "transfer", "compute"};
+
+/* runs every deferred destroy whose work has retired, without blocking */
+void a3d_vk_sync_collect(a3d* e)
+{
+	a3d_vk_sync* s = e->vk.sync;
+
+	while (s->deferred_count) {
+		a3d_vk_deferred* d = &s->deferred[s->deferred_head];
+		if (!deferred_ready(e, d))
+			break;
+
+		run_deferred(e, d);
+		s->deferred_head = (s->deferred_head + 1) % A3D_VK_SYNC_MAX_DEFERRED;
+		s->deferred_count--;
+	}
+}
+
+/* highest value the queue has reached; a failed query logs and falls back to the cached value */
+Uint64 a3d_vk_sync_completed(a3d* e, a3d_vk_queue_type queue)
+{
+	Uint64 value;
+	a3d_vk_sync_poll(e, queue, &value);
+	return value;
+}
+
+/* calls fn once everything submitted so far, on any queue, has finished */
+void a3d_vk_sync_defer(a3d* e, a3d_vk_sync_fn fn, void* data)
+{
+	a3d_vk_deferred d = {
+		.fn = fn,
+		.data = data
+	};
+	push_deferred(e, &d);
+}
+
+/* takes the buffer over and destroys it once no submitted work can still read it */
+void a3d_vk_sync_defer_buffer(a3d* e, a3d_buffer* buff)
+{
+	if (!buff->buff && !buff->alloc)
+		return;
+
+	a3d_vk_deferred d = {
+		.buffer = *buff
+	};
+	*buff = (a3d_buffer){0};
+	push_deferred(e, &d);
+}
+
+bool a3d_vk_sync_init(a3d* e)
+{
+	A3D_LOG_INFO("creating queue timelines");
+
+	a3d_vk_sync* s = calloc(1, sizeof *s);
+	if (!s) {
+		A3D_LOG_ERROR("failed to allocate sync state");
+		return false;
+	}
+	e->vk.sync = s;
+
+	/* compute may share a queue with graphics, its submissions still count on their own timeline */
+	s->timelines[A3D_VK_QUEUE_GRAPHICS].queue = e->vk.graphics_queue;
+	s->timelines[A3D_VK_QUEUE_TRANSFER].queue = e->vk.transfer_queue;
+	s->timelines[A3D_VK_QUEUE_COMPUTE].queue = e->vk.compute_queue;
+
+	VkSemaphoreTypeCreateInfo type_info = {
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+		.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+		.initialValue = 0
+	};
+	VkSemaphoreCreateInfo semaphore_info = {
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+		.pNext = &type_info
+	};
+
+	for (Uint32 i = 0; i < A3D_VK_QUEUE_COUNT; i++) {
+		VkResult r = vkCreateSemaphore(e->vk.logical, &semaphore_info, NULL, &s->timelines[i].timeline);
+		if (r != VK_SUCCESS) {
+			A3D_LOG_ERROR("failed to create %s timeline semaphore with code %d", queue_names[i], r);
+			a3d_vk_sync_shutdown(e);
+			return false;
+		}
+	}
+
+	A3D_LOG_INFO("created %u queue timelines", A3D_VK_QUEUE_COUNT);
+	return true;
+}
+
+/* what the queue's latest submission signals */
+a3d_vk_sync_point a3d_vk_sync_last(a3d* e, a3d_vk_queue_type queue)
+{
+	return (a3d_vk_sync_point){queue, e->vk.sync->timelines[queue].submitted};
+}
+
+/* what the queue's next submission will signal, e.g. for work recorded but not yet submitted */
+a3d_vk_sync_point a3d_vk_sync_next(a3d* e, a3d_vk_queue_type queue)
+{
+	return (a3d_vk_sync_point){queue, e->vk.sync->timelines[queue].submitted + 1};
+}
+
+/* like a3d_vk_sync_completed but fails when the driver can't be asked, e.g. on device loss;
+ * the driver is only asked if something is still outstanding */
+bool a3d_vk_sync_poll(a3d* e, a3d_vk_queue_type queue, Uint64* out_value)
+{
+	a3d_vk_timeline* t = &e->vk.sync->timelines[queue];
+	*out_value = t->completed;
+	if (t->completed >= t->submitted)
+		return true;
+
+	Uint64 value = 0;
+	VkResult r = vkGetSemaphoreCounterValue(e->vk.logical, t->timeline, &value);
+	if (r != VK_SUCCESS) {
+		A3D_LOG_ERROR("vkGetSemaphoreCounterValue failed with code %d", r);
+		return false;
+	}
+
+	if (value > t->completed)
+		t->completed = value;
+	*out_value = t->completed;
+	return true;
+}
+
+bool a3d_vk_sync_reached(a3d* e, a3d_vk_sync_point point)
+{
+	/* the common case never leaves the cache */
+	if (point.value <= e->vk.sync->timelines[point.queue].completed)
+		return true;
+
+	return point.value <= a3d_vk_sync_completed(e, point.queue);
+}
+
+/* the device must be idle, which a3d_vk_shutdown sees to; deferred destroys all run */
+void a3d_vk_sync_shutdown(a3d* e)
+{
+	a3d_vk_sync* s = e->vk.sync;
+	if (!s)
+		return;
+
+	for (; s->deferred_count; s->deferred_count--) {
+		run_deferred(e, &s->deferred[s->deferred_head]);
+		s->deferred_head = (s->deferred_head + 1) % A3D_VK_SYNC_MAX_DEFERRED;
+	}
+
+	for (Uint32 i = 0; i < A3D_VK_QUEUE_COUNT; i++)
+		if (s->timelines[i].timeline)
+			vkDestroySemaphore(e->vk.logical, s->timelines[i].timeline, NULL);
+
+	free(s);
+	e->vk.sync = NULL;
+	A3D_LOG_INFO("destroyed queue timelines");
+}
+
+/* submits and signals the queue's next value; waits on points other queues have already reached are dropped */
+bool a3d_vk_sync_submit(a3d* e, a3d_vk_queue_type queue, const a3d_vk_submission* submission, a3d_vk_sync_point* out_point)
+{
+	a3d_vk_sync* s = e->vk.sync;
+	a3d_vk_timeline* t = &s->timelines[queue];
+
+	/* binary semaphores ignore their value */
+	VkSemaphore wait_semaphores[A3D_VK_SYNC_MAX_WAITS + 1];
+	Uint64 wait_values[A3D_VK_SYNC_MAX_WAITS + 1];
+	VkPipelineStageFlags wait_stages[A3D_VK_SYNC_MAX_WAITS + 1];
+	Uint32 wait_count = 0;
+
+	if (submission->binary_wait) {
+		wait_semaphores[wait_count] = submission->binary_wait;
+		wait_values[wait_count] = 0;
+		wait_stages[wait_count] = submission->binary_wait_stage;
+		wait_count++;
+	}
+
+	for (Uint32 i = 0; i < submission->wait_count; i++) {
+		a3d_vk_sync_point point = submission->waits[i];
+		if (point.value <= s->timelines[point.queue].completed)
+			continue;
+
+		wait_semaphores[wait_count] = s->timelines[point.queue].timeline;
+		wait_values[wait_count] = point.value;
+		wait_stages[wait_count] = submission->wait_stages[i];
+		wait_count++;
+	}
+
+	Uint64 value = t->submitted + 1;
+	VkSemaphore signal_semaphores[] = {t->timeline, submission->binary_signal};
+	Uint64 signal_values[] = {value, 0};
+	Uint32 signal_count = submission->binary_signal ? 2 : 1;
+
+	VkTimelineSemaphoreSubmitInfo timeline_info = {
+		.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+		.waitSemaphoreValueCount = wait_count,
+		.pWaitSemaphoreValues = wait_values,
+		.signalSemaphoreValueCount = signal_count,
+		.pSignalSemaphoreValues = signal_values
+	};
+
+	VkSubmitInfo submit = {
+		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+		.pNext = &timeline_info,
+		.waitSemaphoreCount = wait_count,
+		.pWaitSemaphores = wait_semaphores,
+		.pWaitDstStageMask = wait_stages,
+		.commandBufferCount = submission->cmd_count,
+		.pCommandBuffers = submission->cmds,
+		.signalSemaphoreCount = signal_count,
+		.pSignalSemaphores = signal_semaphores
+	};
+
+	VkResult r = vkQueueSubmit(t->queue, 1, &submit, VK_NULL_HANDLE);
+	if (r != VK_SUCCESS) {
+		A3D_LOG_ERROR("vkQueueSubmit on the %s queue failed with code %d", queue_names[queue], r);
+		return false;
+	}
+
+	t->submitted = value;
+	if (out_point)
+		*out_point = (a3d_vk_sync_point){queue, value};
+	return true;
+}
+
+/* blocks until the point is reached */
+bool a3d_vk_sync_wait(a3d* e, a3d_vk_sync_point point)
+{
+	if (a3d_vk_sync_reached(e, point))
+		return true;
+
+	a3d_vk_timeline* t = &e->vk.sync->timelines[point.queue];
+	VkSemaphoreWaitInfo wait_info = {
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+		.semaphoreCount = 1,
+		.pSemaphores = &t->timeline,
+		.pValues = &point.value
+	};
+
+	VkResult r = vkWaitSemaphores(e->vk.logical, &wait_info, UINT64_MAX);
+	if (r != VK_SUCCESS) {
+		A3D_LOG_ERROR("vkWaitSemaphores failed with code %d", r);
+		return false;
+	}
+
+	t->completed = point.value;
+	return true;
+}
+
+/* blocks until every queue has finished everything submitted, then runs the deferred destroys */
+bool a3d_vk_sync_wait_idle(a3d* e)
+{
+	a3d_vk_sync* s = e->vk.sync;
+
+	VkSemaphore semaphores[A3D_VK_QUEUE_COUNT];
+	Uint64 values[A3D_VK_QUEUE_COUNT];
+	Uint32 count = 0;
+	for (Uint32 i = 0; i < A3D_VK_QUEUE_COUNT; i++) {
+		if (a3d_vk_sync_reached(e, a3d_vk_sync_last(e, i)))
+			continue;
+
+		semaphores[count] = s->timelines[i].timeline;
+		values[count] = s->timelines[i].submitted;
+		count++;
+	}
+
+	if (count) {
+		VkSemaphoreWaitInfo wait_info = {
+			.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+			.semaphoreCount = count,
+			.pSemaphores = semaphores,
+			.pValues = values
+		};
+
+		VkResult r = vkWaitSemaphores(e->vk.logical, &wait_info, UINT64_MAX);
+		if (r != VK_SUCCESS) {
+			A3D_LOG_ERROR("vkWaitSemaphores failed with code %d", r);
+			return false;
+		}
+
+		for (Uint32 i = 0; i < A3D_VK_QUEUE_COUNT; i++)
+			s->timelines[i].completed = s->timelines[i].submitted;
+	}
+
+	a3d_vk_sync_collect(e);
+	return true;
+}
+
+/* private */
+static bool deferred_ready(a3d* e, const a3d_vk_deferred* d)
+{
+	for (Uint32 i = 0; i < A3D_VK_QUEUE_COUNT; i++)
+		if (!a3d_vk_sync_reached(e, (a3d_vk_sync_point){i, d->values[i]}))
+			return false;
+
+	return true;
+}
+
+static void push_deferred(a3d* e, a3d_vk_deferred* d)
+{
+	a3d_vk_sync* s = e->vk.sync;
+
+	/* before init or after shutdown nothing can be in flight */
+	if (!s) {
+		run_deferred(e, d);
+		return;
+	}
+
+	for (Uint32 i = 0; i < A3D_VK_QUEUE_COUNT; i++)
+		d->values[i] = s->timelines[i].submitted;
+
+	/* nothing submitted since the queues last drained, so nothing can read it */
+	if (deferred_ready(e, d)) {
+		run_deferred(e, d);
+		return;
+	}
+
+	if (s->deferred_count == A3D_VK_SYNC_MAX_DEFERRED) {
+		A3D_LOG_WARN("deferred destroy queue full, waiting on the oldest");
+		a3d_vk_deferred* oldest = &s->deferred[s->deferred_head];
+		for (Uint32 i = 0; i < A3D_VK_QUEUE_COUNT; i++)
+			a3d_vk_sync_wait(e, (a3d_vk_sync_point){i, oldest->values[i]});
+
+		run_deferred(e, oldest);
+		s->deferred_head = (s->deferred_head + 1) % A3D_VK_SYNC_MAX_DEFERRED;
+		s->deferred_count--;
+	}
+
+	Uint32 tail = (s->deferred_head + s->deferred_count) % A3D_VK_SYNC_MAX_DEFERRED;
+	s->deferred[tail] = *d;
+	s->deferred_count++;
+}
+
+static void run_deferred(a3d* e, a3d_vk_deferred* d)
+{
+	if (d->fn)
+		d->fn(e, d->data);
+	else
+		a3d_vk_destroy_buffer(e, &d->buffer);
+}
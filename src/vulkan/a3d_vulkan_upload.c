@@ -0,0 +1,305 @@
+#define A3D_LOG_SUBSYSTEM VULKAN
+
+#include <stdlib.h>
+#include <string.h>
+#include <vulkan/vulkan.h>
+
+#include "a3d.h"
+#include "a3d_logging.h"
+#include "vulkan/a3d_vulkan_buffer.h"
+#include "vulkan/a3d_vulkan_sync.h"
+#include "vulkan/a3d_vulkan_upload.h"
+
+static bool begin_batch(a3d* e);
+static bool reserve(a3d* e, VkDeviceSize size, VkDeviceSize* out_offset);
+static bool retire(a3d* e, bool wait, bool* out_retired);
+static bool submit_batch(a3d* e);
+
+bool a3d_vk_upload_buffer(a3d* e, a3d_buffer* dst, VkDeviceSize dst_offset, const void* data, VkDeviceSize size)
+{
+	a3d_vk_uploader* u = e->vk.uploader;
+	const char* src = data;
+
+	for (VkDeviceSize done = 0; done < size;) {
+		VkDeviceSize chunk = size - done;
+		if (chunk > A3D_VK_STAGING_CHUNK)
+			chunk = A3D_VK_STAGING_CHUNK;
+
+		/* reserve first: a full ring submits the current batch */
+		VkDeviceSize offset;
+		if (!reserve(e, chunk, &offset) || !begin_batch(e))
+			return false;
+
+		memcpy((char*)u->staging.alloc->mapped + offset, src + done, chunk);
+
+		a3d_vk_upload_batch* batch = &u->batches[u->current];
+		VkBufferCopy region = {
+			.srcOffset = offset,
+			.dstOffset = dst_offset + done,
+			.size = chunk
+		};
+		vkCmdCopyBuffer(batch->cmd, u->staging.buff, dst->buff, 1, &region);
+		batch->copy_count++;
+
+		done += chunk;
+	}
+
+	return true;
+}
+
+/* highest timeline value the transfer queue has reached */
+Uint64 a3d_vk_upload_completed(a3d* e)
+{
+	return a3d_vk_sync_completed(e, A3D_VK_QUEUE_TRANSFER);
+}
+
+/* copies from a caller owned host visible buffer, which must stay untouched until
+ * a3d_vk_upload_completed reaches *out_value */
+bool a3d_vk_upload_copy(
+	a3d* e, const a3d_buffer* src, VkDeviceSize src_offset, a3d_buffer* dst, VkDeviceSize dst_offset,
+	VkDeviceSize size, Uint64* out_value
+)
+{
+	a3d_vk_uploader* u = e->vk.uploader;
+	if (!begin_batch(e))
+		return false;
+
+	a3d_vk_upload_batch* batch = &u->batches[u->current];
+	VkBufferCopy region = {
+		.srcOffset = src_offset,
+		.dstOffset = dst_offset,
+		.size = size
+	};
+	vkCmdCopyBuffer(batch->cmd, src->buff, dst->buff, 1, &region);
+	batch->copy_count++;
+
+	/* the batch being recorded is always the next one submitted to the transfer queue */
+	*out_value = a3d_vk_sync_next(e, A3D_VK_QUEUE_TRANSFER).value;
+	return true;
+}
+
+bool a3d_vk_upload_flush(a3d* e)
+{
+	a3d_vk_uploader* u = e->vk.uploader;
+
+	if (u->recording && u->batches[u->current].copy_count)
+		if (!submit_batch(e))
+			return false;
+
+	/* recycle whatever already landed without blocking */
+	return retire(e, false, NULL);
+}
+
+bool a3d_vk_upload_init(a3d* e)
+{
+	A3D_LOG_INFO("creating upload queue on family %u", e->vk.transfer_family);
+
+	a3d_vk_uploader* u = calloc(1, sizeof *u);
+	if (!u) {
+		A3D_LOG_ERROR("failed to allocate uploader");
+		return false;
+	}
+	e->vk.uploader = u;
+
+	VkCommandPoolCreateInfo cmd_pool_info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+		.queueFamilyIndex = e->vk.transfer_family,
+		.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT
+	};
+
+	VkResult r = vkCreateCommandPool(e->vk.logical, &cmd_pool_info, NULL, &u->cmd_pool);
+	if (r != VK_SUCCESS) {
+		A3D_LOG_ERROR("failed to create upload command pool with code %d", r);
+		a3d_vk_upload_shutdown(e);
+		return false;
+	}
+
+	VkCommandBuffer cmd_buffs[A3D_VK_UPLOAD_BATCHES];
+	VkCommandBufferAllocateInfo allocate_info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+		.commandPool = u->cmd_pool,
+		.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+		.commandBufferCount = A3D_VK_UPLOAD_BATCHES
+	};
+
+	r = vkAllocateCommandBuffers(e->vk.logical, &allocate_info, cmd_buffs);
+	if (r != VK_SUCCESS) {
+		A3D_LOG_ERROR("failed to allocate upload command buffers with code %d", r);
+		a3d_vk_upload_shutdown(e);
+		return false;
+	}
+	for (Uint32 i = 0; i < A3D_VK_UPLOAD_BATCHES; i++)
+		u->batches[i].cmd = cmd_buffs[i];
+
+	bool ok = a3d_vk_create_buffer(
+		e, A3D_VK_STAGING_SIZE, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&u->staging, NULL
+	);
+	if (!ok) {
+		A3D_LOG_ERROR("failed to create staging buffer");
+		a3d_vk_upload_shutdown(e);
+		return false;
+	}
+
+	A3D_LOG_INFO("created %" SDL_PRIu64 " byte staging ring", (Uint64)A3D_VK_STAGING_SIZE);
+	return true;
+}
+
+void a3d_vk_upload_shutdown(a3d* e)
+{
+	a3d_vk_uploader* u = e->vk.uploader;
+	if (!u)
+		return;
+
+	if (u->cmd_pool)
+		a3d_vk_upload_wait_idle(e);
+
+	a3d_vk_destroy_buffer(e, &u->staging);
+
+	/* frees the batch command buffers too */
+	if (u->cmd_pool)
+		vkDestroyCommandPool(e->vk.logical, u->cmd_pool, NULL);
+
+	free(u);
+	e->vk.uploader = NULL;
+	A3D_LOG_INFO("destroyed uploader");
+}
+
+bool a3d_vk_upload_wait_idle(a3d* e)
+{
+	if (!a3d_vk_upload_flush(e))
+		return false;
+
+	if (!a3d_vk_sync_wait(e, a3d_vk_sync_last(e, A3D_VK_QUEUE_TRANSFER)))
+		return false;
+
+	return retire(e, false, NULL);
+}
+
+/* private */
+static bool begin_batch(a3d* e)
+{
+	a3d_vk_uploader* u = e->vk.uploader;
+	if (u->recording)
+		return true;
+
+	/* a pending current batch is always the oldest one */
+	a3d_vk_upload_batch* batch = &u->batches[u->current];
+	if (batch->pending && !retire(e, true, NULL))
+		return false;
+
+	VkCommandBufferBeginInfo begin_info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+	};
+
+	VkResult r = vkBeginCommandBuffer(batch->cmd, &begin_info);
+	if (r != VK_SUCCESS) {
+		A3D_LOG_ERROR("vkBeginCommandBuffer failed with code %d", r);
+		return false;
+	}
+
+	batch->copy_count = 0;
+	u->recording = true;
+	return true;
+}
+
+static bool reserve(a3d* e, VkDeviceSize size, VkDeviceSize* out_offset)
+{
+	a3d_vk_uploader* u = e->vk.uploader;
+
+	for (;;) {
+		Uint64 start = (u->head + 15) & ~(Uint64)15;
+
+		/* never straddle the end of the ring */
+		Uint64 pos = start % A3D_VK_STAGING_SIZE;
+		if (pos + size > A3D_VK_STAGING_SIZE)
+			start += A3D_VK_STAGING_SIZE - pos;
+
+		if (start + size - u->tail <= A3D_VK_STAGING_SIZE) {
+			u->head = start + size;
+			*out_offset = start % A3D_VK_STAGING_SIZE;
+			return true;
+		}
+
+		/* ring is full: push out what is recorded and wait for the oldest batch */
+		if (u->recording && u->batches[u->current].copy_count && !submit_batch(e))
+			return false;
+
+		bool retired;
+		if (!retire(e, true, &retired))
+			return false;
+		if (!retired) {
+			A3D_LOG_ERROR("staging ring exhausted by a %" SDL_PRIu64 " byte upload", (Uint64)size);
+			return false;
+		}
+	}
+}
+
+/* fails only if the transfer timeline can't be read or waited on; out_retired may be NULL */
+static bool retire(a3d* e, bool wait, bool* out_retired)
+{
+	a3d_vk_uploader* u = e->vk.uploader;
+
+	if (out_retired)
+		*out_retired = false;
+
+	Uint64 done;
+	if (!a3d_vk_sync_poll(e, A3D_VK_QUEUE_TRANSFER, &done))
+		return false;
+
+	/* walk in submission order, which starts at the current slot */
+	for (Uint32 i = 0; i < A3D_VK_UPLOAD_BATCHES; i++) {
+		a3d_vk_upload_batch* batch = &u->batches[(u->current + i) % A3D_VK_UPLOAD_BATCHES];
+		if (!batch->pending)
+			continue;
+
+		if (batch->value > done) {
+			if (!wait)
+				break;
+
+			if (!a3d_vk_sync_wait(e, (a3d_vk_sync_point){A3D_VK_QUEUE_TRANSFER, batch->value}))
+				return false;
+			done = batch->value;
+			wait = false; /* only ever block on the oldest */
+		}
+
+		batch->pending = false;
+		u->tail = batch->ring_end;
+		if (out_retired)
+			*out_retired = true;
+	}
+
+	return true;
+}
+
+static bool submit_batch(a3d* e)
+{
+	a3d_vk_uploader* u = e->vk.uploader;
+	a3d_vk_upload_batch* batch = &u->batches[u->current];
+
+	VkResult r = vkEndCommandBuffer(batch->cmd);
+	if (r != VK_SUCCESS) {
+		A3D_LOG_ERROR("vkEndCommandBuffer failed with code %d", r);
+		return false;
+	}
+
+	a3d_vk_submission submission = {
+		.cmds = &batch->cmd,
+		.cmd_count = 1
+	};
+
+	a3d_vk_sync_point point;
+	if (!a3d_vk_sync_submit(e, A3D_VK_QUEUE_TRANSFER, &submission, &point))
+		return false;
+
+	A3D_LOG_DEBUG("submitted upload batch %" SDL_PRIu64 " with %u copies", point.value, batch->copy_count);
+
+	batch->value = point.value;
+	batch->ring_end = u->head;
+	batch->pending = true;
+	u->recording = false;
+	u->current = (u->current + 1) % A3D_VK_UPLOAD_BATCHES;
+	return true;
+}
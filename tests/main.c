@@ -11,6 +11,7 @@
 #include "a3d_event.h"
 #include "a3d_logging.h"
 #include "a3d_mesh.h"
+#include "a3d_profiler.h"
 #include "a3d_renderer.h"
 #include "a3d_transform.h"
 #include "vulkan/a3d_vulkan.h"
@@ -21,6 +22,10 @@ void on_key_down(a3d* engine, const SDL_Event* ev)
 {
 	(void)engine;
 	A3D_LOG_INFO("key pressed: %s", SDL_GetKeyName(ev->key.key));
+
+	/* open in chrome://tracing or ui.perfetto.dev */
+	if (ev->key.key == SDLK_F12)
+		a3d_profiler_write_trace("trace.json");
 }
 
 int main(void)
@@ -42,21 +47,23 @@ int main(void)
 	}
 
 	/* camera */
-	a3d_mvp mvp;
+	mat4 model;
+	mat4 view;
+	mat4 proj;
 	int w;
 	int h;
 	SDL_GetWindowSize(engine.window, &w, &h);
 
-	glm_mat4_identity(mvp.model);
-	glm_mat4_identity(mvp.view);
-	glm_mat4_identity(mvp.proj);
+	glm_mat4_identity(view);
+	glm_mat4_identity(proj);
 
 	glm_perspective(glm_rad(70.0f),
 		(float)w/(float)h,
 		0.1f, 100.0f,
-		mvp.proj
+		proj
 	);
-	mvp.proj[1][1] *= -1.0f;
+	proj[1][1] *= -1.0f;
+	a3d_set_camera(&engine, view, proj);
 
 	float t = 0.0f;
 
@@ -85,23 +92,25 @@ int main(void)
 
 		float x = sinf(t) * 2.0f;
 
-		glm_mat4_identity(mvp.model);
-		glm_translate(mvp.model, (vec3){x, pow(x, 3)-0.0f, -5.0f});
+		glm_mat4_identity(model);
+		glm_translate(model, (vec3){x, pow(x, 3)-0.0f, -5.0f});
 
 		/* build render queue for this frame: two triangles at different Z to test depth */
 		a3d_renderer_begin_frame(engine.renderer);
 
 		/* closer triangle (z = -4.2) */
-		a3d_mvp mvp_close = mvp;
-		glm_translate(mvp_close.model, (vec3){0.0f, 0.0f, 0.8f}); /* -5.0 + 0.8 = -4.2 */
-		glm_rotate(mvp_close.model, t, (vec3){0.0f, 0.0f, 1.0f});
-		a3d_submit_mesh(&engine, &triangle, &mvp_close);
+		mat4 model_close;
+		glm_mat4_copy(model, model_close);
+		glm_translate(model_close, (vec3){0.0f, 0.0f, 0.8f}); /* -5.0 + 0.8 = -4.2 */
+		glm_rotate(model_close, t, (vec3){0.0f, 0.0f, 1.0f});
+		a3d_submit_mesh(&engine, &triangle, model_close);
 
 		/* farther triangle (z = -5.6) */
-		a3d_mvp mvp_far = mvp;
-		glm_translate(mvp_far.model, (vec3){0.0f, 0.0f, -0.6f}); /* -5.0 - 0.6 = -5.6 */
-		glm_rotate(mvp_far.model, t, (vec3){0.0f, 0.0f, 1.0f});
-		a3d_submit_mesh(&engine, &triangle, &mvp_far);
+		mat4 model_far;
+		glm_mat4_copy(model, model_far);
+		glm_translate(model_far, (vec3){0.0f, 0.0f, -0.6f}); /* -5.0 - 0.6 = -5.6 */
+		glm_rotate(model_far, t, (vec3){0.0f, 0.0f, 1.0f});
+		a3d_submit_mesh(&engine, &triangle, model_far);
 
 		a3d_renderer_end_frame(engine.renderer);
 
@@ -0,0 +1,359 @@
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "a3d_mesh.h"
+#include "a3d_mesh_file.h"
+#include "a3d_vertex.h"
+
+/* offline OBJ to .a3dm converter; every input becomes one lod, the first is the full mesh */
+
+/* full precision until written out in the chosen vertex format */
+typedef struct {
+	float    position[3];
+	float    colour[3];
+	float    normal[3]; /* area weighted sum of the face normals, packed output only */
+} obj_vertex;
+
+typedef struct {
+	obj_vertex* vertices;
+	Uint32   vertex_count;
+	Uint32   vertex_capacity;
+
+	Uint16*  indices;
+	Uint32   index_count;
+	Uint32   index_capacity;
+} mesh_data;
+
+static bool add_index(mesh_data* m, Uint32 index);
+static bool add_vertex(mesh_data* m, const obj_vertex* v);
+static Uint64 align_up(Uint64 value);
+static void compute_normals(mesh_data* m);
+static bool parse_face_index(const char* token, Uint32 base, Uint32 count, Uint32* out_index);
+static bool parse_obj(const char* path, mesh_data* m);
+static bool write_mesh(
+	const char* path, const mesh_data* m, a3d_vertex_format format, const a3d_mesh_file_lod* lods, Uint32 lod_count
+);
+
+int main(int argc, char** argv)
+{
+	if (argc < 3) {
+		fprintf(
+			stderr,
+			"usage: %s out.a3dm [--packed] [--distance D] lod0.obj [[--distance D] lod1.obj ...]\n"
+			"  each lod is used up to its distance, the last one without a limit\n"
+			"  --packed writes a3d_vertex_packed: 3d positions, smooth normals, no uvs yet\n",
+			argv[0]
+		);
+		return EXIT_FAILURE;
+	}
+
+	mesh_data mesh = {0};
+	a3d_mesh_file_lod lods[A3D_MESH_FILE_MAX_LODS];
+	Uint32 lod_count = 0;
+	float distance = FLT_MAX;
+	a3d_vertex_format format = A3D_VERTEX_FORMAT_FLOAT;
+
+	for (int i = 2; i < argc; i++) {
+		if (strcmp(argv[i], "--packed") == 0) {
+			format = A3D_VERTEX_FORMAT_PACKED;
+			continue;
+		}
+		if (strcmp(argv[i], "--distance") == 0 && i + 1 < argc) {
+			distance = strtof(argv[++i], NULL);
+			continue;
+		}
+
+		if (lod_count == A3D_MESH_FILE_MAX_LODS) {
+			fprintf(stderr, "at most %d lods\n", A3D_MESH_FILE_MAX_LODS);
+			return EXIT_FAILURE;
+		}
+
+		Uint32 first_index = mesh.index_count;
+		if (!parse_obj(argv[i], &mesh))
+			return EXIT_FAILURE;
+
+		lods[lod_count++] = (a3d_mesh_file_lod){
+			.first_index = first_index,
+			.index_count = mesh.index_count - first_index,
+			.distance = distance
+		};
+		distance = FLT_MAX;
+	}
+
+	if (lod_count == 0 || lods[0].index_count == 0) {
+		fprintf(stderr, "no triangles in the input\n");
+		return EXIT_FAILURE;
+	}
+
+	if (format == A3D_VERTEX_FORMAT_PACKED)
+		compute_normals(&mesh);
+
+	bool ok = write_mesh(argv[1], &mesh, format, lods, lod_count);
+	if (ok)
+		printf(
+			"%s: %u vertices, %u indices, %u lods\n",
+			argv[1], mesh.vertex_count, mesh.index_count, lod_count
+		);
+
+	free(mesh.vertices);
+	free(mesh.indices);
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* private */
+static bool add_index(mesh_data* m, Uint32 index)
+{
+	if (m->index_count == m->index_capacity) {
+		Uint32 capacity = m->index_capacity ? m->index_capacity * 2 : 1024;
+		Uint16* indices = realloc(m->indices, capacity * sizeof *indices);
+		if (!indices)
+			return false;
+		m->indices = indices;
+		m->index_capacity = capacity;
+	}
+
+	m->indices[m->index_count++] = (Uint16)index;
+	return true;
+}
+
+static bool add_vertex(mesh_data* m, const obj_vertex* v)
+{
+	/* indices are 16 bit */
+	if (m->vertex_count > UINT16_MAX)
+		return false;
+
+	if (m->vertex_count == m->vertex_capacity) {
+		Uint32 capacity = m->vertex_capacity ? m->vertex_capacity * 2 : 1024;
+		obj_vertex* vertices = realloc(m->vertices, capacity * sizeof *vertices);
+		if (!vertices)
+			return false;
+		m->vertices = vertices;
+		m->vertex_capacity = capacity;
+	}
+
+	m->vertices[m->vertex_count++] = *v;
+	return true;
+}
+
+static Uint64 align_up(Uint64 value)
+{
+	return (value + A3D_MESH_FILE_ALIGN - 1) & ~(Uint64)(A3D_MESH_FILE_ALIGN - 1);
+}
+
+/* lods never share vertices, so summing over every triangle keeps them apart */
+static void compute_normals(mesh_data* m)
+{
+	for (Uint32 i = 0; i + 2 < m->index_count; i += 3) {
+		obj_vertex* a = &m->vertices[m->indices[i + 0]];
+		obj_vertex* b = &m->vertices[m->indices[i + 1]];
+		obj_vertex* c = &m->vertices[m->indices[i + 2]];
+
+		float u[3];
+		float v[3];
+		for (Uint32 k = 0; k < 3; k++) {
+			u[k] = b->position[k] - a->position[k];
+			v[k] = c->position[k] - a->position[k];
+		}
+
+		/* unnormalised, so bigger faces weigh more */
+		float n[3] = {
+			u[1] * v[2] - u[2] * v[1],
+			u[2] * v[0] - u[0] * v[2],
+			u[0] * v[1] - u[1] * v[0]
+		};
+		for (Uint32 k = 0; k < 3; k++) {
+			a->normal[k] += n[k];
+			b->normal[k] += n[k];
+			c->normal[k] += n[k];
+		}
+	}
+
+	for (Uint32 i = 0; i < m->vertex_count; i++) {
+		float* n = m->vertices[i].normal;
+		float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (length > 0.0f)
+			for (Uint32 k = 0; k < 3; k++)
+				n[k] /= length;
+	}
+}
+
+/* "v", "v/vt", "v//vn" or "v/vt/vn", 1 based or negative from the end */
+static bool parse_face_index(const char* token, Uint32 base, Uint32 count, Uint32* out_index)
+{
+	long index = strtol(token, NULL, 10);
+	if (index > 0 && (Uint32)index <= count)
+		*out_index = base + (Uint32)index - 1;
+	else if (index < 0 && (Uint32)-index <= count)
+		*out_index = base + count - (Uint32)-index;
+	else
+		return false;
+	return true;
+}
+
+/* positions and optional vertex colours, faces are fanned into triangles */
+static bool parse_obj(const char* path, mesh_data* m)
+{
+	FILE* file = fopen(path, "r");
+	if (!file) {
+		fprintf(stderr, "failed to open file %s\n", path);
+		return false;
+	}
+
+	/* obj indices are relative to this file's vertices */
+	Uint32 base = m->vertex_count;
+	char line[1024];
+	Uint32 line_number = 0;
+	bool ok = true;
+
+	while (ok && fgets(line, sizeof line, file)) {
+		line_number++;
+
+		if (line[0] == 'v' && line[1] == ' ') {
+			float p[3] = {0.0f, 0.0f, 0.0f};
+			float c[3] = {1.0f, 1.0f, 1.0f};
+			int n = sscanf(line + 2, "%f %f %f %f %f %f", &p[0], &p[1], &p[2], &c[0], &c[1], &c[2]);
+			if (n < 2) {
+				fprintf(stderr, "%s:%u: bad vertex\n", path, line_number);
+				ok = false;
+				break;
+			}
+			if (n != 6)
+				c[0] = c[1] = c[2] = 1.0f;
+
+			obj_vertex v = {
+				.position = {p[0], p[1], p[2]},
+				.colour = {c[0], c[1], c[2]}
+			};
+			if (!add_vertex(m, &v)) {
+				fprintf(stderr, "%s: more than %u vertices across all lods\n", path, UINT16_MAX + 1);
+				ok = false;
+			}
+		}
+		else if (line[0] == 'f' && line[1] == ' ') {
+			Uint32 corners[64];
+			Uint32 corner_count = 0;
+			for (char* token = strtok(line + 2, " \t\r\n"); token; token = strtok(NULL, " \t\r\n")) {
+				if (corner_count == 64 ||
+				    !parse_face_index(token, base, m->vertex_count - base, &corners[corner_count++])) {
+					fprintf(stderr, "%s:%u: bad face\n", path, line_number);
+					ok = false;
+					break;
+				}
+			}
+
+			/* one vertex stream serves every lod, so indices address all of it */
+			for (Uint32 i = 2; ok && i < corner_count; i++) {
+				if (!add_index(m, corners[0]) || !add_index(m, corners[i - 1]) || !add_index(m, corners[i])) {
+					fprintf(stderr, "out of memory\n");
+					ok = false;
+				}
+			}
+		}
+	}
+
+	fclose(file);
+	return ok;
+}
+
+static bool write_mesh(
+	const char* path, const mesh_data* m, a3d_vertex_format format, const a3d_mesh_file_lod* lods, Uint32 lod_count
+)
+{
+	Uint32 stride = a3d_vertex_format_stride(format);
+	a3d_mesh_file_header h = {
+		.magic = A3D_MESH_FILE_MAGIC,
+		.version = A3D_MESH_FILE_VERSION,
+		.vertex_size = stride,
+		.index_size = sizeof(Uint16),
+		.vertex_count = m->vertex_count,
+		.index_count = m->index_count,
+		.lod_count = lod_count,
+		.vertex_format = format
+	};
+	h.vertex_offset = align_up(sizeof h);
+	h.index_offset = align_up(h.vertex_offset + (Uint64)m->vertex_count * stride);
+	memcpy(h.lods, lods, lod_count * sizeof *lods);
+
+	/* the float layout is 2d, z is dropped and its bounds stay 0 */
+	Uint32 axes = format == A3D_VERTEX_FORMAT_PACKED ? 3 : 2;
+	bool dropped_z = false;
+
+	/* bounds over every lod's vertices */
+	for (Uint32 i = 0; i < m->vertex_count; i++) {
+		for (Uint32 k = 0; k < axes; k++) {
+			float v = m->vertices[i].position[k];
+			if (i == 0 || v < h.aabb_min[k])
+				h.aabb_min[k] = v;
+			if (i == 0 || v > h.aabb_max[k])
+				h.aabb_max[k] = v;
+		}
+		if (m->vertices[i].position[2] != 0.0f)
+			dropped_z = axes == 2;
+	}
+
+	float radius_sq = 0.0f;
+	for (Uint32 k = 0; k < 3; k++)
+		h.sphere[k] = 0.5f * (h.aabb_min[k] + h.aabb_max[k]);
+	for (Uint32 i = 0; i < m->vertex_count; i++) {
+		float d = 0.0f;
+		for (Uint32 k = 0; k < axes; k++)
+			d += (m->vertices[i].position[k] - h.sphere[k]) * (m->vertices[i].position[k] - h.sphere[k]);
+		if (d > radius_sq)
+			radius_sq = d;
+	}
+	h.sphere[3] = sqrtf(radius_sq);
+
+	if (dropped_z)
+		fprintf(stderr, "warning: a3d_vertex is 2D, z coordinates were dropped, use --packed to keep them\n");
+
+	/* a3d_vertex and a3d_vertex_packed are the same size, but go by the stride anyway */
+	unsigned char* vertices = malloc((size_t)m->vertex_count * stride + 1);
+	if (!vertices) {
+		fprintf(stderr, "out of memory\n");
+		return false;
+	}
+
+	for (Uint32 i = 0; i < m->vertex_count; i++) {
+		const obj_vertex* v = &m->vertices[i];
+		if (format == A3D_VERTEX_FORMAT_PACKED) {
+			float colour[4] = {v->colour[0], v->colour[1], v->colour[2], 1.0f};
+			a3d_pack_vertex(
+				v->position, v->normal, colour, NULL, h.aabb_min, h.aabb_max,
+				(a3d_vertex_packed*)vertices + i
+			);
+		}
+		else {
+			((a3d_vertex*)vertices)[i] = (a3d_vertex){
+				.position = {v->position[0], v->position[1]},
+				.colour = {v->colour[0], v->colour[1], v->colour[2]}
+			};
+		}
+	}
+
+	FILE* file = fopen(path, "wb");
+	if (!file) {
+		fprintf(stderr, "failed to open file %s\n", path);
+		free(vertices);
+		return false;
+	}
+
+	static const char zeros[A3D_MESH_FILE_ALIGN];
+	Uint64 vertex_end = h.vertex_offset + (Uint64)m->vertex_count * stride;
+
+	fwrite(&h, sizeof h, 1, file);
+	fwrite(zeros, 1, h.vertex_offset - sizeof h, file);
+	fwrite(vertices, stride, m->vertex_count, file);
+	fwrite(zeros, 1, h.index_offset - vertex_end, file);
+	fwrite(m->indices, sizeof(Uint16), m->index_count, file);
+	free(vertices);
+
+	if (fclose(file) != 0) {
+		fprintf(stderr, "short write for file %s\n", path);
+		return false;
+	}
+
+	return true;
+}